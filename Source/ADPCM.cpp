@@ -0,0 +1,276 @@
+#include "ADPCM.h"
+#include <algorithm>
+
+namespace
+{
+	// bytes of the per channel block header
+	constexpr unsigned int IMAHeaderBytes = 4;
+	constexpr unsigned int MSHeaderBytes = 7;
+	// IMA nibbles of one channel come in runs of 4 bytes
+	constexpr unsigned int IMAGroupFrames = 8;
+
+	constexpr int IMAStepTable[89] =
+	{
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+		19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+		50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+		130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+		337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+		876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+		2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+		5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+		15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+	};
+
+	constexpr int IMAIndexTable[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+	// only the standard coefficient set is accepted by WAVLoader
+	constexpr int MSCoef[7][2] = { { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 } };
+
+	constexpr int MSAdaptationTable[16] = { 230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230 };
+
+	int16_t ReadS16(const unsigned char* p)
+	{
+		return static_cast<int16_t>(p[0] | (p[1] << 8));
+	}
+
+	void PutS16(unsigned char* p, int16_t v)
+	{
+		p[0] = static_cast<unsigned char>(v & 0xff);
+		p[1] = static_cast<unsigned char>((v >> 8) & 0xff);
+	}
+
+	int16_t Clamp16(int v)
+	{
+		return static_cast<int16_t>(std::min(std::max(v, -32768), 32767));
+	}
+
+	struct IMAState
+	{
+		int predictor_;
+		int index_;
+	};
+
+	// shared by the encoder so both sides stay bit exact
+	int16_t DecodeIMANibble(IMAState& state, unsigned int nibble)
+	{
+		const int step = IMAStepTable[state.index_];
+		int diff = step >> 3;
+		if (nibble & 1) { diff += step >> 2; }
+		if (nibble & 2) { diff += step >> 1; }
+		if (nibble & 4) { diff += step; }
+
+		state.predictor_ = Clamp16((nibble & 8) ? state.predictor_ - diff : state.predictor_ + diff);
+		state.index_ = std::min(std::max(state.index_ + IMAIndexTable[nibble], 0), 88);
+		return static_cast<int16_t>(state.predictor_);
+	}
+
+	unsigned int EncodeIMANibble(IMAState& state, int sample)
+	{
+		int step = IMAStepTable[state.index_];
+		int diff = sample - state.predictor_;
+		unsigned int nibble = 0;
+		if (diff < 0)
+		{
+			nibble = 8;
+			diff = -diff;
+		}
+
+		for (unsigned int bit = 4; bit > 0; bit >>= 1)
+		{
+			if (diff >= step)
+			{
+				nibble |= bit;
+				diff -= step;
+			}
+			step >>= 1;
+		}
+
+		DecodeIMANibble(state, nibble);
+		return nibble;
+	}
+
+	unsigned int DecodeIMABlock(const ADPCMDesc& desc, const unsigned char* block, unsigned int bytes, int16_t* out)
+	{
+		const unsigned int channel = desc.channel_;
+		IMAState state[2] = {};
+		for (unsigned int c = 0; c < channel; c++)
+		{
+			const unsigned char* h = &block[c * IMAHeaderBytes];
+			state[c].predictor_ = ReadS16(h);
+			state[c].index_ = std::min<int>(h[2], 88);
+			out[c] = static_cast<int16_t>(state[c].predictor_);
+		}
+
+		const unsigned int groups = (bytes - IMAHeaderBytes * channel) / (4 * channel);
+		const unsigned int frames = std::min<unsigned int>(1 + groups * IMAGroupFrames, desc.samplesPerBlock_);
+
+		const unsigned char* p = &block[IMAHeaderBytes * channel];
+		for (unsigned int g = 0; g < groups; g++)
+		{
+			const unsigned int first = 1 + g * IMAGroupFrames;
+			for (unsigned int c = 0; c < channel; c++, p += 4)
+			{
+				for (unsigned int i = 0; i < IMAGroupFrames; i++)
+				{
+					const unsigned int nibble = (p[i / 2] >> ((i & 1) * 4)) & 0x0f;
+					const int16_t sample = DecodeIMANibble(state[c], nibble);
+					if (first + i < frames) { out[(first + i) * channel + c] = sample; }
+				}
+			}
+		}
+		return frames;
+	}
+
+	unsigned int DecodeMSBlock(const ADPCMDesc& desc, const unsigned char* block, unsigned int bytes, int16_t* out)
+	{
+		const unsigned int channel = desc.channel_;
+		int coef1[2] = {}, coef2[2] = {}, delta[2] = {}, sample1[2] = {}, sample2[2] = {};
+
+		// predictor bytes, then deltas, then the two starting samples of each channel
+		for (unsigned int c = 0; c < channel; c++)
+		{
+			const unsigned int predictor = std::min<unsigned int>(block[c], 6);
+			coef1[c] = MSCoef[predictor][0];
+			coef2[c] = MSCoef[predictor][1];
+			delta[c] = ReadS16(&block[channel + c * 2]);
+			sample1[c] = ReadS16(&block[channel * 3 + c * 2]);
+			sample2[c] = ReadS16(&block[channel * 5 + c * 2]);
+
+			// sample2 is the older one
+			out[c] = static_cast<int16_t>(sample2[c]);
+			out[channel + c] = static_cast<int16_t>(sample1[c]);
+		}
+
+		const unsigned int nibbles = (bytes - MSHeaderBytes * channel) * 2;
+		const unsigned int frames = std::min<unsigned int>(2 + nibbles / channel, desc.samplesPerBlock_);
+
+		const unsigned char* p = &block[MSHeaderBytes * channel];
+		for (unsigned int n = 0; n < (frames - 2) * channel; n++)
+		{
+			// high nibble first, channels interleaved nibble by nibble
+			const unsigned int c = n % channel;
+			const unsigned int nibble = (p[n / 2] >> ((n & 1) ? 0 : 4)) & 0x0f;
+			const int signedNibble = nibble >= 8 ? static_cast<int>(nibble) - 16 : static_cast<int>(nibble);
+
+			const int predicted = (sample1[c] * coef1[c] + sample2[c] * coef2[c]) >> 8;
+			const int16_t sample = Clamp16(predicted + signedNibble * delta[c]);
+			sample2[c] = sample1[c];
+			sample1[c] = sample;
+			delta[c] = std::max((MSAdaptationTable[nibble] * delta[c]) >> 8, 16);
+
+			out[2 * channel + n] = sample;
+		}
+		return frames;
+	}
+}
+
+bool IsStandardMSADPCMCoef(const unsigned char* raw, unsigned int count)
+{
+	if (count < 7) { return false; }
+
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		if (ReadS16(&raw[i * 4]) != MSCoef[i][0] || ReadS16(&raw[i * 4 + 2]) != MSCoef[i][1]) { return false; }
+	}
+	return true;
+}
+
+unsigned int GetADPCMSamplesPerBlock(uint16_t formatType, unsigned int blockAlign, unsigned int channel)
+{
+	if (channel == 0 || channel > 2) { return 0; }
+
+	if (formatType == ADPCMFormatIMA)
+	{
+		if (blockAlign < IMAHeaderBytes * channel) { return 0; }
+		return (blockAlign - IMAHeaderBytes * channel) * 2 / channel + 1;
+	}
+	if (formatType == ADPCMFormatMS)
+	{
+		if (blockAlign < MSHeaderBytes * channel) { return 0; }
+		return (blockAlign - MSHeaderBytes * channel) * 2 / channel + 2;
+	}
+	return 0;
+}
+
+unsigned int GetADPCMFrameCount(const ADPCMDesc& desc, unsigned int dataSize)
+{
+	if (desc.blockAlign_ == 0) { return 0; }
+
+	const unsigned int header = (desc.formatType_ == ADPCMFormatIMA ? IMAHeaderBytes : MSHeaderBytes) * desc.channel_;
+	const unsigned int tail = dataSize % desc.blockAlign_;
+	unsigned int frames = dataSize / desc.blockAlign_ * desc.samplesPerBlock_;
+	if (tail >= header)
+	{
+		frames += std::min(GetADPCMSamplesPerBlock(desc.formatType_, tail, desc.channel_), static_cast<unsigned int>(desc.samplesPerBlock_));
+	}
+	return frames;
+}
+
+unsigned int DecodeADPCMBlock(const ADPCMDesc& desc, const unsigned char* block, unsigned int bytes, int16_t* out)
+{
+	if (desc.channel_ == 0 || desc.channel_ > 2) { return 0; }
+
+	bytes = std::min<unsigned int>(bytes, desc.blockAlign_);
+	if (desc.formatType_ == ADPCMFormatIMA)
+	{
+		if (bytes < IMAHeaderBytes * desc.channel_) { return 0; }
+		return DecodeIMABlock(desc, block, bytes, out);
+	}
+	if (desc.formatType_ == ADPCMFormatMS)
+	{
+		if (bytes < MSHeaderBytes * desc.channel_) { return 0; }
+		return DecodeMSBlock(desc, block, bytes, out);
+	}
+	return 0;
+}
+
+std::vector<unsigned char> EncodeIMAADPCM(const int16_t* pcm, unsigned int frames, unsigned int channel, ADPCMDesc& desc)
+{
+	desc.formatType_ = ADPCMFormatIMA;
+	desc.channel_ = static_cast<uint16_t>(channel);
+	desc.blockAlign_ = static_cast<uint16_t>(ADPCMEncodeBlockBytes * channel);
+	desc.samplesPerBlock_ = static_cast<uint16_t>(GetADPCMSamplesPerBlock(ADPCMFormatIMA, desc.blockAlign_, channel));
+
+	std::vector<unsigned char> out;
+	if (channel == 0 || channel > 2 || frames == 0) { return out; }
+
+	const unsigned int spb = desc.samplesPerBlock_;
+	const unsigned int blocks = (frames + spb - 1) / spb;
+	out.resize(static_cast<size_t>(blocks) * desc.blockAlign_);
+
+	// past the end the input reads as silence
+	auto sampleAt = [&](unsigned int frame, unsigned int c)
+		{
+			return frame < frames ? static_cast<int>(pcm[frame * channel + c]) : 0;
+		};
+
+	// the step index carries over between blocks, the predictor restarts on the header sample
+	IMAState state[2] = {};
+	for (unsigned int b = 0; b < blocks; b++)
+	{
+		unsigned char* block = &out[static_cast<size_t>(b) * desc.blockAlign_];
+		const unsigned int base = b * spb;
+		for (unsigned int c = 0; c < channel; c++)
+		{
+			state[c].predictor_ = sampleAt(base, c);
+			PutS16(&block[c * IMAHeaderBytes], static_cast<int16_t>(state[c].predictor_));
+			block[c * IMAHeaderBytes + 2] = static_cast<unsigned char>(state[c].index_);
+			block[c * IMAHeaderBytes + 3] = 0;
+		}
+
+		unsigned char* p = &block[IMAHeaderBytes * channel];
+		for (unsigned int first = base + 1; first < base + spb; first += IMAGroupFrames)
+		{
+			for (unsigned int c = 0; c < channel; c++, p += 4)
+			{
+				for (unsigned int i = 0; i < IMAGroupFrames; i++)
+				{
+					const unsigned int nibble = EncodeIMANibble(state[c], sampleAt(first + i, c));
+					p[i / 2] |= static_cast<unsigned char>(nibble << ((i & 1) * 4));
+				}
+			}
+		}
+	}
+	return out;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// format tags of the two ADPCM flavours found in wave files
+constexpr uint16_t ADPCMFormatMS = 0x0002;
+constexpr uint16_t ADPCMFormatIMA = 0x0011;
+
+// bytes per channel of the blocks EncodeIMAADPCM writes, 1017 frames each
+constexpr unsigned int ADPCMEncodeBlockBytes = 512;
+
+struct ADPCMDesc
+{
+	uint16_t formatType_;
+	uint16_t channel_;
+	uint16_t blockAlign_;
+	uint16_t samplesPerBlock_;
+};
+
+inline bool IsADPCM(uint16_t formatType)
+{
+	return formatType == ADPCMFormatMS || formatType == ADPCMFormatIMA;
+}
+
+// raw holds count little endian coefficient pairs of an MS ADPCM fmt chunk
+// only the 7 standard pairs are decoded
+bool IsStandardMSADPCMCoef(const unsigned char* raw, unsigned int count);
+
+// frames a full block of blockAlign bytes holds, 0 when it cannot even hold the headers
+unsigned int GetADPCMSamplesPerBlock(uint16_t formatType, unsigned int blockAlign, unsigned int channel);
+
+// frames in dataSize bytes of blocks, a short tail block counts what it holds
+unsigned int GetADPCMFrameCount(const ADPCMDesc& desc, unsigned int dataSize);
+
+// decodes one block of bytes (a full block or the tail) into interleaved 16 bit PCM
+// out needs samplesPerBlock_ * channel_ samples, returns the frames written
+unsigned int DecodeADPCMBlock(const ADPCMDesc& desc, const unsigned char* block, unsigned int bytes, int16_t* out);
+
+// encodes interleaved 16 bit PCM into IMA ADPCM blocks, the last block is padded with silence
+// desc receives the format of the result
+std::vector<unsigned char> EncodeIMAADPCM(const int16_t* pcm, unsigned int frames, unsigned int channel, ADPCMDesc& desc);
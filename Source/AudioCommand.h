@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include "Backend/AudioPlatform.h"
+#include "LockFreeQueue.h"
+#include "SoundId.h"
+
+constexpr size_t CommandRingSize = 1024;
+
+enum class AudioCommandType
+{
+	Play,
+	PlayAgain,
+	Stop,
+	Continue,
+	SetVolume,
+	SetFrequencyRatio,
+	SetFilter,
+	AddSourceOutputTarget,
+	AddSubmixOutputTarget,
+	RemoveSourceOutputTarget,
+	RemoveSubmixOutputTarget,
+	DeleteHandle,
+	BeginBatch,
+	CommitBatch,
+};
+
+// one deferred AudioManager call
+struct AudioCommand
+{
+	AudioCommandType type_;
+	int handle_;
+	int target_;
+
+	// Play: begin / length / volume, SetFilter: frequency / danping, SetFrequencyRatio: ratio
+	float param_[3];
+	unsigned int loopCount_;
+	XAUDIO2_FILTER_TYPE filterType_;
+
+	// Play only
+	SoundId sound_;
+};
+
+// written by one producer thread, drained by the audio control thread
+using CommandRing = SpscQueue<AudioCommand, CommandRingSize>;
+
+// the ring of one producer thread, closed when the thread exits so the drain can free it once empty
+struct ProducerRing
+{
+	CommandRing ring_;
+	std::atomic<bool> closed_ = false;
+};
@@ -1,21 +1,26 @@
 #include "AudioManager.h"
 #include <cassert>
 #include <algorithm>
-#include <xaudio2fx.h>
-#include <xapofx.h>
-#include <xapo.h>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include "AudioStream.h"
+#include "LoadScheduler.h"
+#include "PCMConvert.h"
+#include "SoundBank.h"
 #include "WAVLoader.h"
+#include "WAVWriter.h"
+#include "Backend/MixerDevice.h"
+#include "Backend/SoftwareMixer.h"
+#include "Effect/ConvolutionEngine.h"
 #include "../Utility/utility.h"
-#include "Effect/CreateEffect.h"
-
-#pragma comment(lib,"xaudio2.lib")
-#pragma comment(lib,"xapobase.lib")
 
 AudioManager* AudioManager::instance_ = nullptr;
+std::atomic<unsigned int> AudioManager::instanceCount_ = 0;
 
-void AudioManager::Create(void)
+void AudioManager::Create(const AudioBackendDesc& desc)
 {
-	instance_ = new AudioManager();
+	instance_ = new AudioManager(desc);
 }
 
 AudioManager& AudioManager::GetInstance(void)
@@ -28,20 +33,25 @@ void AudioManager::Terminate(void)
 	delete instance_;
 }
 
-void AudioManager::LoadSound(const std::string& filename, const std::string& key)
+AudioBackend& AudioManager::GetBackend(void)
+{
+	return *backend_;
+}
+
+void AudioManager::LoadSound(const std::string& filename, const std::string& key, WAVLoadMode mode)
 {
 	std::string ext = GetExtension(filename);
 
 	if (ext == "wav")
 	{
-		if (!wavLoader_->LoadWAVFile(filename))
+		if (!wavLoader_->LoadWAVFile(filename, mode))
 		{
 			return;
 		}
 	}
 	else if (ext.empty())
 	{
-		if (!wavLoader_->LoadWAVFile(filename))
+		if (!wavLoader_->LoadWAVFile(filename, mode))
 		{
 			return;
 		}
@@ -50,7 +60,183 @@ void AudioManager::LoadSound(const std::string& filename, const std::string& key
 	{
 		return;
 	}
-	filenameTable_.emplace(key, filename);
+	RegisterSound(key, filename);
+}
+
+LoadTicket AudioManager::LoadSoundAsync(const std::string& filename, const std::string& key,
+	WAVLoadMode mode, LoadCallback callback)
+{
+	LoadRequest request;
+	request.filename_ = filename;
+	request.key_ = key;
+	request.mode_ = mode;
+	return LoadBatchAsync({ request }, std::move(callback));
+}
+
+LoadTicket AudioManager::LoadBatchAsync(const std::vector<LoadRequest>& requests, LoadCallback callback)
+{
+	if (++lastTicket_ == 0) { ++lastTicket_; }
+	LoadTicket ticket = lastTicket_;
+
+	if (requests.empty())
+	{
+		if (callback) { callback(ticket, LoadReport()); }
+		return ticket;
+	}
+
+	LoadTicketState& state = loadTicket_[ticket];
+	state.remaining_ = static_cast<unsigned int>(requests.size());
+	state.start_ = std::chrono::steady_clock::now();
+	state.last_ = state.start_;
+	state.callback_ = std::move(callback);
+
+	std::vector<LoadJob> jobs;
+	jobs.reserve(requests.size());
+	for (auto& r : requests)
+	{
+		LoadJob job = { ticket, r.filename_, r.key_, r.mode_ };
+
+		std::string ext = GetExtension(r.filename_);
+		if (ext != "wav" && !ext.empty())
+		{
+			std::unique_ptr<LoadResult> result(new LoadResult());
+			result->job_ = std::move(job);
+			result->finished_ = state.start_;
+			loadResult_.emplace_back(std::move(result));
+		}
+		else
+		{
+			jobs.emplace_back(std::move(job));
+		}
+		loadingKey_[MakeSoundId(r.key_)]++;
+	}
+
+	if (!jobs.empty())
+	{
+		if (!loadScheduler_)
+		{
+			unsigned int count = loadThreadCount_;
+			if (count == 0)
+			{
+				// leaves a core to the game and the audio threads
+				unsigned int cores = std::thread::hardware_concurrency();
+				count = cores > 1 ? cores - 1 : 1;
+			}
+			loadScheduler_.reset(new LoadScheduler(*wavLoader_, count));
+		}
+		loadScheduler_->Push(jobs);
+	}
+	return ticket;
+}
+
+bool AudioManager::IsLoadComplete(LoadTicket ticket) const
+{
+	return loadTicket_.find(ticket) == loadTicket_.end();
+}
+
+bool AudioManager::SetLoadThreadCount(unsigned int count)
+{
+	if (!loadTicket_.empty()) { return false; }
+
+	loadThreadCount_ = count;
+	// rebuilt with the new count by the next async load
+	loadScheduler_.reset();
+	return true;
+}
+
+bool AudioManager::LoadBank(const std::string& filename)
+{
+	// an open bank only registers again the keys Unload removed
+	auto it = bank_.find(filename);
+	if (it != bank_.end())
+	{
+		RegisterBankEntries(filename, *it->second);
+		return true;
+	}
+
+	std::unique_ptr<SoundBank> bank(new SoundBank());
+	if (!bank->Open(filename))
+	{
+		OutputDebugString(L"sound bank open failed");
+		return false;
+	}
+
+	RegisterBankEntries(filename, *bank);
+	bank_.emplace(filename, std::move(bank));
+	return true;
+}
+
+void AudioManager::RegisterBankEntries(const std::string& filename, const SoundBank& bank)
+{
+	const unsigned int count = bank.GetEntryCount();
+	soundTable_.reserve(soundTable_.size() + count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const SoundBankEntry& entry = bank.GetEntry(i);
+		const char* key = bank.GetKey(entry);
+		const unsigned char* pcm = bank.GetData(entry);
+		if (key == nullptr || pcm == nullptr) { continue; }
+
+		// ':' cannot appear in a loose file name, so the names never collide
+		std::string name = filename + ':' + key;
+		if (wavLoader_->IsLoaded(name)) { continue; }
+
+		// the fmt fields were parsed when the bank was built
+		WAVData data = {};
+		data.fmt_.chunkSize_ = 16;
+		data.fmt_.formatType_ = entry.formatType_;
+		data.fmt_.channel_ = entry.channel_;
+		data.fmt_.samplesPerSec_ = entry.samplesPerSec_;
+		data.fmt_.bytePerSec_ = entry.bytePerSec_;
+		data.fmt_.blockAlign_ = entry.blockAlign_;
+		data.fmt_.bitPerSample_ = entry.bitPerSample_;
+		data.fmt_.validBitsPerSample_ = entry.bitPerSample_;
+		data.dataSize_ = entry.dataSize_;
+		if (IsADPCM(entry.formatType_))
+		{
+			// the bank keeps no fmt extension, blocks are assumed to be full
+			data.fmt_.samplesPerBlock_ = static_cast<unsigned short>(
+				GetADPCMSamplesPerBlock(entry.formatType_, entry.blockAlign_, entry.channel_));
+			data.frameCount_ = GetADPCMFrameCount(data.fmt_.GetADPCMDesc(), data.dataSize_);
+		}
+		else
+		{
+			data.frameCount_ = entry.blockAlign_ != 0 ? entry.dataSize_ / entry.blockAlign_ : 0;
+		}
+		data.data_ = const_cast<unsigned char*>(pcm);
+		data.mapped_ = true;
+
+		wavLoader_->AddWAVFile(name, data, nullptr);
+		// the index hash is the SoundId, the key is not hashed again
+		if (!RegisterSound(SoundId{ entry.hash_ }, key, name))
+		{
+			wavLoader_->DestroyWAVFile(name);
+		}
+	}
+}
+
+void AudioManager::UnloadBank(const std::string& filename)
+{
+	auto it = bank_.find(filename);
+	if (it == bank_.end()) { return; }
+
+	const SoundBank& bank = *it->second;
+	for (unsigned int i = 0; i < bank.GetEntryCount(); i++)
+	{
+		const SoundBankEntry& e = bank.GetEntry(i);
+		const char* key = bank.GetKey(e);
+		if (key == nullptr) { continue; }
+
+		std::string name = filename + ':' + key;
+		auto entry = soundTable_.find(SoundId{ e.hash_ });
+		if (entry != soundTable_.end() && entry->second.filename_ == name)
+		{
+			soundTable_.erase(entry);
+		}
+		DeleteSourcesOf(name);
+		wavLoader_->DestroyWAVFile(name);
+	}
+	bank_.erase(it);
 }
 
 int AudioManager::CreateSubmix(std::initializer_list<int> outputHandles)
@@ -66,12 +252,10 @@ int AudioManager::CreateSubmix(std::initializer_list<int> outputHandles)
 
 	for (auto& oh : outputHandles)
 	{
-		if ((oh & IdentifyMask) != SubmixIdentifyID) { delete subdata; return -1; }
-		int h = (oh & SubmixHandleMask) >> SubmixHandleShift;
-		if (h < 0 || h >= SubmixVoiceArrayMaxSize) { delete subdata; return -1; }
-		if (!submix_[h]) { delete subdata; return -1; }
+		SubmixVoice* out = ResolveSubmix(oh);
+		if (out == nullptr) { delete subdata; return -1; }
 
-		stage = std::min(submix_[h]->stage_, stage);
+		stage = std::min(out->stage_, stage);
 	}
 
 	if (stage == 0)
@@ -81,8 +265,9 @@ int AudioManager::CreateSubmix(std::initializer_list<int> outputHandles)
 	}
 	stage--;
 
-	xaudioCore_->CreateSubmixVoice(&subdata->submixVoice_, masterVoiceDetails_.InputChannels,
-		masterVoiceDetails_.InputSampleRate, XAUDIO2_VOICE_USEFILTER, stage, nullptr, nullptr);
+	subdata->submixVoice_ = backend_->CreateSubmixVoice(backend_->GetOutputChannels(),
+		backend_->GetOutputSampleRate(), stage);
+	if (subdata->submixVoice_ == nullptr) { delete subdata; return -1; }
 
 	subdata->stage_ = stage;
 
@@ -93,97 +278,102 @@ int AudioManager::CreateSubmix(std::initializer_list<int> outputHandles)
 		return -1;
 	}
 
-	subdata->handle_ = index;
-
-	index = (index << SubmixHandleShift) + SubmixIdentifyID;
+	subdata->handle_ = MakeSubmixHandle(index);
 
 	for (auto& oh : outputHandles)
 	{
-		int h = (oh & SubmixHandleMask) >> SubmixHandleShift;
-		AddSubmixOutputTarget(index, h);
+		AddSubmixOutputTarget(subdata->handle_, oh);
 	}
 
-	return index;
+	return subdata->handle_;
 }
 
 int AudioManager::Play(const std::string& key, float volume)
 {
-	if (filenameTable_.find(key) == filenameTable_.end())
-	{
-		OutputDebugString(L"key not found");
-		return -1;
-	}
-
-	HRESULT result;
-
-	SourceVoice* srcdata = new SourceVoice();
-
-	const auto& data = wavLoader_->GetWAVFile(filenameTable_.at(key));
-
-	srcdata->waveFormat_.wFormatTag = WAVE_FORMAT_PCM;
-	srcdata->waveFormat_.nChannels = data.fmt_.channel_;
-	srcdata->waveFormat_.nSamplesPerSec = data.fmt_.samplesPerSec_;
-	srcdata->waveFormat_.nAvgBytesPerSec = data.fmt_.bytePerSec_;
-	srcdata->waveFormat_.nBlockAlign = data.fmt_.blockAlign_;
-	srcdata->waveFormat_.wBitsPerSample = data.fmt_.bitPerSample_;
-
-	srcdata->buffer_.AudioBytes = data.dataSize_;
-	srcdata->buffer_.pAudioData = data.data_;
-	srcdata->buffer_.PlayBegin = 0;
-	srcdata->buffer_.PlayLength = 0;
-	srcdata->buffer_.LoopBegin = 0;
-	srcdata->buffer_.LoopCount = 0;
-	srcdata->buffer_.LoopLength = 0;
-	srcdata->buffer_.Flags = XAUDIO2_END_OF_STREAM;
-
-	result = xaudioCore_->CreateSourceVoice(&srcdata->sourceVoice_, &srcdata->waveFormat_,
-		XAUDIO2_VOICE_USEFILTER, 4.0f);
-	if (FAILED(result)) { delete srcdata; return -1; }
-
-	result = srcdata->sourceVoice_->SubmitSourceBuffer(&srcdata->buffer_);
-	if (FAILED(result)) { delete srcdata; return -1; }
+	return Play(MakeSoundId(key), volume);
+}
 
-	srcdata->vState_ = VoiceState::Playing;
-	srcdata->sourceVoice_->Start();
-	srcdata->sourceVoice_->SetVolume(volume);
+int AudioManager::PlayLoop(const std::string& key, float begin, 
+	float length, unsigned int loopCount, float volume)
+{
+	return PlayLoop(MakeSoundId(key), begin, length, loopCount, volume);
+}
 
-	int index = source_.Add(srcdata);
-	if (index == -1)
-	{
-		delete srcdata;
-		return index;
-	}
+int AudioManager::Play(SoundId sound, float volume)
+{
+	int slot = source_.Reserve();
+	if (slot == -1) { return -1; }
 
-	srcdata->handle_ = index;
+	return PlayInSlot(slot, sound, 0.0f, 0.0f, 0, volume);
+}
 
-	AddSourceOutputTarget(index + SourceIdentifyID, RootSubmixHandle);
+int AudioManager::PlayLoop(SoundId sound, float begin,
+	float length, unsigned int loopCount, float volume)
+{
+	int slot = source_.Reserve();
+	if (slot == -1) { return -1; }
 
-	return index + SourceIdentifyID;
+	return PlayInSlot(slot, sound, begin, length, loopCount, volume);
 }
 
-int AudioManager::PlayLoop(const std::string& key, float begin, 
+int AudioManager::PlayInSlot(int slot, SoundId sound, float begin,
 	float length, unsigned int loopCount, float volume)
 {
-	if (filenameTable_.find(key) == filenameTable_.end())
+	std::vector<int> steal;
+	if (!AdmitPlay(sound, volume, steal))
+	{
+		source_.Release(slot);
+		return -1;
+	}
+
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end())
 	{
+		if (QueuePlay(slot, sound, begin, length, loopCount, volume))
+		{
+			return MakeSourceHandle(slot);
+		}
 		OutputDebugString(L"key not found");
+		source_.Release(slot);
 		return -1;
 	}
 
-	HRESULT result;
+	auto& data = *asset->second.data_;
+	// reads the file again when the budget evicted it
+	if (!wavLoader_->Acquire(data, asset->second.filename_))
+	{
+		OutputDebugString(L"reload failed");
+		source_.Release(slot);
+		return -1;
+	}
 
 	SourceVoice* sdata = new SourceVoice();
+	sdata->wav_ = &data;
+	sdata->priority_ = asset->second.priority_;
+	sdata->sound_ = sound;
+	sdata->playOrder_ = ++playCount_;
+	sdata->volume_ = volume;
+	sdata->vState_ = VoiceState::Playing;
 
-	const auto& data = wavLoader_->GetWAVFile(filenameTable_.at(key));
+	// ADPCM is decoded into 16 bit PCM blocks, the voice never sees the compressed format
+	const bool compressed = IsADPCM(data.fmt_.formatType_);
 
-	sdata->waveFormat_.wFormatTag = WAVE_FORMAT_PCM;
+	// extensible files were parsed down to their sub format
+	sdata->waveFormat_.wFormatTag = data.fmt_.formatType_;
 	sdata->waveFormat_.nChannels = data.fmt_.channel_;
 	sdata->waveFormat_.nSamplesPerSec = data.fmt_.samplesPerSec_;
 	sdata->waveFormat_.nAvgBytesPerSec = data.fmt_.bytePerSec_;
 	sdata->waveFormat_.nBlockAlign = data.fmt_.blockAlign_;
 	sdata->waveFormat_.wBitsPerSample = data.fmt_.bitPerSample_;
+	if (compressed)
+	{
+		sdata->waveFormat_.wFormatTag = WAVE_FORMAT_PCM;
+		sdata->waveFormat_.nBlockAlign = data.fmt_.channel_ * sizeof(int16_t);
+		sdata->waveFormat_.nAvgBytesPerSec = data.fmt_.samplesPerSec_ * sdata->waveFormat_.nBlockAlign;
+		sdata->waveFormat_.wBitsPerSample = 16;
+	}
 
-	sdata->buffer_.AudioBytes = data.dataSize_;
+	sdata->buffer_.AudioBytes = compressed ? data.frameCount_ * sdata->waveFormat_.nBlockAlign : data.dataSize_;
 	sdata->buffer_.pAudioData = data.data_;
 	sdata->buffer_.PlayBegin = sdata->waveFormat_.nSamplesPerSec * begin;
 	sdata->buffer_.PlayLength = sdata->waveFormat_.nSamplesPerSec * length;
@@ -192,663 +382,2008 @@ int AudioManager::PlayLoop(const std::string& key, float begin,
 	sdata->buffer_.LoopCount = loopCount;
 	sdata->buffer_.Flags = XAUDIO2_END_OF_STREAM;
 
-	result = xaudioCore_->CreateSourceVoice(&sdata->sourceVoice_, &sdata->waveFormat_, 
-		XAUDIO2_VOICE_USEFILTER, 4.0f);
-	if (FAILED(result)) { return -1; }
+	if (data.streamed_ || compressed)
+	{
+		// every voice gets its own file handle or decoder and ring, a decoder of a finished play is opened again
+		std::shared_ptr<AudioStream> stream = compressed ? voicePool_->AcquireStream() : nullptr;
+		const bool reused = stream != nullptr;
+		if (!reused) { stream = std::make_shared<AudioStream>(); }
+		bool opened = compressed ?
+			stream->OpenADPCM(data.data_, data.dataSize_, data.fmt_.GetADPCMDesc(), data.frameCount_) :
+			stream->Open(asset->second.filename_, data.FindChunk("data")->offset_, data.dataSize_, data.fmt_.blockAlign_);
+		if (!opened)
+		{
+			OutputDebugString(L"stream open failed");
+			delete sdata;
+			source_.Release(slot);
+			return -1;
+		}
+		if (!reused)
+		{
+			if (!streamReader_) { streamReader_.reset(new StreamReader()); }
+			streamReader_->Add(stream);
+		}
+		sdata->stream_ = std::move(stream);
+	}
 
-	result = sdata->sourceVoice_->SubmitSourceBuffer(&sdata->buffer_);
-	if (FAILED(result)) { return -1; }
+	// over the budget the play takes the voice of a weaker one or starts virtual
+	if (voiceBudget_ != 0 && voicePool_->GetStats().active_ >= voiceBudget_)
+	{
+		SourceVoice* weakest = nullptr;
+		for (auto& s : source_.GetSlotList())
+		{
+			SourceVoice* v = source_[s].get();
+			if (!v->virtual_ && (weakest == nullptr || Outranks(weakest, v))) { weakest = v; }
+		}
 
-	sdata->vState_ = VoiceState::Playing;
-	sdata->sourceVoice_->Start();
-	sdata->sourceVoice_->SetVolume(volume);
+		if (weakest != nullptr && Outranks(sdata, weakest))
+		{
+			Virtualize(weakest);
+		}
+		else
+		{
+			sdata->virtual_ = true;
+		}
+	}
 
-	int index = source_.Add(sdata);
-	if (index == -1)
+	if (!sdata->virtual_)
 	{
-		delete sdata;
-		return index;
+		sdata->sourceVoice_ = voicePool_->Acquire(sdata->waveFormat_);
+		if (sdata->sourceVoice_ == nullptr) { delete sdata; source_.Release(slot); return -1; }
 	}
+	sdata->pool_ = voicePool_.get();
+
+	source_.Emplace(slot, sdata);
+	sdata->handle_ = MakeSourceHandle(slot);
 
-	sdata->handle_ = index;
+	if (!SubmitSourceBuffer(sdata)) { source_.Remove(slot); return -1; }
+
+	if (sdata->sourceVoice_ != nullptr)
+	{
+		sdata->sourceVoice_->Start(operationSet_);
+		sdata->sourceVoice_->SetVolume(volume, operationSet_);
+	}
 
-	AddSourceOutputTarget(index + SourceIdentifyID, RootSubmixHandle);
+	AddSourceOutputTarget(sdata->handle_, RootSubmixHandle);
 
-	return index + SourceIdentifyID;
+	RecordPlay(sound, steal);
+	return sdata->handle_;
 }
 
 void AudioManager::PlayAgain(int handle)
 {
-	if (!SourceHandleIsValid(handle)) { return; }
-	handle = handle & SourceHandleMask;
-
-	auto& src = source_[handle];
+	SourceVoice* src = ResolveSource(handle);
+	if (src == nullptr) { return; }
 
 	if (src->vState_ == VoiceState::Playing)
 	{
 		src->vState_ = VoiceState::Stop;
-		src->sourceVoice_->Stop();
+		if (src->sourceVoice_ != nullptr) { src->sourceVoice_->Stop(operationSet_); }
 	}
-	source_[handle]->sourceVoice_->FlushSourceBuffers();
-	src->sourceVoice_->SubmitSourceBuffer(&src->buffer_);
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->FlushSourceBuffers(); }
+	SubmitSourceBuffer(src);
 }
 
 void AudioManager::PlayAgain(int handle, float begin, float length)
 {
-	if (!SourceHandleIsValid(handle)) { return; }
-	handle = handle & SourceHandleMask;
-
-	auto& src = source_[handle];
+	SourceVoice* src = ResolveSource(handle);
+	if (src == nullptr) { return; }
 
 	if (src->vState_ == VoiceState::Playing)
 	{
 		src->vState_ = VoiceState::Stop;
-		src->sourceVoice_->Stop();
+		if (src->sourceVoice_ != nullptr) { src->sourceVoice_->Stop(operationSet_); }
 	}
-	src->sourceVoice_->FlushSourceBuffers();
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->FlushSourceBuffers(); }
 
 	src->buffer_.PlayBegin = src->waveFormat_.nSamplesPerSec * begin;
 	src->buffer_.PlayLength = src->waveFormat_.nSamplesPerSec * length;
 
-	src->sourceVoice_->SubmitSourceBuffer(&src->buffer_);
+	SubmitSourceBuffer(src);
 }
 
 float AudioManager::GetProgress(int sourceHandle)
 {
-	if (!SourceHandleIsValid(sourceHandle)) { return 0.0f; }
-	sourceHandle = sourceHandle & SourceHandleMask;
-	auto& src = source_[sourceHandle];
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return 0.0f; }
 
 	if (src->vState_ == VoiceState::Stop) { return 1.0f; }
 
-	XAUDIO2_VOICE_STATE state;
-	src->sourceVoice_->GetState(&state, 0);
+	const uint64_t played = GetConsumed(src);
 
-	return (static_cast<float>(state.SamplesPlayed) / static_cast<float>(src->waveFormat_.nSamplesPerSec)) 
+	return (static_cast<float>(played) / static_cast<float>(src->waveFormat_.nSamplesPerSec)) 
 		/ (static_cast<float>(src->buffer_.AudioBytes) / static_cast<float>(src->waveFormat_.nAvgBytesPerSec));
 }
 
-void AudioManager::SetVolume(int handle, float volume)
+void AudioManager::WarmVoicePool(unsigned short channel, unsigned int samplesPerSec,
+	unsigned short bitPerSample, unsigned int count)
+{
+	WAVEFORMATEX format = {};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = channel;
+	format.nSamplesPerSec = samplesPerSec;
+	format.nBlockAlign = channel * bitPerSample / 8;
+	format.nAvgBytesPerSec = samplesPerSec * format.nBlockAlign;
+	format.wBitsPerSample = bitPerSample;
+
+	voicePool_->Warm(format, count);
+}
+
+void AudioManager::SetVoicePoolMaxIdle(unsigned int count)
 {
-	if (handle < 0) { return; }
+	voicePool_->SetMaxIdlePerFormat(count);
+}
+
+const VoicePoolStats& AudioManager::GetVoicePoolStats(void) const
+{
+	return voicePool_->GetStats();
+}
 
+void AudioManager::SetVolume(int handle, float volume)
+{
 	volume = std::clamp(volume, -XAUDIO2_MAX_VOLUME_LEVEL, XAUDIO2_MAX_VOLUME_LEVEL);
 
 	int id = handle & IdentifyMask;
 	if (id == SourceIdentifyID)
 	{
-		if (handle >= SourceVoiceArrayMaxSize) { return; }
-		if (source_[handle])
+		SourceVoice* src = ResolveSource(handle);
+		if (src != nullptr)
 		{
-			source_[handle]->sourceVoice_->SetVolume(volume);
+			src->volume_ = volume;
+			if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetVolume(volume, operationSet_); }
 		}
 	}
 	else if (id == SubmixIdentifyID)
 	{
-		handle = (handle & SubmixHandleMask) >> SubmixHandleShift;
-		if (handle >= SubmixVoiceArrayMaxSize) { return; }
-		if (submix_[handle])
+		SubmixVoice* sub = ResolveSubmix(handle);
+		if (sub != nullptr)
 		{
-			submix_[handle]->submixVoice_->SetVolume(volume);
+			sub->volume_ = volume;
+			sub->submixVoice_->SetVolume(volume, operationSet_);
 		}
 	}
 }
 
-void AudioManager::Continue(int handle)
+void AudioManager::SetFrequencyRatio(int sourceHandle, float ratio)
 {
-	if (!SourceHandleIsValid(handle)) { return; }
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
+
+	src->frequencyRatio_ = std::clamp(ratio, XAUDIO2_MIN_FREQ_RATIO, MaxFrequencyRatio);
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetFrequencyRatio(src->frequencyRatio_, operationSet_); }
+}
 
-	handle = handle & SourceHandleMask;
+void AudioManager::SetPitch(int sourceHandle, float semitones)
+{
+	SetFrequencyRatio(sourceHandle, std::exp2(semitones / 12.0f));
+}
 
-	if (source_[handle]->vState_ == VoiceState::Playing) { return; }
+void AudioManager::SetResampleQuality(int sourceHandle, ResampleQuality quality)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
 
-	source_[handle]->sourceVoice_->Start();
-	source_[handle]->vState_ = VoiceState::Playing;
+	src->quality_ = quality;
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetResampleQuality(quality); }
 }
 
-void AudioManager::Stop(int handle)
+void AudioManager::SetRealVoiceBudget(unsigned int count)
 {
-	if (!SourceHandleIsValid(handle)) { return; }
+	voiceBudget_ = count;
+}
 
-	handle = handle & SourceHandleMask;
+void AudioManager::SetPriority(int sourceHandle, int priority)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
+	src->priority_ = priority;
+}
 
-	if (source_[handle]->vState_ == VoiceState::Stop) { return; }
+void AudioManager::SetSoundPriority(const std::string& key, int priority)
+{
+	SetSoundPriority(MakeSoundId(key), priority);
+}
 
-	source_[handle]->sourceVoice_->Stop();
-	source_[handle]->vState_ = VoiceState::Stop;
+void AudioManager::SetSoundPriority(SoundId sound, int priority)
+{
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end()) { return; }
+	asset->second.priority_ = priority;
 }
 
-void AudioManager::Unload(const std::string& key)
+void AudioManager::SetInstanceLimit(const std::string& key, unsigned int maxInstances, InstanceSteal steal)
 {
-	if (filenameTable_.find(key) == filenameTable_.end()) { return; }
+	SetInstanceLimit(MakeSoundId(key), maxInstances, steal);
+}
 
-	std::string ext = GetExtension(filenameTable_.at(key));
+void AudioManager::SetInstanceLimit(SoundId sound, unsigned int maxInstances, InstanceSteal steal)
+{
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end()) { return; }
+	asset->second.maxInstances_ = maxInstances;
+	asset->second.steal_ = steal;
+}
 
-	if (ext == "wav")
-	{
-		wavLoader_->DestroyWAVFile(filenameTable_.at(key));
-	}
-	filenameTable_.erase(key);
+void AudioManager::SetRetriggerInterval(const std::string& key, float seconds)
+{
+	SetRetriggerInterval(MakeSoundId(key), seconds);
 }
 
-void AudioManager::ContinueAll(void)
+void AudioManager::SetRetriggerInterval(SoundId sound, float seconds)
 {
-	for (const auto& h : source_.GetHandleList())
-	{
-		if (source_[h]->vState_ == VoiceState::Playing) { continue; }
-		source_[h]->sourceVoice_->Start();
-		source_[h]->vState_ = VoiceState::Playing;
-	}
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end()) { return; }
+	asset->second.retriggerFrames_ = static_cast<uint64_t>(std::max(seconds, 0.0f) * backend_->GetOutputSampleRate());
 }
 
-void AudioManager::StopAll(bool destroy)
+bool AudioManager::IsVirtual(int sourceHandle)
 {
-	for (auto& h : source_.GetHandleList())
-	{
-		if (source_[h]->vState_ != VoiceState::Stop)
-		{
-			source_[h]->sourceVoice_->Stop();
-		}
-	}
-	if (destroy)
-	{
-		source_.Clear();
-	}
+	SourceVoice* src = ResolveSource(sourceHandle);
+	return src != nullptr && src->virtual_;
 }
 
-void AudioManager::DeleteHandle(int handle)
+VoiceBudgetStats AudioManager::GetVoiceBudgetStats(void)
 {
-	if (handle < 0) { return; }
+	// every real play holds exactly one voice of the pool
+	VoiceBudgetStats stats = budgetStats_;
+	stats.real_ = voicePool_->GetStats().active_;
+	stats.virtual_ = static_cast<unsigned int>(source_.GetSlotList().size()) - stats.real_;
+	return stats;
+}
 
-	int id = handle & IdentifyMask;
+void AudioManager::Continue(int handle)
+{
+	SourceVoice* src = ResolveSource(handle);
+	if (src == nullptr) { return; }
 
-	if (id == SourceIdentifyID)
-	{
-		int dh = handle & SourceHandleMask;
-		if (dh < SourceVoiceArrayMaxSize)
-		{
-			if (!source_[dh]) { return; }
-			for (auto& s : source_[dh]->output_)
-			{
-				auto it = std::remove_if(s->sources_.begin(), s->sources_.end(),
-					[&dh, this](SourceVoice* src) { return src == source_[dh].get(); });
-				s->sources_.erase(it, s->sources_.end());
+	if (src->vState_ == VoiceState::Playing) { return; }
 
-				RemoveSourceOutputTarget(handle, 
-					(s->handle_ << SubmixHandleShift) + SubmixIdentifyID);
-			}
-			source_.Remove(dh);
-		}
-		return;
-	}
-	else if (id == SubmixIdentifyID)
-	{
-		int dh = (handle & SubmixHandleMask) >> SubmixHandleShift;
-		if (dh > 0 && dh < SubmixVoiceArrayMaxSize)
-		{
-			if (!submix_[dh]) { return; }
-			for (auto& o : submix_[dh]->output_)
-			{
-				auto oit = std::remove_if(o->input_.begin(), o->input_.end(),
-					[&dh, this](SubmixVoice* sub) { return sub == submix_[dh].get(); });
-				o->input_.erase(oit, o->input_.end());
-			}
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->Start(operationSet_); }
+	src->vState_ = VoiceState::Playing;
+}
 
-			for (auto& i : submix_[dh]->output_)
-			{
-				RemoveSubmixOutputTarget((i->handle_ << SubmixHandleShift) + SubmixIdentifyID, 
-					handle);
-			}
+void AudioManager::Stop(int handle)
+{
+	SourceVoice* src = ResolveSource(handle);
+	if (src == nullptr) { return; }
 
-			for (auto& s : submix_[dh]->sources_)
-			{
-				RemoveSourceOutputTarget(s->handle_ + SourceIdentifyID, 
-					handle);
-			}
+	if (src->vState_ == VoiceState::Stop) { return; }
 
-			submix_.Remove(dh);
-		}
-		return;
-	}
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->Stop(operationSet_); }
+	src->vState_ = VoiceState::Stop;
 }
 
-void AudioManager::Update(void)
+void AudioManager::Unload(const std::string& key)
 {
-	for (auto& s : source_.GetHandleList())
+	Unload(MakeSoundId(key));
+}
+
+void AudioManager::Unload(SoundId sound)
+{
+	auto it = soundTable_.find(sound);
+	if (it == soundTable_.end()) { return; }
+
+	std::string filename = it->second.filename_;
+	soundTable_.erase(it);
+
+	if (GetExtension(filename) == "wav" || IsBankEntry(filename))
 	{
-		XAUDIO2_VOICE_STATE state;
-		source_[s]->sourceVoice_->GetState(&state, 0);
-		if (state.BuffersQueued == 0 && source_[s]->vState_ == VoiceState::Playing)
+		DeleteSourcesOf(filename);
+		wavLoader_->DestroyWAVFile(filename);
+
+		// other keys on the same file would point at freed data
+		for (auto s = soundTable_.begin(); s != soundTable_.end();)
 		{
-			source_[s]->sourceVoice_->Stop();
-			source_[s]->vState_ = VoiceState::Stop;
+			s = s->second.filename_ == filename ? soundTable_.erase(s) : std::next(s);
 		}
 	}
 }
 
-void AudioManager::AddSourceOutputTarget(int sourceHandle, int targetHandle)
+bool AudioManager::RegisterSound(const std::string& key, const std::string& filename)
 {
-	if ((sourceHandle & IdentifyMask) != SourceIdentifyID) { return; }
-	if ((targetHandle & IdentifyMask) != SubmixIdentifyID) { return; }
-
-	int sHandle = sourceHandle & SourceHandleMask;
-	if (sHandle < 0 || sHandle > SourceVoiceArrayMaxSize) { return; }
-	int tHandle = (targetHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (tHandle < 0 || tHandle > SubmixVoiceArrayMaxSize) { return; }
-
-	auto& src = source_[sHandle];
-	auto& tgt = submix_[tHandle];
+	return RegisterSound(MakeSoundId(key), key.c_str(), filename);
+}
 
-	if (!src || !tgt)
+bool AudioManager::RegisterSound(SoundId sound, const char* key, const std::string& filename)
+{
+	auto it = soundTable_.find(sound);
+	if (it != soundTable_.end())
 	{
-		return;
+		// two names on one id would silently play the wrong sound
+		assert(it->second.key_ == key);
+		return false;
 	}
+	if (!wavLoader_->IsLoaded(filename)) { return false; }
 
-	if (targetHandle != RootSubmixHandle)
+	SoundAsset asset;
+	asset.data_ = wavLoader_->FindWAVFile(filename);
+	asset.filename_ = filename;
+#ifndef NDEBUG
+	asset.key_ = key;
+#endif
+	soundTable_.emplace(sound, std::move(asset));
+	return true;
+}
+
+bool AudioManager::IsBankEntry(const std::string& filename) const
+{
+	for (auto& b : bank_)
 	{
-		RemoveSourceOutputTarget(sourceHandle, RootSubmixHandle);
+		if (filename.size() > b.first.size() && filename.compare(0, b.first.size(), b.first) == 0 &&
+			filename[b.first.size()] == ':')
+		{
+			return true;
+		}
 	}
-
-	src->send_.emplace_back(XAUDIO2_SEND_DESCRIPTOR{ 0, tgt->submixVoice_ });
-	src->output_.emplace_back(tgt.get());
-	tgt->sources_.emplace_back(src.get());
-
-	XAUDIO2_VOICE_SENDS snd = { src->send_.size(), src->send_.data() };
-	src->sourceVoice_->SetOutputVoices(&snd);
+	return false;
 }
 
-void AudioManager::AddSubmixOutputTarget(int submixHandle, int targetHandle)
+void AudioManager::DeleteSourcesOf(const std::string& filename)
 {
-	if ((submixHandle & IdentifyMask) != SubmixIdentifyID) { return; }
-	if ((targetHandle & IdentifyMask) != SubmixIdentifyID) { return; }
-
-	int sHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (sHandle < 0 || sHandle > SubmixVoiceArrayMaxSize) { return; }
-	int tHandle = (targetHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (tHandle < 0 || tHandle > SubmixVoiceArrayMaxSize) { return; }
+	const WAVData* data = wavLoader_->FindWAVFile(filename);
+	if (data == nullptr || data->users_ == 0) { return; }
 
-	if (sHandle == tHandle) { return; }
-	auto& sub = submix_[sHandle];
-	auto& tgt = submix_[tHandle];
-
-	if (!sub || !tgt)
+	// copied, DeleteHandle edits the list
+	std::vector<int> handles;
+	for (const auto& h : source_.GetSlotList())
 	{
-		return;
+		if (source_[h]->wav_ == data) { handles.push_back(source_[h]->handle_); }
 	}
-
-	if (targetHandle != RootSubmixHandle)
+	for (auto h : handles)
 	{
-		RemoveSourceOutputTarget(submixHandle,
-			RootSubmixHandle);
+		DeleteHandle(h);
 	}
+}
 
-	sub->send_.emplace_back(XAUDIO2_SEND_DESCRIPTOR{ 0, tgt->submixVoice_ });
-	sub->output_.emplace_back(tgt.get());
-	tgt->input_.emplace_back(sub.get());
-
-	XAUDIO2_VOICE_SENDS snd = 
-	{ sub->send_.size(), 
-		sub->send_.data() };
+void AudioManager::SetLoadConversion(bool enable)
+{
+	wavLoader_->SetConversion(enable ? backend_->GetOutputSampleRate() : 0);
+}
 
-	sub->submixVoice_->SetOutputVoices(&snd);
+void AudioManager::SetCacheBudget(size_t bytes)
+{
+	wavLoader_->SetBudget(bytes);
 }
 
-void AudioManager::RemoveSourceOutputTarget(int sourceHandle, int targetHandle)
+bool AudioManager::PinSound(const std::string& key)
 {
-	if ((sourceHandle & IdentifyMask) != SourceIdentifyID) { return; }
-	if ((targetHandle & IdentifyMask) != SubmixIdentifyID) { return; }
+	return PinSound(MakeSoundId(key));
+}
 
-	int sHandle = sourceHandle & SourceHandleMask;
-	if (sHandle < 0 || sHandle > SourceVoiceArrayMaxSize) { return; }
-	int tHandle = (targetHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (tHandle < 0 || tHandle > SubmixVoiceArrayMaxSize) { return; }
+bool AudioManager::PinSound(SoundId sound)
+{
+	auto it = soundTable_.find(sound);
+	if (it == soundTable_.end()) { return false; }
 
-	auto& src = source_[sHandle];
-	auto& tgt = submix_[tHandle];
+	return wavLoader_->Pin(*it->second.data_, it->second.filename_);
+}
 
-	if (!src || !tgt)
-	{
-		return;
-	}
+void AudioManager::UnpinSound(const std::string& key)
+{
+	UnpinSound(MakeSoundId(key));
+}
 
-	auto it1 = std::remove_if(src->output_.begin(), src->output_.end(),
-		[&tgt](SubmixVoice* sub) { return sub == tgt.get(); });
+void AudioManager::UnpinSound(SoundId sound)
+{
+	auto it = soundTable_.find(sound);
+	if (it == soundTable_.end()) { return; }
 
-	// not found
-	if (it1 == src->output_.end()) { return; }
+	wavLoader_->Unpin(*it->second.data_);
+}
 
-	src->output_.erase(it1, src->output_.end());
+const WAVCacheStats& AudioManager::GetCacheStats(void) const
+{
+	return wavLoader_->GetCacheStats();
+}
 
-	auto it2 = std::remove_if(src->send_.begin(), src->send_.end(),
-		[&tgt](XAUDIO2_SEND_DESCRIPTOR& desc)
-		{ return desc.pOutputVoice == tgt->submixVoice_; });
-	src->send_.erase(it2, src->send_.end());
+void AudioManager::ContinueAll(void)
+{
+	for (const auto& h : source_.GetSlotList())
+	{
+		if (source_[h]->vState_ == VoiceState::Playing) { continue; }
+		if (source_[h]->sourceVoice_ != nullptr) { source_[h]->sourceVoice_->Start(operationSet_); }
+		source_[h]->vState_ = VoiceState::Playing;
+	}
+}
+
+void AudioManager::StopAll(bool destroy)
+{
+	for (auto& h : source_.GetSlotList())
+	{
+		if (source_[h]->vState_ != VoiceState::Stop && source_[h]->sourceVoice_ != nullptr)
+		{
+			source_[h]->sourceVoice_->Stop(operationSet_);
+		}
+	}
+	if (destroy)
+	{
+		// unlinked as DeleteHandle does, the submixes must not keep the deleted voices
+		for (auto& h : source_.GetSlotList())
+		{
+			SourceVoice* src = source_[h].get();
+			for (auto& s : src->output_)
+			{
+				auto it = std::remove(s->sources_.begin(), s->sources_.end(), src);
+				s->sources_.erase(it, s->sources_.end());
+			}
+		}
+		source_.Clear();
+	}
+}
+
+void AudioManager::DeleteHandle(int handle)
+{
+	int id = handle & IdentifyMask;
+
+	if (id == SourceIdentifyID)
+	{
+		SourceVoice* src = ResolveSource(handle);
+		if (src == nullptr)
+		{
+			CancelQueuedPlay(handle);
+			return;
+		}
+
+		// the voice itself is reset when it goes back to the pool
+		for (auto& s : src->output_)
+		{
+			auto it = std::remove(s->sources_.begin(), s->sources_.end(), src);
+			s->sources_.erase(it, s->sources_.end());
+		}
+		source_.Remove(handle & SourceHandleMask);
+		return;
+	}
+	else if (id == SubmixIdentifyID)
+	{
+		if (handle == RootSubmixHandle) { return; }
+		SubmixVoice* sub = ResolveSubmix(handle);
+		if (sub == nullptr) { return; }
+
+		for (auto& o : sub->output_)
+		{
+			auto oit = std::remove(o->input_.begin(), o->input_.end(), sub);
+			o->input_.erase(oit, o->input_.end());
+		}
+
+		// copies, the lists shrink while rerouting
+		std::vector<SubmixVoice*> inputs = sub->input_;
+		for (auto& i : inputs)
+		{
+			RemoveSubmixOutputTarget(i->handle_, handle);
+		}
+
+		std::vector<SourceVoice*> sources = sub->sources_;
+		for (auto& s : sources)
+		{
+			RemoveSourceOutputTarget(s->handle_, handle);
+		}
+
+		submix_.Remove((handle & SubmixHandleMask) >> SubmixHandleShift);
+		return;
+	}
+}
+
+void AudioManager::BeginBatch(void)
+{
+	if (batchDepth_++ > 0) { return; }
+
+	// 0 is XAUDIO2_COMMIT_NOW
+	lastOperationSet_++;
+	if (lastOperationSet_ == XAUDIO2_COMMIT_NOW) { lastOperationSet_++; }
+	operationSet_ = lastOperationSet_;
+}
+
+void AudioManager::CommitBatch(void)
+{
+	if (batchDepth_ == 0 || --batchDepth_ > 0) { return; }
+
+	backend_->CommitChanges(operationSet_);
+	operationSet_ = XAUDIO2_COMMIT_NOW;
+}
+
+void AudioManager::PostBeginBatch(void)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::BeginBatch;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostCommitBatch(void)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::CommitBatch;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::SetFinishedCallback(int sourceHandle, VoiceCallback callback)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
+	src->onFinished_ = std::move(callback);
+}
+
+void AudioManager::SetLoopCallback(int sourceHandle, VoiceCallback callback)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
+	src->onLoop_ = std::move(callback);
+}
+
+void AudioManager::SetAutoRelease(int sourceHandle, bool autoRelease)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	if (src == nullptr) { return; }
+	src->autoRelease_ = autoRelease;
+}
+
+void AudioManager::Update(void)
+{
+	ApplyCommands();
+	ApplyLoads();
+	FinishStolenVoices();
+
+	if (events_.CheckOverflow())
+	{
+		// the poll below covers whatever is still queued
+		VoiceEvent dropped;
+		while (events_.Pop(dropped)) {}
+		PollFinishedVoices();
+	}
+
+	VoiceEvent ev;
+	while (events_.Pop(ev))
+	{
+		uintptr_t context = reinterpret_cast<uintptr_t>(ev.context_);
+		int index = static_cast<int>(context & SourceHandleMask);
+		unsigned int serial = static_cast<unsigned int>(context >> ContextSerialShift) & ContextSerialMask;
+
+		if (static_cast<size_t>(index) >= SourceVoiceArrayMaxSize) { continue; }
+		// the handle was deleted or the buffer was submitted again
+		if (!source_[index] || source_[index]->serial_ != serial) { continue; }
+
+		if (ev.type_ == VoiceEventType::LoopEnd)
+		{
+			if (source_[index]->onLoop_)
+			{
+				VoiceCallback callback = source_[index]->onLoop_;
+				callback(source_[index]->handle_);
+			}
+			continue;
+		}
+
+		if (source_[index]->stream_)
+		{
+			ConsumeStreamBlock(index);
+			continue;
+		}
+
+		FinishVoice(index);
+	}
+
+	UpdateVirtualVoices();
+	SubmitReadyStreamBlocks();
+}
+
+void AudioManager::SubmitReadyStreamBlocks(void)
+{
+	// blocks filled since the last Update
+	for (auto& s : source_.GetSlotList())
+	{
+		if (source_[s]->stream_ && !source_[s]->virtual_)
+		{
+			SubmitStreamBlocks(source_[s].get());
+		}
+	}
+}
+
+int AudioManager::PostPlay(const std::string& key, float volume)
+{
+	return PostPlayLoop(MakeSoundId(key), 0.0f, 0.0f, 0, volume);
+}
+
+int AudioManager::PostPlayLoop(const std::string& key, float begin, float length,
+	unsigned int loopCount, float volume)
+{
+	return PostPlayLoop(MakeSoundId(key), begin, length, loopCount, volume);
+}
+
+int AudioManager::PostPlay(SoundId sound, float volume)
+{
+	return PostPlayLoop(sound, 0.0f, 0.0f, 0, volume);
+}
+
+int AudioManager::PostPlayLoop(SoundId sound, float begin, float length,
+	unsigned int loopCount, float volume)
+{
+	int slot = source_.Reserve();
+	if (slot == -1) { return -1; }
+
+	int handle = MakeSourceHandle(slot);
+
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::Play;
+	command.handle_ = handle;
+	command.param_[0] = begin;
+	command.param_[1] = length;
+	command.param_[2] = volume;
+	command.loopCount_ = loopCount;
+	command.sound_ = sound;
+
+	if (!PostCommand(std::move(command)))
+	{
+		source_.Release(slot);
+		return -1;
+	}
+	return handle;
+}
+
+void AudioManager::PostPlayAgain(int handle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::PlayAgain;
+	command.handle_ = handle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostStop(int handle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::Stop;
+	command.handle_ = handle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostContinue(int handle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::Continue;
+	command.handle_ = handle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostSetVolume(int handle, float volume)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::SetVolume;
+	command.handle_ = handle;
+	command.param_[0] = volume;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostSetFrequencyRatio(int sourceHandle, float ratio)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::SetFrequencyRatio;
+	command.handle_ = sourceHandle;
+	command.param_[0] = ratio;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostSetPitch(int sourceHandle, float semitones)
+{
+	PostSetFrequencyRatio(sourceHandle, std::exp2(semitones / 12.0f));
+}
+
+void AudioManager::PostSetFilter(int handle, XAUDIO2_FILTER_TYPE type, float frequency, float danping)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::SetFilter;
+	command.handle_ = handle;
+	command.filterType_ = type;
+	command.param_[0] = frequency;
+	command.param_[1] = danping;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostAddSourceOutputTarget(int sourceHandle, int targetHandle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::AddSourceOutputTarget;
+	command.handle_ = sourceHandle;
+	command.target_ = targetHandle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostAddSubmixOutputTarget(int submixHandle, int targetHandle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::AddSubmixOutputTarget;
+	command.handle_ = submixHandle;
+	command.target_ = targetHandle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostRemoveSourceOutputTarget(int sourceHandle, int targetHandle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::RemoveSourceOutputTarget;
+	command.handle_ = sourceHandle;
+	command.target_ = targetHandle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostRemoveSubmixOutputTarget(int submixHandle, int targetHandle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::RemoveSubmixOutputTarget;
+	command.handle_ = submixHandle;
+	command.target_ = targetHandle;
+	PostCommand(std::move(command));
+}
+
+void AudioManager::PostDeleteHandle(int handle)
+{
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::DeleteHandle;
+	command.handle_ = handle;
+	PostCommand(std::move(command));
+}
+
+bool AudioManager::BeginRenderToFile(const std::string& filename, int submixHandle, WAVSampleFormat format)
+{
+	if (backend_->GetType() != AudioBackendType::SoftwareMixer) { return false; }
+	if (recorder_) { return false; }
+
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return false; }
+
+	std::unique_ptr<WAVWriter> writer(new WAVWriter());
+	if (!writer->Open(filename, backend_->GetOutputChannels(), backend_->GetOutputSampleRate(), format))
+	{
+		return false;
+	}
+	recorder_ = std::move(writer);
+
+	// submixes share the channel count of the root, so the tap matches the header
+	WAVWriter* recorder = recorder_.get();
+	static_cast<SoftwareMixer&>(*backend_).SetTap(sub->submixVoice_,
+		[recorder](const float* buffer, unsigned int frames, unsigned int)
+		{
+			recorder->Write(buffer, frames);
+		});
+	return true;
+}
+
+bool AudioManager::RenderFrames(unsigned int frames)
+{
+	if (backend_->GetType() != AudioBackendType::SoftwareMixer) { return false; }
+
+	SoftwareMixer& mixer = static_cast<SoftwareMixer&>(*backend_);
+	if (mixer.GetDevice().GetType() != MixerDeviceType::Offline) { return false; }
+
+	OfflineMixerDevice& device = static_cast<OfflineMixerDevice&>(mixer.GetDevice());
+	const unsigned int quantum = mixer.GetQuantumFrames();
+
+	// Update between quanta so callbacks can start the next sound on time
+	while (frames > 0)
+	{
+		// the output must not depend on how fast the disk is, a stream played since the last quantum starts on time
+		if (streamReader_)
+		{
+			streamReader_->WaitIdle();
+			SubmitReadyStreamBlocks();
+		}
+		unsigned int n = std::min(frames, quantum);
+		device.Advance(n);
+		Update();
+		frames -= n;
+	}
+	return true;
+}
+
+bool AudioManager::EndRenderToFile(void)
+{
+	if (!recorder_) { return false; }
+
+	static_cast<SoftwareMixer&>(*backend_).SetTap(nullptr, nullptr);
+	bool result = recorder_->Close();
+	recorder_.reset();
+	return result;
+}
+
+void AudioManager::StartControlThread(unsigned int intervalMs)
+{
+	if (controlThread_.joinable()) { return; }
+
+	controlRunning_.store(true);
+	controlThread_ = std::thread([this, intervalMs]()
+		{
+			while (controlRunning_.load())
+			{
+				Update();
+				std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+			}
+		});
+}
+
+void AudioManager::StopControlThread(void)
+{
+	if (!controlThread_.joinable()) { return; }
+
+	controlRunning_.store(false);
+	controlThread_.join();
+}
+
+void AudioManager::AddSourceOutputTarget(int sourceHandle, int targetHandle)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	SubmixVoice* tgt = ResolveSubmix(targetHandle);
+
+	if (src == nullptr || tgt == nullptr)
+	{
+		return;
+	}
+	if (std::find(src->output_.begin(), src->output_.end(), tgt) != src->output_.end()) { return; }
+
+	if (targetHandle != RootSubmixHandle)
+	{
+		DetachFromRoot(src);
+	}
+
+	src->send_.emplace_back(tgt->submixVoice_);
+	src->output_.emplace_back(tgt);
+	tgt->sources_.emplace_back(src);
+
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetOutputVoices(src->send_, operationSet_); }
+}
+
+void AudioManager::AddSubmixOutputTarget(int submixHandle, int targetHandle)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	SubmixVoice* tgt = ResolveSubmix(targetHandle);
+
+	// only into a higher stage, as XAudio2 requires, which also rules out cycles
+	if (sub == nullptr || tgt == nullptr || tgt->stage_ <= sub->stage_)
+	{
+		return;
+	}
+	if (std::find(sub->output_.begin(), sub->output_.end(), tgt) != sub->output_.end()) { return; }
+
+	if (targetHandle != RootSubmixHandle)
+	{
+		DetachFromRoot(sub);
+	}
+
+	sub->send_.emplace_back(tgt->submixVoice_);
+	sub->output_.emplace_back(tgt);
+	tgt->input_.emplace_back(sub);
+
+	sub->submixVoice_->SetOutputVoices(sub->send_, operationSet_);
+}
+
+void AudioManager::RemoveSourceOutputTarget(int sourceHandle, int targetHandle)
+{
+	SourceVoice* src = ResolveSource(sourceHandle);
+	SubmixVoice* tgt = ResolveSubmix(targetHandle);
+
+	if (src == nullptr || tgt == nullptr)
+	{
+		return;
+	}
+
+	auto it1 = std::remove(src->output_.begin(), src->output_.end(), tgt);
+
+	// not found
+	if (it1 == src->output_.end()) { return; }
+
+	src->output_.erase(it1, src->output_.end());
+
+	auto it2 = std::remove(src->send_.begin(), src->send_.end(), tgt->submixVoice_);
+	src->send_.erase(it2, src->send_.end());
+
+	auto it3 = std::remove(tgt->sources_.begin(), tgt->sources_.end(), src);
+	tgt->sources_.erase(it3, tgt->sources_.end());
+
+	if (src->send_.size() == 0)
+	{
+		AddSourceOutputTarget(sourceHandle, RootSubmixHandle);
+	}
+	if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetOutputVoices(src->send_, operationSet_); }
+}
+
+void AudioManager::RemoveSubmixOutputTarget(int submixHandle, int targetHandle)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	SubmixVoice* tgt = ResolveSubmix(targetHandle);
+
+	if (sub == nullptr || tgt == nullptr || sub == tgt)
+	{
+		return;
+	}
+
+	auto it1 = std::remove(sub->output_.begin(), sub->output_.end(), tgt);
+
+	// not found
+	if (it1 == sub->output_.end()) { return; }
+	
+	sub->output_.erase(it1, sub->output_.end());
+
+	auto it2 = std::remove(sub->send_.begin(), sub->send_.end(), tgt->submixVoice_);
+	sub->send_.erase(it2, sub->send_.end());
+
+	auto it3 = std::remove(tgt->input_.begin(), tgt->input_.end(), sub);
+	tgt->input_.erase(it3, tgt->input_.end());
+
+	if (sub->send_.size() == 0)
+	{
+		AddSubmixOutputTarget(submixHandle, RootSubmixHandle);
+	}
+	sub->submixVoice_->SetOutputVoices(sub->send_, operationSet_);
+}
+
+void AudioManager::DetachFromRoot(SourceVoice* src)
+{
+	SubmixVoice* root = submix_[0].get();
+
+	auto it = std::remove(src->output_.begin(), src->output_.end(), root);
+	if (it == src->output_.end()) { return; }
+	src->output_.erase(it, src->output_.end());
+
+	src->send_.erase(std::remove(src->send_.begin(), src->send_.end(), root->submixVoice_), src->send_.end());
+	root->sources_.erase(std::remove(root->sources_.begin(), root->sources_.end(), src), root->sources_.end());
+}
+
+void AudioManager::DetachFromRoot(SubmixVoice* sub)
+{
+	SubmixVoice* root = submix_[0].get();
+
+	auto it = std::remove(sub->output_.begin(), sub->output_.end(), root);
+	if (it == sub->output_.end()) { return; }
+	sub->output_.erase(it, sub->output_.end());
+
+	sub->send_.erase(std::remove(sub->send_.begin(), sub->send_.end(), root->submixVoice_), sub->send_.end());
+	root->input_.erase(std::remove(root->input_.begin(), root->input_.end(), sub), root->input_.end());
+}
+
+void AudioManager::SetFilter(int handle, XAUDIO2_FILTER_TYPE type, float frequency, float danping)
+{
+	frequency = std::clamp(frequency, 0.0f, XAUDIO2_MAX_FILTER_FREQUENCY);
+	danping = std::clamp(danping, 0.0f, XAUDIO2_MAX_FILTER_ONEOVERQ);
+	XAUDIO2_FILTER_PARAMETERS filter_ = { type, frequency, danping };
+	
+	int id = handle & IdentifyMask;
+	if (id == SourceIdentifyID)
+	{
+		SourceVoice* src = ResolveSource(handle);
+		if (src == nullptr) { return; }
+		src->filter_ = filter_;
+		if (src->sourceVoice_ != nullptr) { src->sourceVoice_->SetFilterParameters(filter_, operationSet_); }
+	}
+	else if (id == SubmixIdentifyID)
+	{
+		SubmixVoice* sub = ResolveSubmix(handle);
+		if (sub == nullptr) { return; }
+		sub->submixVoice_->SetFilterParameters(filter_, operationSet_);
+	}
+}
+
+int AudioManager::AddEffect(int handle, AudioEffectType type, bool active, int insertPosition)
+{
+	SubmixVoice* sub = ResolveSubmix(handle);
+	if (sub == nullptr) { return -1; }
+
+	if (insertPosition > static_cast<int>(sub->efkDesc_.size())) { return -1; }
+	if (insertPosition < 0)
+	{
+		insertPosition = static_cast<int>(sub->efkDesc_.size());
+	}
+
+	EffectParams param;
+
+	const unsigned int channels = backend_->GetOutputChannels();
+	backend_->CreateEffect(param, type, channels);
+	// the backend has no implementation of the type
+	if (param.pEffect_ == nullptr) { return -1; }
+
+	param.type_ = type;
+
+	const XAUDIO2_EFFECT_DESCRIPTOR desc = { param.pEffect_, active, channels };
+	sub->efkDesc_.emplace(sub->efkDesc_.begin() + insertPosition, desc);
+	sub->efkParam_.emplace(sub->efkParam_.begin() + insertPosition, std::move(param));
+
+	// only the new effect starts from scratch
+	sub->submixVoice_->InsertEffect(insertPosition, desc, operationSet_);
+
+	return insertPosition;
+}
+
+void AudioManager::RemoveEffect(int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex < 0 || effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	// the voice keeps the effect alive until the removal is applied
+	sub->submixVoice_->RemoveEffect(effectIndex, operationSet_);
+	sub->efkDesc_.erase(sub->efkDesc_.begin() + effectIndex);
+	sub->efkParam_.erase(sub->efkParam_.begin() + effectIndex);
+}
+
+void AudioManager::MoveEffect(int submixHandle, int from, int to)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	const int count = static_cast<int>(sub->efkDesc_.size());
+	if (from < 0 || from >= count || to < 0 || to >= count || from == to) { return; }
+
+	sub->submixVoice_->MoveEffect(from, to, operationSet_);
+	if (from < to)
+	{
+		std::rotate(sub->efkDesc_.begin() + from, sub->efkDesc_.begin() + from + 1, sub->efkDesc_.begin() + to + 1);
+		std::rotate(sub->efkParam_.begin() + from, sub->efkParam_.begin() + from + 1, sub->efkParam_.begin() + to + 1);
+	}
+	else
+	{
+		std::rotate(sub->efkDesc_.begin() + to, sub->efkDesc_.begin() + from, sub->efkDesc_.begin() + from + 1);
+		std::rotate(sub->efkParam_.begin() + to, sub->efkParam_.begin() + from, sub->efkParam_.begin() + from + 1);
+	}
+}
+
+void AudioManager::EnableEffect(int submixHandle, int effectIndex, bool enable)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex < 0 || effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	sub->efkDesc_[effectIndex].InitialState = enable;
+	sub->submixVoice_->EnableEffect(effectIndex, enable, operationSet_);
+}
+
+void AudioManager::SetReverbParameter(const XAUDIO2FX_REVERB_I3DL2_PARAMETERS& param, int submixHandle, int effectIndex)
+{
+	XAUDIO2FX_REVERB_PARAMETERS p = {};
+	ReverbConvertI3DL2ToNative(&param, &p);
+	SetReverbParameter(p, submixHandle, effectIndex);
+}
+
+void AudioManager::SetReverbParameter(const XAUDIO2FX_REVERB_PARAMETERS& param, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::Reverb);
+		if (effectIndex < 0) { return; }
+	}
+
+	bool result;
+
+	result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+}
+
+void AudioManager::SetEchoParameter(float strength, float delay, float reverb, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::Echo);
+		if (effectIndex < 0) { return; }
+	}
+
+	bool result;
+
+	FXECHO_PARAMETERS param = { strength, delay, reverb };
+	result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+}
+
+void AudioManager::SetEqualizerParameter(const FXEQ_PARAMETERS& param, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::Equalizer);
+		if (effectIndex < 0) { return; }
+	}
+
+	bool result;
+	result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+}
+
+void AudioManager::SetMasteringLimiterParameter(int release, float loudness, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::MasteringLimiter);
+		if (effectIndex < 0) { return; }
+	}
+
+	bool result;
+
+	FXMASTERINGLIMITER_PARAMETERS param = { release, loudness };
+	result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+}
+
+void AudioManager::SetFXReverbParameter(float diffuse, float roomsize, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::FXReverb);
+		if (effectIndex < 0) { return; }
+	}
+
+	bool result;
+
+	FXREVERB_PARAMETERS param = { diffuse, roomsize };
+	result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result)
+	{ 
+		OutputDebugStringA("SetEffectParameter is failed\n");
+	}
+}
+
+void AudioManager::SetConvolutionParameter(float wetDryMix, float gain, int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::Convolution);
+		if (effectIndex < 0) { return; }
+	}
+
+	ConvolutionParameters param = { wetDryMix, gain };
+	bool result = sub->submixVoice_->
+		SetEffectParameters(effectIndex, &param, sizeof(param), operationSet_);
+	if (!result)
+	{
+		OutputDebugStringA("SetEffectParameter is failed\n");
+	}
+}
+
+bool AudioManager::LoadConvolutionImpulse(const std::string& filename, int submixHandle, int effectIndex,
+	bool background)
+{
+	if (backend_->GetType() != AudioBackendType::SoftwareMixer) { return false; }
+
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return false; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return false; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::Convolution);
+		if (effectIndex < 0) { return false; }
+	}
+	if (sub->efkParam_[effectIndex].type_ != AudioEffectType::Convolution) { return false; }
+
+	WAVData data = {};
+	std::unique_ptr<MappedFile> mapping;
+	if (!wavLoader_->ReadWAVFile(filename, WAVLoadMode::Copy, data, mapping)) { return false; }
+
+	// ADPCM is refused here, an impulse response gains nothing from it
+	const unsigned int channel = data.fmt_.channel_;
+	const unsigned int sampleRate = backend_->GetOutputSampleRate();
+	std::vector<float> samples(static_cast<size_t>(data.frameCount_) * channel);
+	bool converted = !samples.empty() &&
+		ConvertToFloat(data.data_, samples.size(), data.fmt_.formatType_, data.fmt_.bitPerSample_, samples.data());
+	if (converted && data.fmt_.samplesPerSec_ != sampleRate)
+	{
+		samples = ResampleFloat(samples.data(), data.frameCount_, channel, data.fmt_.samplesPerSec_, sampleRate);
+	}
+	WAVLoader::FreeWAVData(data);
+	if (!converted || samples.empty()) { return false; }
+
+	std::shared_ptr<ConvolutionEngine> engine = std::make_shared<ConvolutionEngine>(samples.data(),
+		samples.size() / channel, channel, backend_->GetOutputChannels(), background);
+	return static_cast<SoftwareMixer&>(*backend_).SetConvolutionEngine(sub->submixVoice_, effectIndex,
+		std::move(engine), operationSet_);
+}
+
+XAUDIO2FX_VOLUMEMETER_LEVELS* AudioManager::GetVolumeMeterParameter(int submixHandle, int effectIndex)
+{
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return nullptr; }
+	if (effectIndex >= static_cast<int>(sub->efkDesc_.size())) { return nullptr; }
+
+	if (effectIndex < 0)
+	{
+		effectIndex = FindEffect(sub, AudioEffectType::VolumeMeter);
+		if (effectIndex < 0) { return nullptr; }
+	}
+	if (sub->efkParam_[effectIndex].type_ != AudioEffectType::VolumeMeter) { return nullptr; }
+
+	sub->submixVoice_->GetEffectParameters(effectIndex, sub->efkParam_[effectIndex].param_,
+		sizeof(XAUDIO2FX_VOLUMEMETER_LEVELS));
+	return reinterpret_cast<XAUDIO2FX_VOLUMEMETER_LEVELS*>(sub->efkParam_[effectIndex].param_);
+}
+
+std::shared_ptr<const MixerMeter> AudioManager::EnableSubmixMeter(int submixHandle, unsigned int windowMs,
+	bool loudness)
+{
+	if (backend_->GetType() != AudioBackendType::SoftwareMixer) { return nullptr; }
+
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return nullptr; }
+
+	// submixes share the channel count of the root
+	std::shared_ptr<MixerMeter> meter = std::make_shared<MixerMeter>(backend_->GetOutputChannels(),
+		backend_->GetOutputSampleRate(), windowMs, loudness);
+	static_cast<SoftwareMixer&>(*backend_).SetMeter(sub->submixVoice_, meter);
+	return meter;
+}
+
+void AudioManager::DisableSubmixMeter(int submixHandle)
+{
+	if (backend_->GetType() != AudioBackendType::SoftwareMixer) { return; }
+
+	SubmixVoice* sub = ResolveSubmix(submixHandle);
+	if (sub == nullptr) { return; }
+	static_cast<SoftwareMixer&>(*backend_).SetMeter(sub->submixVoice_, nullptr);
+}
+
+AudioManager::AudioManager(const AudioBackendDesc& desc)
+{
+	Initialize(desc);
+}
+
+AudioManager::~AudioManager()
+{
+	StopControlThread();
+	EndRenderToFile();
+	loadScheduler_.reset();
+
+	//for (auto& src : sources_)
+	//{
+	//	src.reset();
+	//}
+
+	//for (auto& s : submixs_)
+	//{
+	//	s.second->submixVoice_->DestroyVoice();
+	//}
+	//submixs_.clear();
 
-	auto it3 = std::remove_if(tgt->sources_.begin(), tgt->sources_.end(),
-		[&src](SourceVoice* sr) { return sr == src.get(); });
-	tgt->sources_.erase(it3, tgt->sources_.end());
+	source_.Clear();
+	streamReader_.reset();
+	voicePool_.reset();
+	submix_.Clear();
 
-	if (src->send_.size() == 0)
-	{
-		AddSourceOutputTarget(sourceHandle, RootSubmixHandle);
-	}
-	XAUDIO2_VOICE_SENDS snd = { src->send_.size(), src->send_.data() };
-	src->sourceVoice_->SetOutputVoices(&snd);
+	backend_.reset();
 }
 
-void AudioManager::RemoveSubmixOutputTarget(int submixHandle, int targetHandle)
+void AudioManager::Initialize(const AudioBackendDesc& desc)
+{
+	instanceId_ = ++instanceCount_;
+
+	wavLoader_.reset(new WAVLoader());
+
+	backend_ = CreateAudioBackend(desc);
+	assert(backend_);
+
+	backend_->SetEventQueue(&events_);
+
+	voicePool_.reset(new SourceVoicePool(*backend_, MaxFrequencyRatio));
+
+	SubmixVoice* sm = new SubmixVoice();
+	sm->submixVoice_ = backend_->CreateSubmixVoice(backend_->GetOutputChannels(),
+		backend_->GetOutputSampleRate(), RootProcessingStage);
+	assert(sm->submixVoice_ != nullptr);
+	int hd = submix_.Add(sm);
+	sm->handle_ = MakeSubmixHandle(hd);
+	assert(sm->handle_ == RootSubmixHandle);
+	sm->stage_ = RootProcessingStage;
+}
+
+UINT64 AudioManager::GetSamplesPlayed(SourceVoice* src)
 {
-	if ((submixHandle & IdentifyMask) != SubmixIdentifyID) { return; }
-	if ((targetHandle & IdentifyMask) != SubmixIdentifyID) { return; }
+	XAUDIO2_VOICE_STATE state;
+	src->sourceVoice_->GetState(state);
+	return state.SamplesPlayed;
+}
 
-	int sHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (sHandle < 0 || sHandle > SubmixVoiceArrayMaxSize) { return; }
-	int tHandle = (targetHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (tHandle < 0 || tHandle > SubmixVoiceArrayMaxSize) { return; }
+bool AudioManager::SubmitSourceBuffer(SourceVoice* src, uint64_t consumed)
+{
+	playSerial_ = (playSerial_ + 1) & ContextSerialMask;
+	src->serial_ = playSerial_;
 
-	if (sHandle == tHandle) { return; }
-	auto& sub = submix_[sHandle];
-	auto& tgt = submix_[tHandle];
+	uintptr_t context = (static_cast<uintptr_t>(src->serial_) << ContextSerialShift) |
+		static_cast<uintptr_t>(src->handle_ & SourceHandleMask);
+	src->buffer_.pContext = reinterpret_cast<void*>(context);
 
-	if (!sub || !tgt)
+	if (src->virtual_)
 	{
-		return;
+		src->virtualConsumed_ = static_cast<double>(consumed);
+		return true;
 	}
 
-	auto it1 = std::remove_if(sub->output_.begin(), sub->output_.end(),
-		[&tgt](SubmixVoice* sub) { return sub == tgt.get(); });
+	src->samplesBase_ = GetSamplesPlayed(src);
+	src->consumedBase_ = consumed;
 
-	// not found
-	if (it1 == sub->output_.end()) { return; }
-	
-	sub->output_.erase(it1, sub->output_.end());
+	unsigned int frame = 0;
+	unsigned int loops = 0;
+	if (!LocatePlay(src, consumed, frame, loops)) { return false; }
 
-	auto it2 = std::remove_if(sub->send_.begin(), sub->send_.end(),
-		[&tgt](XAUDIO2_SEND_DESCRIPTOR& desc)
-		{ return desc.pOutputVoice == tgt->submixVoice_; });
-	sub->send_.erase(it2, sub->send_.end());
+	const XAUDIO2_BUFFER& b = src->buffer_;
+	const unsigned int loopsLeft = b.LoopCount == XAUDIO2_LOOP_INFINITE ? b.LoopCount : b.LoopCount - loops;
+	if (src->stream_)
+	{
+		if (!src->stream_->Restart(b.PlayBegin, b.PlayLength, loopsLeft, frame - b.PlayBegin))
+		{
+			return false;
+		}
+		// a decoder fills its first block here so a sound effect starts at once
+		// a file is only read by the reader, the voice starts when Update submits its first block
+		if (!src->stream_->ReadsFile())
+		{
+			src->stream_->Fill();
+		}
+		streamReader_->Wake();
+		return SubmitStreamBlocks(src);
+	}
+	if (consumed == 0)
+	{
+		return src->sourceVoice_->SubmitSourceBuffer(b);
+	}
 
-	auto it3 = std::remove_if(tgt->input_.begin(), tgt->input_.end(),
-		[&sub](SubmixVoice* sr) { return sr == sub.get(); });
-	tgt->input_.erase(it3, tgt->input_.end());
+	// resumes midway with the loops still to go, past the last wrap the loop region is dropped
+	const unsigned int frames = b.AudioBytes / src->waveFormat_.nBlockAlign;
+	const unsigned int playEnd = b.PlayLength == 0 ? frames : std::min(b.PlayBegin + b.PlayLength, frames);
+	XAUDIO2_BUFFER resumed = b;
+	resumed.PlayBegin = frame;
+	resumed.PlayLength = playEnd - frame;
+	if (loopsLeft > 0)
+	{
+		resumed.LoopLength = (b.LoopLength == 0 ? playEnd : std::min(b.LoopBegin + b.LoopLength, playEnd)) - b.LoopBegin;
+		resumed.LoopCount = loopsLeft;
+	}
+	else
+	{
+		resumed.LoopBegin = 0;
+		resumed.LoopLength = 0;
+		resumed.LoopCount = 0;
+	}
+	return src->sourceVoice_->SubmitSourceBuffer(resumed);
+}
 
-	if (sub->send_.size() == 0)
+bool AudioManager::SubmitStreamBlocks(SourceVoice* src)
+{
+	const StreamBlock* block = nullptr;
+	while ((block = src->stream_->NextReady()) != nullptr)
 	{
-		AddSubmixOutputTarget(submixHandle, RootSubmixHandle);
+		XAUDIO2_BUFFER buffer = {};
+		buffer.AudioBytes = block->bytes_;
+		buffer.pAudioData = block->data_.data();
+		buffer.Flags = block->last_ ? XAUDIO2_END_OF_STREAM : 0;
+		buffer.pContext = src->buffer_.pContext;
+		if (!src->sourceVoice_->SubmitSourceBuffer(buffer)) { return false; }
 	}
-	XAUDIO2_VOICE_SENDS snd = { sub->send_.size(), sub->send_.data() };
-	sub->submixVoice_->SetOutputVoices(&snd);
+	return true;
 }
 
-void AudioManager::SetFilter(int handle, XAUDIO2_FILTER_TYPE type, float frequency, float danping)
+void AudioManager::ConsumeStreamBlock(int index)
 {
-	frequency = std::clamp(frequency, 0.0f, XAUDIO2_MAX_FILTER_FREQUENCY);
-	danping = std::clamp(danping, 0.0f, XAUDIO2_MAX_FILTER_ONEOVERQ);
-	XAUDIO2_FILTER_PARAMETERS filter_ = { type, frequency, danping };
-	
-	int id = handle & IdentifyMask;
-	if (id == SourceIdentifyID)
+	unsigned int serial = source_[index]->serial_;
+	unsigned int loops = 0;
+	bool last = source_[index]->stream_->Consume(loops);
+	streamReader_->Wake();
+
+	// loop callbacks land when the block holding the wrap is done, not on the exact frame
+	for (; loops > 0; loops--)
 	{
-		handle = handle & SourceHandleMask;
-		if (handle < 0 || handle >= SourceVoiceArrayMaxSize) { return; }
-		if (!source_[handle]) { return; }
-		source_[handle]->sourceVoice_->SetFilterParameters(&filter_);
+		if (!source_[index]->onLoop_) { break; }
+
+		VoiceCallback callback = source_[index]->onLoop_;
+		callback(source_[index]->handle_);
+		if (!source_[index] || source_[index]->serial_ != serial) { return; }
 	}
-	else if (id == SubmixIdentifyID)
+
+	if (last)
 	{
-		handle = (handle & SubmixHandleMask) >> SubmixHandleShift;
-		if (handle < 0 || handle >= SubmixVoiceArrayMaxSize) { return; }
-		if (!submix_[handle]) { return; }
-		submix_[handle]->submixVoice_->SetFilterParameters(&filter_);
+		FinishVoice(index);
 	}
 }
 
-int AudioManager::AddEffect(int handle, AudioEffectType type, bool active, int insertPosition)
+void AudioManager::FinishVoice(int index)
+{
+	auto& src = source_[index];
+	unsigned int serial = src->serial_;
+
+	if (src->vState_ == VoiceState::Playing)
+	{
+		if (src->sourceVoice_ != nullptr) { src->sourceVoice_->Stop(); }
+		src->vState_ = VoiceState::Stop;
+	}
+
+	if (src->onFinished_)
+	{
+		// the callback may delete or replay this handle
+		VoiceCallback callback = src->onFinished_;
+		callback(src->handle_);
+		if (!source_[index] || source_[index]->serial_ != serial) { return; }
+	}
+
+	if (source_[index]->autoRelease_)
+	{
+		DeleteHandle(source_[index]->handle_);
+	}
+}
+
+void AudioManager::PollFinishedVoices(void)
 {
-	if (!SubmixHandleIsValid(handle)) { return -1; }
-	int hd = (handle & SubmixHandleMask) >> SubmixHandleShift;
+	std::vector<int> finished;
+	// slot and serial of a streamed voice, once per block the voice released
+	std::vector<std::pair<int, unsigned int>> streamed;
+	for (auto& s : source_.GetSlotList())
+	{
+		// virtual voices finish in UpdateVirtualVoices
+		if (source_[s]->virtual_) { continue; }
 
-	EffectParams param = {};
+		XAUDIO2_VOICE_STATE state;
+		source_[s]->sourceVoice_->GetState(state);
 
-	CreateEffect::GenerateEffectInstance(param, type, masterVoiceDetails_.InputChannels);
+		// an empty queue on a stream may only be the reader falling behind
+		if (source_[s]->stream_)
+		{
+			unsigned int queued = source_[s]->stream_->GetQueuedCount();
+			for (unsigned int i = state.BuffersQueued; i < queued; i++)
+			{
+				streamed.emplace_back(s, source_[s]->serial_);
+			}
+			continue;
+		}
 
-	param.type_ = type;
+		if (state.BuffersQueued == 0 && source_[s]->vState_ == VoiceState::Playing)
+		{
+			finished.emplace_back(s);
+		}
+	}
 
-	if (insertPosition == -1)
+	for (auto& f : finished)
 	{
-		submix_[hd]->efkDesc_.emplace_back(XAUDIO2_EFFECT_DESCRIPTOR
-			{ param.pEffect_, active, masterVoiceDetails_.InputChannels });
-		submix_[hd]->efkParam_.emplace_back(param);
-		insertPosition = submix_[hd]->efkDesc_.size() - 1;
+		if (source_[f]) { FinishVoice(f); }
 	}
-	else
+	for (auto& s : streamed)
 	{
-		submix_[hd]->efkDesc_.emplace(submix_[hd]->efkDesc_.begin() + insertPosition,
-			XAUDIO2_EFFECT_DESCRIPTOR{ param.pEffect_, active,
-			masterVoiceDetails_.InputChannels });
-		submix_[hd]->efkParam_.emplace(submix_[hd]->efkParam_.begin(), param);
+		if (source_[s.first] && source_[s.first]->serial_ == s.second) { ConsumeStreamBlock(s.first); }
 	}
-	XAUDIO2_EFFECT_CHAIN chain = { submix_[hd]->efkDesc_.size(),
-		submix_[hd]->efkDesc_.data() };
+}
 
-	submix_[hd]->submixVoice_->SetEffectChain(nullptr);
-	submix_[hd]->submixVoice_->SetEffectChain(&chain);
+bool AudioManager::LocatePlay(const SourceVoice* src, uint64_t consumed, unsigned int& frame, unsigned int& loops)
+{
+	const XAUDIO2_BUFFER& b = src->buffer_;
+	const uint64_t frames = b.AudioBytes / src->waveFormat_.nBlockAlign;
+	const uint64_t playEnd = b.PlayLength == 0 ? frames : std::min<uint64_t>(b.PlayBegin + b.PlayLength, frames);
+	// a stream loops its play region
+	const uint64_t loopBegin = src->stream_ ? b.PlayBegin : b.LoopBegin;
+	const uint64_t loopEnd = src->stream_ || b.LoopLength == 0 ? playEnd : std::min<uint64_t>(b.LoopBegin + b.LoopLength, playEnd);
+
+	loops = 0;
+	if (b.LoopCount == 0 || loopEnd <= loopBegin || loopEnd <= b.PlayBegin || consumed < loopEnd - b.PlayBegin)
+	{
+		frame = static_cast<unsigned int>(std::min(b.PlayBegin + consumed, playEnd));
+		return b.PlayBegin + consumed < playEnd;
+	}
 
-	return insertPosition;
+	// frames after the first wrap
+	const uint64_t loopLength = loopEnd - loopBegin;
+	const uint64_t after = consumed - (loopEnd - b.PlayBegin);
+	const uint64_t wraps = after / loopLength + 1;
+	if (b.LoopCount == XAUDIO2_LOOP_INFINITE || wraps < b.LoopCount)
+	{
+		loops = static_cast<unsigned int>(wraps);
+		frame = static_cast<unsigned int>(loopBegin + after % loopLength);
+		return true;
+	}
+
+	// past the last wrap it plays on to the end
+	loops = b.LoopCount;
+	const uint64_t tail = loopBegin + after - (b.LoopCount - 1) * loopLength;
+	frame = static_cast<unsigned int>(std::min(tail, playEnd));
+	return tail < playEnd;
 }
 
-void AudioManager::SetReverbParameter(const XAUDIO2FX_REVERB_I3DL2_PARAMETERS& param, int submixHandle, int effectIndex)
+uint64_t AudioManager::GetConsumed(SourceVoice* src)
 {
-	XAUDIO2FX_REVERB_PARAMETERS p = {};
-	ReverbConvertI3DL2ToNative(&param, &p);
-	SetReverbParameter(p, submixHandle, effectIndex);
+	if (src->virtual_) { return static_cast<uint64_t>(src->virtualConsumed_); }
+
+	UINT64 played = GetSamplesPlayed(src);
+	played = played >= src->samplesBase_ ? played - src->samplesBase_ : played;
+	return src->consumedBase_ + played;
 }
 
-void AudioManager::SetReverbParameter(const XAUDIO2FX_REVERB_PARAMETERS& param, int submixHandle, int effectIndex)
+float AudioManager::GetAudibility(const SourceVoice* src) const
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= submix_[submixHandle]->efkDesc_.size()) { return; }
+	if (src->vState_ != VoiceState::Playing) { return 0.0f; }
 
-	if (effectIndex < 0)
+	float out = src->output_.empty() ? GetAudibility(submix_[0].get()) : 0.0f;
+	for (auto& o : src->output_)
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::Reverb);
-		if (effectIndex < 0) { return; }
+		out = std::max(out, GetAudibility(o));
 	}
+	return std::fabs(src->volume_) * out;
+}
 
-	HRESULT result;
+float AudioManager::GetAudibility(const SubmixVoice* sub) const
+{
+	float out = sub->output_.empty() ? 1.0f : 0.0f;
+	for (auto& o : sub->output_)
+	{
+		out = std::max(out, GetAudibility(o));
+	}
+	return std::fabs(sub->volume_) * out;
+}
 
-	result = submix_[submixHandle]->submixVoice_->
-		SetEffectParameters(effectIndex, &param, sizeof(param));
-	if (FAILED(result)) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+bool AudioManager::Outranks(const SourceVoice* a, const SourceVoice* b) const
+{
+	// stopped plays give their voice up first whatever their priority
+	const bool playingA = a->vState_ == VoiceState::Playing;
+	const bool playingB = b->vState_ == VoiceState::Playing;
+	if (playingA != playingB) { return playingA; }
+	if (a->priority_ != b->priority_) { return a->priority_ > b->priority_; }
+
+	// the margin keeps plays of near equal volume from swapping every Update
+	const float ea = GetAudibility(a) * (a->virtual_ ? 1.0f : VirtualSwapMargin);
+	const float eb = GetAudibility(b) * (b->virtual_ ? 1.0f : VirtualSwapMargin);
+	if (ea != eb) { return ea > eb; }
+	return !a->virtual_ && b->virtual_;
 }
 
-void AudioManager::SetEchoParameter(float strength, float delay, float reverb, int submixHandle, int effectIndex)
+bool AudioManager::AdmitPlay(SoundId sound, float volume, std::vector<int>& steal)
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= submix_[submixHandle]->efkDesc_.size()) { return; }
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end()) { return true; }
+	SoundAsset& a = asset->second;
 
-	if (effectIndex < 0)
+	const uint64_t now = backend_->GetRenderedFrames();
+	if (a.retriggerFrames_ != 0 && a.played_ && now - a.lastPlayFrame_ < a.retriggerFrames_)
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::Echo);
-		if (effectIndex < 0) { return; }
+		budgetStats_.rejected_++;
+		return false;
 	}
 
-	HRESULT result;
+	if (a.maxInstances_ != 0)
+	{
+		// handle and order to steal in, paused instances do not count
+		std::vector<std::pair<int, double>> instance;
+		for (auto& s : source_.GetSlotList())
+		{
+			const SourceVoice* v = source_[s].get();
+			if (v->sound_ != sound || v->vState_ != VoiceState::Playing) { continue; }
+			instance.emplace_back(v->handle_, a.steal_ == InstanceSteal::Quietest ?
+				GetAudibility(v) : static_cast<double>(v->playOrder_));
+		}
+
+		if (instance.size() >= a.maxInstances_)
+		{
+			const size_t count = instance.size() - a.maxInstances_ + 1;
+			std::partial_sort(instance.begin(), instance.begin() + count, instance.end(),
+				[](const std::pair<int, double>& x, const std::pair<int, double>& y) { return x.second < y.second; });
 
-	FXECHO_PARAMETERS param = { strength, delay, reverb };
-	result = submix_[submixHandle]->submixVoice_->
-		SetEffectParameters(effectIndex, &param, sizeof(param));
-	if (FAILED(result)) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+			// new plays start on the root submix
+			if (a.steal_ == InstanceSteal::Reject ||
+				(a.steal_ == InstanceSteal::Quietest && std::fabs(volume) * GetAudibility(submix_[0].get()) < instance[count - 1].second))
+			{
+				budgetStats_.rejected_++;
+				return false;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				steal.emplace_back(instance[i].first);
+			}
+		}
+	}
+	return true;
 }
 
-void AudioManager::SetEqualizerParameter(const FXEQ_PARAMETERS& param, int submixHandle, int effectIndex)
+void AudioManager::RecordPlay(SoundId sound, const std::vector<int>& steal)
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= submix_[submixHandle]->efkDesc_.size()) { return; }
+	auto asset = soundTable_.find(sound);
+	if (asset == soundTable_.end()) { return; }
 
-	if (effectIndex < 0)
+	asset->second.played_ = true;
+	asset->second.lastPlayFrame_ = backend_->GetRenderedFrames();
+
+	// stopped now so they stop counting, the callbacks wait for Update and never run inside a play
+	for (int handle : steal)
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::Equalizer);
-		if (effectIndex < 0) { return; }
-	}
+		SourceVoice* v = ResolveSource(handle);
+		if (v == nullptr || v->vState_ != VoiceState::Playing) { continue; }
 
-	HRESULT result;
-	result = submix_[submixHandle]->submixVoice_->
-		SetEffectParameters(effectIndex, &param, sizeof(param));
-	if (FAILED(result)) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+		budgetStats_.stolen_++;
+		if (v->sourceVoice_ != nullptr) { v->sourceVoice_->Stop(); }
+		v->vState_ = VoiceState::Stop;
+		stolenVoice_.emplace_back(handle);
+	}
 }
 
-void AudioManager::SetMasteringLimiterParameter(int release, float loudness, int submixHandle, int effectIndex)
+void AudioManager::FinishStolenVoices(void)
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= submix_[submixHandle]->efkDesc_.size()) { return; }
+	if (stolenVoice_.empty()) { return; }
 
-	if (effectIndex < 0)
+	// a callback may play the sound again and steal more, those finish on the next Update
+	std::vector<int> stolen = std::move(stolenVoice_);
+	stolenVoice_.clear();
+	for (int handle : stolen)
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::MasteringLimiter);
-		if (effectIndex < 0) { return; }
+		// deleted or continued since
+		SourceVoice* v = ResolveSource(handle);
+		if (v == nullptr || v->vState_ != VoiceState::Stop) { continue; }
+		FinishVoice(handle & SourceHandleMask);
 	}
+}
 
-	HRESULT result;
+void AudioManager::Virtualize(SourceVoice* src)
+{
+	if (src->virtual_) { return; }
 
-	FXMASTERINGLIMITER_PARAMETERS param = { release, loudness };
-	result = submix_[submixHandle]->submixVoice_->
-		SetEffectParameters(effectIndex, &param, sizeof(param));
-	if (FAILED(result)) { OutputDebugStringA("SetEffectParameter is failed\n"); }
+	const uint64_t consumed = GetConsumed(src);
+
+	// a new serial, the flush must not finish the play
+	playSerial_ = (playSerial_ + 1) & ContextSerialMask;
+	src->serial_ = playSerial_;
+
+	// the pool stops and flushes it
+	src->pool_->Release(src->waveFormat_, src->sourceVoice_);
+	src->sourceVoice_ = nullptr;
+	src->virtual_ = true;
+	src->virtualConsumed_ = static_cast<double>(consumed);
+	budgetStats_.demoted_++;
 }
 
-void AudioManager::SetFXReverbParameter(float diffuse, float roomsize, int submixHandle, int effectIndex)
+bool AudioManager::Devirtualize(SourceVoice* src)
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= static_cast<int>(submix_[submixHandle]->efkDesc_.size())) { return; }
+	if (!src->virtual_) { return true; }
 
-	if (effectIndex < 0)
+	// a play that ended while virtual keeps waiting for PlayAgain
+	unsigned int frame = 0;
+	unsigned int loops = 0;
+	if (!LocatePlay(src, static_cast<uint64_t>(src->virtualConsumed_), frame, loops)) { return false; }
+
+	AudioSourceVoice* voice = voicePool_->Acquire(src->waveFormat_);
+	if (voice == nullptr) { return false; }
+
+	voice->SetVolume(src->volume_, operationSet_);
+	voice->SetFilterParameters(src->filter_, operationSet_);
+	voice->SetFrequencyRatio(src->frequencyRatio_, operationSet_);
+	voice->SetResampleQuality(src->quality_);
+	voice->SetOutputVoices(src->send_, operationSet_);
+
+	src->sourceVoice_ = voice;
+	src->virtual_ = false;
+	if (!SubmitSourceBuffer(src, static_cast<uint64_t>(src->virtualConsumed_)))
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::FXReverb);
-		if (effectIndex < 0) { return; }
+		voicePool_->Release(src->waveFormat_, voice);
+		src->sourceVoice_ = nullptr;
+		src->virtual_ = true;
+		return false;
+	}
+
+	if (src->vState_ == VoiceState::Playing)
+	{
+		voice->Start(operationSet_);
 	}
+	budgetStats_.promoted_++;
+	return true;
+}
 
-	HRESULT result;
+void AudioManager::UpdateVirtualVoices(void)
+{
+	const uint64_t rendered = backend_->GetRenderedFrames();
+	const uint64_t elapsed = rendered - lastRenderedFrames_;
+	lastRenderedFrames_ = rendered;
 
-	FXREVERB_PARAMETERS param = { diffuse, roomsize };
-	result = submix_[submixHandle]->submixVoice_->
-		SetEffectParameters(effectIndex, &param, sizeof(param));
-	if (FAILED(result)) 
-	{ 
-		OutputDebugStringA("SetEffectParameter is failed\n");
+	// nothing is virtual and nothing has to be
+	const unsigned int real = voicePool_->GetStats().active_;
+	if (real == source_.GetSlotList().size() && (voiceBudget_ == 0 || real <= voiceBudget_)) { return; }
+
+	// copied, finishing may delete handles
+	std::vector<int> slots = source_.GetSlotList();
+	for (auto& s : slots)
+	{
+		if (source_[s] && source_[s]->virtual_ && source_[s]->vState_ == VoiceState::Playing)
+		{
+			AdvanceVirtualVoice(s, elapsed);
+		}
+	}
+
+	// same order as Outranks, with the audibility worked out once per play
+	struct Rank
+	{
+		SourceVoice* src_;
+		float audibility_;
+	};
+	std::vector<Rank> rank;
+	rank.reserve(source_.GetSlotList().size());
+	for (auto& s : source_.GetSlotList())
+	{
+		SourceVoice* src = source_[s].get();
+		rank.emplace_back(Rank{ src, GetAudibility(src) * (src->virtual_ ? 1.0f : VirtualSwapMargin) });
+	}
+	std::sort(rank.begin(), rank.end(), [](const Rank& a, const Rank& b)
+		{
+			const bool playingA = a.src_->vState_ == VoiceState::Playing;
+			const bool playingB = b.src_->vState_ == VoiceState::Playing;
+			if (playingA != playingB) { return playingA; }
+			if (a.src_->priority_ != b.src_->priority_) { return a.src_->priority_ > b.src_->priority_; }
+			if (a.audibility_ != b.audibility_) { return a.audibility_ > b.audibility_; }
+			if (a.src_->virtual_ != b.src_->virtual_) { return !a.src_->virtual_; }
+			return a.src_->handle_ < b.src_->handle_;
+		});
+
+	// demotions first, the voices they free go to the promotions
+	const size_t budget = voiceBudget_ == 0 ? rank.size() : std::min<size_t>(voiceBudget_, rank.size());
+	for (size_t i = budget; i < rank.size(); i++)
+	{
+		Virtualize(rank[i].src_);
+	}
+	for (size_t i = 0; i < budget; i++)
+	{
+		Devirtualize(rank[i].src_);
 	}
 }
 
-XAUDIO2FX_VOLUMEMETER_LEVELS* AudioManager::GetVolumeMeterParameter(int submixHandle, int effectIndex)
+void AudioManager::AdvanceVirtualVoice(int index, uint64_t frames)
 {
-	if (!SubmixHandleIsValid(submixHandle)) { return nullptr; }
-	submixHandle = (submixHandle & SubmixHandleMask) >> SubmixHandleShift;
-	if (effectIndex >= submix_[submixHandle]->efkDesc_.size()) { return nullptr; }
+	SourceVoice* src = source_[index].get();
+	const unsigned int serial = src->serial_;
 
-	if (effectIndex < 0)
+	unsigned int frame = 0;
+	unsigned int before = 0;
+	unsigned int after = 0;
+	LocatePlay(src, static_cast<uint64_t>(src->virtualConsumed_), frame, before);
+
+	src->virtualConsumed_ += static_cast<double>(frames) * src->waveFormat_.nSamplesPerSec *
+		src->frequencyRatio_ / backend_->GetOutputSampleRate();
+	const bool playing = LocatePlay(src, static_cast<uint64_t>(src->virtualConsumed_), frame, after);
+
+	for (; before < after; before++)
 	{
-		effectIndex = FindEffect(submixHandle, AudioEffectType::FXReverb);
-		if (effectIndex < 0) { return nullptr; }
+		if (!source_[index]->onLoop_) { break; }
+
+		VoiceCallback callback = source_[index]->onLoop_;
+		callback(source_[index]->handle_);
+		if (!source_[index] || source_[index]->serial_ != serial) { return; }
 	}
 
-	auto& sub = submix_[submixHandle];
-	sub->submixVoice_->GetEffectParameters(effectIndex, sub->efkParam_[effectIndex].param_,
-		sizeof(XAUDIO2FX_VOLUMEMETER_LEVELS));
-	return reinterpret_cast<XAUDIO2FX_VOLUMEMETER_LEVELS*>(sub->efkParam_[effectIndex].param_);
+	if (!playing)
+	{
+		FinishVoice(index);
+	}
 }
 
-AudioManager::AudioManager():xaudioCore_(nullptr), masterVoice_(nullptr)
+CommandRing& AudioManager::GetCommandRing(void)
 {
-	Initialize();
+	// closes the ring when the thread exits or moves on to a newer instance
+	struct ThreadRing
+	{
+		~ThreadRing() { Close(); }
+		void Close(void)
+		{
+			if (ring_) { ring_->closed_.store(true, std::memory_order_release); }
+		}
+
+		unsigned int owner_ = 0;
+		std::shared_ptr<ProducerRing> ring_;
+	};
+	thread_local ThreadRing thread;
+
+	if (thread.owner_ != instanceId_)
+	{
+		thread.Close();
+		thread.ring_ = std::make_shared<ProducerRing>();
+		thread.owner_ = instanceId_;
+
+		std::lock_guard<std::mutex> lock(ringMutex_);
+		rings_.emplace_back(thread.ring_);
+	}
+	return thread.ring_->ring_;
 }
 
-AudioManager::~AudioManager()
+bool AudioManager::PostCommand(AudioCommand&& command)
 {
-	//for (auto& src : sources_)
-	//{
-	//	src.reset();
-	//}
+	if (!GetCommandRing().Push(std::move(command)))
+	{
+		OutputDebugStringA("command ring is full\n");
+		return false;
+	}
+	return true;
+}
 
-	//for (auto& s : submixs_)
-	//{
-	//	s.second->submixVoice_->DestroyVoice();
-	//}
-	//submixs_.clear();
+void AudioManager::ApplyCommands(void)
+{
+	// drained from a copy, a thread adding its ring or a command posting from a callback never waits on the drain
+	std::vector<std::shared_ptr<ProducerRing>> rings;
+	{
+		std::lock_guard<std::mutex> lock(ringMutex_);
+		rings = rings_;
+	}
 
-	source_.Clear();
-	submix_.Clear();
+	bool closed = false;
+	AudioCommand command;
+	for (auto& ring : rings)
+	{
+		while (ring->ring_.Pop(command))
+		{
+			ApplyCommand(command);
+		}
+		closed = closed || ring->closed_.load(std::memory_order_relaxed);
+	}
+	if (!closed) { return; }
+
+	// a closed ring gets no more commands, every one it had is in the ring before closed_ is seen
+	std::lock_guard<std::mutex> lock(ringMutex_);
+	rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<ProducerRing>& r)
+		{ return r->closed_.load(std::memory_order_acquire) && r->ring_.Empty(); }), rings_.end());
+}
 
-	if (masterVoice_)
+void AudioManager::ApplyCommand(AudioCommand& command)
+{
+	switch (command.type_)
 	{
-		masterVoice_->DestroyVoice();
-		masterVoice_ = nullptr;
+	case AudioCommandType::Play:
+		PlayInSlot(command.handle_ & SourceHandleMask, command.sound_, command.param_[0],
+			command.param_[1], command.loopCount_, command.param_[2]);
+		break;
+	case AudioCommandType::PlayAgain:
+		PlayAgain(command.handle_);
+		break;
+	case AudioCommandType::Stop:
+		Stop(command.handle_);
+		break;
+	case AudioCommandType::Continue:
+		Continue(command.handle_);
+		break;
+	case AudioCommandType::SetVolume:
+		SetVolume(command.handle_, command.param_[0]);
+		break;
+	case AudioCommandType::SetFrequencyRatio:
+		SetFrequencyRatio(command.handle_, command.param_[0]);
+		break;
+	case AudioCommandType::SetFilter:
+		SetFilter(command.handle_, command.filterType_, command.param_[0], command.param_[1]);
+		break;
+	case AudioCommandType::AddSourceOutputTarget:
+		AddSourceOutputTarget(command.handle_, command.target_);
+		break;
+	case AudioCommandType::AddSubmixOutputTarget:
+		AddSubmixOutputTarget(command.handle_, command.target_);
+		break;
+	case AudioCommandType::RemoveSourceOutputTarget:
+		RemoveSourceOutputTarget(command.handle_, command.target_);
+		break;
+	case AudioCommandType::RemoveSubmixOutputTarget:
+		RemoveSubmixOutputTarget(command.handle_, command.target_);
+		break;
+	case AudioCommandType::DeleteHandle:
+		DeleteHandle(command.handle_);
+		break;
+	case AudioCommandType::BeginBatch:
+		BeginBatch();
+		break;
+	case AudioCommandType::CommitBatch:
+		CommitBatch();
+		break;
+	default:
+		break;
 	}
-	
-	xaudioCore_->Release();
 }
 
-void AudioManager::Initialize(void)
+void AudioManager::ApplyLoads(void)
 {
-	HRESULT result;
+	if (loadTicket_.empty()) { return; }
 
-	wavLoader_.reset(new WAVLoader());
-	
-	// IXAudio2IuWFNg̍쐬
-	result = XAudio2Create(&xaudioCore_);
-	assert(SUCCEEDED(result));
-
-	// fobO̐ݒ
-#ifdef _DEBUG
-	XAUDIO2_DEBUG_CONFIGURATION debugc = {};
-	debugc.TraceMask = XAUDIO2_LOG_WARNINGS;
-	debugc.BreakMask = XAUDIO2_LOG_ERRORS;
-	xaudioCore_->SetDebugConfiguration(&debugc);
-#endif
+	std::vector<std::unique_ptr<LoadResult>> results = std::move(loadResult_);
+	loadResult_.clear();
+	if (loadScheduler_) { loadScheduler_->TakeResults(results); }
+
+	for (auto& r : results)
+	{
+		const LoadJob& job = r->job_;
+
+		LoadRecord record;
+		record.filename_ = job.filename_;
+		record.seconds_ = r->seconds_;
+		record.succeeded_ = r->succeeded_;
+		if (r->succeeded_)
+		{
+			record.bytes_ = r->data_.dataSize_;
+			wavLoader_->AddWAVFile(job.filename_, r->data_, std::move(r->mapping_));
+			RegisterSound(job.key_, job.filename_);
+		}
 
-	// }X^O{CX̍쐬
-	result = xaudioCore_->CreateMasteringVoice(&masterVoice_, XAUDIO2_DEFAULT_CHANNELS,
-		XAUDIO2_DEFAULT_SAMPLERATE, 0, 0, nullptr);
-	assert(SUCCEEDED(result));
+		const SoundId sound = MakeSoundId(job.key_);
+		auto key = loadingKey_.find(sound);
+		if (key != loadingKey_.end() && --key->second == 0)
+		{
+			loadingKey_.erase(key);
 
-	masterVoice_->GetVoiceDetails(&masterVoiceDetails_);
+			auto queued = queuedPlay_.find(sound);
+			if (queued != queuedPlay_.end())
+			{
+				std::vector<AudioCommand> plays = std::move(queued->second);
+				queuedPlay_.erase(queued);
+				for (auto& p : plays)
+				{
+					// PlayInSlot releases the slot when the key failed to load
+					ApplyCommand(p);
+				}
+			}
+		}
 
+		auto it = loadTicket_.find(job.ticket_);
+		if (it == loadTicket_.end()) { continue; }
 
-	SubmixVoice* sm = new SubmixVoice();
-	result = xaudioCore_->CreateSubmixVoice(&sm->submixVoice_, masterVoiceDetails_.InputChannels,
-		masterVoiceDetails_.InputSampleRate, XAUDIO2_VOICE_USEFILTER, RootProcessingStage, nullptr, nullptr);
-	assert(SUCCEEDED(result));
-	int hd = submix_.Add(sm);
-	sm->handle_ = hd;
-	sm->stage_ = RootProcessingStage;
+		LoadTicketState& state = it->second;
+		state.report_.bytes_ += record.bytes_;
+		state.report_.failed_ += record.succeeded_ ? 0 : 1;
+		state.report_.records_.emplace_back(std::move(record));
+		state.last_ = std::max(state.last_, r->finished_);
+
+		if (--state.remaining_ > 0) { continue; }
+
+		LoadTicket ticket = it->first;
+		LoadReport report = std::move(state.report_);
+		report.seconds_ = std::chrono::duration<double>(state.last_ - state.start_).count();
+		LoadCallback callback = std::move(state.callback_);
+		loadTicket_.erase(it);
+
+		if (callback) { callback(ticket, report); }
+	}
 }
 
-bool AudioManager::SourceHandleIsValid(int handle)
+bool AudioManager::QueuePlay(int slot, SoundId sound, float begin, float length,
+	unsigned int loopCount, float volume)
 {
-	if ((handle & IdentifyMask) != SourceIdentifyID) { return false; }
-	handle = handle & SourceHandleMask;
-	if (handle < 0 || handle >= SourceVoiceArrayMaxSize) { return false; }
-	if (!source_[handle]) { return false; }
+	if (loadingKey_.find(sound) == loadingKey_.end()) { return false; }
+
+	AudioCommand command = {};
+	command.type_ = AudioCommandType::Play;
+	command.handle_ = MakeSourceHandle(slot);
+	command.param_[0] = begin;
+	command.param_[1] = length;
+	command.param_[2] = volume;
+	command.loopCount_ = loopCount;
+	command.sound_ = sound;
+	queuedPlay_[sound].emplace_back(std::move(command));
 	return true;
 }
 
-bool AudioManager::SubmixHandleIsValid(int handle)
+bool AudioManager::CancelQueuedPlay(int handle)
 {
-	if ((handle & IdentifyMask) != SubmixIdentifyID) { return false; }
-	handle = (handle & SubmixHandleMask) >> SubmixHandleShift;
-	if (handle < 0 || handle >= SubmixVoiceArrayMaxSize) { return false; }
-	if (!submix_[handle]) { return false; }
+	for (auto& q : queuedPlay_)
+	{
+		auto it = std::find_if(q.second.begin(), q.second.end(),
+			[handle](const AudioCommand& c) { return c.handle_ == handle; });
+		if (it == q.second.end()) { continue; }
 
-	return true;
+		source_.Release(handle & SourceHandleMask);
+		q.second.erase(it);
+		return true;
+	}
+	return false;
 }
 
-int AudioManager::FindEffect(int handle, AudioEffectType type)
+int AudioManager::FindEffect(SubmixVoice* sub, AudioEffectType type)
 {
-	auto& p = submix_[handle]->efkParam_;
+	auto& p = sub->efkParam_;
 	int ret;
 	for (ret = p.size() - 1; ret >= 0; ret--)
 	{
@@ -865,3 +2400,34 @@ int AudioManager::FindEffect(int handle, AudioEffectType type)
 
 	return ret;
 }
+
+SourceVoice::~SourceVoice()
+{
+	// the reader may still hold the stream, it must stop reading wav_ first
+	if (stream_)
+	{
+		const bool decoder = !stream_->ReadsFile();
+		stream_->Close();
+		if (decoder && pool_ != nullptr)
+		{
+			pool_->ReleaseStream(std::move(stream_));
+		}
+	}
+
+	if (sourceVoice_ != nullptr)
+	{
+		if (pool_ != nullptr)
+		{
+			pool_->Release(waveFormat_, sourceVoice_);
+		}
+		else
+		{
+			sourceVoice_->DestroyVoice();
+		}
+	}
+
+	if (wav_ != nullptr)
+	{
+		WAVLoader::Release(*wav_);
+	}
+}
@@ -1,15 +1,25 @@
 #pragma once
-#include <xaudio2.h>
-#include <xaudio2fx.h>
-#include <xapofx.h>
 #include <array>
+#include <atomic>
+#include <functional>
 #include <initializer_list>
 #include <list>
+#include <mutex>
 #include <string>
 #include <memory>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+#include "AudioCommand.h"
 #include "EffectDefines.h"
-#include "../Utility/HandleArray.h"
+#include "LoadDefines.h"
+#include "WAVDefines.h"
+#include "Backend/AudioBackend.h"
+#include "Backend/MixerMeter.h"
+#include "SlotArray.h"
+#include "SoundId.h"
+#include "SourceVoicePool.h"
 
 #define AudioIns AudioManager::GetInstance()
 
@@ -19,6 +29,11 @@ constexpr size_t SubmixVoiceArrayMaxSize = 256;
 constexpr int SourceHandleMask = 0x0000ffff;
 constexpr int SubmixHandleMask = 0x00ff0000;
 
+// generation of the slot, a handle of a released slot no longer resolves
+constexpr int SourceGenerationMask = 0x0fff0000;
+constexpr int SourceGenerationShift = 16;
+constexpr int SubmixGenerationMask = 0x0000ffff;
+
 constexpr int IdentifyMask = 0x70000000;
 constexpr int SourceIdentifyID = 0x10000000;
 constexpr int SubmixIdentifyID = 0x20000000;
@@ -29,6 +44,16 @@ constexpr int RootSubmixHandle = SubmixIdentifyID + 0;
 
 constexpr unsigned int RootProcessingStage = 128;
 
+// highest frequency ratio a source voice accepts, 2 octaves up
+constexpr float MaxFrequencyRatio = 4.0f;
+
+// XAUDIO2_BUFFER::pContext holds (serial << ContextSerialShift) | slot
+constexpr int ContextSerialShift = 16;
+constexpr unsigned int ContextSerialMask = 0xffff;
+
+// called from Update with the source handle
+using VoiceCallback = std::function<void(int)>;
+
 struct SubmixVoice;
 struct SourceVoice;
 
@@ -38,36 +63,206 @@ enum class VoiceState
 	Stop,
 };
 
+struct WAVData;
+struct WAVCacheStats;
+
+struct VoiceBudgetStats
+{
+	// plays holding a backend voice, and plays only tracked because they are over the budget
+	unsigned int real_ = 0;
+	unsigned int virtual_ = 0;
+	// moves between the two since the start
+	uint64_t demoted_ = 0;
+	uint64_t promoted_ = 0;
+	// plays refused and instances stopped by the instance limits of their sound
+	uint64_t rejected_ = 0;
+	uint64_t stolen_ = 0;
+};
+
+// what Play does when the sound already has its maximum of instances playing
+enum class InstanceSteal
+{
+	// stops the instance started first
+	Oldest,
+	// stops the least audible instance, or refuses the play when it would be quieter still
+	Quietest,
+	// refuses the play
+	Reject,
+};
+
+// a real voice keeps its voice against a virtual one up to this much more audible, about 2dB
+constexpr float VirtualSwapMargin = 1.25f;
+
+// what a SoundId resolves to, valid until the sound is unloaded
+struct SoundAsset
+{
+	// may be evicted by the cache budget, PlayInSlot reads it again
+	WAVData* data_;
+	// name of the data in WAVLoader, streams reopen it
+	std::string filename_;
+	// priority new plays of the sound start with
+	int priority_ = 0;
+	// playing instances allowed at once, 0 means no limit
+	unsigned int maxInstances_ = 0;
+	InstanceSteal steal_ = InstanceSteal::Oldest;
+	// output frames a new play has to wait after the last one, on the backend clock
+	uint64_t retriggerFrames_ = 0;
+	uint64_t lastPlayFrame_ = 0;
+	bool played_ = false;
+#ifndef NDEBUG
+	// key the id was made from, a second key on the same id is reported
+	std::string key_;
+#endif
+};
+
 class WAVLoader;
+class WAVWriter;
+class AudioStream;
+class StreamReader;
+class LoadScheduler;
+struct LoadResult;
+class SoundBank;
 class AudioManager
 {
 public:
-	static void Create();
+	static void Create(const AudioBackendDesc& desc = AudioBackendDesc());
 	static AudioManager& GetInstance(void);
 	static void Terminate(void);
 
-	void LoadSound(const std::string& filename, const std::string& key);
+	AudioBackend& GetBackend(void);
+
+	void LoadSound(const std::string& filename, const std::string& key, WAVLoadMode mode = WAVLoadMode::Copy);
+
+	// parses on worker threads, the key becomes playable in the Update that sees it done
+	// Play on a key still loading returns a handle at once and starts the sound when the file is ready,
+	// other calls on that handle are ignored until then
+	LoadTicket LoadSoundAsync(const std::string& filename, const std::string& key,
+		WAVLoadMode mode = WAVLoadMode::Copy, LoadCallback callback = nullptr);
+	LoadTicket LoadBatchAsync(const std::vector<LoadRequest>& requests, LoadCallback callback = nullptr);
+	// unknown tickets count as complete
+	bool IsLoadComplete(LoadTicket ticket) const;
+
+	// maps a bank built by SoundBankWriter and registers every key in it, the sounds play out of the mapping
+	// on a bank already loaded it registers again the keys Unload removed
+	bool LoadBank(const std::string& filename);
+	// sounds of the bank must not be playing
+	void UnloadBank(const std::string& filename);
+	// WAVLoadMode::Copy loads from now on are stored as 32 bit float at the output rate
+	// so voices play them without converting or resampling, sounds already loaded are kept
+	void SetLoadConversion(bool enable);
+	// workers used by the async loads, 0 picks one per spare core, false while a ticket is in flight
+	bool SetLoadThreadCount(unsigned int count);
 
 	int CreateSubmix(std::initializer_list<int> outputHandles = { RootSubmixHandle });
 
 	int Play(const std::string& key, float volume = 1.0f);
 	int PlayLoop(const std::string& key, float begin, float length, unsigned int loopCount, float volume = 1.0f);
+	// one integer lookup, no string work
+	int Play(SoundId sound, float volume = 1.0f);
+	int PlayLoop(SoundId sound, float begin, float length, unsigned int loopCount, float volume = 1.0f);
 	void PlayAgain(int handle);
 	void PlayAgain(int handle, float begin, float length);
 
 	float GetProgress(int sourceHandle);
+
+	// preallocates idle source voices for one wave format, call at startup
+	void WarmVoicePool(unsigned short channel, unsigned int samplesPerSec,
+		unsigned short bitPerSample, unsigned int count);
+	void SetVoicePoolMaxIdle(unsigned int count);
+	const VoicePoolStats& GetVoicePoolStats(void) const;
 	
 	void SetVolume(int handle, float volume);
+	// playback rate of a sound relative to its recording, pitch follows
+	void SetFrequencyRatio(int sourceHandle, float ratio);
+	// semitones from the recorded pitch, negative goes down
+	void SetPitch(int sourceHandle, float semitones);
+	// interpolation used by one sound on the software mixer, XAudio2 ignores it
+	void SetResampleQuality(int sourceHandle, ResampleQuality quality);
+
+	// plays holding a backend voice at once, 0 means no limit
+	// past it stopped, then lowest priority, then least audible plays become virtual: they keep their position
+	// and callbacks but are not mixed, and get a voice back in Update once they rank high enough
+	void SetRealVoiceBudget(unsigned int count);
+	// higher priority keeps its voice first, plays take the priority of their sound
+	void SetPriority(int sourceHandle, int priority);
+	void SetSoundPriority(const std::string& key, int priority);
+	void SetSoundPriority(SoundId sound, int priority);
+	bool IsVirtual(int sourceHandle);
+	// checked by every Play before a voice is made, a refused play returns -1
+	// a stolen instance is stopped at once and finishes on the next Update, its callback runs there
+	void SetInstanceLimit(const std::string& key, unsigned int maxInstances, InstanceSteal steal = InstanceSteal::Oldest);
+	void SetInstanceLimit(SoundId sound, unsigned int maxInstances, InstanceSteal steal = InstanceSteal::Oldest);
+	// plays of the sound closer than seconds to the previous one are refused, 0 turns it off
+	void SetRetriggerInterval(const std::string& key, float seconds);
+	void SetRetriggerInterval(SoundId sound, float seconds);
+	VoiceBudgetStats GetVoiceBudgetStats(void);
 	void Continue(int handle);
 	void Stop(int handle);
 	void Unload(const std::string& key);
+	void Unload(SoundId sound);
+
+	// bytes of loaded (WAVLoadMode::Copy) sounds kept in memory, 0 means no limit
+	// least recently played sounds that are not playing are evicted and read again on the next Play
+	void SetCacheBudget(size_t bytes);
+	// pinned sounds are never evicted, pins nest
+	bool PinSound(const std::string& key);
+	bool PinSound(SoundId sound);
+	void UnpinSound(const std::string& key);
+	void UnpinSound(SoundId sound);
+	const WAVCacheStats& GetCacheStats(void) const;
+
 	void ContinueAll(void);
 	void StopAll(bool destroy);
 	void DeleteHandle(int handle);
 
+	// volume, filter, effect, start / stop and routing changes made until the outermost
+	// CommitBatch reach the engine on the same audio frame
+	void BeginBatch(void);
+	void CommitBatch(void);
+
+	// the callbacks run inside Update
+	void SetFinishedCallback(int sourceHandle, VoiceCallback callback);
+	void SetLoopCallback(int sourceHandle, VoiceCallback callback);
+	// deletes the handle as soon as the voice finishes
+	void SetAutoRelease(int sourceHandle, bool autoRelease);
+
 	void Update(void);
 
+	// thread safe versions of the calls above, applied by the next Update
+	// commands of one thread keep their order, Post*Play returns the handle at once
+	int PostPlay(const std::string& key, float volume = 1.0f);
+	int PostPlayLoop(const std::string& key, float begin, float length, unsigned int loopCount, float volume = 1.0f);
+	int PostPlay(SoundId sound, float volume = 1.0f);
+	int PostPlayLoop(SoundId sound, float begin, float length, unsigned int loopCount, float volume = 1.0f);
+	void PostPlayAgain(int handle);
+	void PostStop(int handle);
+	void PostContinue(int handle);
+	void PostSetVolume(int handle, float volume);
+	void PostSetFrequencyRatio(int sourceHandle, float ratio);
+	void PostSetPitch(int sourceHandle, float semitones);
+	void PostSetFilter(int handle, XAUDIO2_FILTER_TYPE type, float frequency, float danping);
+	void PostAddSourceOutputTarget(int sourceHandle, int targetHandle);
+	void PostAddSubmixOutputTarget(int submixHandle, int targetHandle);
+	void PostRemoveSourceOutputTarget(int sourceHandle, int targetHandle);
+	void PostRemoveSubmixOutputTarget(int submixHandle, int targetHandle);
+	void PostDeleteHandle(int handle);
+	void PostBeginBatch(void);
+	void PostCommitBatch(void);
+
+	// records the output of a submix (after its volume) to a WAV file, software mixer only
+	// with the offline device nothing plays until RenderFrames is called
+	bool BeginRenderToFile(const std::string& filename, int submixHandle = RootSubmixHandle,
+		WAVSampleFormat format = WAVSampleFormat::PCM16);
+	// offline device only, renders as fast as possible then runs Update
+	bool RenderFrames(unsigned int frames);
+	bool EndRenderToFile(void);
+
+	// runs Update on its own thread, direct calls must then be made from callbacks only
+	void StartControlThread(unsigned int intervalMs);
+	void StopControlThread(void);
+
 	void AddSourceOutputTarget(int sourceHandle, int targetHandle);
+	// ignored unless the target was created at a higher stage, e.g. an output of the submix at creation
 	void AddSubmixOutputTarget(int sourceHandle, int targetHandle);
 
 	void RemoveSourceOutputTarget(int sourceHandle, int targetHandle);
@@ -75,7 +270,16 @@ public:
 
 	void SetFilter(int handle, XAUDIO2_FILTER_TYPE type, float frequency, float danping);
 
+	// chain edits leave the other effects running with their state (reverb tails included) on the software mixer,
+	// XAudio2 takes the whole chain again on insert / remove / move
+	// the edits land on one quantum boundary, with the rest of the batch when inside one
+	// returns the index of the effect, a negative insertPosition appends
 	int AddEffect(int handle, AudioEffectType type, bool active, int insertPosition = -1);
+	void RemoveEffect(int submixHandle, int effectIndex);
+	// the effect at from ends up at to, the ones between shift by one
+	void MoveEffect(int submixHandle, int from, int to);
+	// a disabled effect passes its input through and keeps its state
+	void EnableEffect(int submixHandle, int effectIndex, bool enable);
 
 	void SetReverbParameter(const XAUDIO2FX_REVERB_I3DL2_PARAMETERS& param, int submixHandle, int effectIndex = -1);
 	void SetReverbParameter(const XAUDIO2FX_REVERB_PARAMETERS& param, int submixHandle, int effectIndex = -1);
@@ -83,77 +287,249 @@ public:
 	void SetEqualizerParameter(const FXEQ_PARAMETERS& param, int submixHandle, int effectIndex = -1);
 	void SetMasteringLimiterParameter(int release, float loudness, int submixHandle, int effectIndex = -1);
 	void SetFXReverbParameter(float diffuse, float roomsize, int submixHandle, int effectIndex = -1);
+	void SetConvolutionParameter(float wetDryMix, float gain, int submixHandle, int effectIndex = -1);
+
+	// software mixer only, the impulse response of a Convolution effect from a PCM or float WAV file of any rate
+	// the file is read and transformed on the calling thread, the effect takes it over on the next quantum
+	// background runs the later partitions on a thread of the effect instead of the mixer threads
+	bool LoadConvolutionImpulse(const std::string& filename, int submixHandle, int effectIndex = -1,
+		bool background = false);
 
+	// control thread only, the levels stay valid until the next call, EnableSubmixMeter serves other threads
 	XAUDIO2FX_VOLUMEMETER_LEVELS* GetVolumeMeterParameter(int submixHandle, int effectIndex = -1);
+
+	// software mixer only, levels of a submix after its effects and before its volume, published every quantum
+	// the meter is read from any thread without locks or engine calls and stays readable after the submix is gone
+	// windowMs is the span of peak and RMS, loudness adds the short-term loudness at the cost of a filter pass
+	// enabling again replaces the meter, the old one stops moving
+	std::shared_ptr<const MixerMeter> EnableSubmixMeter(int submixHandle, unsigned int windowMs = 300,
+		bool loudness = false);
+	void DisableSubmixMeter(int submixHandle);
 private:
-	AudioManager();
+	AudioManager(const AudioBackendDesc& desc);
 	AudioManager(const AudioManager&) = delete;
 	AudioManager operator=(const AudioManager&) = delete;
 	~AudioManager();
 
 	static AudioManager* instance_;
 
-	void Initialize(void);
+	void Initialize(const AudioBackendDesc& desc);
+
+	// nullptr when the handle is malformed or stale
+	SourceVoice* ResolveSource(int handle);
+	SubmixVoice* ResolveSubmix(int handle);
+
+	int MakeSourceHandle(int slot) const;
+	int MakeSubmixHandle(int slot) const;
+
+	// fills a reserved slot, releases it on failure
+	int PlayInSlot(int slot, SoundId sound, float begin, float length,
+		unsigned int loopCount, float volume);
+
+	// false when the instance limit or the retrigger interval of the sound refuses a play of volume
+	// fills steal with the instances the play replaces, unknown sounds pass
+	bool AdmitPlay(SoundId sound, float volume, std::vector<int>& steal);
+	// a play that started counts against the retrigger interval and stops the instances it stole
+	void RecordPlay(SoundId sound, const std::vector<int>& steal);
+	// finishes the stolen instances outside of any play or command
+	void FinishStolenVoices(void);
+
+	// keeps the first registration of an id, like the string table did
+	bool RegisterSound(const std::string& key, const std::string& filename);
+	bool RegisterSound(SoundId sound, const char* key, const std::string& filename);
+	// before the data goes away, voices playing it would read freed memory
+	void DeleteSourcesOf(const std::string& filename);
+	// adds and registers every entry of the bank not loaded yet, named "<bank>:<key>"
+	void RegisterBankEntries(const std::string& filename, const SoundBank& bank);
+	// true for the "<bank>:<key>" name of an entry of a loaded bank
+	bool IsBankEntry(const std::string& filename) const;
+
+	CommandRing& GetCommandRing(void);
+	bool PostCommand(AudioCommand&& command);
+	void ApplyCommands(void);
+	void ApplyCommand(AudioCommand& command);
+
+	// moves finished files into the loader, starts the plays waiting for them and reports tickets
+	void ApplyLoads(void);
+	// a Play on a key that is still loading, false when the key is not loading
+	bool QueuePlay(int slot, SoundId sound, float begin, float length,
+		unsigned int loopCount, float volume);
+	bool CancelQueuedPlay(int handle);
+
+	// drops the default route to the root submix, without the fallback of Remove*OutputTarget
+	void DetachFromRoot(SourceVoice* src);
+	void DetachFromRoot(SubmixVoice* sub);
+
+	int FindEffect(SubmixVoice* sub, AudioEffectType type);
+	UINT64 GetSamplesPlayed(SourceVoice* src);
+
+	// stamps a new serial into pContext so events of older submits are ignored
+	// consumed skips that many source frames of the play, loops included, a virtual voice only moves its cursor
+	bool SubmitSourceBuffer(SourceVoice* src, uint64_t consumed = 0);
+	// hands every block the reader has filled to the voice
+	bool SubmitStreamBlocks(SourceVoice* src);
+	// the same for every streamed voice that is not virtual
+	void SubmitReadyStreamBlocks(void);
+	// a streamed block finished playing, runs loop callbacks and finishes on the last one
+	void ConsumeStreamBlock(int index);
+	void FinishVoice(int index);
+	// fallback when events were lost
+	void PollFinishedVoices(void);
+
+	// frame of the buffer and wraps done after consumed source frames, false once the play is over
+	static bool LocatePlay(const SourceVoice* src, uint64_t consumed, unsigned int& frame, unsigned int& loops);
+	// source frames played since the last submit, loops included
+	uint64_t GetConsumed(SourceVoice* src);
+	// volume reaching the output, 0 when stopped
+	float GetAudibility(const SourceVoice* src) const;
+	float GetAudibility(const SubmixVoice* sub) const;
+	// true when a should hold a voice before b: playing, then priority, then audibility
+	bool Outranks(const SourceVoice* a, const SourceVoice* b) const;
+	// gives the backend voice back to the pool and tracks the position
+	void Virtualize(SourceVoice* src);
+	// false when no voice could be had
+	bool Devirtualize(SourceVoice* src);
+	// moves virtual cursors by the frames rendered since the last Update, then enforces the budget
+	void UpdateVirtualVoices(void);
+	void AdvanceVirtualVoice(int index, uint64_t frames);
 
-	bool SourceHandleIsValid(int handle);
-	bool SubmixHandleIsValid(int handle);
+	std::unique_ptr<WAVLoader> wavLoader_;
 
-	int FindEffect(int handle, AudioEffectType type);
+	std::unique_ptr<AudioBackend> backend_;
+	std::unique_ptr<SourceVoicePool> voicePool_;
+	std::unique_ptr<StreamReader> streamReader_;
 
-	std::unique_ptr<WAVLoader> wavLoader_;
+	unsigned int voiceBudget_ = 0;
+	// counts plays, tells which instance is the oldest
+	uint64_t playCount_ = 0;
+	uint64_t lastRenderedFrames_ = 0;
+	VoiceBudgetStats budgetStats_;
+	// handles stopped by instance limits, finished by the next Update
+	std::vector<int> stolenVoice_;
+
+	VoiceEventQueue events_;
+	unsigned int playSerial_ = 0;
+
+	// XAUDIO2_COMMIT_NOW outside of a batch
+	unsigned int operationSet_ = XAUDIO2_COMMIT_NOW;
+	unsigned int lastOperationSet_ = XAUDIO2_COMMIT_NOW;
+	unsigned int batchDepth_ = 0;
+
+	// tells the rings of an old instance apart from ours
+	static std::atomic<unsigned int> instanceCount_;
+	unsigned int instanceId_;
 
-	IXAudio2* xaudioCore_;
-	IXAudio2MasteringVoice* masterVoice_;
-	XAUDIO2_VOICE_DETAILS masterVoiceDetails_ = {};
+	// held only to add, list and remove rings, never while commands run
+	std::mutex ringMutex_;
+	std::vector<std::shared_ptr<ProducerRing>> rings_;
 
-	std::unordered_map<std::string, std::string> filenameTable_;
+	std::unique_ptr<WAVWriter> recorder_;
 
-	HandleArray<SourceVoice, SourceVoiceArrayMaxSize> source_;
+	std::unique_ptr<LoadScheduler> loadScheduler_;
+	unsigned int loadThreadCount_ = 0;
+	LoadTicket lastTicket_ = 0;
+	std::unordered_map<LoadTicket, LoadTicketState> loadTicket_;
+	// results that never reached a worker, reported by the next Update
+	std::vector<std::unique_ptr<LoadResult>> loadResult_;
+	// jobs in flight per key, and the plays waiting for the key
+	std::unordered_map<SoundId, unsigned int> loadingKey_;
+	std::unordered_map<SoundId, std::vector<AudioCommand>> queuedPlay_;
 
-	HandleArray<SubmixVoice, SubmixVoiceArrayMaxSize> submix_;
+	std::thread controlThread_;
+	std::atomic<bool> controlRunning_ = false;
+
+	std::unordered_map<SoundId, SoundAsset> soundTable_;
+	std::unordered_map<std::string, std::unique_ptr<SoundBank>> bank_;
+
+	SlotArray<SourceVoice, SourceVoiceArrayMaxSize> source_;
+
+	SlotArray<SubmixVoice, SubmixVoiceArrayMaxSize> submix_;
 };
 
 struct SourceVoice
 {
 	SourceVoice() = default;
-	~SourceVoice()
-	{
-		if (sourceVoice_ != nullptr)
-		{
-			sourceVoice_->DestroyVoice();
-		}
-	}
+	~SourceVoice();
 
-	WAVEFORMATEX waveFormat_;
-	XAUDIO2_BUFFER buffer_;
-	IXAudio2SourceVoice* sourceVoice_ = nullptr;
+	WAVEFORMATEX waveFormat_ = {};
+	XAUDIO2_BUFFER buffer_ = {};
+	AudioSourceVoice* sourceVoice_ = nullptr;
+	SourceVoicePool* pool_ = nullptr;
 	VoiceState vState_;
 
+	// SamplesPlayed when the buffer was submitted, a pooled voice keeps counting
+	UINT64 samplesBase_ = 0;
+
+	// last values set through AudioManager, applied again when a virtual voice gets a voice
+	float volume_ = 1.0f;
+	float frequencyRatio_ = 1.0f;
+	ResampleQuality quality_ = ResampleQuality::Default;
+	XAUDIO2_FILTER_PARAMETERS filter_ = { LowPassFilter, XAUDIO2_MAX_FILTER_FREQUENCY, XAUDIO2_DEFAULT_FILTER_ONEOVERQ };
+
+	int priority_ = 0;
+	// sound the voice plays and playCount_ when it started, for the instance limits
+	SoundId sound_ = {};
+	uint64_t playOrder_ = 0;
+	// no backend voice while virtual, virtualConsumed_ follows where it would be playing
+	bool virtual_ = false;
+	double virtualConsumed_ = 0.0;
+	// source frames skipped by the current submit, a voice made real again resumes midway
+	uint64_t consumedBase_ = 0;
+
+	// set for WAVLoadMode::Stream, buffer_ then only carries the play region
+	std::shared_ptr<AudioStream> stream_;
+	// held in the WAVLoader cache while the voice lives
+	WAVData* wav_ = nullptr;
+
+	// full handle including the generation
 	int handle_;
 
-	std::vector<XAUDIO2_SEND_DESCRIPTOR> send_;
+	unsigned int serial_ = 0;
+	VoiceCallback onFinished_;
+	VoiceCallback onLoop_;
+	bool autoRelease_ = false;
+
+	std::vector<AudioVoice*> send_;
 	std::vector<SubmixVoice*> output_;
 };
 
+// one entry of a submix effect chain, owns its effect reference and levels so it can only be moved
 struct EffectParams
 {
+	EffectParams() = default;
+	EffectParams(const EffectParams&) = delete;
+	EffectParams& operator=(const EffectParams&) = delete;
+	EffectParams(EffectParams&& other) noexcept { Swap(other); }
+	EffectParams& operator=(EffectParams&& other) noexcept { Swap(other); return *this; }
+
 	~EffectParams()
 	{
-		if (type_ == AudioEffectType::VolumeMeter)
+		if (type_ == AudioEffectType::VolumeMeter && param_ != nullptr)
 		{
 			XAUDIO2FX_VOLUMEMETER_LEVELS* level = reinterpret_cast<XAUDIO2FX_VOLUMEMETER_LEVELS*>(param_);
 			delete[] level->pPeakLevels;
 			delete[] level->pRMSLevels;
-			delete param_;
+			delete level;
+		}
 
+		// the voice holds a reference of its own while the effect is in its chain
+		if (pEffect_ != nullptr)
+		{
 			pEffect_->Release();
 		}
 	}
 
-	AudioEffectType type_;
+	void Swap(EffectParams& other)
+	{
+		std::swap(type_, other.type_);
+		std::swap(pEffect_, other.pEffect_);
+		std::swap(param_, other.param_);
+	}
+
+	AudioEffectType type_ = AudioEffectType::Reverb;
 	
-	IUnknown* pEffect_;
-	void* param_;
+	IUnknown* pEffect_ = nullptr;
+	void* param_ = nullptr;
 };
 
 struct SubmixVoice
@@ -167,9 +543,10 @@ struct SubmixVoice
 		}
 	}
 
-	IXAudio2SubmixVoice* submixVoice_ = nullptr;
+	AudioVoice* submixVoice_ = nullptr;
+	float volume_ = 1.0f;
 
-	std::vector<XAUDIO2_SEND_DESCRIPTOR> send_;
+	std::vector<AudioVoice*> send_;
 
 	std::vector<SubmixVoice*> input_;
 	std::vector<SubmixVoice*> output_;
@@ -179,6 +556,40 @@ struct SubmixVoice
 	std::vector<XAUDIO2_EFFECT_DESCRIPTOR> efkDesc_;
 	std::vector<EffectParams> efkParam_;
 
+	// full handle including the generation
 	int handle_;
 	unsigned int stage_;
 };
+
+inline SourceVoice* AudioManager::ResolveSource(int handle)
+{
+	if ((handle & IdentifyMask) != SourceIdentifyID) { return nullptr; }
+
+	int slot = handle & SourceHandleMask;
+	if (static_cast<size_t>(slot) >= SourceVoiceArrayMaxSize) { return nullptr; }
+	if (static_cast<int>(source_.GetGeneration(slot) << SourceGenerationShift & SourceGenerationMask)
+		!= (handle & SourceGenerationMask)) { return nullptr; }
+
+	return source_[slot].get();
+}
+
+inline SubmixVoice* AudioManager::ResolveSubmix(int handle)
+{
+	if ((handle & IdentifyMask) != SubmixIdentifyID) { return nullptr; }
+
+	int slot = (handle & SubmixHandleMask) >> SubmixHandleShift;
+	if (static_cast<int>(submix_.GetGeneration(slot) & SubmixGenerationMask)
+		!= (handle & SubmixGenerationMask)) { return nullptr; }
+
+	return submix_[slot].get();
+}
+
+inline int AudioManager::MakeSourceHandle(int slot) const
+{
+	return SourceIdentifyID + static_cast<int>(source_.GetGeneration(slot) << SourceGenerationShift & SourceGenerationMask) + slot;
+}
+
+inline int AudioManager::MakeSubmixHandle(int slot) const
+{
+	return SubmixIdentifyID + (slot << SubmixHandleShift) + static_cast<int>(submix_.GetGeneration(slot) & SubmixGenerationMask);
+}
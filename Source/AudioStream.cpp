@@ -0,0 +1,318 @@
+#include "AudioStream.h"
+#include <algorithm>
+#include <cstring>
+#include "Backend/AudioPlatform.h"
+
+AudioStream::~AudioStream()
+{
+	if (file_ != nullptr)
+	{
+		fclose(file_);
+	}
+}
+
+bool AudioStream::Open(const std::string& filename, unsigned int dataOffset, unsigned int dataSize, unsigned int blockAlign)
+{
+	if (blockAlign == 0) { return false; }
+
+	if (fopen_s(&file_, filename.c_str(), "rb") != 0)
+	{
+		file_ = nullptr;
+		return false;
+	}
+
+	dataOffset_ = dataOffset;
+	dataSize_ = dataSize / blockAlign * blockAlign;
+	blockAlign_ = blockAlign;
+	AllocateBlocks(StreamBlockBytes);
+	return true;
+}
+
+bool AudioStream::OpenADPCM(const unsigned char* data, unsigned int dataSize, const ADPCMDesc& desc, unsigned int frameCount)
+{
+	if (data == nullptr || desc.channel_ == 0 || desc.samplesPerBlock_ == 0) { return false; }
+
+	adpcm_ = data;
+	adpcmSize_ = dataSize;
+	adpcmDesc_ = desc;
+	decoded_.resize(static_cast<size_t>(desc.samplesPerBlock_) * desc.channel_);
+	decodedIndex_ = UINT32_MAX;
+
+	blockAlign_ = desc.channel_ * sizeof(int16_t);
+	dataSize_ = std::min(frameCount, GetADPCMFrameCount(desc, dataSize)) * blockAlign_;
+	AllocateBlocks(DecodeBlockBytes);
+	return true;
+}
+
+void AudioStream::Close(void)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (file_ != nullptr)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	adpcm_ = nullptr;
+	done_.store(true, std::memory_order_release);
+}
+
+void AudioStream::AllocateBlocks(unsigned int bytes)
+{
+	blockLimit_ = std::max(bytes / blockAlign_ * blockAlign_, blockAlign_);
+
+	// the buffers grow in Fill, a reopened stream keeps the ones it has
+	block_.resize(StreamBlockCount);
+}
+
+bool AudioStream::Restart(unsigned int begin, unsigned int length, unsigned int loopCount, unsigned int start)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	unsigned int first = begin * blockAlign_;
+	if ((file_ == nullptr && adpcm_ == nullptr) || first >= dataSize_) { return false; }
+
+	begin_ = first;
+	end_ = length == 0 ? dataSize_ : std::min(first + length * blockAlign_, dataSize_);
+	if (start >= (end_ - begin_) / blockAlign_) { return false; }
+	cursor_ = begin_ + start * blockAlign_;
+	loopsLeft_ = loopCount;
+
+	// a short region never needs more than its own length per block
+	blockBytes_ = std::min(blockLimit_, end_ - begin_);
+
+	filled_.store(0, std::memory_order_relaxed);
+	consumed_.store(0, std::memory_order_relaxed);
+	submitted_ = 0;
+	done_.store(false, std::memory_order_release);
+	return true;
+}
+
+bool AudioStream::Fill(void)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!NeedsFill()) { return false; }
+
+	const unsigned int filled = filled_.load(std::memory_order_relaxed);
+	StreamBlock& block = block_[filled % StreamBlockCount];
+	// sized on first use, a one shot region that fits in one block never touches the others
+	if (block.data_.size() < blockBytes_)
+	{
+		block.data_.resize(blockBytes_);
+	}
+	block.bytes_ = 0;
+	block.loops_ = 0;
+	block.last_ = false;
+
+	bool failed = false;
+	while (block.bytes_ < blockBytes_)
+	{
+		if (cursor_ == end_)
+		{
+			if (!Wrap()) { break; }
+			block.loops_++;
+		}
+
+		unsigned int size = std::min(blockBytes_ - block.bytes_, end_ - cursor_);
+		unsigned int read = Read(&block.data_[block.bytes_], cursor_, size) / blockAlign_ * blockAlign_;
+
+		cursor_ += read;
+		block.bytes_ += read;
+		if (read < size)
+		{
+			failed = true;
+			break;
+		}
+	}
+
+	if (failed || (cursor_ == end_ && loopsLeft_ == 0))
+	{
+		// a voice cannot take an empty buffer, a broken file ends on one silent frame
+		if (block.bytes_ == 0)
+		{
+			std::fill(block.data_.begin(), block.data_.begin() + blockAlign_, static_cast<unsigned char>(0));
+			block.bytes_ = blockAlign_;
+		}
+		block.last_ = true;
+		done_.store(true, std::memory_order_relaxed);
+	}
+
+	filled_.store(filled + 1, std::memory_order_release);
+	return true;
+}
+
+unsigned int AudioStream::Read(unsigned char* out, unsigned int position, unsigned int size)
+{
+	if (adpcm_ != nullptr)
+	{
+		return ReadADPCM(out, position, size);
+	}
+	if (file_ == nullptr) { return 0; }
+
+	if (fseek(file_, static_cast<long>(dataOffset_) + static_cast<long>(position), SEEK_SET) != 0) { return 0; }
+	return static_cast<unsigned int>(fread_s(out, size, sizeof(unsigned char), size, file_));
+}
+
+unsigned int AudioStream::ReadADPCM(unsigned char* out, unsigned int position, unsigned int size)
+{
+	const unsigned int spb = adpcmDesc_.samplesPerBlock_;
+	unsigned int frame = position / blockAlign_;
+	unsigned int frames = size / blockAlign_;
+	unsigned int copied = 0;
+	while (frames > 0)
+	{
+		const unsigned int index = frame / spb;
+		if (index != decodedIndex_)
+		{
+			const size_t offset = static_cast<size_t>(index) * adpcmDesc_.blockAlign_;
+			if (offset >= adpcmSize_) { break; }
+
+			const unsigned int bytes = static_cast<unsigned int>(std::min<size_t>(adpcmDesc_.blockAlign_, adpcmSize_ - offset));
+			decodedFrames_ = DecodeADPCMBlock(adpcmDesc_, adpcm_ + offset, bytes, decoded_.data());
+			decodedIndex_ = index;
+		}
+
+		const unsigned int inBlock = frame - index * spb;
+		if (inBlock >= decodedFrames_) { break; }
+
+		const unsigned int count = std::min(frames, decodedFrames_ - inBlock);
+		std::memcpy(out + copied, &decoded_[static_cast<size_t>(inBlock) * adpcmDesc_.channel_], count * blockAlign_);
+		copied += count * blockAlign_;
+		frame += count;
+		frames -= count;
+	}
+	return copied;
+}
+
+bool AudioStream::NeedsFill(void) const
+{
+	if (done_.load(std::memory_order_acquire)) { return false; }
+	return filled_.load(std::memory_order_relaxed) - consumed_.load(std::memory_order_acquire) < StreamBlockCount;
+}
+
+bool AudioStream::Wrap(void)
+{
+	if (loopsLeft_ == 0) { return false; }
+
+	if (loopsLeft_ != XAUDIO2_LOOP_INFINITE)
+	{
+		loopsLeft_--;
+	}
+	cursor_ = begin_;
+	return true;
+}
+
+const StreamBlock* AudioStream::NextReady(void)
+{
+	if (submitted_ == filled_.load(std::memory_order_acquire)) { return nullptr; }
+
+	return &block_[submitted_++ % StreamBlockCount];
+}
+
+bool AudioStream::Consume(unsigned int& loops)
+{
+	const unsigned int consumed = consumed_.load(std::memory_order_relaxed);
+	if (consumed == submitted_)
+	{
+		loops = 0;
+		return false;
+	}
+
+	const StreamBlock& block = block_[consumed % StreamBlockCount];
+	loops = block.loops_;
+	bool last = block.last_;
+
+	// the reader may overwrite the block from here on
+	consumed_.store(consumed + 1, std::memory_order_release);
+	return last;
+}
+
+StreamReader::~StreamReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_ = false;
+	}
+	wake_.notify_all();
+
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+}
+
+void StreamReader::Add(const std::shared_ptr<AudioStream>& stream)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stream_.emplace_back(stream);
+
+		// started on the first stream, games without music never pay for the thread
+		if (!thread_.joinable())
+		{
+			running_ = true;
+			thread_ = std::thread([this]() { Run(); });
+		}
+	}
+	wake_.notify_one();
+}
+
+void StreamReader::Wake(void)
+{
+	// taking the lock keeps the wake from slipping between the check and the wait
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+	}
+	wake_.notify_one();
+}
+
+void StreamReader::WaitIdle(void)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [this]() { return !busy_ && !AnyPending(); });
+}
+
+void StreamReader::Run(void)
+{
+	std::vector<std::shared_ptr<AudioStream>> streams;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			busy_ = false;
+			streams.clear();
+			idle_.notify_all();
+
+			wake_.wait(lock, [this]() { return !running_ || AnyPending(); });
+			if (!running_) { return; }
+
+			busy_ = true;
+			for (auto& s : stream_)
+			{
+				if (auto stream = s.lock()) { streams.emplace_back(std::move(stream)); }
+			}
+		}
+
+		// disk reads happen outside the lock so Add / Wake never wait on them
+		for (auto& s : streams)
+		{
+			while (s->Fill()) {}
+		}
+	}
+}
+
+bool StreamReader::AnyPending(void)
+{
+	bool pending = false;
+	for (auto it = stream_.begin(); it != stream_.end();)
+	{
+		auto stream = it->lock();
+		if (!stream)
+		{
+			it = stream_.erase(it);
+			continue;
+		}
+		pending = pending || stream->NeedsFill();
+		++it;
+	}
+	return pending;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ADPCM.h"
+
+// size of one disk read, rounded down to whole frames
+constexpr unsigned int StreamBlockBytes = 64 * 1024;
+// blocks per stream, one is being played while the others are read ahead
+constexpr unsigned int StreamBlockCount = 4;
+// decoding is cheap next to a disk read, smaller blocks keep the ring of a short sound small
+constexpr unsigned int DecodeBlockBytes = 16 * 1024;
+
+struct StreamBlock
+{
+	std::vector<unsigned char> data_;
+	unsigned int bytes_ = 0;
+	// times the play region wrapped around inside this block
+	unsigned int loops_ = 0;
+	// the region ends with this block
+	bool last_ = false;
+};
+
+// reads the data chunk of one wave file, or decodes ADPCM held in memory, into a ring of 16 bit PCM blocks
+// Fill runs on the reader thread, NextReady / Consume / Restart / Close on the control thread
+// the control thread may Fill the first block of a decoder, which never touches the disk
+class AudioStream
+{
+public:
+	AudioStream() = default;
+	~AudioStream();
+	AudioStream(const AudioStream&) = delete;
+	AudioStream& operator=(const AudioStream&) = delete;
+
+	bool Open(const std::string& filename, unsigned int dataOffset, unsigned int dataSize, unsigned int blockAlign);
+	// data must outlive the stream or Close, frameCount trims the padding of the last block
+	bool OpenADPCM(const unsigned char* data, unsigned int dataSize, const ADPCMDesc& desc, unsigned int frameCount);
+	// waits for a Fill in progress, the reader never touches the source afterwards
+	// a closed stream can be opened again and reuses its blocks
+	void Close(void);
+	// false for an ADPCM decoder, its Fill never touches the disk
+	bool ReadsFile(void) const { return file_ != nullptr; }
+
+	// rewinds to begin, the region is in frames and length 0 plays to the end of the data
+	// start frames into the region, later loops still go back to begin
+	bool Restart(unsigned int begin, unsigned int length, unsigned int loopCount, unsigned int start = 0);
+
+	// reads one block, false when the ring is full or the region is over
+	bool Fill(void);
+	bool NeedsFill(void) const;
+
+	// next filled block not handed to the voice yet, nullptr when none
+	const StreamBlock* NextReady(void);
+	// gives the oldest submitted block back to the reader, true when it was the last one
+	bool Consume(unsigned int& loops);
+
+	// blocks handed to the voice and not consumed yet
+	unsigned int GetQueuedCount(void) const { return submitted_ - consumed_.load(std::memory_order_relaxed); }
+private:
+	// mutex_ must be held, false when no loop is left
+	bool Wrap(void);
+	void AllocateBlocks(unsigned int bytes);
+	// mutex_ must be held, copies size bytes of PCM from position, returns the bytes copied
+	unsigned int Read(unsigned char* out, unsigned int position, unsigned int size);
+	unsigned int ReadADPCM(unsigned char* out, unsigned int position, unsigned int size);
+
+	std::mutex mutex_;
+	FILE* file_ = nullptr;
+
+	const unsigned char* adpcm_ = nullptr;
+	unsigned int adpcmSize_ = 0;
+	ADPCMDesc adpcmDesc_ = {};
+	// the last decoded ADPCM block, sequential reads decode each block once
+	std::vector<int16_t> decoded_;
+	unsigned int decodedIndex_ = UINT32_MAX;
+	unsigned int decodedFrames_ = 0;
+
+	unsigned int dataOffset_ = 0;
+	unsigned int dataSize_ = 0;
+	unsigned int blockAlign_ = 0;
+	// block size of the stream and of the current region, the smaller when the region is short
+	unsigned int blockLimit_ = 0;
+	unsigned int blockBytes_ = 0;
+
+	// byte positions inside the data chunk
+	unsigned int begin_ = 0;
+	unsigned int end_ = 0;
+	unsigned int cursor_ = 0;
+	unsigned int loopsLeft_ = 0;
+
+	std::vector<StreamBlock> block_;
+
+	// running counts, the block index is count % StreamBlockCount
+	std::atomic<unsigned int> filled_ = 0;
+	std::atomic<unsigned int> consumed_ = 0;
+	unsigned int submitted_ = 0;
+	std::atomic<bool> done_ = true;
+};
+
+// one background thread keeping the rings of every stream full
+class StreamReader
+{
+public:
+	StreamReader() = default;
+	~StreamReader();
+	StreamReader(const StreamReader&) = delete;
+	StreamReader& operator=(const StreamReader&) = delete;
+
+	// the reader forgets a stream once its last owner drops it
+	void Add(const std::shared_ptr<AudioStream>& stream);
+
+	// call after a block was consumed or a stream restarted
+	void Wake(void);
+
+	// returns once every ring is full or finished
+	void WaitIdle(void);
+private:
+	void Run(void);
+	// mutex_ must be held
+	bool AnyPending(void);
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable idle_;
+
+	std::vector<std::weak_ptr<AudioStream>> stream_;
+
+	std::thread thread_;
+	bool running_ = false;
+	bool busy_ = false;
+};
@@ -0,0 +1,28 @@
+#include "AudioBackend.h"
+#include "SoftwareMixer.h"
+#include "XAudio2Backend.h"
+
+std::unique_ptr<AudioBackend> CreateAudioBackend(const AudioBackendDesc& desc)
+{
+	std::unique_ptr<AudioBackend> backend;
+
+	switch (desc.type_)
+	{
+#ifdef _WIN32
+	case AudioBackendType::XAudio2:
+		backend.reset(new XAudio2Backend());
+		break;
+#endif
+	case AudioBackendType::SoftwareMixer:
+		backend.reset(new SoftwareMixer());
+		break;
+	default:
+		return nullptr;
+	}
+
+	if (!backend->Initialize(desc))
+	{
+		return nullptr;
+	}
+	return backend;
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "AudioPlatform.h"
+#include "../EffectDefines.h"
+#include "../LockFreeQueue.h"
+
+struct EffectParams;
+
+enum class AudioBackendType
+{
+	XAudio2,
+	SoftwareMixer,
+};
+
+enum class MixerDeviceType
+{
+	// pulls frames on its own thread and throws them away, at the output rate unless
+	// AudioBackendDesc::realTime_ is false
+	Null,
+	// renders into memory only when asked to
+	Offline,
+};
+
+// interpolation a software mixer source voice resamples with
+enum class ResampleQuality
+{
+	// whatever AudioBackendDesc::resampleQuality_ says
+	Default,
+	// 2 taps
+	Linear,
+	// 4 tap Catmull-Rom
+	Cubic,
+	// 16 tap windowed sinc
+	Sinc,
+};
+
+struct AudioBackendDesc
+{
+#ifdef _WIN32
+	AudioBackendType type_ = AudioBackendType::XAudio2;
+#else
+	AudioBackendType type_ = AudioBackendType::SoftwareMixer;
+#endif
+	MixerDeviceType device_ = MixerDeviceType::Null;
+
+	// 0 means the device default (2ch / 48kHz on the software mixer)
+	unsigned int channels_ = 0;
+	unsigned int sampleRate_ = 0;
+
+	// software mixer only
+	unsigned int quantumFrames_ = 480;
+	ResampleQuality resampleQuality_ = ResampleQuality::Linear;
+	// threads rendering one quantum including the device thread, 0 picks one per core
+	// sources, then the submixes of each processing stage, are spread over them
+	unsigned int mixerThreads_ = 1;
+	// the null device keeps to the output rate, false renders as fast as it can for throughput runs
+	bool realTime_ = true;
+};
+
+enum class VoiceEventType
+{
+	// a submitted buffer finished (or was flushed on XAudio2)
+	BufferEnd,
+	// a buffer loop wrapped around
+	LoopEnd,
+};
+
+struct VoiceEvent
+{
+	VoiceEventType type_;
+	// pContext of the XAUDIO2_BUFFER
+	void* context_;
+};
+
+constexpr size_t VoiceEventQueueSize = 8192;
+
+// posted by the engine thread, drained by AudioManager::Update
+class VoiceEventQueue
+{
+public:
+	void Post(VoiceEventType type, void* context)
+	{
+		if (!queue_.Push(VoiceEvent{ type, context }))
+		{
+			overflow_.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	bool Pop(VoiceEvent& ev)
+	{
+		return queue_.Pop(ev);
+	}
+
+	// true once after an event was dropped because the queue was full
+	bool CheckOverflow(void)
+	{
+		return overflow_.exchange(false, std::memory_order_relaxed);
+	}
+private:
+	SpscQueue<VoiceEvent, VoiceEventQueueSize> queue_;
+	std::atomic<bool> overflow_ = false;
+};
+
+// one node of the voice graph, same role as IXAudio2Voice
+class AudioVoice
+{
+public:
+	virtual ~AudioVoice() = default;
+
+	// deletes this object, like IXAudio2Voice::DestroyVoice
+	virtual void DestroyVoice(void) = 0;
+
+	// operationSet other than XAUDIO2_COMMIT_NOW defers the change to AudioBackend::CommitChanges
+	virtual void SetVolume(float volume, unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual void SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS& filter,
+		unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+
+	// replaces every send; an empty list sends to the mastering output
+	// XAudio2 cannot defer routing, it applies at once there
+	virtual void SetOutputVoices(const std::vector<AudioVoice*>& outputs,
+		unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+
+	// nullptr removes the chain
+	virtual void SetEffectChain(const std::vector<XAUDIO2_EFFECT_DESCRIPTOR>* chain) = 0;
+	// edits of one effect, the voice holds a reference to every effect in its chain
+	// the software mixer keeps the state of the other effects, XAudio2 has to take the whole chain again
+	virtual void InsertEffect(unsigned int index, const XAUDIO2_EFFECT_DESCRIPTOR& effect,
+		unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual void RemoveEffect(unsigned int index, unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	// the effect at from ends up at to
+	virtual void MoveEffect(unsigned int from, unsigned int to, unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	// keeps the state of every effect on both backends
+	virtual void EnableEffect(unsigned int index, bool enable, unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual bool SetEffectParameters(unsigned int effectIndex, const void* param, unsigned int size,
+		unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual bool GetEffectParameters(unsigned int effectIndex, void* param, unsigned int size) = 0;
+};
+
+class AudioSourceVoice : public AudioVoice
+{
+public:
+	virtual void Start(unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual void Stop(unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual bool SubmitSourceBuffer(const XAUDIO2_BUFFER& buffer) = 0;
+	virtual void FlushSourceBuffers(void) = 0;
+	virtual void GetState(XAUDIO2_VOICE_STATE& state) = 0;
+
+	// source rate multiplier, clamped to [XAUDIO2_MIN_FREQ_RATIO, maxFrequencyRatio of the voice]
+	virtual void SetFrequencyRatio(float ratio, unsigned int operationSet = XAUDIO2_COMMIT_NOW) = 0;
+	virtual void SetResampleQuality(ResampleQuality quality) = 0;
+};
+
+// the audio engine below AudioManager
+class AudioBackend
+{
+public:
+	virtual ~AudioBackend() = default;
+
+	virtual bool Initialize(const AudioBackendDesc& desc) = 0;
+	virtual AudioBackendType GetType(void) const = 0;
+
+	virtual unsigned int GetOutputChannels(void) const = 0;
+	virtual unsigned int GetOutputSampleRate(void) const = 0;
+	// output frames rendered since Initialize, the clock virtual voices advance on
+	virtual uint64_t GetRenderedFrames(void) const = 0;
+
+	virtual AudioSourceVoice* CreateSourceVoice(const WAVEFORMATEX& format, float maxFrequencyRatio) = 0;
+	virtual AudioVoice* CreateSubmixVoice(unsigned int channels, unsigned int sampleRate, unsigned int stage) = 0;
+
+	virtual void CreateEffect(EffectParams& param, AudioEffectType type, unsigned int channel) = 0;
+
+	// source voices post buffer / loop end events here
+	virtual void SetEventQueue(VoiceEventQueue* queue) = 0;
+
+	// applies every change deferred with operationSet together, XAUDIO2_COMMIT_ALL applies all
+	virtual void CommitChanges(unsigned int operationSet) = 0;
+};
+
+std::unique_ptr<AudioBackend> CreateAudioBackend(const AudioBackendDesc& desc);
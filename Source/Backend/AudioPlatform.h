@@ -0,0 +1,368 @@
+#pragma once
+// XAudio2 types appear in the AudioManager API, so outside Windows
+// the subset used by the library is declared here with the same layout
+#ifdef _WIN32
+#include <xaudio2.h>
+#include <xaudio2fx.h>
+#include <xapofx.h>
+#else
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cwchar>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int32_t INT32;
+typedef int BOOL;
+typedef int32_t HRESULT;
+typedef int errno_t;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+struct WAVEFORMATEX
+{
+	WORD wFormatTag;
+	WORD nChannels;
+	DWORD nSamplesPerSec;
+	DWORD nAvgBytesPerSec;
+	WORD nBlockAlign;
+	WORD wBitsPerSample;
+	WORD cbSize;
+};
+
+#define STDMETHODCALLTYPE
+
+struct IUnknown
+{
+	virtual unsigned long AddRef(void) = 0;
+	virtual unsigned long Release(void) = 0;
+protected:
+	virtual ~IUnknown() = default;
+};
+
+#define XAUDIO2_COMMIT_NOW 0
+#define XAUDIO2_COMMIT_ALL 0
+#define XAUDIO2_END_OF_STREAM 0x0040
+#define XAUDIO2_MAX_LOOP_COUNT 254
+#define XAUDIO2_LOOP_INFINITE 255
+#define XAUDIO2_MAX_VOLUME_LEVEL 16777216.0f
+#define XAUDIO2_MAX_FILTER_ONEOVERQ 1.5f
+#define XAUDIO2_MAX_FILTER_FREQUENCY 1.0f
+#define XAUDIO2_DEFAULT_FILTER_FREQUENCY XAUDIO2_MAX_FILTER_FREQUENCY
+#define XAUDIO2_DEFAULT_FILTER_ONEOVERQ 1.0f
+#define XAUDIO2_MIN_FREQ_RATIO (1 / 1024.0f)
+#define XAUDIO2_DEFAULT_FREQ_RATIO 2.0f
+
+struct XAUDIO2_BUFFER
+{
+	UINT32 Flags;
+	UINT32 AudioBytes;
+	const BYTE* pAudioData;
+	UINT32 PlayBegin;
+	UINT32 PlayLength;
+	UINT32 LoopBegin;
+	UINT32 LoopLength;
+	UINT32 LoopCount;
+	void* pContext;
+};
+
+struct XAUDIO2_VOICE_STATE
+{
+	void* pCurrentBufferContext;
+	UINT32 BuffersQueued;
+	UINT64 SamplesPlayed;
+};
+
+enum XAUDIO2_FILTER_TYPE
+{
+	LowPassFilter,
+	BandPassFilter,
+	HighPassFilter,
+	NotchFilter,
+	LowPassOnePoleFilter,
+	HighPassOnePoleFilter
+};
+
+struct XAUDIO2_FILTER_PARAMETERS
+{
+	XAUDIO2_FILTER_TYPE Type;
+	float Frequency;
+	float OneOverQ;
+};
+
+struct XAUDIO2_EFFECT_DESCRIPTOR
+{
+	IUnknown* pEffect;
+	BOOL InitialState;
+	UINT32 OutputChannels;
+};
+
+struct XAUDIO2FX_VOLUMEMETER_LEVELS
+{
+	float* pPeakLevels;
+	float* pRMSLevels;
+	UINT32 ChannelCount;
+};
+
+#define XAUDIO2FX_REVERB_MAX_REFLECTIONS_DELAY 300
+#define XAUDIO2FX_REVERB_MAX_REVERB_DELAY 85
+#define XAUDIO2FX_REVERB_DEFAULT_REAR_DELAY 5
+#define XAUDIO2FX_REVERB_DEFAULT_7POINT1_REAR_DELAY 20
+#define XAUDIO2FX_REVERB_DEFAULT_7POINT1_SIDE_DELAY 5
+#define XAUDIO2FX_REVERB_DEFAULT_POSITION 6
+#define XAUDIO2FX_REVERB_DEFAULT_POSITION_MATRIX 27
+#define XAUDIO2FX_REVERB_DEFAULT_ROOM_SIZE 100.0f
+#define XAUDIO2FX_REVERB_MAX_DIFFUSION 15
+#define XAUDIO2FX_REVERB_MAX_LOW_EQ_GAIN 12
+#define XAUDIO2FX_REVERB_MAX_LOW_EQ_CUTOFF 9
+#define XAUDIO2FX_REVERB_MAX_HIGH_EQ_GAIN 8
+#define XAUDIO2FX_REVERB_MAX_HIGH_EQ_CUTOFF 14
+#define XAUDIO2FX_REVERB_MIN_DECAY_TIME 0.1f
+#define XAUDIO2FX_REVERB_MIN_ROOM_SIZE 1.0f
+#define XAUDIO2FX_REVERB_MAX_ROOM_SIZE 100.0f
+#define XAUDIO2FX_REVERB_DEFAULT_WET_DRY_MIX 100.0f
+#define XAUDIO2FX_REVERB_DEFAULT_REFLECTIONS_DELAY 5
+#define XAUDIO2FX_REVERB_DEFAULT_REVERB_DELAY 5
+#define XAUDIO2FX_REVERB_DEFAULT_EARLY_DIFFUSION 8
+#define XAUDIO2FX_REVERB_DEFAULT_LATE_DIFFUSION 8
+#define XAUDIO2FX_REVERB_DEFAULT_LOW_EQ_GAIN 8
+#define XAUDIO2FX_REVERB_DEFAULT_LOW_EQ_CUTOFF 4
+#define XAUDIO2FX_REVERB_DEFAULT_HIGH_EQ_GAIN 8
+#define XAUDIO2FX_REVERB_DEFAULT_HIGH_EQ_CUTOFF 4
+#define XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_FREQ 5000.0f
+#define XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_MAIN 0.0f
+#define XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_HF 0.0f
+#define XAUDIO2FX_REVERB_DEFAULT_REFLECTIONS_GAIN 0.0f
+#define XAUDIO2FX_REVERB_DEFAULT_REVERB_GAIN 0.0f
+#define XAUDIO2FX_REVERB_DEFAULT_DECAY_TIME 1.0f
+#define XAUDIO2FX_REVERB_DEFAULT_DENSITY 100.0f
+
+struct XAUDIO2FX_REVERB_PARAMETERS
+{
+	float WetDryMix;
+	UINT32 ReflectionsDelay;
+	BYTE ReverbDelay;
+	BYTE RearDelay;
+	BYTE SideDelay;
+	BYTE PositionLeft;
+	BYTE PositionRight;
+	BYTE PositionMatrixLeft;
+	BYTE PositionMatrixRight;
+	BYTE EarlyDiffusion;
+	BYTE LateDiffusion;
+	BYTE LowEQGain;
+	BYTE LowEQCutoff;
+	BYTE HighEQGain;
+	BYTE HighEQCutoff;
+	float RoomFilterFreq;
+	float RoomFilterMain;
+	float RoomFilterHF;
+	float ReflectionsGain;
+	float ReverbGain;
+	float DecayTime;
+	float Density;
+	float RoomSize;
+	BOOL DisableLateField;
+};
+
+struct XAUDIO2FX_REVERB_I3DL2_PARAMETERS
+{
+	float WetDryMix;
+	INT32 Room;
+	INT32 RoomHF;
+	float RoomRolloffFactor;
+	float DecayTime;
+	float DecayHFRatio;
+	INT32 Reflections;
+	float ReflectionsDelay;
+	INT32 Reverb;
+	float ReverbDelay;
+	float Diffusion;
+	float Density;
+	float HFReference;
+};
+
+// same conversion as the inline version in xaudio2fx.h
+inline void ReverbConvertI3DL2ToNative(const XAUDIO2FX_REVERB_I3DL2_PARAMETERS* pI3DL2,
+	XAUDIO2FX_REVERB_PARAMETERS* pNative, BOOL sevenDotOneReverb = TRUE)
+{
+	float reflectionsDelay;
+	float reverbDelay;
+
+	pNative->RearDelay = sevenDotOneReverb ?
+		XAUDIO2FX_REVERB_DEFAULT_7POINT1_REAR_DELAY : XAUDIO2FX_REVERB_DEFAULT_REAR_DELAY;
+	pNative->SideDelay = XAUDIO2FX_REVERB_DEFAULT_7POINT1_SIDE_DELAY;
+	pNative->PositionLeft = XAUDIO2FX_REVERB_DEFAULT_POSITION;
+	pNative->PositionRight = XAUDIO2FX_REVERB_DEFAULT_POSITION;
+	pNative->PositionMatrixLeft = XAUDIO2FX_REVERB_DEFAULT_POSITION_MATRIX;
+	pNative->PositionMatrixRight = XAUDIO2FX_REVERB_DEFAULT_POSITION_MATRIX;
+	pNative->RoomSize = XAUDIO2FX_REVERB_DEFAULT_ROOM_SIZE;
+	pNative->LowEQCutoff = 4;
+	pNative->HighEQCutoff = 6;
+
+	pNative->RoomFilterMain = static_cast<float>(pI3DL2->Room) / 100.0f;
+	pNative->RoomFilterHF = static_cast<float>(pI3DL2->RoomHF) / 100.0f;
+
+	if (pI3DL2->DecayHFRatio >= 1.0f)
+	{
+		INT32 index = static_cast<INT32>(-4.0 * log10(pI3DL2->DecayHFRatio));
+		if (index < -8) { index = -8; }
+		pNative->LowEQGain = static_cast<BYTE>((index < 0) ? index + 8 : 8);
+		pNative->HighEQGain = 8;
+		pNative->DecayTime = pI3DL2->DecayTime * pI3DL2->DecayHFRatio;
+	}
+	else
+	{
+		INT32 index = static_cast<INT32>(4.0 * log10(pI3DL2->DecayHFRatio));
+		if (index < -8) { index = -8; }
+		pNative->LowEQGain = 8;
+		pNative->HighEQGain = static_cast<BYTE>((index < 0) ? index + 8 : 8);
+		pNative->DecayTime = pI3DL2->DecayTime;
+	}
+
+	reflectionsDelay = pI3DL2->ReflectionsDelay * 1000.0f;
+	if (reflectionsDelay >= XAUDIO2FX_REVERB_MAX_REFLECTIONS_DELAY)
+	{
+		reflectionsDelay = static_cast<float>(XAUDIO2FX_REVERB_MAX_REFLECTIONS_DELAY - 1);
+	}
+	else if (reflectionsDelay <= 1)
+	{
+		reflectionsDelay = 1;
+	}
+	pNative->ReflectionsDelay = static_cast<UINT32>(reflectionsDelay);
+
+	reverbDelay = pI3DL2->ReverbDelay * 1000.0f;
+	if (reverbDelay >= XAUDIO2FX_REVERB_MAX_REVERB_DELAY)
+	{
+		reverbDelay = static_cast<float>(XAUDIO2FX_REVERB_MAX_REVERB_DELAY - 1);
+	}
+	pNative->ReverbDelay = static_cast<BYTE>(reverbDelay);
+
+	pNative->ReflectionsGain = pI3DL2->Reflections / 100.0f;
+	pNative->ReverbGain = pI3DL2->Reverb / 100.0f;
+	pNative->EarlyDiffusion = static_cast<BYTE>(15.0f * pI3DL2->Diffusion / 100.0f);
+	pNative->LateDiffusion = pNative->EarlyDiffusion;
+	pNative->Density = pI3DL2->Density;
+	pNative->RoomFilterFreq = pI3DL2->HFReference;
+
+	pNative->WetDryMix = pI3DL2->WetDryMix;
+	pNative->DisableLateField = FALSE;
+}
+
+#define FXEQ_MIN_FREQUENCY_CENTER 20.0f
+#define FXEQ_MAX_FREQUENCY_CENTER 20000.0f
+#define FXEQ_DEFAULT_FREQUENCY_CENTER_0 100.0f
+#define FXEQ_DEFAULT_FREQUENCY_CENTER_1 800.0f
+#define FXEQ_DEFAULT_FREQUENCY_CENTER_2 2000.0f
+#define FXEQ_DEFAULT_FREQUENCY_CENTER_3 10000.0f
+#define FXEQ_MIN_GAIN 0.126f
+#define FXEQ_MAX_GAIN 7.94f
+#define FXEQ_DEFAULT_GAIN 1.0f
+#define FXEQ_MIN_BANDWIDTH 0.1f
+#define FXEQ_MAX_BANDWIDTH 2.0f
+#define FXEQ_DEFAULT_BANDWIDTH 1.0f
+
+#define FXMASTERINGLIMITER_MIN_RELEASE 1
+#define FXMASTERINGLIMITER_MAX_RELEASE 20
+#define FXMASTERINGLIMITER_DEFAULT_RELEASE 6
+#define FXMASTERINGLIMITER_MIN_LOUDNESS 1
+#define FXMASTERINGLIMITER_MAX_LOUDNESS 1800
+#define FXMASTERINGLIMITER_DEFAULT_LOUDNESS 1000
+
+#define FXREVERB_MIN_DIFFUSION 0.0f
+#define FXREVERB_MAX_DIFFUSION 1.0f
+#define FXREVERB_DEFAULT_DIFFUSION 0.9f
+#define FXREVERB_MIN_ROOMSIZE 0.0001f
+#define FXREVERB_MAX_ROOMSIZE 1.0f
+#define FXREVERB_DEFAULT_ROOMSIZE 0.6f
+
+#define FXECHO_MIN_WETDRYMIX 0.0f
+#define FXECHO_MAX_WETDRYMIX 1.0f
+#define FXECHO_DEFAULT_WETDRYMIX 0.5f
+#define FXECHO_MIN_FEEDBACK 0.0f
+#define FXECHO_MAX_FEEDBACK 1.0f
+#define FXECHO_DEFAULT_FEEDBACK 0.5f
+#define FXECHO_MIN_DELAY 1.0f
+#define FXECHO_MAX_DELAY 2000.0f
+#define FXECHO_DEFAULT_DELAY 500.0f
+
+struct FXEQ_PARAMETERS
+{
+	float FrequencyCenter0;
+	float Gain0;
+	float Bandwidth0;
+	float FrequencyCenter1;
+	float Gain1;
+	float Bandwidth1;
+	float FrequencyCenter2;
+	float Gain2;
+	float Bandwidth2;
+	float FrequencyCenter3;
+	float Gain3;
+	float Bandwidth3;
+};
+
+struct FXMASTERINGLIMITER_PARAMETERS
+{
+	UINT32 Release;
+	UINT32 Loudness;
+};
+
+struct FXREVERB_PARAMETERS
+{
+	float Diffusion;
+	float RoomSize;
+};
+
+struct FXECHO_PARAMETERS
+{
+	float WetDryMix;
+	float Feedback;
+	float Delay;
+};
+
+inline void OutputDebugString(const wchar_t* str)
+{
+#ifndef NDEBUG
+	fwprintf(stderr, L"%ls\n", str);
+#endif
+}
+
+inline void OutputDebugStringA(const char* str)
+{
+#ifndef NDEBUG
+	fprintf(stderr, "%s", str);
+#endif
+}
+
+inline errno_t fopen_s(FILE** fp, const char* filename, const char* mode)
+{
+	*fp = fopen(filename, mode);
+	return (*fp == nullptr) ? errno : 0;
+}
+
+inline size_t fread_s(void* buffer, size_t bufferSize, size_t elementSize, size_t count, FILE* fp)
+{
+	if (elementSize == 0 || bufferSize / elementSize < count) { return 0; }
+	return fread(buffer, elementSize, count, fp);
+}
+#endif
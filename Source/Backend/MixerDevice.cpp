@@ -0,0 +1,94 @@
+#include "MixerDevice.h"
+#include <algorithm>
+#include "SoftwareMixer.h"
+
+NullMixerDevice::~NullMixerDevice()
+{
+	Stop();
+}
+
+bool NullMixerDevice::Start(SoftwareMixer& mixer)
+{
+	if (running_) { return true; }
+
+	mixer_ = &mixer;
+	buffer_.resize(mixer.GetQuantumFrames() * mixer.GetOutputChannels());
+	renderedFrames_ = 0;
+	startTime_ = std::chrono::steady_clock::now();
+
+	running_ = true;
+	thread_ = std::thread(&NullMixerDevice::Run, this);
+	return true;
+}
+
+void NullMixerDevice::Stop(void)
+{
+	running_ = false;
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+}
+
+double NullMixerDevice::GetRunningTime(void) const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+}
+
+void NullMixerDevice::Run(void)
+{
+	const unsigned int frames = mixer_->GetQuantumFrames();
+	const double sampleRate = mixer_->GetOutputSampleRate();
+	while (running_)
+	{
+		mixer_->Render(buffer_.data(), frames);
+		const uint64_t rendered = renderedFrames_.fetch_add(frames, std::memory_order_relaxed) + frames;
+
+		if (realTime_)
+		{
+			// due when a real device would ask for the next quantum, a late quantum is caught up at once
+			std::this_thread::sleep_until(startTime_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(rendered / sampleRate)));
+		}
+		else
+		{
+			// let API callers take the mixer lock between quanta
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool OfflineMixerDevice::Start(SoftwareMixer& mixer)
+{
+	mixer_ = &mixer;
+	return true;
+}
+
+void OfflineMixerDevice::Stop(void)
+{
+	mixer_ = nullptr;
+}
+
+void OfflineMixerDevice::Render(unsigned int frames)
+{
+	if (mixer_ == nullptr) { return; }
+
+	size_t offset = output_.size();
+	output_.resize(offset + static_cast<size_t>(frames) * mixer_->GetOutputChannels());
+	mixer_->Render(output_.data() + offset, frames);
+}
+
+void OfflineMixerDevice::Advance(unsigned int frames)
+{
+	if (mixer_ == nullptr) { return; }
+
+	// one quantum at a time keeps the scratch small
+	const unsigned int quantum = mixer_->GetQuantumFrames();
+	scratch_.resize(static_cast<size_t>(quantum) * mixer_->GetOutputChannels());
+	while (frames > 0)
+	{
+		unsigned int n = std::min(frames, quantum);
+		mixer_->Render(scratch_.data(), n);
+		frames -= n;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "AudioBackend.h"
+
+class SoftwareMixer;
+
+// pulls rendered frames out of the software mixer
+class MixerDevice
+{
+public:
+	virtual ~MixerDevice() = default;
+
+	virtual bool Start(SoftwareMixer& mixer) = 0;
+	virtual void Stop(void) = 0;
+	virtual MixerDeviceType GetType(void) const = 0;
+};
+
+// renders on its own thread without any output, paced to the output rate or, for throughput
+// and soak runs, as fast as it can
+class NullMixerDevice : public MixerDevice
+{
+public:
+	explicit NullMixerDevice(bool realTime) : realTime_(realTime) {}
+	~NullMixerDevice();
+
+	bool Start(SoftwareMixer& mixer) override;
+	void Stop(void) override;
+	MixerDeviceType GetType(void) const override { return MixerDeviceType::Null; }
+
+	uint64_t GetRenderedFrames(void) const { return renderedFrames_.load(std::memory_order_relaxed); }
+
+	// seconds since Start
+	double GetRunningTime(void) const;
+private:
+	void Run(void);
+
+	SoftwareMixer* mixer_ = nullptr;
+	bool realTime_;
+	std::thread thread_;
+	std::atomic<bool> running_ = false;
+	std::atomic<uint64_t> renderedFrames_ = 0;
+	std::chrono::steady_clock::time_point startTime_;
+	std::vector<float> buffer_;
+};
+
+// renders into memory only when Render is called
+class OfflineMixerDevice : public MixerDevice
+{
+public:
+	OfflineMixerDevice() = default;
+
+	bool Start(SoftwareMixer& mixer) override;
+	void Stop(void) override;
+	MixerDeviceType GetType(void) const override { return MixerDeviceType::Offline; }
+
+	// appends frames of interleaved float to the output
+	void Render(unsigned int frames);
+	// renders without keeping the output, taps still see it
+	void Advance(unsigned int frames);
+
+	const std::vector<float>& GetOutput(void) const { return output_; }
+	void ClearOutput(void) { output_.clear(); }
+private:
+	SoftwareMixer* mixer_ = nullptr;
+	std::vector<float> output_;
+	std::vector<float> scratch_;
+};
@@ -0,0 +1,1370 @@
+#include "MixerKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MIXER_KERNELS_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define MIXER_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// msvc emits avx2 intrinsics anywhere, gcc / clang need the function marked
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MIXER_TARGET_AVX2
+#else
+#define MIXER_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace
+{
+	constexpr float Pcm16Scale = 1.0f / 32768.0f;
+	constexpr float Pcm24Scale = 1.0f / 8388608.0f;
+
+	inline float Pcm24Sample(const uint8_t* p)
+	{
+		uint32_t u = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+			(static_cast<uint32_t>(p[2]) << 24);
+		return static_cast<float>(static_cast<int32_t>(u) >> 8) * Pcm24Scale;
+	}
+
+	inline int16_t Pcm16Sample(float s)
+	{
+		s = std::min(std::max(s, -1.0f), 1.0f);
+		return static_cast<int16_t>(std::lrint(s * 32767.0f));
+	}
+
+	// scalar ----------------------------------------------------------------
+
+	void Pcm16ToFloatScalar(const int16_t* src, float* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = src[i] * Pcm16Scale;
+		}
+	}
+
+	void Pcm24ToFloatScalar(const uint8_t* src, float* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = Pcm24Sample(src + i * 3);
+		}
+	}
+
+	// frames from 'first' on, used for the tails of the vector versions too
+	void AccumulateRampFrom(const float* src, float* dst, unsigned int first, unsigned int frames,
+		unsigned int channels, float gainBegin, float step)
+	{
+		for (unsigned int f = first; f < frames; f++)
+		{
+			float g = gainBegin + step * f;
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				dst[f * channels + c] += src[f * channels + c] * g;
+			}
+		}
+	}
+
+	void AccumulateRampScalar(const float* src, float* dst, unsigned int frames, unsigned int channels,
+		float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		AccumulateRampFrom(src, dst, 0, frames, channels, gainBegin, (gainEnd - gainBegin) / frames);
+	}
+
+	void MixMatrixFrom(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int first, unsigned int frames, const float* matrix, float gainBegin, float step)
+	{
+		for (unsigned int f = first; f < frames; f++)
+		{
+			float g = gainBegin + step * f;
+			const float* s = src + f * srcChannels;
+			float* d = dst + f * dstChannels;
+			for (unsigned int o = 0; o < dstChannels; o++)
+			{
+				const float* m = matrix + o * srcChannels;
+				float sum = 0.0f;
+				for (unsigned int i = 0; i < srcChannels; i++)
+				{
+					sum += s[i] * m[i];
+				}
+				d[o] += sum * g;
+			}
+		}
+	}
+
+	void MixMatrixScalar(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int frames, const float* matrix, float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		MixMatrixFrom(src, srcChannels, dst, dstChannels, 0, frames, matrix, gainBegin,
+			(gainEnd - gainBegin) / frames);
+	}
+
+	// widest source the vector matrix kernels take, and the upmix layouts they take it to
+	constexpr unsigned int MatrixVectorMaxSource = 8;
+
+	inline bool IsMatrixVectorShape(unsigned int srcChannels, unsigned int dstChannels)
+	{
+		return srcChannels <= MatrixVectorMaxSource && (dstChannels == 4 || dstChannels == 6 || dstChannels == 8);
+	}
+
+	// column s holds what source channel s adds to each output, zero past dstChannels
+	struct MatrixColumns
+	{
+		alignas(32) float col_[MatrixVectorMaxSource][8];
+
+		MatrixColumns(const float* matrix, unsigned int srcChannels, unsigned int dstChannels)
+		{
+			for (unsigned int s = 0; s < srcChannels; s++)
+			{
+				for (unsigned int o = 0; o < 8; o++)
+				{
+					col_[s][o] = o < dstChannels ? matrix[o * srcChannels + s] : 0.0f;
+				}
+			}
+		}
+	};
+
+	void FloatToPcm16Scalar(const float* src, int16_t* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = Pcm16Sample(src[i]);
+		}
+	}
+
+	// resampling --------------------------------------------------------------
+
+	constexpr unsigned int SincTaps = ResampleHistoryFrames + ResampleLookaheadFrames + 1;
+	constexpr unsigned int SincPhases = 256;
+	constexpr float FracScale = 1.0f / 4294967296.0f;
+
+	inline float Frac(uint64_t position)
+	{
+		return static_cast<float>(position & 0xffffffffull) * FracScale;
+	}
+
+	// first of the frames a kernel reads for this position
+	inline const float* Window(const float* src, unsigned int channels, uint64_t position, unsigned int history)
+	{
+		return src + (static_cast<ptrdiff_t>(position >> 32) - static_cast<ptrdiff_t>(history)) * channels;
+	}
+
+	// tap k weighs the frame k - ResampleHistoryFrames away, one row per phase plus a closing row
+	struct SincTable
+	{
+		alignas(32) float coef_[(SincPhases + 1) * SincTaps];
+	};
+
+	const SincTable& GetSincTable(void)
+	{
+		static const SincTable table = []()
+			{
+				const double pi = 3.14159265358979323846;
+				const double half = SincTaps / 2.0;
+				SincTable t = {};
+				for (unsigned int p = 0; p <= SincPhases; p++)
+				{
+					const double frac = static_cast<double>(p) / SincPhases;
+					double w[SincTaps];
+					double sum = 0.0;
+					for (unsigned int k = 0; k < SincTaps; k++)
+					{
+						const double x = static_cast<double>(k) - ResampleHistoryFrames - frac;
+						const double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+						// Blackman across the taps, centered on the position
+						const double n = (x + half) / (2.0 * half);
+						w[k] = sinc * (0.42 - 0.5 * std::cos(2.0 * pi * n) + 0.08 * std::cos(4.0 * pi * n));
+						sum += w[k];
+					}
+					// every phase sums to one, so dc passes without ripple
+					for (unsigned int k = 0; k < SincTaps; k++)
+					{
+						t.coef_[p * SincTaps + k] = static_cast<float>(w[k] / sum);
+					}
+				}
+				return t;
+			}();
+		return table;
+	}
+
+	// row of the phase under the position, t is how far it is toward the next row
+	inline const float* SincRow(const float* table, uint64_t position, float& t)
+	{
+		const uint64_t phase = (position & 0xffffffffull) * SincPhases;
+		t = static_cast<float>(phase & 0xffffffffull) * FracScale;
+		return table + (phase >> 32) * SincTaps;
+	}
+
+	inline void CubicWeights(float f, float w[4])
+	{
+		const float f2 = f * f;
+		const float f3 = f2 * f;
+		w[0] = -0.5f * f3 + f2 - 0.5f * f;
+		w[1] = 1.5f * f3 - 2.5f * f2 + 1.0f;
+		w[2] = -1.5f * f3 + 2.0f * f2 + 0.5f * f;
+		w[3] = 0.5f * f3 - 0.5f * f2;
+	}
+
+	// frames from 'first' on, used for the tails of the vector versions too
+	void ResampleLinearFrom(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int first, unsigned int frames)
+	{
+		position += step * first;
+		for (unsigned int i = first; i < frames; i++, position += step)
+		{
+			const float frac = Frac(position);
+			const float* a = Window(src, channels, position, 0);
+			const float* b = a + channels;
+			float* o = dst + i * channels;
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				o[c] = a[c] + (b[c] - a[c]) * frac;
+			}
+		}
+	}
+
+	void ResampleCubicFrom(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int first, unsigned int frames)
+	{
+		position += step * first;
+		for (unsigned int i = first; i < frames; i++, position += step)
+		{
+			float w[4];
+			CubicWeights(Frac(position), w);
+			const float* s = Window(src, channels, position, 1);
+			float* o = dst + i * channels;
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				o[c] = s[c] * w[0] + s[channels + c] * w[1] + s[channels * 2 + c] * w[2] + s[channels * 3 + c] * w[3];
+			}
+		}
+	}
+
+	void ResampleSincFrom(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int first, unsigned int frames)
+	{
+		const float* table = GetSincTable().coef_;
+		position += step * first;
+		for (unsigned int i = first; i < frames; i++, position += step)
+		{
+			float t;
+			const float* c0 = SincRow(table, position, t);
+			const float* c1 = c0 + SincTaps;
+			const float* s = Window(src, channels, position, ResampleHistoryFrames);
+			float* o = dst + i * channels;
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				float sum = 0.0f;
+				for (unsigned int k = 0; k < SincTaps; k++)
+				{
+					sum += s[k * channels + c] * (c0[k] + (c1[k] - c0[k]) * t);
+				}
+				o[c] = sum;
+			}
+		}
+	}
+
+	void ResampleLinearScalar(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		ResampleLinearFrom(src, channels, position, step, dst, 0, frames);
+	}
+
+	void ResampleCubicScalar(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		ResampleCubicFrom(src, channels, position, step, dst, 0, frames);
+	}
+
+	void ResampleSincScalar(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		ResampleSincFrom(src, channels, position, step, dst, 0, frames);
+	}
+
+	void ComplexMultiplyAccumulateScalar(const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+		float* accRe, float* accIm, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+			accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+		}
+	}
+
+	void ConvolveDirectScalar(const float* src, const float* taps, unsigned int tapCount, float* dst, unsigned int frames)
+	{
+		for (unsigned int t = 0; t < tapCount; t++)
+		{
+			const float h = taps[t];
+			const float* s = src - t;
+			for (unsigned int i = 0; i < frames; i++)
+			{
+				dst[i] += h * s[i];
+			}
+		}
+	}
+
+	const MixerKernels ScalarKernels =
+	{
+		SimdLevel::Scalar,
+		Pcm16ToFloatScalar,
+		Pcm24ToFloatScalar,
+		AccumulateRampScalar,
+		MixMatrixScalar,
+		FloatToPcm16Scalar,
+		ResampleLinearScalar,
+		ResampleCubicScalar,
+		ResampleSincScalar,
+		ComplexMultiplyAccumulateScalar,
+		ConvolveDirectScalar,
+	};
+
+#ifdef MIXER_KERNELS_X64
+	// sse2, always present on x64 ---------------------------------------------
+
+	void Pcm16ToFloatSSE2(const int16_t* src, float* dst, size_t count)
+	{
+		const __m128 scale = _mm_set1_ps(Pcm16Scale);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			// duplicate into both halves, then shift the sign down
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+		Pcm16ToFloatScalar(src + i, dst + i, count - i);
+	}
+
+	void Pcm24ToFloatSSE2(const uint8_t* src, float* dst, size_t count)
+	{
+		// sample k is moved up 1 + k bytes so it fills the top of dword k, the masks keep one sample per dword
+		const __m128i top = _mm_set1_epi32(static_cast<int>(0xffffff00u));
+		const __m128i keep0 = _mm_and_si128(top, _mm_setr_epi32(-1, 0, 0, 0));
+		const __m128i keep1 = _mm_and_si128(top, _mm_setr_epi32(0, -1, 0, 0));
+		const __m128i keep2 = _mm_and_si128(top, _mm_setr_epi32(0, 0, -1, 0));
+		const __m128i keep3 = _mm_and_si128(top, _mm_setr_epi32(0, 0, 0, -1));
+		const __m128 scale = _mm_set1_ps(Pcm24Scale);
+		size_t i = 0;
+		// each load reads 16 bytes of which 12 are used
+		for (; i + 6 <= count; i += 4)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+			__m128i s = _mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 1), keep0), _mm_and_si128(_mm_slli_si128(v, 2), keep1));
+			s = _mm_or_si128(s, _mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 3), keep2), _mm_and_si128(_mm_slli_si128(v, 4), keep3)));
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(s, 8)), scale));
+		}
+		Pcm24ToFloatScalar(src + i * 3, dst + i, count - i);
+	}
+
+	void AccumulateRampSSE2(const float* src, float* dst, unsigned int frames, unsigned int channels,
+		float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		const float step = (gainEnd - gainBegin) / frames;
+
+		unsigned int f = 0;
+		if (channels == 1 || channels == 2)
+		{
+			// 4 lanes hold 4 mono frames or 2 stereo frames
+			const unsigned int perVector = 4 / channels;
+			__m128 g = channels == 1 ?
+				_mm_setr_ps(gainBegin, gainBegin + step, gainBegin + step * 2, gainBegin + step * 3) :
+				_mm_setr_ps(gainBegin, gainBegin, gainBegin + step, gainBegin + step);
+			const __m128 inc = _mm_set1_ps(step * perVector);
+
+			for (; f + perVector <= frames; f += perVector)
+			{
+				__m128 d = _mm_loadu_ps(dst + f * channels);
+				__m128 s = _mm_loadu_ps(src + f * channels);
+				_mm_storeu_ps(dst + f * channels, _mm_add_ps(d, _mm_mul_ps(s, g)));
+				g = _mm_add_ps(g, inc);
+			}
+		}
+		else if (channels % 4 == 0)
+		{
+			for (; f < frames; f++)
+			{
+				const __m128 g = _mm_set1_ps(gainBegin + step * f);
+				for (unsigned int c = 0; c < channels; c += 4)
+				{
+					__m128 d = _mm_loadu_ps(dst + f * channels + c);
+					__m128 s = _mm_loadu_ps(src + f * channels + c);
+					_mm_storeu_ps(dst + f * channels + c, _mm_add_ps(d, _mm_mul_ps(s, g)));
+				}
+			}
+		}
+		AccumulateRampFrom(src, dst, f, frames, channels, gainBegin, step);
+	}
+
+	void MixMatrixSSE2(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int frames, const float* matrix, float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		const float step = (gainEnd - gainBegin) / frames;
+
+		unsigned int f = 0;
+		if (srcChannels == 1 && dstChannels == 2)
+		{
+			const __m128 m = _mm_setr_ps(matrix[0], matrix[1], matrix[0], matrix[1]);
+			__m128 g = _mm_setr_ps(gainBegin, gainBegin, gainBegin + step, gainBegin + step);
+			const __m128 inc = _mm_set1_ps(step * 2);
+
+			for (; f + 2 <= frames; f += 2)
+			{
+				__m128 s = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(src + f)));
+				s = _mm_unpacklo_ps(s, s);
+				__m128 d = _mm_loadu_ps(dst + f * 2);
+				_mm_storeu_ps(dst + f * 2, _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(s, m), g)));
+				g = _mm_add_ps(g, inc);
+			}
+		}
+		else if (srcChannels == 2 && dstChannels == 2)
+		{
+			// out = x * (m00, m11) + swap(x) * (m01, m10)
+			const __m128 direct = _mm_setr_ps(matrix[0], matrix[3], matrix[0], matrix[3]);
+			const __m128 cross = _mm_setr_ps(matrix[1], matrix[2], matrix[1], matrix[2]);
+			__m128 g = _mm_setr_ps(gainBegin, gainBegin, gainBegin + step, gainBegin + step);
+			const __m128 inc = _mm_set1_ps(step * 2);
+
+			for (; f + 2 <= frames; f += 2)
+			{
+				__m128 s = _mm_loadu_ps(src + f * 2);
+				__m128 sw = _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1));
+				__m128 mixed = _mm_add_ps(_mm_mul_ps(s, direct), _mm_mul_ps(sw, cross));
+				__m128 d = _mm_loadu_ps(dst + f * 2);
+				_mm_storeu_ps(dst + f * 2, _mm_add_ps(d, _mm_mul_ps(mixed, g)));
+				g = _mm_add_ps(g, inc);
+			}
+		}
+		else if (IsMatrixVectorShape(srcChannels, dstChannels))
+		{
+			// upmix, every source channel is broadcast against its column, 4 outputs per vector
+			const MatrixColumns m(matrix, srcChannels, dstChannels);
+			for (; f < frames; f++)
+			{
+				const float* s = src + f * srcChannels;
+				float* d = dst + f * dstChannels;
+				__m128 lo = _mm_setzero_ps();
+				__m128 hi = _mm_setzero_ps();
+				for (unsigned int i = 0; i < srcChannels; i++)
+				{
+					const __m128 x = _mm_set1_ps(s[i]);
+					lo = _mm_add_ps(lo, _mm_mul_ps(x, _mm_load_ps(m.col_[i])));
+					hi = _mm_add_ps(hi, _mm_mul_ps(x, _mm_load_ps(m.col_[i] + 4)));
+				}
+				const __m128 g = _mm_set1_ps(gainBegin + step * f);
+				_mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_mul_ps(lo, g)));
+				if (dstChannels == 8)
+				{
+					_mm_storeu_ps(d + 4, _mm_add_ps(_mm_loadu_ps(d + 4), _mm_mul_ps(hi, g)));
+				}
+				else if (dstChannels == 6)
+				{
+					const __m128 d45 = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(d + 4));
+					_mm_storel_pi(reinterpret_cast<__m64*>(d + 4), _mm_add_ps(d45, _mm_mul_ps(hi, g)));
+				}
+			}
+		}
+		MixMatrixFrom(src, srcChannels, dst, dstChannels, f, frames, matrix, gainBegin, step);
+	}
+
+	void FloatToPcm16SSE2(const float* src, int16_t* dst, size_t count)
+	{
+		const __m128 lo = _mm_set1_ps(-1.0f);
+		const __m128 hi = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+			__m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lo), hi);
+			__m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a, scale));
+			__m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b, scale));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(ia, ib));
+		}
+		FloatToPcm16Scalar(src + i, dst + i, count - i);
+	}
+
+	// 4 frames per vector for mono, 2 for stereo, other layouts take the scalar loop
+	void ResampleLinearSSE2(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		if (channels == 1)
+		{
+			for (; i + 4 <= frames; i += 4)
+			{
+				const uint64_t p[4] = { position, position + step, position + step * 2, position + step * 3 };
+				// (a0 b0 a1 b1), (a2 b2 a3 b3)
+				__m128 x01 = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(Window(src, 1, p[0], 0)));
+				x01 = _mm_loadh_pi(x01, reinterpret_cast<const __m64*>(Window(src, 1, p[1], 0)));
+				__m128 x23 = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(Window(src, 1, p[2], 0)));
+				x23 = _mm_loadh_pi(x23, reinterpret_cast<const __m64*>(Window(src, 1, p[3], 0)));
+				const __m128 a = _mm_shuffle_ps(x01, x23, _MM_SHUFFLE(2, 0, 2, 0));
+				const __m128 b = _mm_shuffle_ps(x01, x23, _MM_SHUFFLE(3, 1, 3, 1));
+				const __m128 f = _mm_setr_ps(Frac(p[0]), Frac(p[1]), Frac(p[2]), Frac(p[3]));
+				_mm_storeu_ps(dst + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f)));
+				position += step * 4;
+			}
+		}
+		else if (channels == 2)
+		{
+			for (; i + 2 <= frames; i += 2)
+			{
+				// (aL aR bL bR) of both frames, the low half ends up holding the result
+				const __m128 x0 = _mm_loadu_ps(Window(src, 2, position, 0));
+				const __m128 x1 = _mm_loadu_ps(Window(src, 2, position + step, 0));
+				const __m128 r0 = _mm_add_ps(x0, _mm_mul_ps(_mm_sub_ps(_mm_movehl_ps(x0, x0), x0), _mm_set1_ps(Frac(position))));
+				const __m128 r1 = _mm_add_ps(x1, _mm_mul_ps(_mm_sub_ps(_mm_movehl_ps(x1, x1), x1), _mm_set1_ps(Frac(position + step))));
+				_mm_storeu_ps(dst + i * 2, _mm_movelh_ps(r0, r1));
+				position += step * 2;
+			}
+		}
+		ResampleLinearFrom(src, channels, position - step * i, step, dst, i, frames);
+	}
+
+	// CubicWeights of 4 positions, w[k] holds tap k of each
+	inline void CubicWeightsSSE2(const uint64_t p[4], __m128 w[4])
+	{
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 onehalf = _mm_set1_ps(1.5f);
+		const __m128 f = _mm_setr_ps(Frac(p[0]), Frac(p[1]), Frac(p[2]), Frac(p[3]));
+		const __m128 f2 = _mm_mul_ps(f, f);
+		const __m128 f3 = _mm_mul_ps(f2, f);
+		w[0] = _mm_sub_ps(_mm_sub_ps(f2, _mm_mul_ps(half, f3)), _mm_mul_ps(half, f));
+		w[1] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(onehalf, f3), _mm_mul_ps(_mm_set1_ps(2.5f), f2)), _mm_set1_ps(1.0f));
+		w[2] = _mm_add_ps(_mm_sub_ps(_mm_add_ps(f2, f2), _mm_mul_ps(onehalf, f3)), _mm_mul_ps(half, f));
+		w[3] = _mm_mul_ps(half, _mm_sub_ps(f3, f2));
+	}
+
+	void ResampleCubicSSE2(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		if (channels == 1)
+		{
+			for (; i + 4 <= frames; i += 4)
+			{
+				const uint64_t p[4] = { position, position + step, position + step * 2, position + step * 3 };
+				__m128 w[4];
+				CubicWeightsSSE2(p, w);
+
+				// one row per output frame, transposed into one row per tap
+				__m128 r0 = _mm_loadu_ps(Window(src, 1, p[0], 1));
+				__m128 r1 = _mm_loadu_ps(Window(src, 1, p[1], 1));
+				__m128 r2 = _mm_loadu_ps(Window(src, 1, p[2], 1));
+				__m128 r3 = _mm_loadu_ps(Window(src, 1, p[3], 1));
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				const __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, w[0]), _mm_mul_ps(r1, w[1])),
+					_mm_add_ps(_mm_mul_ps(r2, w[2]), _mm_mul_ps(r3, w[3])));
+				_mm_storeu_ps(dst + i, y);
+				position += step * 4;
+			}
+		}
+		else if (channels == 2)
+		{
+			for (; i + 4 <= frames; i += 4)
+			{
+				const uint64_t p[4] = { position, position + step, position + step * 2, position + step * 3 };
+				__m128 w[4];
+				CubicWeightsSSE2(p, w);
+
+				// (w0 w1) and (w2 w3) of frames 0 / 1 and 2 / 3 interleaved
+				const __m128 lo[2] = { _mm_unpacklo_ps(w[0], w[1]), _mm_unpackhi_ps(w[0], w[1]) };
+				const __m128 hi[2] = { _mm_unpacklo_ps(w[2], w[3]), _mm_unpackhi_ps(w[2], w[3]) };
+				__m128 r[4];
+				for (unsigned int k = 0; k < 4; k++)
+				{
+					// (wa wa wb wb) of frame k
+					const __m128 wlo = (k & 1) ? _mm_shuffle_ps(lo[k / 2], lo[k / 2], _MM_SHUFFLE(3, 3, 2, 2)) :
+						_mm_shuffle_ps(lo[k / 2], lo[k / 2], _MM_SHUFFLE(1, 1, 0, 0));
+					const __m128 whi = (k & 1) ? _mm_shuffle_ps(hi[k / 2], hi[k / 2], _MM_SHUFFLE(3, 3, 2, 2)) :
+						_mm_shuffle_ps(hi[k / 2], hi[k / 2], _MM_SHUFFLE(1, 1, 0, 0));
+					const float* s = Window(src, 2, p[k], 1);
+					const __m128 acc = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s), wlo), _mm_mul_ps(_mm_loadu_ps(s + 4), whi));
+					r[k] = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+				}
+				_mm_storeu_ps(dst + i * 2, _mm_movelh_ps(r[0], r[1]));
+				_mm_storeu_ps(dst + i * 2 + 4, _mm_movelh_ps(r[2], r[3]));
+				position += step * 4;
+			}
+		}
+		ResampleCubicFrom(src, channels, position - step * i, step, dst, i, frames);
+	}
+
+	// the 16 weights of one position, 4 at a time
+	inline __m128 SincWeightsSSE2(const float* c0, __m128 t, unsigned int k)
+	{
+		const __m128 a = _mm_load_ps(c0 + k);
+		const __m128 b = _mm_load_ps(c0 + SincTaps + k);
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	void ResampleSincSSE2(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		if (channels != 1 && channels != 2)
+		{
+			ResampleSincFrom(src, channels, position, step, dst, 0, frames);
+			return;
+		}
+
+		const float* table = GetSincTable().coef_;
+		for (unsigned int i = 0; i < frames; i++, position += step)
+		{
+			float tf;
+			const float* c0 = SincRow(table, position, tf);
+			const __m128 t = _mm_set1_ps(tf);
+			const float* s = Window(src, channels, position, ResampleHistoryFrames);
+
+			__m128 acc = _mm_setzero_ps();
+			if (channels == 1)
+			{
+				for (unsigned int k = 0; k < SincTaps; k += 4)
+				{
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + k), SincWeightsSSE2(c0, t, k)));
+				}
+				acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+				acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+				_mm_store_ss(dst + i, acc);
+			}
+			else
+			{
+				// weights doubled up to match the interleaved frames
+				for (unsigned int k = 0; k < SincTaps; k += 4)
+				{
+					const __m128 w = SincWeightsSSE2(c0, t, k);
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + k * 2), _mm_unpacklo_ps(w, w)));
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + k * 2 + 4), _mm_unpackhi_ps(w, w)));
+				}
+				acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+				_mm_storel_pi(reinterpret_cast<__m64*>(dst + i * 2), acc);
+			}
+		}
+	}
+
+	void ComplexMultiplyAccumulateSSE2(const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+		float* accRe, float* accIm, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 ar = _mm_loadu_ps(aRe + i);
+			const __m128 ai = _mm_loadu_ps(aIm + i);
+			const __m128 br = _mm_loadu_ps(bRe + i);
+			const __m128 bi = _mm_loadu_ps(bIm + i);
+			const __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+			const __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+			_mm_storeu_ps(accRe + i, _mm_add_ps(_mm_loadu_ps(accRe + i), re));
+			_mm_storeu_ps(accIm + i, _mm_add_ps(_mm_loadu_ps(accIm + i), im));
+		}
+		ComplexMultiplyAccumulateScalar(aRe + i, aIm + i, bRe + i, bIm + i, accRe + i, accIm + i, count - i);
+	}
+
+	void ConvolveDirectSSE2(const float* src, const float* taps, unsigned int tapCount, float* dst, unsigned int frames)
+	{
+		// 16 outputs stay in registers over all the taps, only the input is loaded per tap
+		unsigned int i = 0;
+		for (; i + 16 <= frames; i += 16)
+		{
+			__m128 a0 = _mm_loadu_ps(dst + i);
+			__m128 a1 = _mm_loadu_ps(dst + i + 4);
+			__m128 a2 = _mm_loadu_ps(dst + i + 8);
+			__m128 a3 = _mm_loadu_ps(dst + i + 12);
+			const float* s = src + i;
+			for (unsigned int t = 0; t < tapCount; t++, s--)
+			{
+				const __m128 h = _mm_set1_ps(taps[t]);
+				a0 = _mm_add_ps(a0, _mm_mul_ps(h, _mm_loadu_ps(s)));
+				a1 = _mm_add_ps(a1, _mm_mul_ps(h, _mm_loadu_ps(s + 4)));
+				a2 = _mm_add_ps(a2, _mm_mul_ps(h, _mm_loadu_ps(s + 8)));
+				a3 = _mm_add_ps(a3, _mm_mul_ps(h, _mm_loadu_ps(s + 12)));
+			}
+			_mm_storeu_ps(dst + i, a0);
+			_mm_storeu_ps(dst + i + 4, a1);
+			_mm_storeu_ps(dst + i + 8, a2);
+			_mm_storeu_ps(dst + i + 12, a3);
+		}
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(dst + i);
+			const float* s = src + i;
+			for (unsigned int t = 0; t < tapCount; t++, s--)
+			{
+				a = _mm_add_ps(a, _mm_mul_ps(_mm_set1_ps(taps[t]), _mm_loadu_ps(s)));
+			}
+			_mm_storeu_ps(dst + i, a);
+		}
+		ConvolveDirectScalar(src + i, taps, tapCount, dst + i, frames - i);
+	}
+
+	const MixerKernels SSE2Kernels =
+	{
+		SimdLevel::SSE2,
+		Pcm16ToFloatSSE2,
+		Pcm24ToFloatSSE2,
+		AccumulateRampSSE2,
+		MixMatrixSSE2,
+		FloatToPcm16SSE2,
+		ResampleLinearSSE2,
+		ResampleCubicSSE2,
+		ResampleSincSSE2,
+		ComplexMultiplyAccumulateSSE2,
+		ConvolveDirectSSE2,
+	};
+
+	// avx2 + fma ----------------------------------------------------------------
+
+	MIXER_TARGET_AVX2 void Pcm16ToFloatAVX2(const int16_t* src, float* dst, size_t count)
+	{
+		const __m256 scale = _mm256_set1_ps(Pcm16Scale);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+			_mm256_storeu_ps(dst + i, _mm256_mul_ps(f, scale));
+		}
+		Pcm16ToFloatScalar(src + i, dst + i, count - i);
+	}
+
+	MIXER_TARGET_AVX2 void Pcm24ToFloatAVX2(const uint8_t* src, float* dst, size_t count)
+	{
+		// moves 4 packed 3 byte samples into the top of 4 dwords
+		const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+		const __m128 scale = _mm_set1_ps(Pcm24Scale);
+		size_t i = 0;
+		// each load reads 16 bytes of which 12 are used
+		for (; i + 6 <= count; i += 4)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+			__m128i s = _mm_srai_epi32(_mm_shuffle_epi8(v, shuffle), 8);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+		}
+		Pcm24ToFloatScalar(src + i * 3, dst + i, count - i);
+	}
+
+	MIXER_TARGET_AVX2 void AccumulateRampAVX2(const float* src, float* dst, unsigned int frames,
+		unsigned int channels, float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		const float step = (gainEnd - gainBegin) / frames;
+
+		unsigned int f = 0;
+		if (channels == 1 || channels == 2)
+		{
+			const unsigned int perVector = 8 / channels;
+			const __m256 lane = channels == 1 ?
+				_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f) :
+				_mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+			__m256 g = _mm256_fmadd_ps(lane, _mm256_set1_ps(step), _mm256_set1_ps(gainBegin));
+			const __m256 inc = _mm256_set1_ps(step * perVector);
+
+			for (; f + perVector <= frames; f += perVector)
+			{
+				__m256 d = _mm256_loadu_ps(dst + f * channels);
+				__m256 s = _mm256_loadu_ps(src + f * channels);
+				_mm256_storeu_ps(dst + f * channels, _mm256_fmadd_ps(s, g, d));
+				g = _mm256_add_ps(g, inc);
+			}
+		}
+		else if (channels % 8 == 0)
+		{
+			for (; f < frames; f++)
+			{
+				const __m256 g = _mm256_set1_ps(gainBegin + step * f);
+				for (unsigned int c = 0; c < channels; c += 8)
+				{
+					__m256 d = _mm256_loadu_ps(dst + f * channels + c);
+					__m256 s = _mm256_loadu_ps(src + f * channels + c);
+					_mm256_storeu_ps(dst + f * channels + c, _mm256_fmadd_ps(s, g, d));
+				}
+			}
+		}
+		else
+		{
+			AccumulateRampSSE2(src, dst, frames, channels, gainBegin, gainEnd);
+			return;
+		}
+		AccumulateRampFrom(src, dst, f, frames, channels, gainBegin, step);
+	}
+
+	MIXER_TARGET_AVX2 void MixMatrixAVX2(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int frames, const float* matrix, float gainBegin, float gainEnd)
+	{
+		// a masked store of 6 outputs stalls the load of the next frame, 4 and 6 run faster on sse2
+		if (frames == 0 || dstChannels != 8 || !IsMatrixVectorShape(srcChannels, dstChannels))
+		{
+			MixMatrixSSE2(src, srcChannels, dst, dstChannels, frames, matrix, gainBegin, gainEnd);
+			return;
+		}
+		const float step = (gainEnd - gainBegin) / frames;
+
+		// all 8 outputs of a frame in one vector
+		const MatrixColumns m(matrix, srcChannels, dstChannels);
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			const float* s = src + f * srcChannels;
+			float* d = dst + f * dstChannels;
+			__m256 acc = _mm256_mul_ps(_mm256_set1_ps(s[0]), _mm256_load_ps(m.col_[0]));
+			for (unsigned int i = 1; i < srcChannels; i++)
+			{
+				acc = _mm256_fmadd_ps(_mm256_set1_ps(s[i]), _mm256_load_ps(m.col_[i]), acc);
+			}
+			const __m256 g = _mm256_set1_ps(gainBegin + step * f);
+			_mm256_storeu_ps(d, _mm256_fmadd_ps(acc, g, _mm256_loadu_ps(d)));
+		}
+		_mm256_zeroupper();
+	}
+
+	MIXER_TARGET_AVX2 void FloatToPcm16AVX2(const float* src, int16_t* dst, size_t count)
+	{
+		const __m256 lo = _mm256_set1_ps(-1.0f);
+		const __m256 hi = _mm256_set1_ps(1.0f);
+		const __m256 scale = _mm256_set1_ps(32767.0f);
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+			__m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), lo), hi);
+			__m256i p = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(a, scale)),
+				_mm256_cvtps_epi32(_mm256_mul_ps(b, scale)));
+			// packs works per 128 bit lane, put the quarters back in order
+			p = _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), p);
+		}
+		FloatToPcm16SSE2(src + i, dst + i, count - i);
+	}
+
+	MIXER_TARGET_AVX2 void ResampleSincAVX2(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		if (channels != 1 && channels != 2)
+		{
+			ResampleSincFrom(src, channels, position, step, dst, 0, frames);
+			return;
+		}
+
+		const float* table = GetSincTable().coef_;
+		const __m256i dupLo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		const __m256i dupHi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+		for (unsigned int i = 0; i < frames; i++, position += step)
+		{
+			float tf;
+			const float* c0 = SincRow(table, position, tf);
+			const __m256 t = _mm256_set1_ps(tf);
+			const float* s = Window(src, channels, position, ResampleHistoryFrames);
+
+			// the rows are 64 byte apart from a 32 byte aligned table
+			const __m256 a0 = _mm256_load_ps(c0);
+			const __m256 a1 = _mm256_load_ps(c0 + 8);
+			const __m256 w0 = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(c0 + SincTaps), a0), t, a0);
+			const __m256 w1 = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(c0 + SincTaps + 8), a1), t, a1);
+
+			__m256 acc;
+			if (channels == 1)
+			{
+				acc = _mm256_fmadd_ps(_mm256_loadu_ps(s), w0, _mm256_mul_ps(_mm256_loadu_ps(s + 8), w1));
+			}
+			else
+			{
+				acc = _mm256_mul_ps(_mm256_loadu_ps(s), _mm256_permutevar8x32_ps(w0, dupLo));
+				acc = _mm256_fmadd_ps(_mm256_loadu_ps(s + 8), _mm256_permutevar8x32_ps(w0, dupHi), acc);
+				acc = _mm256_fmadd_ps(_mm256_loadu_ps(s + 16), _mm256_permutevar8x32_ps(w1, dupLo), acc);
+				acc = _mm256_fmadd_ps(_mm256_loadu_ps(s + 24), _mm256_permutevar8x32_ps(w1, dupHi), acc);
+			}
+
+			__m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+			sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+			if (channels == 1)
+			{
+				sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+				_mm_store_ss(dst + i, sum);
+			}
+			else
+			{
+				_mm_storel_pi(reinterpret_cast<__m64*>(dst + i * 2), sum);
+			}
+		}
+	}
+
+	MIXER_TARGET_AVX2 void ComplexMultiplyAccumulateAVX2(const float* aRe, const float* aIm, const float* bRe,
+		const float* bIm, float* accRe, float* accIm, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 ar = _mm256_loadu_ps(aRe + i);
+			const __m256 ai = _mm256_loadu_ps(aIm + i);
+			const __m256 br = _mm256_loadu_ps(bRe + i);
+			const __m256 bi = _mm256_loadu_ps(bIm + i);
+			__m256 re = _mm256_fmadd_ps(ar, br, _mm256_loadu_ps(accRe + i));
+			__m256 im = _mm256_fmadd_ps(ar, bi, _mm256_loadu_ps(accIm + i));
+			_mm256_storeu_ps(accRe + i, _mm256_fnmadd_ps(ai, bi, re));
+			_mm256_storeu_ps(accIm + i, _mm256_fmadd_ps(ai, br, im));
+		}
+		// gcc leaves out the vzeroupper before the tail call, the sse code after it would pay for the dirty state
+		_mm256_zeroupper();
+		ComplexMultiplyAccumulateSSE2(aRe + i, aIm + i, bRe + i, bIm + i, accRe + i, accIm + i, count - i);
+	}
+
+	MIXER_TARGET_AVX2 void ConvolveDirectAVX2(const float* src, const float* taps, unsigned int tapCount,
+		float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		for (; i + 32 <= frames; i += 32)
+		{
+			__m256 a0 = _mm256_loadu_ps(dst + i);
+			__m256 a1 = _mm256_loadu_ps(dst + i + 8);
+			__m256 a2 = _mm256_loadu_ps(dst + i + 16);
+			__m256 a3 = _mm256_loadu_ps(dst + i + 24);
+			const float* s = src + i;
+			for (unsigned int t = 0; t < tapCount; t++, s--)
+			{
+				const __m256 h = _mm256_broadcast_ss(taps + t);
+				a0 = _mm256_fmadd_ps(h, _mm256_loadu_ps(s), a0);
+				a1 = _mm256_fmadd_ps(h, _mm256_loadu_ps(s + 8), a1);
+				a2 = _mm256_fmadd_ps(h, _mm256_loadu_ps(s + 16), a2);
+				a3 = _mm256_fmadd_ps(h, _mm256_loadu_ps(s + 24), a3);
+			}
+			_mm256_storeu_ps(dst + i, a0);
+			_mm256_storeu_ps(dst + i + 8, a1);
+			_mm256_storeu_ps(dst + i + 16, a2);
+			_mm256_storeu_ps(dst + i + 24, a3);
+		}
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m256 a = _mm256_loadu_ps(dst + i);
+			const float* s = src + i;
+			for (unsigned int t = 0; t < tapCount; t++, s--)
+			{
+				a = _mm256_fmadd_ps(_mm256_broadcast_ss(taps + t), _mm256_loadu_ps(s), a);
+			}
+			_mm256_storeu_ps(dst + i, a);
+		}
+		_mm256_zeroupper();
+		ConvolveDirectSSE2(src + i, taps, tapCount, dst + i, frames - i);
+	}
+
+	const MixerKernels AVX2Kernels =
+	{
+		SimdLevel::AVX2,
+		Pcm16ToFloatAVX2,
+		Pcm24ToFloatAVX2,
+		AccumulateRampAVX2,
+		MixMatrixAVX2,
+		FloatToPcm16AVX2,
+		ResampleLinearSSE2,
+		ResampleCubicSSE2,
+		ResampleSincAVX2,
+		ComplexMultiplyAccumulateAVX2,
+		ConvolveDirectAVX2,
+	};
+
+	bool CpuHasAVX2(void)
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave || !avx || !fma) { return false; }
+		// the os must save the ymm registers
+		if ((_xgetbv(0) & 0x6) != 0x6) { return false; }
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#endif
+
+#ifdef MIXER_KERNELS_NEON
+	// neon, always present on arm64 -------------------------------------------
+
+	void Pcm16ToFloatNEON(const int16_t* src, float* dst, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			int16x8_t v = vld1q_s16(src + i);
+			vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), Pcm16Scale));
+			vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), Pcm16Scale));
+		}
+		Pcm16ToFloatScalar(src + i, dst + i, count - i);
+	}
+
+	void Pcm24ToFloatNEON(const uint8_t* src, float* dst, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			// byte k of the 8 samples in b.val[k], zipped into the top 3 bytes of each dword
+			const uint8x8x3_t b = vld3_u8(src + i * 3);
+			const uint16x8_t low = vshll_n_u8(b.val[0], 8);
+			const uint16x8_t high = vorrq_u16(vmovl_u8(b.val[1]), vshll_n_u8(b.val[2], 8));
+			const uint16x8x2_t w = vzipq_u16(low, high);
+			const int32x4_t s0 = vshrq_n_s32(vreinterpretq_s32_u16(w.val[0]), 8);
+			const int32x4_t s1 = vshrq_n_s32(vreinterpretq_s32_u16(w.val[1]), 8);
+			vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(s0), Pcm24Scale));
+			vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(s1), Pcm24Scale));
+		}
+		Pcm24ToFloatScalar(src + i * 3, dst + i, count - i);
+	}
+
+	void AccumulateRampNEON(const float* src, float* dst, unsigned int frames, unsigned int channels,
+		float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		const float step = (gainEnd - gainBegin) / frames;
+
+		unsigned int f = 0;
+		if (channels == 1 || channels == 2)
+		{
+			const unsigned int perVector = 4 / channels;
+			const float lanes[2][4] = { { 0.0f, 1.0f, 2.0f, 3.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } };
+			float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gainBegin), vld1q_f32(lanes[channels - 1]), step);
+			const float32x4_t inc = vdupq_n_f32(step * perVector);
+
+			for (; f + perVector <= frames; f += perVector)
+			{
+				float32x4_t d = vld1q_f32(dst + f * channels);
+				float32x4_t s = vld1q_f32(src + f * channels);
+				vst1q_f32(dst + f * channels, vmlaq_f32(d, s, g));
+				g = vaddq_f32(g, inc);
+			}
+		}
+		AccumulateRampFrom(src, dst, f, frames, channels, gainBegin, step);
+	}
+
+	void MixMatrixNEON(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int frames, const float* matrix, float gainBegin, float gainEnd)
+	{
+		if (frames == 0) { return; }
+		const float step = (gainEnd - gainBegin) / frames;
+
+		unsigned int f = 0;
+		if (srcChannels == 1 && dstChannels == 2)
+		{
+			const float m[4] = { matrix[0], matrix[1], matrix[0], matrix[1] };
+			const float32x4_t mv = vld1q_f32(m);
+			const float lanes[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+			float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gainBegin), vld1q_f32(lanes), step);
+			const float32x4_t inc = vdupq_n_f32(step * 2);
+
+			for (; f + 2 <= frames; f += 2)
+			{
+				const float32x2x2_t s = vzip_f32(vld1_f32(src + f), vld1_f32(src + f));
+				const float32x4_t x = vcombine_f32(s.val[0], s.val[1]);
+				vst1q_f32(dst + f * 2, vmlaq_f32(vld1q_f32(dst + f * 2), vmulq_f32(x, mv), g));
+				g = vaddq_f32(g, inc);
+			}
+		}
+		else if (srcChannels == 2 && dstChannels == 2)
+		{
+			// out = x * (m00, m11) + swap(x) * (m01, m10)
+			const float direct[4] = { matrix[0], matrix[3], matrix[0], matrix[3] };
+			const float cross[4] = { matrix[1], matrix[2], matrix[1], matrix[2] };
+			const float32x4_t dv = vld1q_f32(direct);
+			const float32x4_t cv = vld1q_f32(cross);
+			const float lanes[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+			float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gainBegin), vld1q_f32(lanes), step);
+			const float32x4_t inc = vdupq_n_f32(step * 2);
+
+			for (; f + 2 <= frames; f += 2)
+			{
+				const float32x4_t s = vld1q_f32(src + f * 2);
+				const float32x4_t mixed = vmlaq_f32(vmulq_f32(s, dv), vrev64q_f32(s), cv);
+				vst1q_f32(dst + f * 2, vmlaq_f32(vld1q_f32(dst + f * 2), mixed, g));
+				g = vaddq_f32(g, inc);
+			}
+		}
+		else if (IsMatrixVectorShape(srcChannels, dstChannels))
+		{
+			const MatrixColumns m(matrix, srcChannels, dstChannels);
+			for (; f < frames; f++)
+			{
+				const float* s = src + f * srcChannels;
+				float* d = dst + f * dstChannels;
+				float32x4_t lo = vdupq_n_f32(0.0f);
+				float32x4_t hi = vdupq_n_f32(0.0f);
+				for (unsigned int i = 0; i < srcChannels; i++)
+				{
+					lo = vmlaq_n_f32(lo, vld1q_f32(m.col_[i]), s[i]);
+					hi = vmlaq_n_f32(hi, vld1q_f32(m.col_[i] + 4), s[i]);
+				}
+				const float g = gainBegin + step * f;
+				vst1q_f32(d, vmlaq_n_f32(vld1q_f32(d), lo, g));
+				if (dstChannels == 8)
+				{
+					vst1q_f32(d + 4, vmlaq_n_f32(vld1q_f32(d + 4), hi, g));
+				}
+				else if (dstChannels == 6)
+				{
+					vst1_f32(d + 4, vmla_n_f32(vld1_f32(d + 4), vget_low_f32(hi), g));
+				}
+			}
+		}
+		MixMatrixFrom(src, srcChannels, dst, dstChannels, f, frames, matrix, gainBegin, step);
+	}
+
+	void FloatToPcm16NEON(const float* src, int16_t* dst, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+			float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+			int16x4_t ia = vqmovn_s32(vcvtnq_s32_f32(vmulq_n_f32(a, 32767.0f)));
+			int16x4_t ib = vqmovn_s32(vcvtnq_s32_f32(vmulq_n_f32(b, 32767.0f)));
+			vst1q_s16(dst + i, vcombine_s16(ia, ib));
+		}
+		FloatToPcm16Scalar(src + i, dst + i, count - i);
+	}
+
+	// 4 frames per vector for mono, 2 for stereo, other layouts take the scalar loop
+	void ResampleLinearNEON(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		if (channels == 1)
+		{
+			for (; i + 4 <= frames; i += 4)
+			{
+				const uint64_t p[4] = { position, position + step, position + step * 2, position + step * 3 };
+				// (a0 b0 a1 b1), (a2 b2 a3 b3) split into the a and b of each frame
+				const float32x4_t x01 = vcombine_f32(vld1_f32(Window(src, 1, p[0], 0)), vld1_f32(Window(src, 1, p[1], 0)));
+				const float32x4_t x23 = vcombine_f32(vld1_f32(Window(src, 1, p[2], 0)), vld1_f32(Window(src, 1, p[3], 0)));
+				const float32x4x2_t ab = vuzpq_f32(x01, x23);
+				const float frac[4] = { Frac(p[0]), Frac(p[1]), Frac(p[2]), Frac(p[3]) };
+				vst1q_f32(dst + i, vmlaq_f32(ab.val[0], vsubq_f32(ab.val[1], ab.val[0]), vld1q_f32(frac)));
+				position += step * 4;
+			}
+		}
+		else if (channels == 2)
+		{
+			for (; i + 2 <= frames; i += 2)
+			{
+				// (aL aR bL bR) of both frames
+				const float32x4_t x0 = vld1q_f32(Window(src, 2, position, 0));
+				const float32x4_t x1 = vld1q_f32(Window(src, 2, position + step, 0));
+				const float32x2_t r0 = vmla_n_f32(vget_low_f32(x0), vsub_f32(vget_high_f32(x0), vget_low_f32(x0)), Frac(position));
+				const float32x2_t r1 = vmla_n_f32(vget_low_f32(x1), vsub_f32(vget_high_f32(x1), vget_low_f32(x1)),
+					Frac(position + step));
+				vst1q_f32(dst + i * 2, vcombine_f32(r0, r1));
+				position += step * 2;
+			}
+		}
+		ResampleLinearFrom(src, channels, position - step * i, step, dst, i, frames);
+	}
+
+	void ResampleCubicNEON(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		if (channels == 1)
+		{
+			for (; i + 4 <= frames; i += 4)
+			{
+				// w[k] holds tap k of the 4 frames
+				float w[4][4];
+				for (unsigned int n = 0; n < 4; n++)
+				{
+					float wn[4];
+					CubicWeights(Frac(position + step * n), wn);
+					for (unsigned int k = 0; k < 4; k++)
+					{
+						w[k][n] = wn[k];
+					}
+				}
+
+				// one row per output frame, transposed into one row per tap
+				const float32x4x2_t t01 = vtrnq_f32(vld1q_f32(Window(src, 1, position, 1)),
+					vld1q_f32(Window(src, 1, position + step, 1)));
+				const float32x4x2_t t23 = vtrnq_f32(vld1q_f32(Window(src, 1, position + step * 2, 1)),
+					vld1q_f32(Window(src, 1, position + step * 3, 1)));
+				const float32x4_t r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+				const float32x4_t r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+				const float32x4_t r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+				const float32x4_t r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+
+				float32x4_t y = vmulq_f32(r0, vld1q_f32(w[0]));
+				y = vmlaq_f32(y, r1, vld1q_f32(w[1]));
+				y = vmlaq_f32(y, r2, vld1q_f32(w[2]));
+				y = vmlaq_f32(y, r3, vld1q_f32(w[3]));
+				vst1q_f32(dst + i, y);
+				position += step * 4;
+			}
+		}
+		else if (channels == 2)
+		{
+			for (; i < frames; i++, position += step)
+			{
+				float w[4];
+				CubicWeights(Frac(position), w);
+				const float* s = Window(src, 2, position, 1);
+				float32x2_t y = vmul_n_f32(vld1_f32(s), w[0]);
+				y = vmla_n_f32(y, vld1_f32(s + 2), w[1]);
+				y = vmla_n_f32(y, vld1_f32(s + 4), w[2]);
+				y = vmla_n_f32(y, vld1_f32(s + 6), w[3]);
+				vst1_f32(dst + i * 2, y);
+			}
+		}
+		ResampleCubicFrom(src, channels, position - step * i, step, dst, i, frames);
+	}
+
+	void ResampleSincNEON(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames)
+	{
+		if (channels != 1 && channels != 2)
+		{
+			ResampleSincFrom(src, channels, position, step, dst, 0, frames);
+			return;
+		}
+
+		const float* table = GetSincTable().coef_;
+		for (unsigned int i = 0; i < frames; i++, position += step)
+		{
+			float t;
+			const float* c0 = SincRow(table, position, t);
+			const float* s = Window(src, channels, position, ResampleHistoryFrames);
+
+			float32x4_t acc = vdupq_n_f32(0.0f);
+			for (unsigned int k = 0; k < SincTaps; k += 4)
+			{
+				const float32x4_t a = vld1q_f32(c0 + k);
+				const float32x4_t w = vmlaq_n_f32(a, vsubq_f32(vld1q_f32(c0 + SincTaps + k), a), t);
+				if (channels == 1)
+				{
+					acc = vmlaq_f32(acc, vld1q_f32(s + k), w);
+				}
+				else
+				{
+					const float32x4x2_t d = vzipq_f32(w, w);
+					acc = vmlaq_f32(acc, vld1q_f32(s + k * 2), d.val[0]);
+					acc = vmlaq_f32(acc, vld1q_f32(s + k * 2 + 4), d.val[1]);
+				}
+			}
+
+			if (channels == 1)
+			{
+				dst[i] = vaddvq_f32(acc);
+			}
+			else
+			{
+				vst1_f32(dst + i * 2, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+			}
+		}
+	}
+
+	void ComplexMultiplyAccumulateNEON(const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+		float* accRe, float* accIm, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const float32x4_t ar = vld1q_f32(aRe + i);
+			const float32x4_t ai = vld1q_f32(aIm + i);
+			const float32x4_t br = vld1q_f32(bRe + i);
+			const float32x4_t bi = vld1q_f32(bIm + i);
+			vst1q_f32(accRe + i, vmlsq_f32(vmlaq_f32(vld1q_f32(accRe + i), ar, br), ai, bi));
+			vst1q_f32(accIm + i, vmlaq_f32(vmlaq_f32(vld1q_f32(accIm + i), ar, bi), ai, br));
+		}
+		ComplexMultiplyAccumulateScalar(aRe + i, aIm + i, bRe + i, bIm + i, accRe + i, accIm + i, count - i);
+	}
+
+	void ConvolveDirectNEON(const float* src, const float* taps, unsigned int tapCount, float* dst, unsigned int frames)
+	{
+		unsigned int i = 0;
+		for (; i + 16 <= frames; i += 16)
+		{
+			float32x4_t a0 = vld1q_f32(dst + i);
+			float32x4_t a1 = vld1q_f32(dst + i + 4);
+			float32x4_t a2 = vld1q_f32(dst + i + 8);
+			float32x4_t a3 = vld1q_f32(dst + i + 12);
+			const float* s = src + i;
+			for (unsigned int t = 0; t < tapCount; t++, s--)
+			{
+				const float h = taps[t];
+				a0 = vmlaq_n_f32(a0, vld1q_f32(s), h);
+				a1 = vmlaq_n_f32(a1, vld1q_f32(s + 4), h);
+				a2 = vmlaq_n_f32(a2, vld1q_f32(s + 8), h);
+				a3 = vmlaq_n_f32(a3, vld1q_f32(s + 12), h);
+			}
+			vst1q_f32(dst + i, a0);
+			vst1q_f32(dst + i + 4, a1);
+			vst1q_f32(dst + i + 8, a2);
+			vst1q_f32(dst + i + 12, a3);
+		}
+		ConvolveDirectScalar(src + i, taps, tapCount, dst + i, frames - i);
+	}
+
+	const MixerKernels NEONKernels =
+	{
+		SimdLevel::NEON,
+		Pcm16ToFloatNEON,
+		Pcm24ToFloatNEON,
+		AccumulateRampNEON,
+		MixMatrixNEON,
+		FloatToPcm16NEON,
+		ResampleLinearNEON,
+		ResampleCubicNEON,
+		ResampleSincNEON,
+		ComplexMultiplyAccumulateNEON,
+		ConvolveDirectNEON,
+	};
+#endif
+}
+
+SimdLevel DetectSimdLevel(void)
+{
+#if defined(MIXER_KERNELS_X64)
+	return CpuHasAVX2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#elif defined(MIXER_KERNELS_NEON)
+	return SimdLevel::NEON;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+const MixerKernels& GetMixerKernels(void)
+{
+	static const MixerKernels* best = GetMixerKernels(DetectSimdLevel());
+	return *best;
+}
+
+const MixerKernels* GetMixerKernels(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Scalar:
+		return &ScalarKernels;
+#ifdef MIXER_KERNELS_X64
+	case SimdLevel::SSE2:
+		return &SSE2Kernels;
+	case SimdLevel::AVX2:
+		return CpuHasAVX2() ? &AVX2Kernels : nullptr;
+#endif
+#ifdef MIXER_KERNELS_NEON
+	case SimdLevel::NEON:
+		return &NEONKernels;
+#endif
+	default:
+		return nullptr;
+	}
+}
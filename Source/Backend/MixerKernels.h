@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	NEON,
+};
+
+// frames the resample kernels read before and after the frame under the position
+constexpr unsigned int ResampleHistoryFrames = 7;
+constexpr unsigned int ResampleLookaheadFrames = 8;
+
+// inner loops of the software mixer, one table per instruction set
+// buffers are interleaved, gains move linearly from gainBegin (first frame) toward gainEnd
+struct MixerKernels
+{
+	SimdLevel level_;
+
+	// little endian signed PCM to [-1, 1)
+	void (*pcm16ToFloat_)(const int16_t* src, float* dst, size_t count);
+	void (*pcm24ToFloat_)(const uint8_t* src, float* dst, size_t count);
+
+	// dst += src * gain
+	void (*accumulateRamp_)(const float* src, float* dst, unsigned int frames, unsigned int channels,
+		float gainBegin, float gainEnd);
+
+	// dst[d] += sum(src[s] * matrix[d * srcChannels + s]) * gain
+	// vector paths for 1 -> 2, 2 -> 2 and up to 8 channels -> 4, 6 or 8, other layouts run the scalar loop
+	void (*mixMatrix_)(const float* src, unsigned int srcChannels, float* dst, unsigned int dstChannels,
+		unsigned int frames, const float* matrix, float gainBegin, float gainEnd);
+
+	// clamped and rounded to nearest
+	void (*floatToPcm16_)(const float* src, int16_t* dst, size_t count);
+
+	// dst frame i = src interpolated at position + step * i, 32.32 fixed point in frames of src
+	// src must stay readable ResampleHistoryFrames before and ResampleLookaheadFrames after every frame touched
+	// 2 taps
+	void (*resampleLinear_)(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames);
+	// 4 tap Catmull-Rom
+	void (*resampleCubic_)(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames);
+	// 16 tap windowed sinc, polyphase table interpolated between phases
+	void (*resampleSinc_)(const float* src, unsigned int channels, uint64_t position, uint64_t step,
+		float* dst, unsigned int frames);
+
+	// acc += a * b over complex values split in real and imaginary arrays
+	void (*complexMultiplyAccumulate_)(const float* aRe, const float* aIm, const float* bRe, const float* bIm,
+		float* accRe, float* accIm, size_t count);
+	// dst[i] += sum(taps[t] * src[i - t]) on one channel, src must stay readable tapCount - 1 samples before frame 0
+	void (*convolveDirect_)(const float* src, const float* taps, unsigned int tapCount, float* dst, unsigned int frames);
+};
+
+SimdLevel DetectSimdLevel(void);
+
+// the best table this cpu can run
+const MixerKernels& GetMixerKernels(void);
+
+// nullptr when the level is not supported by this cpu or build
+const MixerKernels* GetMixerKernels(SimdLevel level);
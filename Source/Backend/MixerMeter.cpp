@@ -0,0 +1,180 @@
+#include "MixerMeter.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr double Pi = 3.14159265358979323846;
+	constexpr unsigned int BlockMs = 10;
+	constexpr unsigned int ShortTermMs = 3000;
+	// surround channels count 1.5 dB more, the LFE not at all
+	constexpr double SurroundWeight = 1.41;
+}
+
+MixerMeter::MixerMeter(unsigned int channels, unsigned int sampleRate, unsigned int windowMs, bool loudness) :
+	channels_(channels), metered_(std::min(channels, MeterMaxChannels)),
+	blockFrames_(std::max(sampleRate * BlockMs / 1000, 1u)),
+	windowBlocks_(std::max((windowMs + BlockMs / 2) / BlockMs, 1u)), loudness_(loudness)
+{
+	history_.resize(std::max(windowBlocks_, loudness ? ShortTermMs / BlockMs : 0u));
+
+	// the two stages of BS.1770 at 48 kHz, derived again for the rate of the mixer
+	{
+		const double k = std::tan(Pi * 1681.974450955533 / sampleRate);
+		const double q = 0.7071752369554196;
+		const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+		shelf_ = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+			2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+	}
+	{
+		const double k = std::tan(Pi * 38.13547087602444 / sampleRate);
+		const double q = 0.5003270373238773;
+		const double a0 = 1.0 + k / q + k * k;
+		highPass_ = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+	}
+
+	// wave channel order, 5.1 and 7.1 drop the LFE and weight the surrounds
+	for (unsigned int c = 0; c < MeterMaxChannels; c++)
+	{
+		weight_[c] = 1.0;
+	}
+	if (channels == 4)
+	{
+		weight_[2] = weight_[3] = SurroundWeight;
+	}
+	else if (channels == 6 || channels == 8)
+	{
+		weight_[3] = 0.0;
+		for (unsigned int c = 4; c < channels; c++)
+		{
+			weight_[c] = SurroundWeight;
+		}
+	}
+
+	MeterLevels levels = {};
+	levels.channels_ = metered_;
+	levels.shortTermLoudness_ = -std::numeric_limits<float>::infinity();
+	levels_.Write(levels);
+}
+
+void MixerMeter::Process(const float* buffer, unsigned int frames)
+{
+	const unsigned int ch = channels_;
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int n = std::min(frames - done, blockFrames_ - fill_);
+		const float* x = buffer + static_cast<size_t>(done) * ch;
+		for (unsigned int c = 0; c < metered_; c++)
+		{
+			float peak = current_.peak_[c];
+			float sum = 0.0f;
+			for (unsigned int i = 0; i < n; i++)
+			{
+				const float s = x[static_cast<size_t>(i) * ch + c];
+				peak = std::max(peak, std::fabs(s));
+				sum += s * s;
+			}
+			current_.peak_[c] = peak;
+			current_.sum_[c] += sum;
+		}
+		if (loudness_) { Weight(x, n); }
+
+		fill_ += n;
+		done += n;
+		frame_ += n;
+		if (fill_ == blockFrames_)
+		{
+			history_[next_] = current_;
+			next_ = (next_ + 1) % history_.size();
+			finished_ = std::min(finished_ + 1, history_.size());
+			current_ = {};
+			fill_ = 0;
+		}
+	}
+	Publish();
+}
+
+void MixerMeter::Weight(const float* buffer, unsigned int frames)
+{
+	const unsigned int ch = channels_;
+	const Biquad a = shelf_;
+	const Biquad b = highPass_;
+	for (unsigned int c = 0; c < metered_; c++)
+	{
+		if (weight_[c] == 0.0) { continue; }
+
+		double* st = state_[c];
+		double s1 = st[0], s2 = st[1], s3 = st[2], s4 = st[3];
+		double sum = 0.0;
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			const double v = buffer[static_cast<size_t>(i) * ch + c];
+			const double y = a.b0_ * v + s1;
+			s1 = a.b1_ * v - a.a1_ * y + s2;
+			s2 = a.b2_ * v - a.a2_ * y;
+			const double z = b.b0_ * y + s3;
+			s3 = b.b1_ * y - b.a1_ * z + s4;
+			s4 = b.b2_ * y - b.a2_ * z;
+			sum += z * z;
+		}
+		st[0] = s1;
+		st[1] = s2;
+		st[2] = s3;
+		st[3] = s4;
+		current_.loudness_ += sum * weight_[c];
+	}
+}
+
+void MixerMeter::Publish(void)
+{
+	MeterLevels levels = {};
+	levels.channels_ = metered_;
+	levels.frame_ = frame_;
+
+	// the block being filled then the newest finished ones
+	float peak[MeterMaxChannels];
+	double sum[MeterMaxChannels];
+	for (unsigned int c = 0; c < metered_; c++)
+	{
+		peak[c] = current_.peak_[c];
+		sum[c] = current_.sum_[c];
+	}
+	double loudness = current_.loudness_;
+
+	const size_t size = history_.size();
+	const size_t window = std::min<size_t>(windowBlocks_, finished_);
+	const size_t loudnessWindow = loudness_ ? std::min<size_t>(ShortTermMs / BlockMs, finished_) : 0;
+	for (size_t k = 0; k < std::max(window, loudnessWindow); k++)
+	{
+		const Block& b = history_[(next_ + size - 1 - k) % size];
+		if (k < window)
+		{
+			for (unsigned int c = 0; c < metered_; c++)
+			{
+				peak[c] = std::max(peak[c], b.peak_[c]);
+				sum[c] += b.sum_[c];
+			}
+		}
+		if (k < loudnessWindow)
+		{
+			loudness += b.loudness_;
+		}
+	}
+
+	const double frames = static_cast<double>(window) * blockFrames_ + fill_;
+	for (unsigned int c = 0; c < metered_; c++)
+	{
+		levels.peak_[c] = peak[c];
+		levels.rms_[c] = frames > 0.0 ? static_cast<float>(std::sqrt(sum[c] / frames)) : 0.0f;
+	}
+
+	const double loudnessFrames = static_cast<double>(loudnessWindow) * blockFrames_ + fill_;
+	levels.shortTermLoudness_ = loudness_ && loudness > 0.0 && loudnessFrames > 0.0 ?
+		static_cast<float>(-0.691 + 10.0 * std::log10(loudness / loudnessFrames)) :
+		-std::numeric_limits<float>::infinity();
+
+	levels_.Write(levels);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../TripleBuffer.h"
+
+// channels a meter covers, the ones after them are left out
+constexpr unsigned int MeterMaxChannels = 8;
+
+// what a meter publishes every quantum
+struct MeterLevels
+{
+	unsigned int channels_;
+	// linear sample peak and RMS over the window of the meter
+	float peak_[MeterMaxChannels];
+	float rms_[MeterMaxChannels];
+	// ITU-R BS.1770 short-term loudness (3 s, K-weighted) in LUFS
+	// -infinity for silence and when the meter measures no loudness
+	float shortTermLoudness_;
+	// frames metered so far, tells a reader whether the levels moved since it last looked
+	uint64_t frame_;
+};
+
+// levels of one submix, written by the mixer thread rendering it and read from any thread without locks
+class MixerMeter
+{
+public:
+	// windowMs is the span of peak and RMS, to 10 ms, loudness adds K-weighting filters on every channel
+	MixerMeter(unsigned int channels, unsigned int sampleRate, unsigned int windowMs, bool loudness);
+
+	// the latest levels, never waits on the mixer
+	void Read(MeterLevels& levels) const { levels_.Read(levels); }
+
+	// mixer side, interleaved frames of the submix
+	void Process(const float* buffer, unsigned int frames);
+private:
+	// peak, sum of squares and weighted loudness sum of 10 ms
+	struct Block
+	{
+		float peak_[MeterMaxChannels];
+		double sum_[MeterMaxChannels];
+		double loudness_;
+	};
+
+	// one stage of the K-weighting, per channel state
+	struct Biquad
+	{
+		double b0_, b1_, b2_, a1_, a2_;
+	};
+
+	void Weight(const float* buffer, unsigned int frames);
+	void Publish(void);
+
+	unsigned int channels_;
+	unsigned int metered_;
+	unsigned int blockFrames_;
+	unsigned int windowBlocks_;
+	bool loudness_;
+
+	Biquad shelf_;
+	Biquad highPass_;
+	double weight_[MeterMaxChannels];
+	// s1, s2 of both stages per channel
+	double state_[MeterMaxChannels][4] = {};
+
+	Block current_ = {};
+	unsigned int fill_ = 0;
+	// finished blocks, the newest before next_
+	std::vector<Block> history_;
+	size_t next_ = 0;
+	size_t finished_ = 0;
+	uint64_t frame_ = 0;
+
+	TripleBuffer<MeterLevels> levels_;
+};
@@ -0,0 +1,164 @@
+#include "MixerThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+	// yields an idle worker makes before it sleeps, covers the gap between the stages of one quantum
+	constexpr unsigned int IdleSpinCount = 256;
+
+	uint64_t PackRange(uint32_t begin, uint32_t end)
+	{
+		return (static_cast<uint64_t>(end) << 32) | begin;
+	}
+}
+
+MixerThreadPool::MixerThreadPool(unsigned int threadCount) :
+	threadCount_(std::max(threadCount, 1u)), range_(new Range[std::max(threadCount, 1u)])
+{
+	for (unsigned int i = 1; i < threadCount_; i++)
+	{
+		thread_.emplace_back(&MixerThreadPool::Loop, this, i);
+	}
+}
+
+MixerThreadPool::~MixerThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_.store(false, std::memory_order_relaxed);
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+	wake_.notify_all();
+
+	for (auto& t : thread_)
+	{
+		t.join();
+	}
+}
+
+void MixerThreadPool::Run(unsigned int count, const MixerJob& job)
+{
+	if (threadCount_ == 1 || count <= 1)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			job(i, 0);
+		}
+		return;
+	}
+
+	job_.store(&job, std::memory_order_relaxed);
+	remaining_.store(count, std::memory_order_relaxed);
+	for (unsigned int w = 0; w < threadCount_; w++)
+	{
+		const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * w / threadCount_);
+		const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (w + 1) / threadCount_);
+		range_[w].range_.store(PackRange(begin, end), std::memory_order_release);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+	wake_.notify_all();
+
+	Drain(0);
+
+	// the last indices may still run on other workers
+	while (remaining_.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void MixerThreadPool::Loop(unsigned int worker)
+{
+	uint64_t seen = 0;
+	for (;;)
+	{
+		uint64_t generation = generation_.load(std::memory_order_acquire);
+		for (unsigned int spin = 0; generation == seen && spin < IdleSpinCount; spin++)
+		{
+			std::this_thread::yield();
+			generation = generation_.load(std::memory_order_acquire);
+		}
+
+		if (generation == seen)
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [&] { return generation_.load(std::memory_order_relaxed) != seen; });
+			generation = generation_.load(std::memory_order_relaxed);
+		}
+
+		if (!running_.load(std::memory_order_relaxed)) { return; }
+
+		seen = generation;
+		Drain(worker);
+	}
+}
+
+void MixerThreadPool::Drain(unsigned int worker)
+{
+	for (;;)
+	{
+		unsigned int index = 0;
+		if (Pop(worker, index))
+		{
+			(*job_.load(std::memory_order_relaxed))(index, worker);
+			remaining_.fetch_sub(1, std::memory_order_acq_rel);
+			continue;
+		}
+		if (!Steal(worker)) { return; }
+	}
+}
+
+bool MixerThreadPool::Pop(unsigned int worker, unsigned int& index)
+{
+	auto& range = range_[worker].range_;
+	uint64_t r = range.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const uint32_t begin = static_cast<uint32_t>(r);
+		const uint32_t end = static_cast<uint32_t>(r >> 32);
+		if (begin >= end) { return false; }
+
+		if (range.compare_exchange_weak(r, PackRange(begin + 1, end), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			index = begin;
+			return true;
+		}
+	}
+}
+
+bool MixerThreadPool::Steal(unsigned int worker)
+{
+	for (unsigned int i = 1; i < threadCount_; i++)
+	{
+		auto& range = range_[(worker + i) % threadCount_].range_;
+		uint64_t r = range.load(std::memory_order_acquire);
+		for (;;)
+		{
+			const uint32_t begin = static_cast<uint32_t>(r);
+			const uint32_t end = static_cast<uint32_t>(r >> 32);
+			if (begin >= end) { break; }
+
+			// the stolen half runs here and is not offered again, only Run ever stores a range
+			// so a worker still draining an old Run cannot overwrite the ranges of a new one
+			const uint32_t take = (end - begin + 1) / 2;
+			if (!range.compare_exchange_weak(r, PackRange(begin, end - take), std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				continue;
+			}
+
+			steals_.fetch_add(1, std::memory_order_relaxed);
+			const MixerJob& job = *job_.load(std::memory_order_relaxed);
+			for (uint32_t index = end - take; index < end; index++)
+			{
+				job(index, worker);
+			}
+			remaining_.fetch_sub(take, std::memory_order_acq_rel);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// called with the job index and the worker running it
+using MixerJob = std::function<void(unsigned int, unsigned int)>;
+
+// fork / join pool the software mixer spreads the voices of one graph stage over
+// every worker owns a range of job indices, takes them from the front and
+// steals the upper half of another range once its own is empty
+class MixerThreadPool
+{
+public:
+	// threadCount includes the thread calling Run, which works as worker 0
+	explicit MixerThreadPool(unsigned int threadCount);
+	~MixerThreadPool();
+	MixerThreadPool(const MixerThreadPool&) = delete;
+	MixerThreadPool& operator=(const MixerThreadPool&) = delete;
+
+	unsigned int GetThreadCount(void) const { return threadCount_; }
+
+	// runs job for every index below count and returns once all of them are done
+	// one caller at a time
+	void Run(unsigned int count, const MixerJob& job);
+
+	// ranges taken from another worker since the start
+	uint64_t GetStealCount(void) const { return steals_.load(std::memory_order_relaxed); }
+private:
+	// begin in the low 32 bits, end in the high 32 bits, so both move with one CAS
+	struct alignas(64) Range
+	{
+		std::atomic<uint64_t> range_ = 0;
+	};
+
+	void Loop(unsigned int worker);
+	// works until no range has an index left
+	void Drain(unsigned int worker);
+	bool Pop(unsigned int worker, unsigned int& index);
+	bool Steal(unsigned int worker);
+
+	unsigned int threadCount_;
+	std::unique_ptr<Range[]> range_;
+
+	// read after a range was taken, which orders it after the Run that stored the range
+	std::atomic<const MixerJob*> job_ = nullptr;
+	// indices not finished yet
+	std::atomic<unsigned int> remaining_ = 0;
+	std::atomic<uint64_t> steals_ = 0;
+
+	// bumped by Run, idle workers spin on it for a while before they sleep
+	std::atomic<uint64_t> generation_ = 0;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::atomic<bool> running_ = true;
+
+	std::vector<std::thread> thread_;
+};
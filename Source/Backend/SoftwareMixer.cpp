@@ -0,0 +1,996 @@
+#include "SoftwareMixer.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "MixerDevice.h"
+#include "MixerMeter.h"
+#include "../AudioManager.h"
+#include "../Effect/ConvolutionEngine.h"
+#include "../Effect/CreateEffect.h"
+#include "../Effect/MixerEffect.h"
+
+namespace
+{
+	constexpr unsigned int DefaultMixerChannels = 2;
+	constexpr unsigned int DefaultMixerSampleRate = 48000;
+	// chain length edits fit in without reallocating
+	constexpr size_t ReservedEffectCount = 8;
+
+	// a reference owned by a deferred change, dropped with it whether it was applied or not
+	std::shared_ptr<IUnknown> HoldEffect(IUnknown* effect)
+	{
+		if (effect != nullptr) { effect->AddRef(); }
+		return std::shared_ptr<IUnknown>(effect, [](IUnknown* e) { if (e != nullptr) { e->Release(); } });
+	}
+}
+
+template<class Interface>
+MixerVoice<Interface>::MixerVoice(SoftwareMixer& mixer, unsigned int channels) :
+	mixer_(mixer), channels_(channels), filterState_(channels * 2, 0.0f)
+{
+	effect_.reserve(ReservedEffectCount);
+}
+
+template<class Interface>
+MixerVoice<Interface>::~MixerVoice()
+{
+	for (auto& e : effect_)
+	{
+		if (e.pEffect != nullptr) { e.pEffect->Release(); }
+	}
+}
+
+template<class Interface>
+void MixerVoice<Interface>::SetVolume(float volume, unsigned int operationSet)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [this, volume](SoftwareMixer::PendingChange&) { volume_ = volume; });
+		return;
+	}
+	volume_ = volume;
+}
+
+template<class Interface>
+void MixerVoice<Interface>::SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS& filter, unsigned int operationSet)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [this, filter](SoftwareMixer::PendingChange&) { filter_ = filter; });
+		return;
+	}
+	filter_ = filter;
+}
+
+template<class Interface>
+void MixerVoice<Interface>::SetOutputVoices(const std::vector<AudioVoice*>& outputs, unsigned int operationSet)
+{
+	std::vector<MixerSubmixVoice*> out;
+	for (auto& o : outputs)
+	{
+		MixerSubmixVoice* sm = static_cast<MixerSubmixVoice*>(o);
+		if (sm->stage_ < minOutputStage_) { continue; }
+		out.emplace_back(sm);
+	}
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this,
+			[this](SoftwareMixer::PendingChange& c) { output_ = c.outputs_; }, std::move(out));
+		return;
+	}
+	output_ = std::move(out);
+}
+
+template<class Interface>
+void MixerVoice<Interface>::SetEffectChain(const std::vector<XAUDIO2_EFFECT_DESCRIPTOR>* chain)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+
+	// the new chain is referenced first, an effect in both chains stays alive
+	if (chain != nullptr)
+	{
+		for (auto& e : *chain)
+		{
+			if (e.pEffect != nullptr) { e.pEffect->AddRef(); }
+		}
+	}
+	for (auto& e : effect_)
+	{
+		if (e.pEffect != nullptr) { e.pEffect->Release(); }
+	}
+
+	if (chain == nullptr)
+	{
+		effect_.clear();
+		return;
+	}
+	effect_ = *chain;
+}
+
+template<class Interface>
+void MixerVoice<Interface>::InsertEffect(unsigned int index, const XAUDIO2_EFFECT_DESCRIPTOR& effect,
+	unsigned int operationSet)
+{
+	std::shared_ptr<IUnknown> hold = HoldEffect(effect.pEffect);
+	auto apply = [this, index, effect, hold]()
+		{
+			if (effect.pEffect != nullptr) { effect.pEffect->AddRef(); }
+			effect_.insert(effect_.begin() + std::min<size_t>(index, effect_.size()), effect);
+		};
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [apply](SoftwareMixer::PendingChange&) { apply(); });
+		return;
+	}
+	apply();
+}
+
+template<class Interface>
+void MixerVoice<Interface>::RemoveEffect(unsigned int index, unsigned int operationSet)
+{
+	auto apply = [this, index]()
+		{
+			if (index >= effect_.size()) { return; }
+			if (effect_[index].pEffect != nullptr) { effect_[index].pEffect->Release(); }
+			effect_.erase(effect_.begin() + index);
+		};
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [apply](SoftwareMixer::PendingChange&) { apply(); });
+		return;
+	}
+	apply();
+}
+
+template<class Interface>
+void MixerVoice<Interface>::MoveEffect(unsigned int from, unsigned int to, unsigned int operationSet)
+{
+	auto apply = [this, from, to]()
+		{
+			if (from >= effect_.size() || to >= effect_.size()) { return; }
+			if (from < to)
+			{
+				std::rotate(effect_.begin() + from, effect_.begin() + from + 1, effect_.begin() + to + 1);
+			}
+			else
+			{
+				std::rotate(effect_.begin() + to, effect_.begin() + from, effect_.begin() + from + 1);
+			}
+		};
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [apply](SoftwareMixer::PendingChange&) { apply(); });
+		return;
+	}
+	apply();
+}
+
+template<class Interface>
+void MixerVoice<Interface>::EnableEffect(unsigned int index, bool enable, unsigned int operationSet)
+{
+	auto apply = [this, index, enable]()
+		{
+			if (index < effect_.size()) { effect_[index].InitialState = enable; }
+		};
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [apply](SoftwareMixer::PendingChange&) { apply(); });
+		return;
+	}
+	apply();
+}
+
+template<class Interface>
+bool MixerVoice<Interface>::SetEffectParameters(unsigned int effectIndex, const void* param, unsigned int size,
+	unsigned int operationSet)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (effectIndex >= effect_.size() || effect_[effectIndex].pEffect == nullptr) { return false; }
+
+	// every effect in a mixer chain comes from SoftwareMixer::CreateEffect
+	MixerEffect* effect = static_cast<MixerEffect*>(effect_[effectIndex].pEffect);
+	if (param == nullptr || size != effect->GetParameterSize()) { return false; }
+
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		// the effect itself is held, it may leave the chain before the set is committed
+		std::shared_ptr<IUnknown> hold = HoldEffect(effect);
+		std::vector<unsigned char> copy(static_cast<const unsigned char*>(param),
+			static_cast<const unsigned char*>(param) + size);
+		mixer_.Defer(operationSet, this, [effect, hold, copy](SoftwareMixer::PendingChange&)
+			{
+				effect->SetParameters(copy.data());
+			});
+		return true;
+	}
+	return effect->SetParameters(param);
+}
+
+template<class Interface>
+bool MixerVoice<Interface>::GetEffectParameters(unsigned int effectIndex, void* param, unsigned int size)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (effectIndex >= effect_.size() || effect_[effectIndex].pEffect == nullptr) { return false; }
+
+	MixerEffect* effect = static_cast<MixerEffect*>(effect_[effectIndex].pEffect);
+	if (param == nullptr || size != effect->GetParameterSize()) { return false; }
+
+	effect->GetParameters(param);
+	return true;
+}
+
+template class MixerVoice<AudioVoice>;
+template class MixerVoice<AudioSourceVoice>;
+
+MixerSubmixVoice::MixerSubmixVoice(SoftwareMixer& mixer, unsigned int channels, unsigned int stage) :
+	MixerVoice(mixer, channels), stage_(stage), mix_(mixer.GetQuantumFrames() * channels, 0.0f)
+{
+	minOutputStage_ = stage + 1;
+}
+
+void MixerSubmixVoice::DestroyVoice(void)
+{
+	mixer_.ReleaseVoice(this);
+	delete this;
+}
+
+MixerSourceVoice::MixerSourceVoice(SoftwareMixer& mixer, const WAVEFORMATEX& format, float maxFrequencyRatio) :
+	MixerVoice(mixer, format.nChannels), format_(format), maxFrequencyRatio_(maxFrequencyRatio),
+	history_(ResampleHistoryFrames * format.nChannels, 0.0f), render_(mixer.GetQuantumFrames() * format.nChannels, 0.0f)
+{
+}
+
+void MixerSourceVoice::DestroyVoice(void)
+{
+	mixer_.ReleaseVoice(this);
+	delete this;
+}
+
+void MixerSourceVoice::Start(unsigned int operationSet)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [this](SoftwareMixer::PendingChange&) { started_ = true; });
+		return;
+	}
+	started_ = true;
+}
+
+void MixerSourceVoice::Stop(unsigned int operationSet)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [this](SoftwareMixer::PendingChange&) { started_ = false; });
+		return;
+	}
+	started_ = false;
+}
+
+bool MixerSourceVoice::SubmitSourceBuffer(const XAUDIO2_BUFFER& buffer)
+{
+	if (format_.nBlockAlign == 0 || buffer.pAudioData == nullptr) { return false; }
+
+	unsigned int frames = buffer.AudioBytes / format_.nBlockAlign;
+	if (buffer.PlayBegin >= frames) { return false; }
+
+	QueuedBuffer qb;
+	qb.buffer_ = buffer;
+	qb.playEnd_ = buffer.PlayLength == 0 ? frames : std::min(buffer.PlayBegin + buffer.PlayLength, frames);
+	qb.loopBegin_ = buffer.LoopBegin;
+	qb.loopEnd_ = buffer.LoopLength == 0 ? qb.playEnd_ : std::min(buffer.LoopBegin + buffer.LoopLength, qb.playEnd_);
+	qb.loopsLeft_ = qb.loopEnd_ > qb.loopBegin_ ? buffer.LoopCount : 0;
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (queue_.empty())
+	{
+		position_ = static_cast<uint64_t>(buffer.PlayBegin) << 32;
+	}
+	queue_.emplace_back(qb);
+	return true;
+}
+
+void MixerSourceVoice::FlushSourceBuffers(void)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	queue_.clear();
+	position_ = 0;
+	std::fill(history_.begin(), history_.end(), 0.0f);
+}
+
+void MixerSourceVoice::GetState(XAUDIO2_VOICE_STATE& state)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	state.pCurrentBufferContext = queue_.empty() ? nullptr : queue_.front().buffer_.pContext;
+	state.BuffersQueued = static_cast<UINT32>(queue_.size());
+	state.SamplesPlayed = samplesPlayed_ >> 32;
+}
+
+void MixerSourceVoice::SetFrequencyRatio(float ratio, unsigned int operationSet)
+{
+	ratio = std::min(std::max(ratio, XAUDIO2_MIN_FREQ_RATIO), maxFrequencyRatio_);
+
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		mixer_.Defer(operationSet, this, [this, ratio](SoftwareMixer::PendingChange&) { frequencyRatio_ = ratio; });
+		return;
+	}
+	frequencyRatio_ = ratio;
+}
+
+void MixerSourceVoice::SetResampleQuality(ResampleQuality quality)
+{
+	std::lock_guard<std::mutex> lock(mixer_.mutex_);
+	quality_ = quality;
+}
+
+void MixerSourceVoice::DecodeFrames(const MixerKernels& kernels, unsigned int first, unsigned int count, float* out) const
+{
+	const BYTE* p = queue_.front().buffer_.pAudioData + first * format_.nBlockAlign;
+	const size_t samples = static_cast<size_t>(count) * format_.nChannels;
+
+	switch (format_.wBitsPerSample)
+	{
+	case 16:
+		kernels.pcm16ToFloat_(reinterpret_cast<const int16_t*>(p), out, samples);
+		break;
+	case 24:
+		kernels.pcm24ToFloat_(p, out, samples);
+		break;
+	case 32:
+		if (format_.wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+		{
+			std::memcpy(out, p, samples * sizeof(float));
+			break;
+		}
+		// fall through
+	default:
+		for (unsigned int f = 0; f < count; f++)
+		{
+			for (unsigned int c = 0; c < format_.nChannels; c++)
+			{
+				out[f * format_.nChannels + c] = ReadSample(queue_.front(), first + f, c);
+			}
+		}
+		break;
+	}
+}
+
+float MixerSourceVoice::ReadSample(const QueuedBuffer& qb, unsigned int frame, unsigned int channel) const
+{
+	const BYTE* p = qb.buffer_.pAudioData +
+		frame * format_.nBlockAlign + channel * (format_.wBitsPerSample / 8);
+
+	switch (format_.wBitsPerSample)
+	{
+	case 8:
+		return (static_cast<int>(p[0]) - 128) * (1.0f / 128.0f);
+	case 16:
+	{
+		int16_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v * (1.0f / 32768.0f);
+	}
+	case 24:
+	{
+		uint32_t u = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+			(static_cast<uint32_t>(p[2]) << 24);
+		return static_cast<float>(static_cast<int32_t>(u) >> 8) * (1.0f / 8388608.0f);
+	}
+	case 32:
+	{
+		if (format_.wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+		{
+			float v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		int32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v * (1.0f / 2147483648.0f);
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+SoftwareMixer::SoftwareMixer()
+{
+}
+
+SoftwareMixer::~SoftwareMixer()
+{
+	if (device_)
+	{
+		device_->Stop();
+	}
+
+	// voices still alive are owned by nobody now
+	while (!source_.empty())
+	{
+		source_.back()->DestroyVoice();
+	}
+	while (!submix_.empty())
+	{
+		submix_.back()->DestroyVoice();
+	}
+}
+
+bool SoftwareMixer::Initialize(const AudioBackendDesc& desc)
+{
+	channels_ = desc.channels_ == 0 ? DefaultMixerChannels : desc.channels_;
+	sampleRate_ = desc.sampleRate_ == 0 ? DefaultMixerSampleRate : desc.sampleRate_;
+	quantumFrames_ = desc.quantumFrames_ == 0 ? sampleRate_ / 100 : desc.quantumFrames_;
+	quality_ = desc.resampleQuality_ == ResampleQuality::Default ? ResampleQuality::Linear : desc.resampleQuality_;
+
+	kernels_ = &GetMixerKernels();
+
+	const unsigned int threads = desc.mixerThreads_ == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : desc.mixerThreads_;
+	pool_.reset(new MixerThreadPool(threads));
+	worker_.resize(threads);
+	// capture this only, so handing them to the pool does not allocate every quantum
+	renderSourceJob_ = [this](unsigned int index, unsigned int worker)
+		{
+			MixerSourceVoice& src = *active_[index];
+			RenderSource(src, quantumLength_, worker_[worker]);
+			ApplyFilter(src, src.render_.data(), quantumLength_);
+			ApplyEffects(src, src.render_.data(), quantumLength_);
+		};
+	mixSubmixJob_ = [this](unsigned int index, unsigned int worker)
+		{
+			MixSubmix(*submix_[stageBegin_ + index], quantumLength_, worker_[worker]);
+		};
+
+	switch (desc.device_)
+	{
+	case MixerDeviceType::Null:
+		device_.reset(new NullMixerDevice(desc.realTime_));
+		break;
+	case MixerDeviceType::Offline:
+		device_.reset(new OfflineMixerDevice());
+		break;
+	default:
+		return false;
+	}
+
+	return device_->Start(*this);
+}
+
+AudioSourceVoice* SoftwareMixer::CreateSourceVoice(const WAVEFORMATEX& format, float maxFrequencyRatio)
+{
+	if (format.nChannels == 0 || format.nSamplesPerSec == 0) { return nullptr; }
+	if (format.wFormatTag != WAVE_FORMAT_PCM && format.wFormatTag != WAVE_FORMAT_IEEE_FLOAT) { return nullptr; }
+
+	switch (format.wBitsPerSample)
+	{
+	case 8:
+	case 16:
+	case 24:
+	case 32:
+		break;
+	default:
+		return nullptr;
+	}
+
+	MixerSourceVoice* voice = new MixerSourceVoice(*this, format, maxFrequencyRatio);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	source_.emplace_back(voice);
+	return voice;
+}
+
+AudioVoice* SoftwareMixer::CreateSubmixVoice(unsigned int channels, unsigned int sampleRate, unsigned int stage)
+{
+	// submixes always run at the mixer rate, 0 asks for it as on XAudio2
+	if (sampleRate != 0 && sampleRate != sampleRate_) { return nullptr; }
+
+	MixerSubmixVoice* voice = new MixerSubmixVoice(*this, channels, stage);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = std::upper_bound(submix_.begin(), submix_.end(), stage,
+		[](unsigned int s, MixerSubmixVoice* v) { return s < v->stage_; });
+	submix_.insert(it, voice);
+	return voice;
+}
+
+void SoftwareMixer::CreateEffect(EffectParams& param, AudioEffectType type, unsigned int channel)
+{
+	param.pEffect_ = CreateMixerEffect(type, channel, sampleRate_);
+	if (type == AudioEffectType::VolumeMeter)
+	{
+		CreateEffect::CreateVolumeMeterLevels(param, channel);
+	}
+}
+
+void SoftwareMixer::CommitChanges(unsigned int operationSet)
+{
+	// Render keeps the lock for whole quanta, so the set lands on one quantum boundary
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = std::stable_partition(pending_.begin(), pending_.end(), [operationSet](const PendingChange& c)
+		{ return operationSet != XAUDIO2_COMMIT_ALL && c.operationSet_ != operationSet; });
+	for (auto c = it; c != pending_.end(); ++c)
+	{
+		c->apply_(*c);
+	}
+	pending_.erase(it, pending_.end());
+}
+
+void SoftwareMixer::Defer(unsigned int operationSet, const void* voice,
+	std::function<void(PendingChange&)> apply, std::vector<MixerSubmixVoice*> outputs)
+{
+	pending_.emplace_back(PendingChange{ operationSet, voice, std::move(outputs), std::move(apply) });
+}
+
+void SoftwareMixer::ReleaseVoice(MixerSourceVoice* voice)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	source_.erase(std::remove(source_.begin(), source_.end(), voice), source_.end());
+
+	pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+		[voice](const PendingChange& c) { return c.voice_ == voice; }), pending_.end());
+}
+
+void SoftwareMixer::ReleaseVoice(MixerSubmixVoice* voice)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	submix_.erase(std::remove(submix_.begin(), submix_.end(), voice), submix_.end());
+
+	pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+		[voice](const PendingChange& c) { return c.voice_ == voice; }), pending_.end());
+
+	if (tapVoice_ == voice)
+	{
+		tapVoice_ = nullptr;
+		tap_ = nullptr;
+	}
+
+	for (auto& c : pending_)
+	{
+		c.outputs_.erase(std::remove(c.outputs_.begin(), c.outputs_.end(), voice), c.outputs_.end());
+	}
+
+	// nothing may keep sending into a destroyed submix
+	for (auto& s : source_)
+	{
+		auto& o = s->output_;
+		o.erase(std::remove(o.begin(), o.end(), voice), o.end());
+	}
+	for (auto& s : submix_)
+	{
+		auto& o = s->output_;
+		o.erase(std::remove(o.begin(), o.end(), voice), o.end());
+	}
+}
+
+void SoftwareMixer::Render(float* output, unsigned int frames)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	renderedFrames_.fetch_add(frames, std::memory_order_relaxed);
+
+	while (frames > 0)
+	{
+		unsigned int n = std::min(frames, quantumFrames_);
+		RenderQuantum(output, n);
+		output += n * channels_;
+		frames -= n;
+	}
+}
+
+void SoftwareMixer::SetTap(AudioVoice* submix, MixerTap tap)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (submix == nullptr || !tap)
+	{
+		tapVoice_ = nullptr;
+		tap_ = nullptr;
+		return;
+	}
+	tapVoice_ = static_cast<MixerSubmixVoice*>(submix);
+	tap_ = std::move(tap);
+}
+
+void SoftwareMixer::SetMeter(AudioVoice* submix, std::shared_ptr<MixerMeter> meter)
+{
+	// a meter replaced is freed after the lock is released, readers may still hold it
+	std::shared_ptr<MixerMeter> old;
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (submix == nullptr) { return; }
+
+	old = std::move(static_cast<MixerSubmixVoice*>(submix)->meter_);
+	static_cast<MixerSubmixVoice*>(submix)->meter_ = std::move(meter);
+}
+
+bool SoftwareMixer::SetConvolutionEngine(AudioVoice* submix, unsigned int effectIndex,
+	std::shared_ptr<ConvolutionEngine> engine, unsigned int operationSet)
+{
+	// declared before the lock, an engine replaced at once is freed after it is released
+	std::shared_ptr<ConvolutionEngine> old;
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	MixerSubmixVoice* voice = static_cast<MixerSubmixVoice*>(submix);
+	if (voice == nullptr || !engine) { return false; }
+	if (effectIndex >= voice->effect_.size() || voice->effect_[effectIndex].pEffect == nullptr) { return false; }
+
+	MixerEffect* effect = static_cast<MixerEffect*>(voice->effect_[effectIndex].pEffect);
+	if (effect->GetType() != AudioEffectType::Convolution || effect->GetChannels() != engine->GetChannels())
+	{
+		return false;
+	}
+	MixerConvolution* convolution = static_cast<MixerConvolution*>(effect);
+
+	if (operationSet != XAUDIO2_COMMIT_NOW)
+	{
+		std::shared_ptr<IUnknown> hold = HoldEffect(effect);
+		Defer(operationSet, voice, [convolution, hold, engine](PendingChange&)
+			{
+				convolution->SetEngine(engine);
+			});
+		return true;
+	}
+	old = convolution->SetEngine(std::move(engine));
+	return true;
+}
+
+void SoftwareMixer::RenderQuantum(float* output, unsigned int frames)
+{
+	BuildGraph();
+	quantumLength_ = frames;
+
+	// a source only writes its own buffer, so all of them render at once
+	pool_->Run(static_cast<unsigned int>(active_.size()), renderSourceJob_);
+
+	for (auto& src : active_)
+	{
+		if (events_ != nullptr)
+		{
+			for (auto& ev : src->event_)
+			{
+				events_->Post(ev.type_, ev.context_);
+			}
+		}
+		src->event_.clear();
+	}
+
+	// a submix only reads sources and lower stages, the submixes of one stage run at once
+	for (size_t begin = 0; begin < submix_.size();)
+	{
+		size_t end = begin + 1;
+		while (end < submix_.size() && submix_[end]->stage_ == submix_[begin]->stage_)
+		{
+			end++;
+		}
+		stageBegin_ = begin;
+		pool_->Run(static_cast<unsigned int>(end - begin), mixSubmixJob_);
+		begin = end;
+	}
+
+	if (tapVoice_ != nullptr)
+	{
+		const unsigned int ch = tapVoice_->channels_;
+		tapBuffer_.assign(frames * ch, 0.0f);
+		kernels_->accumulateRamp_(tapVoice_->mix_.data(), tapBuffer_.data(), frames, ch,
+			tapVoice_->gainBegin_, tapVoice_->gainEnd_);
+		tap_(tapBuffer_.data(), frames, ch);
+	}
+
+	std::fill(output, output + frames * channels_, 0.0f);
+	for (auto& send : masterInput_)
+	{
+		MixChannels(send, output, channels_, frames, worker_[0].matrix_);
+	}
+}
+
+void SoftwareMixer::BuildGraph(void)
+{
+	active_.clear();
+	masterInput_.clear();
+	for (auto& sm : submix_)
+	{
+		sm->input_.clear();
+	}
+
+	for (auto& src : source_)
+	{
+		if (!src->started_ || src->queue_.empty())
+		{
+			src->ramp_ = false;
+			continue;
+		}
+		active_.emplace_back(src);
+		AddSends(*src, src->render_.data());
+	}
+
+	// lower stages feed higher ones, so ascending order is dependency order
+	for (auto& sm : submix_)
+	{
+		AddSends(*sm, sm->mix_.data());
+	}
+}
+
+void SoftwareMixer::MixSubmix(MixerSubmixVoice& sm, unsigned int frames, Worker& worker)
+{
+	std::fill(sm.mix_.begin(), sm.mix_.begin() + frames * sm.channels_, 0.0f);
+	for (auto& send : sm.input_)
+	{
+		MixChannels(send, sm.mix_.data(), sm.channels_, frames, worker.matrix_);
+	}
+	ApplyFilter(sm, sm.mix_.data(), frames);
+	ApplyEffects(sm, sm.mix_.data(), frames);
+	if (sm.meter_)
+	{
+		sm.meter_->Process(sm.mix_.data(), frames);
+	}
+}
+
+void SoftwareMixer::RenderSource(MixerSourceVoice& src, unsigned int frames, Worker& worker)
+{
+	const unsigned int ch = src.channels_;
+	float* out = src.render_.data();
+	std::fill(out, out + frames * ch, 0.0f);
+
+	const uint64_t rate = src.format_.nSamplesPerSec;
+	const uint64_t step = src.frequencyRatio_ == 1.0f ? (rate << 32) / sampleRate_ :
+		static_cast<uint64_t>(static_cast<double>(rate) * src.frequencyRatio_ / sampleRate_ * 4294967296.0);
+
+	// lookahead is how many frames the tier reads after the one under the position
+	auto resample = kernels_->resampleLinear_;
+	unsigned int lookahead = 1;
+	switch (src.quality_ == ResampleQuality::Default ? quality_ : src.quality_)
+	{
+	case ResampleQuality::Cubic:
+		resample = kernels_->resampleCubic_;
+		lookahead = 2;
+		break;
+	case ResampleQuality::Sinc:
+		resample = kernels_->resampleSinc_;
+		lookahead = ResampleLookaheadFrames;
+		break;
+	default:
+		break;
+	}
+	constexpr unsigned int history = ResampleHistoryFrames;
+
+	unsigned int written = 0;
+	while (written < frames && !src.queue_.empty())
+	{
+		auto& qb = src.queue_.front();
+		const bool looping = qb.loopsLeft_ > 0;
+		const unsigned int end = looping ? qb.loopEnd_ : qb.playEnd_;
+
+		const uint64_t endFixed = static_cast<uint64_t>(end) << 32;
+		if (src.position_ < endFixed)
+		{
+			// output frames left before the segment end, and the source frames they touch
+			const uint64_t remain = (endFixed - src.position_ + step - 1) / step;
+			const unsigned int count = static_cast<unsigned int>(std::min<uint64_t>(frames - written, remain));
+			const uint64_t stop = src.position_ + step * count;
+			const unsigned int first = static_cast<unsigned int>(src.position_ >> 32);
+			// the window also covers the frames the next history is taken from
+			const unsigned int last = std::max(static_cast<unsigned int>((stop - step) >> 32) + lookahead,
+				static_cast<unsigned int>(stop >> 32));
+
+			// [history][first .. last], frame first sits at index history
+			const unsigned int span = history + last - first + 1;
+			if (worker.decoded_.size() < span * ch)
+			{
+				worker.decoded_.resize(span * ch);
+			}
+			float* in = worker.decoded_.data();
+			std::copy(src.history_.begin(), src.history_.end(), in);
+			FillWindow(src, first, last - first + 1, end, in + history * ch);
+
+			resample(in, ch, (src.position_ & 0xffffffffull) + (static_cast<uint64_t>(history) << 32), step,
+				out + written * ch, count);
+
+			const unsigned int next = static_cast<unsigned int>(stop >> 32) - first;
+			std::copy(in + next * ch, in + (next + history) * ch, src.history_.begin());
+
+			src.position_ = stop;
+			src.samplesPlayed_ += step * count;
+			written += count;
+		}
+
+		if ((src.position_ >> 32) < end) { continue; }
+
+		if (looping)
+		{
+			src.position_ -= static_cast<uint64_t>(qb.loopEnd_ - qb.loopBegin_) << 32;
+			if (qb.loopsLeft_ != XAUDIO2_LOOP_INFINITE)
+			{
+				qb.loopsLeft_--;
+			}
+			if (events_ != nullptr)
+			{
+				src.event_.emplace_back(VoiceEvent{ VoiceEventType::LoopEnd, qb.buffer_.pContext });
+			}
+		}
+		else
+		{
+			// SamplesPlayed restarts after the end of a stream, as in XAudio2
+			if (qb.buffer_.Flags & XAUDIO2_END_OF_STREAM)
+			{
+				src.samplesPlayed_ = 0;
+			}
+			if (events_ != nullptr)
+			{
+				src.event_.emplace_back(VoiceEvent{ VoiceEventType::BufferEnd, qb.buffer_.pContext });
+			}
+			// the part of a frame already stepped past carries over, streamed blocks join seamlessly
+			const uint64_t over = src.position_ - endFixed;
+			src.queue_.pop_front();
+			if (!src.queue_.empty())
+			{
+				src.position_ = (static_cast<uint64_t>(src.queue_.front().buffer_.PlayBegin) << 32) + over;
+			}
+		}
+	}
+}
+
+void SoftwareMixer::FillWindow(MixerSourceVoice& src, unsigned int first, unsigned int count, unsigned int end, float* out)
+{
+	const auto& qb = src.queue_.front();
+	const unsigned int ch = src.channels_;
+	const unsigned int inside = std::min(count, end - first);
+	src.DecodeFrames(*kernels_, first, inside, out);
+
+	// past the end playback goes on from the loop start or the next buffer, otherwise it is silence
+	for (unsigned int f = inside; f < count; f++)
+	{
+		const unsigned int past = first + f - end;
+		const MixerSourceVoice::QueuedBuffer* from = nullptr;
+		unsigned int frame = 0;
+		if (qb.loopsLeft_ > 0)
+		{
+			from = &qb;
+			frame = qb.loopBegin_ + past % (qb.loopEnd_ - qb.loopBegin_);
+		}
+		else if (src.queue_.size() > 1)
+		{
+			from = &src.queue_[1];
+			frame = from->buffer_.PlayBegin + past;
+			if (frame >= from->playEnd_) { from = nullptr; }
+		}
+
+		for (unsigned int c = 0; c < ch; c++)
+		{
+			out[f * ch + c] = from != nullptr ? src.ReadSample(*from, frame, c) : 0.0f;
+		}
+	}
+}
+
+template<class Interface>
+void SoftwareMixer::ApplyFilter(MixerVoice<Interface>& voice, float* buffer, unsigned int frames)
+{
+	const auto& filter = voice.filter_;
+
+	// the default low pass at max frequency is treated as bypass
+	if (filter.Type == LowPassFilter && filter.Frequency >= XAUDIO2_MAX_FILTER_FREQUENCY) { return; }
+
+	const unsigned int ch = voice.channels_;
+	const float f = filter.Frequency;
+	const float q = filter.OneOverQ;
+
+	for (unsigned int c = 0; c < ch; c++)
+	{
+		float low = voice.filterState_[c * 2];
+		float band = voice.filterState_[c * 2 + 1];
+
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			float& s = buffer[i * ch + c];
+			float high;
+			switch (filter.Type)
+			{
+			case LowPassOnePoleFilter:
+				low += f * (s - low);
+				s = low;
+				break;
+			case HighPassOnePoleFilter:
+				low += f * (s - low);
+				s = s - low;
+				break;
+			default:
+				low += f * band;
+				high = s - low - q * band;
+				band += f * high;
+				switch (filter.Type)
+				{
+				case LowPassFilter: s = low; break;
+				case BandPassFilter: s = band; break;
+				case HighPassFilter: s = high; break;
+				case NotchFilter: s = high + low; break;
+				default: break;
+				}
+				break;
+			}
+		}
+
+		voice.filterState_[c * 2] = low;
+		voice.filterState_[c * 2 + 1] = band;
+	}
+}
+
+template<class Interface>
+void SoftwareMixer::ApplyEffects(MixerVoice<Interface>& voice, float* buffer, unsigned int frames)
+{
+	// after the filter and before the volume, in chain order, as XAudio2 runs a voice
+	for (auto& e : voice.effect_)
+	{
+		// a disabled effect lets the signal through and keeps its state
+		if (!e.InitialState || e.pEffect == nullptr) { continue; }
+
+		MixerEffect* effect = static_cast<MixerEffect*>(e.pEffect);
+		if (effect->GetChannels() != voice.channels_) { continue; }
+		effect->Process(buffer, frames);
+	}
+}
+
+template<class Interface>
+void SoftwareMixer::AddSends(MixerVoice<Interface>& voice, const float* buffer)
+{
+	// ramping over the quantum avoids zipper noise on volume changes
+	voice.gainBegin_ = voice.ramp_ ? voice.lastVolume_ : voice.volume_;
+	voice.gainEnd_ = voice.volume_;
+	voice.lastVolume_ = voice.volume_;
+	voice.ramp_ = true;
+
+	const MixerSend send = { buffer, voice.channels_, voice.gainBegin_, voice.gainEnd_ };
+	if (voice.output_.empty())
+	{
+		masterInput_.emplace_back(send);
+		return;
+	}
+	for (auto& o : voice.output_)
+	{
+		o->input_.emplace_back(send);
+	}
+}
+
+void SoftwareMixer::MixChannels(const MixerSend& send, float* dst, unsigned int dstChannels, unsigned int frames,
+	std::vector<float>& matrix)
+{
+	const unsigned int srcChannels = send.channels_;
+	if (srcChannels == dstChannels)
+	{
+		kernels_->accumulateRamp_(send.buffer_, dst, frames, dstChannels, send.gainBegin_, send.gainEnd_);
+		return;
+	}
+
+	matrix.assign(srcChannels * dstChannels, 0.0f);
+	if (srcChannels == 1)
+	{
+		// mono goes to front left / right
+		for (unsigned int d = 0; d < std::min(dstChannels, 2u); d++)
+		{
+			matrix[d] = 1.0f;
+		}
+	}
+	else if (dstChannels == 1)
+	{
+		std::fill(matrix.begin(), matrix.end(), 1.0f / static_cast<float>(srcChannels));
+	}
+	else
+	{
+		for (unsigned int c = 0; c < std::min(srcChannels, dstChannels); c++)
+		{
+			matrix[c * srcChannels + c] = 1.0f;
+		}
+	}
+
+	kernels_->mixMatrix_(send.buffer_, srcChannels, dst, dstChannels, frames, matrix.data(), send.gainBegin_, send.gainEnd_);
+}
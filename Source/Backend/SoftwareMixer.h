@@ -0,0 +1,271 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AudioBackend.h"
+#include "MixerKernels.h"
+#include "MixerThreadPool.h"
+
+class ConvolutionEngine;
+class MixerDevice;
+class MixerMeter;
+class SoftwareMixer;
+class MixerSubmixVoice;
+
+// one send of the current quantum, mixed in by the voice it goes into
+struct MixerSend
+{
+	const float* buffer_;
+	unsigned int channels_;
+	float gainBegin_;
+	float gainEnd_;
+};
+
+// parts shared by source and submix voices of the software mixer
+template<class Interface>
+class MixerVoice : public Interface
+{
+public:
+	MixerVoice(SoftwareMixer& mixer, unsigned int channels);
+	~MixerVoice();
+
+	void SetVolume(float volume, unsigned int operationSet) override;
+	void SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS& filter, unsigned int operationSet) override;
+	void SetOutputVoices(const std::vector<AudioVoice*>& outputs, unsigned int operationSet) override;
+	void SetEffectChain(const std::vector<XAUDIO2_EFFECT_DESCRIPTOR>* chain) override;
+	void InsertEffect(unsigned int index, const XAUDIO2_EFFECT_DESCRIPTOR& effect, unsigned int operationSet) override;
+	void RemoveEffect(unsigned int index, unsigned int operationSet) override;
+	void MoveEffect(unsigned int from, unsigned int to, unsigned int operationSet) override;
+	void EnableEffect(unsigned int index, bool enable, unsigned int operationSet) override;
+	bool SetEffectParameters(unsigned int effectIndex, const void* param, unsigned int size,
+		unsigned int operationSet) override;
+	bool GetEffectParameters(unsigned int effectIndex, void* param, unsigned int size) override;
+protected:
+	friend class SoftwareMixer;
+
+	SoftwareMixer& mixer_;
+	unsigned int channels_;
+
+	float volume_ = 1.0f;
+	// volume reached at the end of the last quantum, sends ramp from it to volume_
+	float lastVolume_ = 1.0f;
+	// false while the voice was silent, the next quantum starts at volume_ directly
+	bool ramp_ = false;
+	// ramp of the current quantum
+	float gainBegin_ = 1.0f;
+	float gainEnd_ = 1.0f;
+	XAUDIO2_FILTER_PARAMETERS filter_ = { LowPassFilter, XAUDIO2_MAX_FILTER_FREQUENCY, 1.0f };
+
+	// low / band state of the state variable filter, per channel
+	std::vector<float> filterState_;
+
+	std::vector<MixerSubmixVoice*> output_;
+	// outputs below this stage are dropped, a submix only sends to higher stages as on XAudio2
+	unsigned int minOutputStage_ = 0;
+	// InitialState is whether the effect runs, each entry holds a reference
+	std::vector<XAUDIO2_EFFECT_DESCRIPTOR> effect_;
+};
+
+class MixerSubmixVoice : public MixerVoice<AudioVoice>
+{
+public:
+	MixerSubmixVoice(SoftwareMixer& mixer, unsigned int channels, unsigned int stage);
+
+	void DestroyVoice(void) override;
+private:
+	friend class SoftwareMixer;
+	template<class> friend class MixerVoice;
+
+	// the submixes of one stage mix at once, so a send into the same or a lower stage would race
+	unsigned int stage_;
+
+	// interleaved input accumulated during one quantum
+	std::vector<float> mix_;
+	// what is mixed into mix_ this quantum, sources first then lower stages, as the serial order was
+	std::vector<MixerSend> input_;
+	// fed with mix_ after the effects
+	std::shared_ptr<MixerMeter> meter_;
+};
+
+class MixerSourceVoice : public MixerVoice<AudioSourceVoice>
+{
+public:
+	MixerSourceVoice(SoftwareMixer& mixer, const WAVEFORMATEX& format, float maxFrequencyRatio);
+
+	void DestroyVoice(void) override;
+
+	void Start(unsigned int operationSet) override;
+	void Stop(unsigned int operationSet) override;
+	bool SubmitSourceBuffer(const XAUDIO2_BUFFER& buffer) override;
+	void FlushSourceBuffers(void) override;
+	void GetState(XAUDIO2_VOICE_STATE& state) override;
+	void SetFrequencyRatio(float ratio, unsigned int operationSet) override;
+	void SetResampleQuality(ResampleQuality quality) override;
+private:
+	friend class SoftwareMixer;
+
+	struct QueuedBuffer
+	{
+		XAUDIO2_BUFFER buffer_;
+		unsigned int playEnd_;
+		unsigned int loopBegin_;
+		unsigned int loopEnd_;
+		unsigned int loopsLeft_;
+	};
+
+	float ReadSample(const QueuedBuffer& qb, unsigned int frame, unsigned int channel) const;
+	// converts count frames from the front buffer into interleaved floats
+	void DecodeFrames(const MixerKernels& kernels, unsigned int first, unsigned int count, float* out) const;
+
+	WAVEFORMATEX format_;
+	float maxFrequencyRatio_;
+	float frequencyRatio_ = 1.0f;
+	ResampleQuality quality_ = ResampleQuality::Default;
+
+	bool started_ = false;
+	std::deque<QueuedBuffer> queue_;
+
+	// 32.32 fixed point, in source frames
+	uint64_t position_ = 0;
+	uint64_t samplesPlayed_ = 0;
+
+	// the ResampleHistoryFrames source frames played before position_, interleaved
+	std::vector<float> history_;
+
+	// output of the current quantum after the filter, read by the voices it is sent to
+	std::vector<float> render_;
+	// events of the current quantum, posted by the render thread in voice order
+	std::vector<VoiceEvent> event_;
+};
+
+// receives the output of one submix every quantum, on the render thread
+using MixerTap = std::function<void(const float* buffer, unsigned int frames, unsigned int channels)>;
+
+// in-house mixer reproducing the source -> submix -> root graph of XAudio2
+class SoftwareMixer : public AudioBackend
+{
+public:
+	SoftwareMixer();
+	~SoftwareMixer();
+
+	bool Initialize(const AudioBackendDesc& desc) override;
+	AudioBackendType GetType(void) const override { return AudioBackendType::SoftwareMixer; }
+
+	unsigned int GetOutputChannels(void) const override { return channels_; }
+	unsigned int GetOutputSampleRate(void) const override { return sampleRate_; }
+	uint64_t GetRenderedFrames(void) const override { return renderedFrames_.load(std::memory_order_relaxed); }
+
+	AudioSourceVoice* CreateSourceVoice(const WAVEFORMATEX& format, float maxFrequencyRatio) override;
+	// submixes run at the mixer rate, any other sampleRate than 0 or that fails
+	AudioVoice* CreateSubmixVoice(unsigned int channels, unsigned int sampleRate, unsigned int stage) override;
+
+	void CreateEffect(EffectParams& param, AudioEffectType type, unsigned int channel) override;
+
+	void SetEventQueue(VoiceEventQueue* queue) override { events_ = queue; }
+	void CommitChanges(unsigned int operationSet) override;
+
+	// renders interleaved float frames, called from the device
+	void Render(float* output, unsigned int frames);
+
+	// taps the post volume output of a submix, nullptr or an empty tap removes it
+	void SetTap(AudioVoice* submix, MixerTap tap);
+	// meters a submix after its effects and before its volume, nullptr removes the meter
+	void SetMeter(AudioVoice* submix, std::shared_ptr<MixerMeter> meter);
+	// hands a built engine to the Convolution effect at effectIndex of a submix
+	// false when the effect is of another type or has another channel count
+	bool SetConvolutionEngine(AudioVoice* submix, unsigned int effectIndex, std::shared_ptr<ConvolutionEngine> engine,
+		unsigned int operationSet);
+
+	unsigned int GetQuantumFrames(void) const { return quantumFrames_; }
+	MixerDevice& GetDevice(void) { return *device_; }
+private:
+	template<class Interface>
+	friend class MixerVoice;
+	friend class MixerSubmixVoice;
+	friend class MixerSourceVoice;
+
+	// scratch of one thread rendering a quantum
+	struct Worker
+	{
+		// history, then the source frames decoded to float, then the lookahead
+		std::vector<float> decoded_;
+		std::vector<float> matrix_;
+	};
+
+	// a change held back until CommitChanges
+	struct PendingChange
+	{
+		unsigned int operationSet_;
+		const void* voice_;
+		// SetOutputVoices only, kept here so a destroyed submix can be dropped
+		std::vector<MixerSubmixVoice*> outputs_;
+		std::function<void(PendingChange&)> apply_;
+	};
+
+	// mutex_ must be held
+	void Defer(unsigned int operationSet, const void* voice, std::function<void(PendingChange&)> apply,
+		std::vector<MixerSubmixVoice*> outputs = {});
+
+	void ReleaseVoice(MixerSourceVoice* voice);
+	void ReleaseVoice(MixerSubmixVoice* voice);
+
+	void RenderQuantum(float* output, unsigned int frames);
+	// the graph of the quantum: sources playing, the ramps and the send lists
+	void BuildGraph(void);
+	void RenderSource(MixerSourceVoice& src, unsigned int frames, Worker& worker);
+	void MixSubmix(MixerSubmixVoice& sm, unsigned int frames, Worker& worker);
+	// fills count frames of src from frame first of the front buffer on, past the segment end included
+	void FillWindow(MixerSourceVoice& src, unsigned int first, unsigned int count, unsigned int end, float* out);
+
+	template<class Interface>
+	void ApplyFilter(MixerVoice<Interface>& voice, float* buffer, unsigned int frames);
+	template<class Interface>
+	void ApplyEffects(MixerVoice<Interface>& voice, float* buffer, unsigned int frames);
+	// fixes the ramp of the quantum and adds buffer to the inputs of every output
+	template<class Interface>
+	void AddSends(MixerVoice<Interface>& voice, const float* buffer);
+	void MixChannels(const MixerSend& send, float* dst, unsigned int dstChannels, unsigned int frames,
+		std::vector<float>& matrix);
+
+	unsigned int channels_ = 2;
+	unsigned int sampleRate_ = 48000;
+	unsigned int quantumFrames_ = 480;
+	ResampleQuality quality_ = ResampleQuality::Linear;
+	std::atomic<uint64_t> renderedFrames_ = 0;
+
+	std::mutex mutex_;
+
+	std::vector<MixerSourceVoice*> source_;
+
+	// kept sorted by processing stage
+	std::vector<MixerSubmixVoice*> submix_;
+
+	const MixerKernels* kernels_ = nullptr;
+
+	// worker 0 is the thread calling Render, with one thread the pool runs every job inline
+	std::unique_ptr<MixerThreadPool> pool_;
+	std::vector<Worker> worker_;
+	MixerJob renderSourceJob_;
+	MixerJob mixSubmixJob_;
+	// frames of the quantum being rendered and the first submix of the stage being mixed
+	unsigned int quantumLength_ = 0;
+	size_t stageBegin_ = 0;
+
+	// rebuilt every quantum by BuildGraph
+	std::vector<MixerSourceVoice*> active_;
+	std::vector<MixerSend> masterInput_;
+
+	VoiceEventQueue* events_ = nullptr;
+
+	std::vector<PendingChange> pending_;
+
+	MixerSubmixVoice* tapVoice_ = nullptr;
+	MixerTap tap_;
+	std::vector<float> tapBuffer_;
+
+	std::unique_ptr<MixerDevice> device_;
+};
@@ -0,0 +1,291 @@
+#ifdef _WIN32
+#include "XAudio2Backend.h"
+#include <algorithm>
+#include <cassert>
+#include "../Effect/CreateEffect.h"
+
+#pragma comment(lib,"xaudio2.lib")
+#pragma comment(lib,"xapobase.lib")
+
+namespace
+{
+	template<class Interface, class Native>
+	class XAudio2Voice : public Interface
+	{
+	public:
+		explicit XAudio2Voice(Native* voice) : voice_(voice) {}
+
+		void DestroyVoice(void) override
+		{
+			voice_->DestroyVoice();
+			delete this;
+		}
+
+		void SetVolume(float volume, unsigned int operationSet) override
+		{
+			voice_->SetVolume(volume, operationSet);
+		}
+
+		void SetFilterParameters(const XAUDIO2_FILTER_PARAMETERS& filter, unsigned int operationSet) override
+		{
+			voice_->SetFilterParameters(&filter, operationSet);
+		}
+
+		void SetOutputVoices(const std::vector<AudioVoice*>& outputs, unsigned int operationSet) override;
+
+		void SetEffectChain(const std::vector<XAUDIO2_EFFECT_DESCRIPTOR>* chain) override
+		{
+			if (chain == nullptr)
+			{
+				chain_.clear();
+				voice_->SetEffectChain(nullptr);
+				return;
+			}
+			chain_ = *chain;
+			ApplyChain();
+		}
+
+		// IXAudio2Voice::SetEffectChain has no operation set and no partial form,
+		// the chain is passed again in one call and XAudio2 keeps its references to the effects in both
+		void InsertEffect(unsigned int index, const XAUDIO2_EFFECT_DESCRIPTOR& effect, unsigned int operationSet) override
+		{
+			chain_.insert(chain_.begin() + std::min<size_t>(index, chain_.size()), effect);
+			ApplyChain();
+		}
+
+		void RemoveEffect(unsigned int index, unsigned int operationSet) override
+		{
+			if (index >= chain_.size()) { return; }
+			chain_.erase(chain_.begin() + index);
+			ApplyChain();
+		}
+
+		void MoveEffect(unsigned int from, unsigned int to, unsigned int operationSet) override
+		{
+			if (from >= chain_.size() || to >= chain_.size() || from == to) { return; }
+			XAUDIO2_EFFECT_DESCRIPTOR effect = chain_[from];
+			chain_.erase(chain_.begin() + from);
+			chain_.insert(chain_.begin() + to, effect);
+			ApplyChain();
+		}
+
+		void EnableEffect(unsigned int index, bool enable, unsigned int operationSet) override
+		{
+			if (index >= chain_.size()) { return; }
+			chain_[index].InitialState = enable;
+			if (enable)
+			{
+				voice_->EnableEffect(index, operationSet);
+			}
+			else
+			{
+				voice_->DisableEffect(index, operationSet);
+			}
+		}
+
+		bool SetEffectParameters(unsigned int effectIndex, const void* param, unsigned int size,
+			unsigned int operationSet) override
+		{
+			return SUCCEEDED(voice_->SetEffectParameters(effectIndex, param, size, operationSet));
+		}
+
+		bool GetEffectParameters(unsigned int effectIndex, void* param, unsigned int size) override
+		{
+			return SUCCEEDED(voice_->GetEffectParameters(effectIndex, param, size));
+		}
+
+		Native* voice_;
+	private:
+		void ApplyChain(void)
+		{
+			if (chain_.empty())
+			{
+				voice_->SetEffectChain(nullptr);
+				return;
+			}
+			XAUDIO2_EFFECT_CHAIN ch = { static_cast<UINT32>(chain_.size()), chain_.data() };
+			voice_->SetEffectChain(&ch);
+		}
+
+		std::vector<XAUDIO2_SEND_DESCRIPTOR> send_;
+		// what was last given to XAudio2, with the enabled state of each effect
+		std::vector<XAUDIO2_EFFECT_DESCRIPTOR> chain_;
+	};
+
+	using XAudio2SubmixVoice = XAudio2Voice<AudioVoice, IXAudio2SubmixVoice>;
+
+	template<class Interface, class Native>
+	void XAudio2Voice<Interface, Native>::SetOutputVoices(const std::vector<AudioVoice*>& outputs,
+		unsigned int operationSet)
+	{
+		// IXAudio2Voice::SetOutputVoices has no operation set
+		if (outputs.empty())
+		{
+			send_.clear();
+			voice_->SetOutputVoices(nullptr);
+			return;
+		}
+
+		send_.clear();
+		for (auto& o : outputs)
+		{
+			send_.emplace_back(XAUDIO2_SEND_DESCRIPTOR{ 0, static_cast<XAudio2SubmixVoice*>(o)->voice_ });
+		}
+		XAUDIO2_VOICE_SENDS snd = { static_cast<UINT32>(send_.size()), send_.data() };
+		voice_->SetOutputVoices(&snd);
+	}
+
+	// forwards engine callbacks into the event queue of AudioManager
+	class XAudio2EventCallback : public IXAudio2VoiceCallback
+	{
+	public:
+		void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32) override {}
+		void STDMETHODCALLTYPE OnVoiceProcessingPassEnd(void) override {}
+		void STDMETHODCALLTYPE OnStreamEnd(void) override {}
+		void STDMETHODCALLTYPE OnBufferStart(void*) override {}
+
+		void STDMETHODCALLTYPE OnBufferEnd(void* context) override
+		{
+			if (events_ != nullptr) { events_->Post(VoiceEventType::BufferEnd, context); }
+		}
+
+		void STDMETHODCALLTYPE OnLoopEnd(void* context) override
+		{
+			if (events_ != nullptr) { events_->Post(VoiceEventType::LoopEnd, context); }
+		}
+
+		void STDMETHODCALLTYPE OnVoiceError(void*, HRESULT) override {}
+
+		VoiceEventQueue* events_ = nullptr;
+	};
+
+	XAudio2EventCallback eventCallback;
+
+	class XAudio2SourceVoice : public XAudio2Voice<AudioSourceVoice, IXAudio2SourceVoice>
+	{
+	public:
+		explicit XAudio2SourceVoice(IXAudio2SourceVoice* voice) : XAudio2Voice(voice) {}
+
+		void Start(unsigned int operationSet) override
+		{
+			voice_->Start(0, operationSet);
+		}
+
+		void Stop(unsigned int operationSet) override
+		{
+			voice_->Stop(0, operationSet);
+		}
+
+		bool SubmitSourceBuffer(const XAUDIO2_BUFFER& buffer) override
+		{
+			return SUCCEEDED(voice_->SubmitSourceBuffer(&buffer));
+		}
+
+		void FlushSourceBuffers(void) override
+		{
+			voice_->FlushSourceBuffers();
+		}
+
+		void GetState(XAUDIO2_VOICE_STATE& state) override
+		{
+			voice_->GetState(&state, 0);
+		}
+
+		void SetFrequencyRatio(float ratio, unsigned int operationSet) override
+		{
+			voice_->SetFrequencyRatio(ratio, operationSet);
+		}
+
+		// XAudio2 has a single built in resampler
+		void SetResampleQuality(ResampleQuality quality) override {}
+	};
+}
+
+XAudio2Backend::XAudio2Backend() :xaudioCore_(nullptr), masterVoice_(nullptr)
+{
+}
+
+XAudio2Backend::~XAudio2Backend()
+{
+	if (masterVoice_)
+	{
+		masterVoice_->DestroyVoice();
+		masterVoice_ = nullptr;
+	}
+
+	if (xaudioCore_)
+	{
+		xaudioCore_->UnregisterForCallbacks(&clock_);
+		xaudioCore_->Release();
+	}
+}
+
+bool XAudio2Backend::Initialize(const AudioBackendDesc& desc)
+{
+	HRESULT result;
+
+	// IXAudio2IuWFNg̍쐬
+	result = XAudio2Create(&xaudioCore_);
+	assert(SUCCEEDED(result));
+	if (FAILED(result)) { return false; }
+
+	// fobO̐ݒ
+#ifdef _DEBUG
+	XAUDIO2_DEBUG_CONFIGURATION debugc = {};
+	debugc.TraceMask = XAUDIO2_LOG_WARNINGS;
+	debugc.BreakMask = XAUDIO2_LOG_ERRORS;
+	xaudioCore_->SetDebugConfiguration(&debugc);
+#endif
+
+	// }X^O{CX̍쐬
+	result = xaudioCore_->CreateMasteringVoice(&masterVoice_, desc.channels_,
+		desc.sampleRate_, 0, 0, nullptr);
+	assert(SUCCEEDED(result));
+	if (FAILED(result)) { return false; }
+
+	masterVoice_->GetVoiceDetails(&masterVoiceDetails_);
+
+	// the default quantum is 10ms
+	clock_.framesPerPass_ = masterVoiceDetails_.InputSampleRate / 100;
+	xaudioCore_->RegisterForCallbacks(&clock_);
+
+	return true;
+}
+
+AudioSourceVoice* XAudio2Backend::CreateSourceVoice(const WAVEFORMATEX& format, float maxFrequencyRatio)
+{
+	IXAudio2SourceVoice* voice = nullptr;
+
+	HRESULT result = xaudioCore_->CreateSourceVoice(&voice, &format,
+		XAUDIO2_VOICE_USEFILTER, maxFrequencyRatio, &eventCallback);
+	if (FAILED(result)) { return nullptr; }
+
+	return new XAudio2SourceVoice(voice);
+}
+
+AudioVoice* XAudio2Backend::CreateSubmixVoice(unsigned int channels, unsigned int sampleRate, unsigned int stage)
+{
+	IXAudio2SubmixVoice* voice = nullptr;
+
+	HRESULT result = xaudioCore_->CreateSubmixVoice(&voice, channels,
+		sampleRate, XAUDIO2_VOICE_USEFILTER, stage, nullptr, nullptr);
+	if (FAILED(result)) { return nullptr; }
+
+	return new XAudio2SubmixVoice(voice);
+}
+
+void XAudio2Backend::CreateEffect(EffectParams& param, AudioEffectType type, unsigned int channel)
+{
+	CreateEffect::GenerateEffectInstance(param, type, channel);
+}
+
+void XAudio2Backend::SetEventQueue(VoiceEventQueue* queue)
+{
+	eventCallback.events_ = queue;
+}
+
+void XAudio2Backend::CommitChanges(unsigned int operationSet)
+{
+	xaudioCore_->CommitChanges(operationSet);
+}
+#endif
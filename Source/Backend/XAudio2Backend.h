@@ -0,0 +1,46 @@
+#pragma once
+#ifdef _WIN32
+#include "AudioBackend.h"
+
+class XAudio2Backend : public AudioBackend
+{
+public:
+	XAudio2Backend();
+	~XAudio2Backend();
+
+	bool Initialize(const AudioBackendDesc& desc) override;
+	AudioBackendType GetType(void) const override { return AudioBackendType::XAudio2; }
+
+	unsigned int GetOutputChannels(void) const override { return masterVoiceDetails_.InputChannels; }
+	unsigned int GetOutputSampleRate(void) const override { return masterVoiceDetails_.InputSampleRate; }
+	uint64_t GetRenderedFrames(void) const override { return clock_.frames_.load(std::memory_order_relaxed); }
+
+	AudioSourceVoice* CreateSourceVoice(const WAVEFORMATEX& format, float maxFrequencyRatio) override;
+	AudioVoice* CreateSubmixVoice(unsigned int channels, unsigned int sampleRate, unsigned int stage) override;
+
+	void CreateEffect(EffectParams& param, AudioEffectType type, unsigned int channel) override;
+
+	void SetEventQueue(VoiceEventQueue* queue) override;
+	void CommitChanges(unsigned int operationSet) override;
+private:
+	// XAudio2 reports no frame total, every processing pass is one quantum
+	class EngineClock : public IXAudio2EngineCallback
+	{
+	public:
+		void STDMETHODCALLTYPE OnProcessingPassStart(void) override {}
+		void STDMETHODCALLTYPE OnProcessingPassEnd(void) override
+		{
+			frames_.fetch_add(framesPerPass_, std::memory_order_relaxed);
+		}
+		void STDMETHODCALLTYPE OnCriticalError(HRESULT) override {}
+
+		std::atomic<uint64_t> frames_ = 0;
+		unsigned int framesPerPass_ = 0;
+	};
+
+	IXAudio2* xaudioCore_;
+	IXAudio2MasteringVoice* masterVoice_;
+	XAUDIO2_VOICE_DETAILS masterVoiceDetails_ = {};
+	EngineClock clock_;
+};
+#endif
@@ -0,0 +1,220 @@
+#include "ConvolutionEngine.h"
+#include <algorithm>
+#include <cmath>
+#include "../Backend/MixerKernels.h"
+
+namespace
+{
+	constexpr unsigned int MinPartitionFrames = 64;
+	constexpr unsigned int MaxPartitionFrames = 1024;
+
+	// per frame the direct partition costs one multiply-add per tap and the spectra one complex multiply-add
+	// per partition, the sum is lowest around twice the square root of the length
+	unsigned int ChoosePartitionFrames(size_t irFrames)
+	{
+		unsigned int frames = MinPartitionFrames;
+		while (frames < MaxPartitionFrames && static_cast<double>(frames) * frames < irFrames * 4.0)
+		{
+			frames <<= 1;
+		}
+		return frames;
+	}
+}
+
+ConvolutionEngine::ConvolutionEngine(const float* ir, size_t irFrames, unsigned int irChannels, unsigned int channels,
+	bool background, unsigned int partitionFrames) :
+	kernels_(GetMixerKernels()), channels_(channels), irChannels_(irChannels),
+	partition_(partitionFrames != 0 ? partitionFrames : ChoosePartitionFrames(irFrames)),
+	spectrumCount_(irFrames > partition_ ? (irFrames - 1) / partition_ : 0),
+	stride_((partition_ + 1 + 7) & ~static_cast<size_t>(7)), fft_(partition_ * 2),
+	head_(static_cast<size_t>(irChannels) * partition_, 0.0f),
+	spectra_(irChannels * spectrumCount_ * stride_ * 2, 0.0f),
+	channel_(channels), in_(partition_), out_(partition_)
+{
+	const unsigned int n = partition_;
+	std::vector<float> block(n * 2, 0.0f);
+	const float scale = 1.0f / (n * 2);
+	for (unsigned int r = 0; r < irChannels; r++)
+	{
+		for (size_t i = 0; i < std::min<size_t>(n, irFrames); i++)
+		{
+			head_[r * n + i] = ir[i * irChannels + r];
+		}
+
+		// zero padded to twice the length, the second half of a circular result is then the linear one
+		for (size_t p = 0; p < spectrumCount_; p++)
+		{
+			const size_t first = (p + 1) * n;
+			const size_t count = std::min<size_t>(n, irFrames - first);
+			std::fill(block.begin(), block.end(), 0.0f);
+			for (size_t i = 0; i < count; i++)
+			{
+				block[i] = ir[(first + i) * irChannels + r] * scale;
+			}
+			float* s = Spectrum(r, p);
+			fft_.Forward(block.data(), s, s + stride_);
+		}
+	}
+
+	for (auto& ch : channel_)
+	{
+		ch.input_.assign(n * 2, 0.0f);
+		ch.tail_.assign(n, 0.0f);
+		ch.history_.assign(spectrumCount_ * stride_ * 2, 0.0f);
+		ch.next_.assign(stride_ * 2, 0.0f);
+		ch.acc_.assign(stride_ * 2, 0.0f);
+		ch.time_.assign(n * 2, 0.0f);
+	}
+
+	// with one spectrum there is nothing to hand over
+	if (background && spectrumCount_ > 1)
+	{
+		thread_ = std::thread(&ConvolutionEngine::TailThread, this);
+	}
+}
+
+ConvolutionEngine::~ConvolutionEngine()
+{
+	if (thread_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+}
+
+void ConvolutionEngine::Process(const float* in, float* out, unsigned int frames)
+{
+	const unsigned int n = partition_;
+	const unsigned int chCount = channels_;
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int count = std::min(frames - done, n - position_);
+		const float* src = in + static_cast<size_t>(done) * chCount;
+		float* dst = out + static_cast<size_t>(done) * chCount;
+
+		for (unsigned int c = 0; c < chCount; c++)
+		{
+			Channel& ch = channel_[c];
+			float* x = &ch.input_[n + position_];
+			for (unsigned int i = 0; i < count; i++)
+			{
+				x[i] = src[i * chCount + c];
+			}
+
+			// the tail was known at the end of the last block, the first partition only needs the input so far
+			float* y = out_.data();
+			std::copy(&ch.tail_[position_], &ch.tail_[position_] + count, y);
+			kernels_.convolveDirect_(x, &head_[(c % irChannels_) * n], n, y, count);
+
+			for (unsigned int i = 0; i < count; i++)
+			{
+				dst[i * chCount + c] = y[i];
+			}
+		}
+
+		position_ += count;
+		done += count;
+		if (position_ == n)
+		{
+			EndBlock();
+			position_ = 0;
+		}
+	}
+}
+
+void ConvolutionEngine::EndBlock(void)
+{
+	const unsigned int n = partition_;
+	const size_t bins = n + 1;
+
+	if (spectrumCount_ > 0)
+	{
+		for (auto& ch : channel_)
+		{
+			float* x = History(ch, block_);
+			fft_.Forward(ch.input_.data(), x, x + stride_);
+		}
+	}
+
+	if (thread_.joinable())
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_.wait(lock, [this] { return finished_ == posted_; });
+	}
+
+	for (unsigned int c = 0; c < channels_; c++)
+	{
+		Channel& ch = channel_[c];
+		if (spectrumCount_ > 0)
+		{
+			// the second partition meets the block just finished, the rest was summed one block earlier
+			float* acc = ch.acc_.data();
+			std::copy(ch.next_.begin(), ch.next_.end(), acc);
+			const float* h = Spectrum(c % irChannels_, 0);
+			const float* x = History(ch, block_);
+			kernels_.complexMultiplyAccumulate_(h, h + stride_, x, x + stride_, acc, acc + stride_, bins);
+
+			fft_.Inverse(acc, acc + stride_, ch.time_.data());
+			std::copy(ch.time_.begin() + n, ch.time_.end(), ch.tail_.begin());
+		}
+		std::copy(ch.input_.begin() + n, ch.input_.end(), ch.input_.begin());
+	}
+	block_++;
+
+	if (spectrumCount_ > 1)
+	{
+		if (thread_.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				posted_++;
+			}
+			wake_.notify_one();
+		}
+		else
+		{
+			ComputeTail();
+		}
+	}
+}
+
+void ConvolutionEngine::ComputeTail(void)
+{
+	// for the block after next partition p meets block block_ + 1 - p, the last one finished is block_ - 1
+	const size_t bins = partition_ + 1;
+	const uint64_t last = block_ - 1;
+	for (unsigned int c = 0; c < channels_; c++)
+	{
+		Channel& ch = channel_[c];
+		float* acc = ch.next_.data();
+		std::fill(ch.next_.begin(), ch.next_.end(), 0.0f);
+		for (size_t p = 1; p < spectrumCount_ && p <= last + 1; p++)
+		{
+			const float* h = Spectrum(c % irChannels_, p);
+			const float* x = History(ch, last + 1 - p);
+			kernels_.complexMultiplyAccumulate_(h, h + stride_, x, x + stride_, acc, acc + stride_, bins);
+		}
+	}
+}
+
+void ConvolutionEngine::TailThread(void)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;)
+	{
+		wake_.wait(lock, [this] { return stop_ || finished_ != posted_; });
+		if (stop_) { return; }
+
+		// the render thread only writes the slot of the oldest block meanwhile, which is read by nobody
+		lock.unlock();
+		ComputeTail();
+		lock.lock();
+
+		finished_ = posted_;
+		done_.notify_one();
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RealFFT.h"
+
+struct MixerKernels;
+
+// zero latency convolution with a long impulse response, uniformly partitioned overlap-save
+// the first partition runs as a direct FIR, the later ones as spectra against a frequency domain delay line
+// everything is allocated and the impulse response transformed in the constructor, so it is built outside the mixer lock
+class ConvolutionEngine
+{
+public:
+	// ir is interleaved at the rate of the mixer, output channel c uses ir channel c % irChannels
+	// partitionFrames is a power of two, 0 picks one from the length
+	// background moves the partitions from the third on to a thread of the engine, which then has a whole block
+	// to finish them, the render thread only waits when it is late
+	ConvolutionEngine(const float* ir, size_t irFrames, unsigned int irChannels, unsigned int channels,
+		bool background, unsigned int partitionFrames = 0);
+	~ConvolutionEngine();
+	ConvolutionEngine(const ConvolutionEngine&) = delete;
+	ConvolutionEngine& operator=(const ConvolutionEngine&) = delete;
+
+	unsigned int GetChannels(void) const { return channels_; }
+	unsigned int GetPartitionFrames(void) const { return partition_; }
+	// partitions after the direct one
+	size_t GetSpectrumCount(void) const { return spectrumCount_; }
+
+	// the convolved signal alone, interleaved, in and out must not overlap
+	void Process(const float* in, float* out, unsigned int frames);
+private:
+	struct Channel
+	{
+		// the previous block then the one being filled
+		std::vector<float> input_;
+		// what the later partitions add to the block being filled
+		std::vector<float> tail_;
+		// spectra of the last blocks, block b in slot b % spectrumCount_
+		std::vector<float> history_;
+		// partitions from the second on summed for the block after next
+		std::vector<float> next_;
+		std::vector<float> acc_;
+		std::vector<float> time_;
+	};
+
+	float* Spectrum(unsigned int irChannel, size_t partition)
+	{
+		return &spectra_[(irChannel * spectrumCount_ + partition) * stride_ * 2];
+	}
+	float* History(Channel& ch, uint64_t block)
+	{
+		return &ch.history_[(block % spectrumCount_) * stride_ * 2];
+	}
+
+	void EndBlock(void);
+	// next_ of every channel from the spectra of the blocks up to block_
+	void ComputeTail(void);
+	void TailThread(void);
+
+	const MixerKernels& kernels_;
+	unsigned int channels_;
+	unsigned int irChannels_;
+	unsigned int partition_;
+	size_t spectrumCount_;
+	// bins of a spectrum rounded up so every one starts aligned
+	size_t stride_;
+	RealFFT fft_;
+
+	// first partition of every ir channel, as taps
+	std::vector<float> head_;
+	// the later partitions, real then imaginary, scaled by 1 / fft size
+	std::vector<float> spectra_;
+
+	std::vector<Channel> channel_;
+	std::vector<float> in_;
+	std::vector<float> out_;
+	unsigned int position_ = 0;
+	// blocks finished so far
+	uint64_t block_ = 0;
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	uint64_t posted_ = 0;
+	uint64_t finished_ = 0;
+	bool stop_ = false;
+};
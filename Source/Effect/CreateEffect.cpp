@@ -1,9 +1,17 @@
 #include "CreateEffect.h"
-#include <xaudio2.h>
-#include <xaudio2fx.h>
-#include <xapofx.h>
 #include "../AudioManager.h"
 
+void CreateEffect::CreateVolumeMeterLevels(EffectParams& param, unsigned int channel)
+{
+	XAUDIO2FX_VOLUMEMETER_LEVELS* level = new XAUDIO2FX_VOLUMEMETER_LEVELS();
+
+	level->pPeakLevels = new float[channel];
+	level->pRMSLevels = new float[channel];
+	level->ChannelCount = channel;
+	param.param_ = level;
+}
+
+#ifdef _WIN32
 void CreateEffect::GenerateEffectInstance(EffectParams& param, AudioEffectType type, unsigned int channel)
 {
 	switch (type)
@@ -40,12 +48,7 @@ void CreateEffect::CreateVolumeMeter(EffectParams& param, unsigned int channel)
 {
 	XAudio2CreateVolumeMeter(&param.pEffect_);
 
-	XAUDIO2FX_VOLUMEMETER_LEVELS* level = new XAUDIO2FX_VOLUMEMETER_LEVELS();
-
-	level->pPeakLevels = new float[channel];
-	level->pRMSLevels = new float[channel];
-	level->ChannelCount = channel;
-	param.param_ = level;
+	CreateVolumeMeterLevels(param, channel);
 }
 
 void CreateEffect::CreateEcho(EffectParams& param)
@@ -67,3 +70,4 @@ void CreateEffect::CreateFXReverb(EffectParams& param)
 {
 	CreateFX(__uuidof(FXReverb), &param.pEffect_);
 }
+#endif
@@ -5,6 +5,8 @@ struct EffectParams;
 class CreateEffect
 {
 public:
+	static void CreateVolumeMeterLevels(EffectParams& param, unsigned int channel);
+#ifdef _WIN32
 	static void GenerateEffectInstance(EffectParams& param, AudioEffectType type, unsigned int channel);
 private:
 	static void CreateReverb(EffectParams& param);
@@ -13,6 +15,7 @@ private:
 	static void CreateEq(EffectParams& param);
 	static void CreateMasteringLimiter(EffectParams& param);
 	static void CreateFXReverb(EffectParams& param);
+#endif
 
 };
 
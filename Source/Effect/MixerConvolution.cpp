@@ -0,0 +1,62 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include "ConvolutionEngine.h"
+
+MixerConvolution::MixerConvolution(unsigned int channels, unsigned int sampleRate) :
+	MixerEffect(AudioEffectType::Convolution, channels, sampleRate), wetBuffer_(MixerEffectBlockFrames * channels, 0.0f)
+{
+	// a send effect like the reverbs, all wet
+	const ConvolutionParameters param = { 100.0f, 1.0f };
+	SetParameters(&param);
+}
+
+bool MixerConvolution::SetParameters(const void* param)
+{
+	const auto& p = *static_cast<const ConvolutionParameters*>(param);
+	param_.WetDryMix = std::min(std::max(p.WetDryMix, 0.0f), 100.0f);
+	param_.Gain = std::max(p.Gain, 0.0f);
+
+	wet_ = param_.WetDryMix / 100.0f * param_.Gain;
+	dry_ = 1.0f - param_.WetDryMix / 100.0f;
+	return true;
+}
+
+void MixerConvolution::GetParameters(void* param)
+{
+	*static_cast<ConvolutionParameters*>(param) = param_;
+}
+
+std::shared_ptr<ConvolutionEngine> MixerConvolution::SetEngine(std::shared_ptr<ConvolutionEngine> engine)
+{
+	engine_.swap(engine);
+	return engine;
+}
+
+void MixerConvolution::Process(float* buffer, unsigned int frames)
+{
+	const size_t count = static_cast<size_t>(frames) * channels_;
+	if (!engine_)
+	{
+		for (size_t k = 0; k < count; k++)
+		{
+			buffer[k] *= dry_;
+		}
+		return;
+	}
+
+	const unsigned int ch = channels_;
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int n = std::min(frames - done, MixerEffectBlockFrames);
+		const size_t blockCount = static_cast<size_t>(n) * ch;
+		float* x = buffer + static_cast<size_t>(done) * ch;
+		float* wet = wetBuffer_.data();
+
+		engine_->Process(x, wet, n);
+		for (size_t k = 0; k < blockCount; k++)
+		{
+			x[k] = x[k] * dry_ + wet[k] * wet_;
+		}
+		done += n;
+	}
+}
@@ -0,0 +1,62 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include <cmath>
+
+MixerEcho::MixerEcho(unsigned int channels, unsigned int sampleRate) :
+	MixerEffect(AudioEffectType::Echo, channels, sampleRate), tap_(MixerEffectBlockFrames * channels, 0.0f)
+{
+	// sized for the longest delay, a new Delay only moves the read position
+	const size_t maxDelay = static_cast<size_t>(std::ceil(FXECHO_MAX_DELAY * sampleRate / 1000.0f));
+	ring_.assign(RingSize((maxDelay + MixerEffectBlockFrames) * channels), 0.0f);
+
+	const FXECHO_PARAMETERS param = { FXECHO_DEFAULT_WETDRYMIX, FXECHO_DEFAULT_FEEDBACK, FXECHO_DEFAULT_DELAY };
+	SetParameters(&param);
+}
+
+bool MixerEcho::SetParameters(const void* param)
+{
+	const auto& p = *static_cast<const FXECHO_PARAMETERS*>(param);
+	param_.WetDryMix = std::min(std::max(p.WetDryMix, FXECHO_MIN_WETDRYMIX), FXECHO_MAX_WETDRYMIX);
+	param_.Feedback = std::min(std::max(p.Feedback, FXECHO_MIN_FEEDBACK), FXECHO_MAX_FEEDBACK);
+	param_.Delay = std::min(std::max(p.Delay, FXECHO_MIN_DELAY), FXECHO_MAX_DELAY);
+
+	delayFrames_ = std::max(static_cast<unsigned int>(std::lround(param_.Delay * sampleRate_ / 1000.0f)), 1u);
+	return true;
+}
+
+void MixerEcho::GetParameters(void* param)
+{
+	*static_cast<FXECHO_PARAMETERS*>(param) = param_;
+}
+
+void MixerEcho::Process(float* buffer, unsigned int frames)
+{
+	const unsigned int ch = channels_;
+	const float wet = param_.WetDryMix;
+	const float dry = 1.0f - wet;
+	const float feedback = param_.Feedback;
+	const size_t delay = static_cast<size_t>(delayFrames_) * ch;
+
+	// a block no longer than the delay never reads what it writes, so the loop has no carried dependency
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int n = std::min({ frames - done, delayFrames_, MixerEffectBlockFrames });
+		const size_t count = static_cast<size_t>(n) * ch;
+		float* x = buffer + static_cast<size_t>(done) * ch;
+		float* tap = tap_.data();
+
+		ReadRing(ring_, write_ - delay, tap, count);
+		for (size_t k = 0; k < count; k++)
+		{
+			const float in = x[k];
+			const float echo = tap[k];
+			x[k] = in * dry + echo * wet;
+			tap[k] = in + echo * feedback;
+		}
+		FlushTiny(tap, count);
+		WriteRing(ring_, write_, tap, count);
+
+		write_ += count;
+		done += n;
+	}
+}
@@ -0,0 +1,135 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include <cmath>
+
+MixerEffect::MixerEffect(AudioEffectType type, unsigned int channels, unsigned int sampleRate) :
+	type_(type), channels_(channels), sampleRate_(sampleRate)
+{
+}
+
+#ifdef _WIN32
+HRESULT STDMETHODCALLTYPE MixerEffect::QueryInterface(REFIID riid, void** object)
+{
+	if (object == nullptr) { return E_POINTER; }
+	if (riid != __uuidof(IUnknown))
+	{
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+	AddRef();
+	*object = static_cast<IUnknown*>(this);
+	return S_OK;
+}
+#endif
+
+unsigned long STDMETHODCALLTYPE MixerEffect::AddRef(void)
+{
+	return ref_.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+unsigned long STDMETHODCALLTYPE MixerEffect::Release(void)
+{
+	const unsigned long ref = ref_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	if (ref == 0)
+	{
+		delete this;
+	}
+	return ref;
+}
+
+size_t MixerEffect::RingSize(size_t count)
+{
+	size_t size = 1;
+	while (size < count) { size <<= 1; }
+	return size;
+}
+
+void MixerEffect::ReadRing(const std::vector<float>& ring, size_t pos, float* out, size_t count)
+{
+	const size_t mask = ring.size() - 1;
+	pos &= mask;
+	const size_t first = std::min(count, ring.size() - pos);
+	std::copy(ring.begin() + pos, ring.begin() + pos + first, out);
+	std::copy(ring.begin(), ring.begin() + (count - first), out + first);
+}
+
+void MixerEffect::WriteRing(std::vector<float>& ring, size_t pos, const float* in, size_t count)
+{
+	const size_t mask = ring.size() - 1;
+	pos &= mask;
+	const size_t first = std::min(count, ring.size() - pos);
+	std::copy(in, in + first, ring.begin() + pos);
+	std::copy(in + first, in + count, ring.begin());
+}
+
+void MixerEffect::FlushTiny(float* data, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		data[i] = std::fabs(data[i]) < 1e-15f ? 0.0f : data[i];
+	}
+}
+
+MixerEffect* CreateMixerEffect(AudioEffectType type, unsigned int channels, unsigned int sampleRate)
+{
+	if (channels == 0 || sampleRate == 0) { return nullptr; }
+
+	switch (type)
+	{
+	case AudioEffectType::Reverb:
+		return new MixerReverb(channels, sampleRate, false);
+	case AudioEffectType::VolumeMeter:
+		return new MixerVolumeMeter(channels, sampleRate);
+	case AudioEffectType::Echo:
+		return new MixerEcho(channels, sampleRate);
+	case AudioEffectType::Equalizer:
+		return new MixerEqualizer(channels, sampleRate);
+	case AudioEffectType::MasteringLimiter:
+		return new MixerMasteringLimiter(channels, sampleRate);
+	case AudioEffectType::FXReverb:
+		return new MixerReverb(channels, sampleRate, true);
+	case AudioEffectType::Convolution:
+		return new MixerConvolution(channels, sampleRate);
+	default:
+		return nullptr;
+	}
+}
+
+MixerVolumeMeter::MixerVolumeMeter(unsigned int channels, unsigned int sampleRate) :
+	MixerEffect(AudioEffectType::VolumeMeter, channels, sampleRate), peak_(channels, 0.0f), rms_(channels, 0.0f)
+{
+}
+
+void MixerVolumeMeter::GetParameters(void* param)
+{
+	auto* level = static_cast<XAUDIO2FX_VOLUMEMETER_LEVELS*>(param);
+	const unsigned int count = std::min<unsigned int>(level->ChannelCount, channels_);
+	if (level->pPeakLevels != nullptr)
+	{
+		std::copy(peak_.begin(), peak_.begin() + count, level->pPeakLevels);
+	}
+	if (level->pRMSLevels != nullptr)
+	{
+		std::copy(rms_.begin(), rms_.begin() + count, level->pRMSLevels);
+	}
+}
+
+void MixerVolumeMeter::Process(float* buffer, unsigned int frames)
+{
+	if (frames == 0) { return; }
+
+	const unsigned int ch = channels_;
+	for (unsigned int c = 0; c < ch; c++)
+	{
+		float peak = 0.0f;
+		float sum = 0.0f;
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			const float s = buffer[i * ch + c];
+			peak = std::max(peak, std::fabs(s));
+			sum += s * s;
+		}
+		peak_[c] = peak;
+		rms_[c] = std::sqrt(sum / frames);
+	}
+}
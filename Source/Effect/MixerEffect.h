@@ -0,0 +1,242 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "../EffectDefines.h"
+#include "../Backend/AudioPlatform.h"
+
+class ConvolutionEngine;
+
+// frames one pass of an effect works on at most, longer buffers are split
+constexpr unsigned int MixerEffectBlockFrames = 256;
+
+// in-library effect of the software mixer, takes the parameter struct of the XAudio2 / XAPOFX effect it replaces
+// Process runs on a mixer thread with the mixer lock held, parameters are only touched under the same lock
+class MixerEffect : public IUnknown
+{
+public:
+	MixerEffect(const MixerEffect&) = delete;
+	MixerEffect& operator=(const MixerEffect&) = delete;
+
+#ifdef _WIN32
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override;
+#endif
+	unsigned long STDMETHODCALLTYPE AddRef(void) override;
+	unsigned long STDMETHODCALLTYPE Release(void) override;
+
+	AudioEffectType GetType(void) const { return type_; }
+	unsigned int GetChannels(void) const { return channels_; }
+
+	// the size of the parameter struct, SetParameters / GetParameters take nothing else
+	virtual unsigned int GetParameterSize(void) const = 0;
+	// values out of range are clamped, false when the effect takes no parameters
+	virtual bool SetParameters(const void* param) = 0;
+	virtual void GetParameters(void* param) = 0;
+
+	// in place on interleaved frames of GetChannels() channels
+	virtual void Process(float* buffer, unsigned int frames) = 0;
+protected:
+	MixerEffect(AudioEffectType type, unsigned int channels, unsigned int sampleRate);
+	virtual ~MixerEffect() = default;
+
+	// the smallest power of two holding count samples
+	static size_t RingSize(size_t count);
+	// power of two rings, pos is taken modulo the size
+	static void ReadRing(const std::vector<float>& ring, size_t pos, float* out, size_t count);
+	static void WriteRing(std::vector<float>& ring, size_t pos, const float* in, size_t count);
+	// values below -300 dB become 0, decaying feedback would otherwise end in denormals
+	static void FlushTiny(float* data, size_t count);
+
+	AudioEffectType type_;
+	unsigned int channels_;
+	unsigned int sampleRate_;
+private:
+	std::atomic<unsigned long> ref_ = 1;
+};
+
+// nullptr for a type the mixer has no implementation of
+MixerEffect* CreateMixerEffect(AudioEffectType type, unsigned int channels, unsigned int sampleRate);
+
+// peak and RMS of every channel over the last pass
+class MixerVolumeMeter : public MixerEffect
+{
+public:
+	MixerVolumeMeter(unsigned int channels, unsigned int sampleRate);
+
+	unsigned int GetParameterSize(void) const override { return sizeof(XAUDIO2FX_VOLUMEMETER_LEVELS); }
+	bool SetParameters(const void*) override { return false; }
+	// fills the arrays of the caller, ChannelCount of them at most
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+private:
+	std::vector<float> peak_;
+	std::vector<float> rms_;
+};
+
+// FXEcho, a feedback delay per channel
+class MixerEcho : public MixerEffect
+{
+public:
+	MixerEcho(unsigned int channels, unsigned int sampleRate);
+
+	unsigned int GetParameterSize(void) const override { return sizeof(FXECHO_PARAMETERS); }
+	bool SetParameters(const void* param) override;
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+private:
+	FXECHO_PARAMETERS param_;
+	unsigned int delayFrames_ = 1;
+
+	// interleaved, what comes out Delay later
+	std::vector<float> ring_;
+	size_t write_ = 0;
+	std::vector<float> tap_;
+};
+
+// FXEQ, four peaking bands
+class MixerEqualizer : public MixerEffect
+{
+public:
+	MixerEqualizer(unsigned int channels, unsigned int sampleRate);
+
+	unsigned int GetParameterSize(void) const override { return sizeof(FXEQ_PARAMETERS); }
+	bool SetParameters(const void* param) override;
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+private:
+	static constexpr unsigned int BandCount = 4;
+
+	// normalized biquad, transposed direct form II
+	struct Band
+	{
+		bool active_;
+		float b0_, b1_, b2_, a1_, a2_;
+	};
+
+	FXEQ_PARAMETERS param_;
+	Band band_[BandCount];
+	// s1, s2 of every band and channel
+	std::vector<float> state_;
+};
+
+// FXMasteringLimiter, pre gain from Loudness then a peak limiter with instant attack
+class MixerMasteringLimiter : public MixerEffect
+{
+public:
+	MixerMasteringLimiter(unsigned int channels, unsigned int sampleRate);
+
+	unsigned int GetParameterSize(void) const override { return sizeof(FXMASTERINGLIMITER_PARAMETERS); }
+	bool SetParameters(const void* param) override;
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+private:
+	FXMASTERINGLIMITER_PARAMETERS param_;
+	float preGain_ = 1.0f;
+	float releaseCoef_ = 0.0f;
+	float gain_ = 1.0f;
+	std::vector<float> frameGain_;
+};
+
+// the XAudio2 reverb, also behind FXReverb
+// early reflections from a tapped pre delay, late field from an 8 line feedback delay network
+// the position, density and rear / side delay parameters have no effect
+class MixerReverb : public MixerEffect
+{
+public:
+	// fx selects the FXREVERB_PARAMETERS interface
+	MixerReverb(unsigned int channels, unsigned int sampleRate, bool fx);
+
+	unsigned int GetParameterSize(void) const override;
+	bool SetParameters(const void* param) override;
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+private:
+	static constexpr unsigned int LineCount = 8;
+	static constexpr unsigned int TapCount = 8;
+	static constexpr unsigned int DiffuserCount = 2;
+
+	// Schroeder allpass over a ring
+	struct Allpass
+	{
+		std::vector<float> ring_;
+		size_t delay_;
+		float coef_;
+	};
+
+	void SetNative(const XAUDIO2FX_REVERB_PARAMETERS& param);
+	void ProcessBlock(float* buffer, unsigned int frames);
+	static void RunAllpass(Allpass& ap, size_t write, float* buffer, float* scratch, unsigned int frames);
+
+	bool fx_;
+	FXREVERB_PARAMETERS fxParam_;
+	XAUDIO2FX_REVERB_PARAMETERS param_;
+
+	float wet_ = 1.0f;
+	float dry_ = 0.0f;
+	float roomCoef_ = 1.0f;
+	float roomMain_ = 1.0f;
+	float roomHF_ = 1.0f;
+	float room_ = 0.0f;
+	float lateGain_ = 1.0f;
+
+	// mono input after the room filter
+	std::vector<float> preDelay_;
+	size_t tapDelay_[TapCount];
+	float tapGain_[TapCount];
+	size_t lateDelay_ = 0;
+	Allpass early_[2];
+	Allpass diffuser_[DiffuserCount];
+
+	std::vector<float> line_[LineCount];
+	size_t lineDelay_[LineCount];
+	// gains per pass below the low cutoff, in between and above the high cutoff
+	float lowGain_[LineCount];
+	float midGain_[LineCount];
+	float highGain_[LineCount];
+	float lowCoef_ = 0.0f;
+	float highCoef_ = 0.0f;
+	float lowState_[LineCount] = {};
+	float highState_[LineCount] = {};
+	bool late_ = true;
+
+	size_t write_ = 0;
+	// frames a block may have so no delay in the graph reads what the block writes
+	unsigned int blockFrames_ = MixerEffectBlockFrames;
+
+	// planar scratch of one block
+	std::vector<float> mono_;
+	std::vector<float> side_[2];
+	std::vector<float> lateIn_;
+	std::vector<float> lane_[LineCount];
+	std::vector<float> scratch_;
+};
+
+// convolution with the impulse response of an engine, the wet signal is silent until one is set
+class MixerConvolution : public MixerEffect
+{
+public:
+	MixerConvolution(unsigned int channels, unsigned int sampleRate);
+
+	unsigned int GetParameterSize(void) const override { return sizeof(ConvolutionParameters); }
+	bool SetParameters(const void* param) override;
+	void GetParameters(void* param) override;
+
+	void Process(float* buffer, unsigned int frames) override;
+
+	// the engine must have GetChannels() channels, the tail of the one before is cut
+	// returns the one before so it can be freed outside the mixer lock
+	std::shared_ptr<ConvolutionEngine> SetEngine(std::shared_ptr<ConvolutionEngine> engine);
+private:
+	ConvolutionParameters param_;
+	float wet_ = 1.0f;
+	float dry_ = 0.0f;
+
+	std::shared_ptr<ConvolutionEngine> engine_;
+	std::vector<float> wetBuffer_;
+};
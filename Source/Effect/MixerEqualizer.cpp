@@ -0,0 +1,127 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr float Pi = 3.14159265358979f;
+}
+
+MixerEqualizer::MixerEqualizer(unsigned int channels, unsigned int sampleRate) :
+	MixerEffect(AudioEffectType::Equalizer, channels, sampleRate), state_(BandCount * channels * 2, 0.0f)
+{
+	const FXEQ_PARAMETERS param =
+	{
+		FXEQ_DEFAULT_FREQUENCY_CENTER_0, FXEQ_DEFAULT_GAIN, FXEQ_DEFAULT_BANDWIDTH,
+		FXEQ_DEFAULT_FREQUENCY_CENTER_1, FXEQ_DEFAULT_GAIN, FXEQ_DEFAULT_BANDWIDTH,
+		FXEQ_DEFAULT_FREQUENCY_CENTER_2, FXEQ_DEFAULT_GAIN, FXEQ_DEFAULT_BANDWIDTH,
+		FXEQ_DEFAULT_FREQUENCY_CENTER_3, FXEQ_DEFAULT_GAIN, FXEQ_DEFAULT_BANDWIDTH,
+	};
+	SetParameters(&param);
+}
+
+bool MixerEqualizer::SetParameters(const void* param)
+{
+	const auto& p = *static_cast<const FXEQ_PARAMETERS*>(param);
+	const float in[BandCount][3] =
+	{
+		{ p.FrequencyCenter0, p.Gain0, p.Bandwidth0 },
+		{ p.FrequencyCenter1, p.Gain1, p.Bandwidth1 },
+		{ p.FrequencyCenter2, p.Gain2, p.Bandwidth2 },
+		{ p.FrequencyCenter3, p.Gain3, p.Bandwidth3 },
+	};
+	float out[BandCount][3];
+
+	// the centre stays below nyquist whatever the rate
+	const float maxFrequency = std::min(FXEQ_MAX_FREQUENCY_CENTER, sampleRate_ * 0.49f);
+	for (unsigned int b = 0; b < BandCount; b++)
+	{
+		const float frequency = std::min(std::max(in[b][0], FXEQ_MIN_FREQUENCY_CENTER), maxFrequency);
+		const float gain = std::min(std::max(in[b][1], FXEQ_MIN_GAIN), FXEQ_MAX_GAIN);
+		const float bandwidth = std::min(std::max(in[b][2], FXEQ_MIN_BANDWIDTH), FXEQ_MAX_BANDWIDTH);
+		out[b][0] = frequency;
+		out[b][1] = gain;
+		out[b][2] = bandwidth;
+
+		// peaking filter of the audio eq cookbook, bandwidth in octaves
+		Band& band = band_[b];
+		band.active_ = gain != 1.0f;
+		if (!band.active_)
+		{
+			std::fill(&state_[b * channels_ * 2], &state_[(b + 1) * channels_ * 2], 0.0f);
+		}
+
+		const float w0 = 2.0f * Pi * frequency / sampleRate_;
+		const float a = std::sqrt(gain);
+		const float alpha = std::sin(w0) * std::sinh(std::log(2.0f) / 2.0f * bandwidth * w0 / std::sin(w0));
+		const float a0 = 1.0f + alpha / a;
+		band.b0_ = (1.0f + alpha * a) / a0;
+		band.b1_ = -2.0f * std::cos(w0) / a0;
+		band.b2_ = (1.0f - alpha * a) / a0;
+		band.a1_ = band.b1_;
+		band.a2_ = (1.0f - alpha / a) / a0;
+	}
+
+	param_ =
+	{
+		out[0][0], out[0][1], out[0][2],
+		out[1][0], out[1][1], out[1][2],
+		out[2][0], out[2][1], out[2][2],
+		out[3][0], out[3][1], out[3][2],
+	};
+	return true;
+}
+
+void MixerEqualizer::GetParameters(void* param)
+{
+	*static_cast<FXEQ_PARAMETERS*>(param) = param_;
+}
+
+void MixerEqualizer::Process(float* buffer, unsigned int frames)
+{
+	// a band at unity gain is the identity, its state stays at rest
+	unsigned int active[BandCount];
+	unsigned int count = 0;
+	for (unsigned int b = 0; b < BandCount; b++)
+	{
+		if (band_[b].active_) { active[count++] = b; }
+	}
+	if (count == 0) { return; }
+
+	// all bands in one pass over a channel with the state in registers, the recursion of a band
+	// only waits on its own last frame, so the next frame of the first band overlaps the later bands
+	const unsigned int ch = channels_;
+	for (unsigned int c = 0; c < ch; c++)
+	{
+		float s1[BandCount];
+		float s2[BandCount];
+		for (unsigned int k = 0; k < count; k++)
+		{
+			s1[k] = state_[(active[k] * ch + c) * 2];
+			s2[k] = state_[(active[k] * ch + c) * 2 + 1];
+		}
+
+		float* x = buffer + c;
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			float v = x[static_cast<size_t>(i) * ch];
+			for (unsigned int k = 0; k < count; k++)
+			{
+				const Band& band = band_[active[k]];
+				const float out = band.b0_ * v + s1[k];
+				s1[k] = band.b1_ * v - band.a1_ * out + s2[k];
+				s2[k] = band.b2_ * v - band.a2_ * out;
+				v = out;
+			}
+			x[static_cast<size_t>(i) * ch] = v;
+		}
+
+		FlushTiny(s1, count);
+		FlushTiny(s2, count);
+		for (unsigned int k = 0; k < count; k++)
+		{
+			state_[(active[k] * ch + c) * 2] = s1[k];
+			state_[(active[k] * ch + c) * 2 + 1] = s2[k];
+		}
+	}
+}
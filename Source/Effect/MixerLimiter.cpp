@@ -0,0 +1,77 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// just under full scale, what the limiter lets through at most
+	constexpr float LimiterCeiling = 0.99f;
+	// one step of Release in milliseconds
+	constexpr float ReleaseStepMs = 10.0f;
+}
+
+MixerMasteringLimiter::MixerMasteringLimiter(unsigned int channels, unsigned int sampleRate) :
+	MixerEffect(AudioEffectType::MasteringLimiter, channels, sampleRate), frameGain_(MixerEffectBlockFrames, 1.0f)
+{
+	const FXMASTERINGLIMITER_PARAMETERS param = { FXMASTERINGLIMITER_DEFAULT_RELEASE, FXMASTERINGLIMITER_DEFAULT_LOUDNESS };
+	SetParameters(&param);
+}
+
+bool MixerMasteringLimiter::SetParameters(const void* param)
+{
+	const auto& p = *static_cast<const FXMASTERINGLIMITER_PARAMETERS*>(param);
+	param_.Release = std::min<UINT32>(std::max<UINT32>(p.Release, FXMASTERINGLIMITER_MIN_RELEASE), FXMASTERINGLIMITER_MAX_RELEASE);
+	param_.Loudness = std::min<UINT32>(std::max<UINT32>(p.Loudness, FXMASTERINGLIMITER_MIN_LOUDNESS), FXMASTERINGLIMITER_MAX_LOUDNESS);
+
+	// the default loudness is unity gain
+	preGain_ = static_cast<float>(param_.Loudness) / FXMASTERINGLIMITER_DEFAULT_LOUDNESS;
+	const float releaseFrames = param_.Release * ReleaseStepMs * sampleRate_ / 1000.0f;
+	releaseCoef_ = std::exp(-1.0f / releaseFrames);
+	return true;
+}
+
+void MixerMasteringLimiter::GetParameters(void* param)
+{
+	*static_cast<FXMASTERINGLIMITER_PARAMETERS*>(param) = param_;
+}
+
+void MixerMasteringLimiter::Process(float* buffer, unsigned int frames)
+{
+	const unsigned int ch = channels_;
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int n = std::min(frames - done, MixerEffectBlockFrames);
+		float* x = buffer + static_cast<size_t>(done) * ch;
+		float* gain = frameGain_.data();
+
+		// the gain each frame needs to stay under the ceiling, independent per frame
+		for (unsigned int i = 0; i < n; i++)
+		{
+			float peak = 0.0f;
+			for (unsigned int c = 0; c < ch; c++)
+			{
+				peak = std::max(peak, std::fabs(x[i * ch + c]));
+			}
+			peak *= preGain_;
+			gain[i] = peak > LimiterCeiling ? LimiterCeiling / peak : 1.0f;
+		}
+
+		// the only serial part, attack is instant so the ceiling holds without lookahead
+		float g = gain_;
+		for (unsigned int i = 0; i < n; i++)
+		{
+			g = gain[i] < g ? gain[i] : gain[i] + (g - gain[i]) * releaseCoef_;
+			gain[i] = g * preGain_;
+		}
+		gain_ = g;
+
+		for (unsigned int i = 0; i < n; i++)
+		{
+			for (unsigned int c = 0; c < ch; c++)
+			{
+				x[i * ch + c] *= gain[i];
+			}
+		}
+		done += n;
+	}
+}
@@ -0,0 +1,405 @@
+#include "MixerEffect.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr float Pi = 3.14159265358979f;
+
+	// lengths of the late lines in a room of XAUDIO2FX_REVERB_MAX_ROOM_SIZE feet, mutually prime in frames at common rates
+	constexpr float LineMs[] = { 31.71f, 37.11f, 40.23f, 44.14f, 50.87f, 56.29f, 61.57f, 68.03f };
+	// early reflections after ReflectionsDelay, alternating left / right, scaled with the room like the lines
+	constexpr float TapMs[] = { 0.0f, 3.7f, 7.9f, 11.3f, 15.1f, 19.7f, 23.9f, 28.3f };
+	constexpr float TapGain[] = { 0.84f, -0.71f, 0.64f, -0.55f, 0.47f, -0.40f, 0.33f, -0.27f };
+	constexpr float EarlyAllpassMs[] = { 4.3f, 5.1f };
+	constexpr float DiffuserMs[] = { 6.1f, 8.9f };
+	// allpass coefficient at diffusion XAUDIO2FX_REVERB_MAX_DIFFUSION
+	constexpr float MaxDiffusionCoef = 0.7f;
+	// rooms smaller than this share its line lengths, shorter lines ring metallic
+	constexpr float MinRoomScale = 0.1f;
+	// input into each late line and the share of each line in the output of its side
+	constexpr float LateInputGain = 0.5f;
+	constexpr float LateOutputGain = 0.25f;
+	// FXReverb has no mix parameter, it runs half wet
+	constexpr float FXReverbWetDryMix = 50.0f;
+	// decay at FXREVERB_MIN_ROOMSIZE and at FXREVERB_MAX_ROOMSIZE, in seconds
+	constexpr float FXReverbMinDecay = 0.3f;
+	constexpr float FXReverbMaxDecay = 4.0f;
+
+	float DecibelToGain(float db)
+	{
+		return std::pow(10.0f, db / 20.0f);
+	}
+
+	// one pole coefficient of a lowpass at frequency
+	float OnePoleCoef(float frequency, unsigned int sampleRate)
+	{
+		return 1.0f - std::exp(-2.0f * Pi * frequency / sampleRate);
+	}
+
+	size_t MsToFrames(float ms, unsigned int sampleRate)
+	{
+		return static_cast<size_t>(std::lround(ms * sampleRate / 1000.0f));
+	}
+
+	XAUDIO2FX_REVERB_PARAMETERS DefaultReverbParameters(void)
+	{
+		XAUDIO2FX_REVERB_PARAMETERS p = {};
+		p.WetDryMix = XAUDIO2FX_REVERB_DEFAULT_WET_DRY_MIX;
+		p.ReflectionsDelay = XAUDIO2FX_REVERB_DEFAULT_REFLECTIONS_DELAY;
+		p.ReverbDelay = XAUDIO2FX_REVERB_DEFAULT_REVERB_DELAY;
+		p.RearDelay = XAUDIO2FX_REVERB_DEFAULT_REAR_DELAY;
+		p.SideDelay = XAUDIO2FX_REVERB_DEFAULT_7POINT1_SIDE_DELAY;
+		p.PositionLeft = XAUDIO2FX_REVERB_DEFAULT_POSITION;
+		p.PositionRight = XAUDIO2FX_REVERB_DEFAULT_POSITION;
+		p.PositionMatrixLeft = XAUDIO2FX_REVERB_DEFAULT_POSITION_MATRIX;
+		p.PositionMatrixRight = XAUDIO2FX_REVERB_DEFAULT_POSITION_MATRIX;
+		p.EarlyDiffusion = XAUDIO2FX_REVERB_DEFAULT_EARLY_DIFFUSION;
+		p.LateDiffusion = XAUDIO2FX_REVERB_DEFAULT_LATE_DIFFUSION;
+		p.LowEQGain = XAUDIO2FX_REVERB_DEFAULT_LOW_EQ_GAIN;
+		p.LowEQCutoff = XAUDIO2FX_REVERB_DEFAULT_LOW_EQ_CUTOFF;
+		p.HighEQGain = XAUDIO2FX_REVERB_DEFAULT_HIGH_EQ_GAIN;
+		p.HighEQCutoff = XAUDIO2FX_REVERB_DEFAULT_HIGH_EQ_CUTOFF;
+		p.RoomFilterFreq = XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_FREQ;
+		p.RoomFilterMain = XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_MAIN;
+		p.RoomFilterHF = XAUDIO2FX_REVERB_DEFAULT_ROOM_FILTER_HF;
+		p.ReflectionsGain = XAUDIO2FX_REVERB_DEFAULT_REFLECTIONS_GAIN;
+		p.ReverbGain = XAUDIO2FX_REVERB_DEFAULT_REVERB_GAIN;
+		p.DecayTime = XAUDIO2FX_REVERB_DEFAULT_DECAY_TIME;
+		p.Density = XAUDIO2FX_REVERB_DEFAULT_DENSITY;
+		p.RoomSize = XAUDIO2FX_REVERB_DEFAULT_ROOM_SIZE;
+		p.DisableLateField = FALSE;
+		return p;
+	}
+}
+
+MixerReverb::MixerReverb(unsigned int channels, unsigned int sampleRate, bool fx) :
+	MixerEffect(fx ? AudioEffectType::FXReverb : AudioEffectType::Reverb, channels, sampleRate), fx_(fx),
+	fxParam_{ FXREVERB_DEFAULT_DIFFUSION, FXREVERB_DEFAULT_ROOMSIZE }
+{
+	// every ring is sized for the largest setting, parameters only move read positions
+	const size_t block = MixerEffectBlockFrames;
+	const size_t maxPreDelay = MsToFrames(static_cast<float>(XAUDIO2FX_REVERB_MAX_REFLECTIONS_DELAY) +
+		std::max(static_cast<float>(XAUDIO2FX_REVERB_MAX_REVERB_DELAY), TapMs[TapCount - 1]), sampleRate) + 1;
+	preDelay_.assign(RingSize(maxPreDelay + block), 0.0f);
+
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		early_[s].delay_ = MsToFrames(EarlyAllpassMs[s], sampleRate);
+		early_[s].ring_.assign(RingSize(early_[s].delay_ + block), 0.0f);
+		early_[s].coef_ = 0.0f;
+	}
+	for (unsigned int d = 0; d < DiffuserCount; d++)
+	{
+		diffuser_[d].delay_ = MsToFrames(DiffuserMs[d], sampleRate);
+		diffuser_[d].ring_.assign(RingSize(diffuser_[d].delay_ + block), 0.0f);
+		diffuser_[d].coef_ = 0.0f;
+	}
+	for (unsigned int j = 0; j < LineCount; j++)
+	{
+		line_[j].assign(RingSize(MsToFrames(LineMs[j], sampleRate) + block), 0.0f);
+		lane_[j].assign(block, 0.0f);
+	}
+
+	mono_.assign(block, 0.0f);
+	side_[0].assign(block, 0.0f);
+	side_[1].assign(block, 0.0f);
+	lateIn_.assign(block, 0.0f);
+	scratch_.assign(block, 0.0f);
+
+	if (fx_)
+	{
+		SetParameters(&fxParam_);
+	}
+	else
+	{
+		SetNative(DefaultReverbParameters());
+	}
+}
+
+unsigned int MixerReverb::GetParameterSize(void) const
+{
+	return fx_ ? sizeof(FXREVERB_PARAMETERS) : sizeof(XAUDIO2FX_REVERB_PARAMETERS);
+}
+
+bool MixerReverb::SetParameters(const void* param)
+{
+	if (!fx_)
+	{
+		SetNative(*static_cast<const XAUDIO2FX_REVERB_PARAMETERS*>(param));
+		return true;
+	}
+
+	// FXReverb drives the same network, diffusion and density follow Diffusion, size and decay follow RoomSize
+	const auto& p = *static_cast<const FXREVERB_PARAMETERS*>(param);
+	fxParam_.Diffusion = std::min(std::max(p.Diffusion, FXREVERB_MIN_DIFFUSION), FXREVERB_MAX_DIFFUSION);
+	fxParam_.RoomSize = std::min(std::max(p.RoomSize, FXREVERB_MIN_ROOMSIZE), FXREVERB_MAX_ROOMSIZE);
+
+	XAUDIO2FX_REVERB_PARAMETERS native = DefaultReverbParameters();
+	native.WetDryMix = FXReverbWetDryMix;
+	native.EarlyDiffusion = static_cast<BYTE>(std::lround(fxParam_.Diffusion * XAUDIO2FX_REVERB_MAX_DIFFUSION));
+	native.LateDiffusion = native.EarlyDiffusion;
+	native.Density = fxParam_.Diffusion * 100.0f;
+	native.RoomSize = XAUDIO2FX_REVERB_MIN_ROOM_SIZE +
+		(XAUDIO2FX_REVERB_MAX_ROOM_SIZE - XAUDIO2FX_REVERB_MIN_ROOM_SIZE) * fxParam_.RoomSize;
+	native.DecayTime = FXReverbMinDecay + (FXReverbMaxDecay - FXReverbMinDecay) * fxParam_.RoomSize;
+	SetNative(native);
+	return true;
+}
+
+void MixerReverb::GetParameters(void* param)
+{
+	if (fx_)
+	{
+		*static_cast<FXREVERB_PARAMETERS*>(param) = fxParam_;
+		return;
+	}
+	*static_cast<XAUDIO2FX_REVERB_PARAMETERS*>(param) = param_;
+}
+
+void MixerReverb::SetNative(const XAUDIO2FX_REVERB_PARAMETERS& param)
+{
+	auto clamp = [](auto v, auto low, auto high) { return std::min(std::max(v, low), high); };
+
+	XAUDIO2FX_REVERB_PARAMETERS p = param;
+	p.WetDryMix = clamp(p.WetDryMix, 0.0f, 100.0f);
+	p.ReflectionsDelay = std::min<UINT32>(p.ReflectionsDelay, XAUDIO2FX_REVERB_MAX_REFLECTIONS_DELAY);
+	p.ReverbDelay = std::min<BYTE>(p.ReverbDelay, XAUDIO2FX_REVERB_MAX_REVERB_DELAY);
+	p.EarlyDiffusion = std::min<BYTE>(p.EarlyDiffusion, XAUDIO2FX_REVERB_MAX_DIFFUSION);
+	p.LateDiffusion = std::min<BYTE>(p.LateDiffusion, XAUDIO2FX_REVERB_MAX_DIFFUSION);
+	p.LowEQGain = std::min<BYTE>(p.LowEQGain, XAUDIO2FX_REVERB_MAX_LOW_EQ_GAIN);
+	p.LowEQCutoff = std::min<BYTE>(p.LowEQCutoff, XAUDIO2FX_REVERB_MAX_LOW_EQ_CUTOFF);
+	p.HighEQGain = std::min<BYTE>(p.HighEQGain, XAUDIO2FX_REVERB_MAX_HIGH_EQ_GAIN);
+	p.HighEQCutoff = std::min<BYTE>(p.HighEQCutoff, XAUDIO2FX_REVERB_MAX_HIGH_EQ_CUTOFF);
+	p.RoomFilterFreq = clamp(p.RoomFilterFreq, 20.0f, std::min(20000.0f, sampleRate_ * 0.49f));
+	p.RoomFilterMain = clamp(p.RoomFilterMain, -100.0f, 0.0f);
+	p.RoomFilterHF = clamp(p.RoomFilterHF, -100.0f, 0.0f);
+	p.ReflectionsGain = clamp(p.ReflectionsGain, -100.0f, 20.0f);
+	p.ReverbGain = clamp(p.ReverbGain, -100.0f, 20.0f);
+	p.DecayTime = std::max(p.DecayTime, XAUDIO2FX_REVERB_MIN_DECAY_TIME);
+	p.Density = clamp(p.Density, 0.0f, 100.0f);
+	p.RoomSize = clamp(p.RoomSize, XAUDIO2FX_REVERB_MIN_ROOM_SIZE, XAUDIO2FX_REVERB_MAX_ROOM_SIZE);
+	param_ = p;
+
+	wet_ = p.WetDryMix / 100.0f;
+	dry_ = 1.0f - wet_;
+	roomCoef_ = OnePoleCoef(p.RoomFilterFreq, sampleRate_);
+	roomMain_ = DecibelToGain(p.RoomFilterMain);
+	roomHF_ = DecibelToGain(p.RoomFilterHF);
+	late_ = !p.DisableLateField;
+	lateGain_ = DecibelToGain(p.ReverbGain) * LateOutputGain;
+
+	const float scale = std::max(p.RoomSize / XAUDIO2FX_REVERB_MAX_ROOM_SIZE, MinRoomScale);
+	const size_t reflections = MsToFrames(static_cast<float>(p.ReflectionsDelay), sampleRate_);
+	const float reflectionsGain = DecibelToGain(p.ReflectionsGain);
+	for (unsigned int k = 0; k < TapCount; k++)
+	{
+		tapDelay_[k] = reflections + MsToFrames(TapMs[k] * scale, sampleRate_);
+		tapGain_[k] = TapGain[k] * reflectionsGain;
+	}
+	lateDelay_ = reflections + MsToFrames(static_cast<float>(p.ReverbDelay), sampleRate_);
+
+	const float earlyCoef = MaxDiffusionCoef * p.EarlyDiffusion / XAUDIO2FX_REVERB_MAX_DIFFUSION;
+	const float lateCoef = MaxDiffusionCoef * p.LateDiffusion / XAUDIO2FX_REVERB_MAX_DIFFUSION;
+	early_[0].coef_ = earlyCoef;
+	early_[1].coef_ = earlyCoef;
+	for (auto& d : diffuser_)
+	{
+		d.coef_ = lateCoef;
+	}
+
+	// the EQ gains shorten or stretch the decay of their band, 1 dB a step from the neutral value
+	const float lowDecay = p.DecayTime * DecibelToGain(static_cast<float>(p.LowEQGain) - XAUDIO2FX_REVERB_DEFAULT_LOW_EQ_GAIN);
+	const float highDecay = p.DecayTime * DecibelToGain(static_cast<float>(p.HighEQGain) - XAUDIO2FX_REVERB_DEFAULT_HIGH_EQ_GAIN);
+	lowCoef_ = OnePoleCoef(50.0f + 50.0f * p.LowEQCutoff, sampleRate_);
+	highCoef_ = OnePoleCoef(std::min(1000.0f + 500.0f * p.HighEQCutoff, sampleRate_ * 0.49f), sampleRate_);
+
+	// a block may not be longer than the shortest delay it reads through
+	size_t block = MixerEffectBlockFrames;
+	for (auto& e : early_)
+	{
+		block = std::min(block, e.delay_);
+	}
+	for (auto& d : diffuser_)
+	{
+		block = std::min(block, d.delay_);
+	}
+
+	// each pass through a line loses 60 dB over the decay time of the band, 3 bands a line
+	for (unsigned int j = 0; j < LineCount; j++)
+	{
+		lineDelay_[j] = std::max<size_t>(MsToFrames(LineMs[j] * scale, sampleRate_), 1);
+		block = std::min(block, lineDelay_[j]);
+
+		const float seconds = static_cast<float>(lineDelay_[j]) / sampleRate_;
+		lowGain_[j] = std::pow(10.0f, -3.0f * seconds / lowDecay);
+		midGain_[j] = std::pow(10.0f, -3.0f * seconds / p.DecayTime);
+		highGain_[j] = std::pow(10.0f, -3.0f * seconds / highDecay);
+	}
+	blockFrames_ = static_cast<unsigned int>(std::max<size_t>(block, 1));
+}
+
+void MixerReverb::Process(float* buffer, unsigned int frames)
+{
+	for (unsigned int done = 0; done < frames;)
+	{
+		const unsigned int n = std::min(frames - done, blockFrames_);
+		ProcessBlock(buffer + static_cast<size_t>(done) * channels_, n);
+		done += n;
+	}
+}
+
+void MixerReverb::RunAllpass(Allpass& ap, size_t write, float* buffer, float* scratch, unsigned int frames)
+{
+	// v[n] = x[n] + g v[n - D], y[n] = v[n - D] - g v[n], frames <= D so v[n - D] is all in the ring
+	ReadRing(ap.ring_, write - ap.delay_, scratch, frames);
+	const float g = ap.coef_;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		const float delayed = scratch[i];
+		const float v = buffer[i] + g * delayed;
+		buffer[i] = delayed - g * v;
+		scratch[i] = v;
+	}
+	FlushTiny(scratch, frames);
+	WriteRing(ap.ring_, write, scratch, frames);
+}
+
+void MixerReverb::ProcessBlock(float* buffer, unsigned int frames)
+{
+	const unsigned int ch = channels_;
+	float* mono = mono_.data();
+	float* scratch = scratch_.data();
+	float* side[2] = { side_[0].data(), side_[1].data() };
+
+	// mono input through the room filter, a lowpass whose upper band is scaled by RoomFilterHF
+	const float toMono = 1.0f / ch;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		float sum = 0.0f;
+		for (unsigned int c = 0; c < ch; c++)
+		{
+			sum += buffer[i * ch + c];
+		}
+		mono[i] = sum * toMono;
+	}
+	float room = room_;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		room += roomCoef_ * (mono[i] - room);
+		mono[i] = roomMain_ * (room + roomHF_ * (mono[i] - room));
+	}
+	FlushTiny(&room, 1);
+	room_ = room;
+
+	// written first, so a tap at delay 0 reads this block
+	WriteRing(preDelay_, write_, mono, frames);
+
+	std::fill(side[0], side[0] + frames, 0.0f);
+	std::fill(side[1], side[1] + frames, 0.0f);
+	for (unsigned int k = 0; k < TapCount; k++)
+	{
+		ReadRing(preDelay_, write_ - tapDelay_[k], scratch, frames);
+		float* s = side[k & 1];
+		const float g = tapGain_[k];
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			s[i] += g * scratch[i];
+		}
+	}
+	RunAllpass(early_[0], write_, side[0], scratch, frames);
+	RunAllpass(early_[1], write_, side[1], scratch, frames);
+
+	if (late_)
+	{
+		float* in = lateIn_.data();
+		ReadRing(preDelay_, write_ - lateDelay_, in, frames);
+		for (auto& d : diffuser_)
+		{
+			RunAllpass(d, write_, in, scratch, frames);
+		}
+
+		float* lane[LineCount];
+		for (unsigned int j = 0; j < LineCount; j++)
+		{
+			lane[j] = lane_[j].data();
+			ReadRing(line_[j], write_ - lineDelay_[j], lane[j], frames);
+		}
+
+		// the band split is the only recursion, the 8 lines step together so their chains overlap
+		// every other step is an elementwise loop over one lane
+		float low[LineCount];
+		float high[LineCount];
+		std::copy(lowState_, lowState_ + LineCount, low);
+		std::copy(highState_, highState_ + LineCount, high);
+		for (unsigned int i = 0; i < frames; i++)
+		{
+			for (unsigned int j = 0; j < LineCount; j++)
+			{
+				const float x = lane[j][i];
+				low[j] += lowCoef_ * (x - low[j]);
+				high[j] += highCoef_ * (x - high[j]);
+				lane[j][i] = lowGain_[j] * low[j] + midGain_[j] * (high[j] - low[j]) + highGain_[j] * (x - high[j]);
+			}
+		}
+		FlushTiny(low, LineCount);
+		FlushTiny(high, LineCount);
+		std::copy(low, low + LineCount, lowState_);
+		std::copy(high, high + LineCount, highState_);
+
+		for (unsigned int j = 0; j < LineCount; j++)
+		{
+			// lines alternate sides, every other pair inverted so the sides decorrelate
+			const float* x = lane[j];
+			float* s = side[j & 1];
+			const float g = (j & 2) ? -lateGain_ : lateGain_;
+			for (unsigned int i = 0; i < frames; i++)
+			{
+				s[i] += g * x[i];
+			}
+		}
+
+		// 8 point Hadamard feedback matrix as butterflies across the lanes
+		for (unsigned int span = 1; span < LineCount; span <<= 1)
+		{
+			for (unsigned int j = 0; j < LineCount; j += span * 2)
+			{
+				for (unsigned int k = j; k < j + span; k++)
+				{
+					float* a = lane[k];
+					float* b = lane[k + span];
+					for (unsigned int i = 0; i < frames; i++)
+					{
+						const float x = a[i];
+						a[i] = x + b[i];
+						b[i] = x - b[i];
+					}
+				}
+			}
+		}
+
+		const float norm = 1.0f / std::sqrt(static_cast<float>(LineCount));
+		for (unsigned int j = 0; j < LineCount; j++)
+		{
+			float* x = lane[j];
+			const float g = (j & 1) ? -LateInputGain : LateInputGain;
+			for (unsigned int i = 0; i < frames; i++)
+			{
+				x[i] = x[i] * norm + g * in[i];
+			}
+			FlushTiny(x, frames);
+			WriteRing(line_[j], write_, x, frames);
+		}
+	}
+
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		for (unsigned int c = 0; c < ch; c++)
+		{
+			float& s = buffer[i * ch + c];
+			s = dry_ * s + wet_ * side[c & 1][i];
+		}
+	}
+
+	write_ += frames;
+}
@@ -0,0 +1,145 @@
+#include "RealFFT.h"
+#include <cmath>
+
+namespace
+{
+	constexpr double Pi = 3.14159265358979323846;
+}
+
+RealFFT::RealFFT(unsigned int size) :
+	size_(size), half_(size / 2), reverse_(size / 2), stageRe_(size / 2), stageIm_(size / 2),
+	splitRe_(size / 2), splitIm_(size / 2), re_(size / 2), im_(size / 2)
+{
+	unsigned int bits = 0;
+	while ((1u << bits) < half_) { bits++; }
+	for (unsigned int i = 0; i < half_; i++)
+	{
+		unsigned int r = 0;
+		for (unsigned int b = 0; b < bits; b++)
+		{
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		reverse_[i] = r;
+	}
+
+	// contiguous per stage so the butterflies of a group read them in order
+	for (unsigned int len = 8; len <= half_; len <<= 1)
+	{
+		const unsigned int h = len / 2;
+		for (unsigned int k = 0; k < h; k++)
+		{
+			stageRe_[h + k] = static_cast<float>(std::cos(-2.0 * Pi * k / len));
+			stageIm_[h + k] = static_cast<float>(std::sin(-2.0 * Pi * k / len));
+		}
+	}
+	for (unsigned int k = 0; k < half_; k++)
+	{
+		splitRe_[k] = static_cast<float>(std::cos(-2.0 * Pi * k / size_));
+		splitIm_[k] = static_cast<float>(std::sin(-2.0 * Pi * k / size_));
+	}
+}
+
+void RealFFT::Transform(void)
+{
+	const unsigned int n = half_;
+	float* re = re_.data();
+	float* im = im_.data();
+
+	// the first two stages have trivial twiddles, both in one pass
+	if (n >= 4)
+	{
+		for (unsigned int i = 0; i < n; i += 4)
+		{
+			const float r0 = re[i] + re[i + 1], i0 = im[i] + im[i + 1];
+			const float r1 = re[i] - re[i + 1], i1 = im[i] - im[i + 1];
+			const float r2 = re[i + 2] + re[i + 3], i2 = im[i + 2] + im[i + 3];
+			const float r3 = re[i + 2] - re[i + 3], i3 = im[i + 2] - im[i + 3];
+			re[i] = r0 + r2; im[i] = i0 + i2;
+			re[i + 2] = r0 - r2; im[i + 2] = i0 - i2;
+			// times -i
+			re[i + 1] = r1 + i3; im[i + 1] = i1 - r3;
+			re[i + 3] = r1 - i3; im[i + 3] = i1 + r3;
+		}
+	}
+	else if (n == 2)
+	{
+		const float r = re[0] - re[1], i = im[0] - im[1];
+		re[0] += re[1]; im[0] += im[1];
+		re[1] = r; im[1] = i;
+	}
+
+	for (unsigned int len = 8; len <= n; len <<= 1)
+	{
+		const unsigned int h = len / 2;
+		const float* wr = stageRe_.data() + h;
+		const float* wi = stageIm_.data() + h;
+		for (unsigned int g = 0; g < n; g += len)
+		{
+			float* ar = re + g;
+			float* ai = im + g;
+			float* br = re + g + h;
+			float* bi = im + g + h;
+			for (unsigned int k = 0; k < h; k++)
+			{
+				const float tr = br[k] * wr[k] - bi[k] * wi[k];
+				const float ti = br[k] * wi[k] + bi[k] * wr[k];
+				br[k] = ar[k] - tr;
+				bi[k] = ai[k] - ti;
+				ar[k] += tr;
+				ai[k] += ti;
+			}
+		}
+	}
+}
+
+void RealFFT::Forward(const float* in, float* re, float* im)
+{
+	const unsigned int n = half_;
+	// even samples as the real part, odd ones as the imaginary part
+	for (unsigned int i = 0; i < n; i++)
+	{
+		re_[reverse_[i]] = in[i * 2];
+		im_[reverse_[i]] = in[i * 2 + 1];
+	}
+	Transform();
+
+	re[0] = re_[0] + im_[0];
+	im[0] = 0.0f;
+	re[n] = re_[0] - im_[0];
+	im[n] = 0.0f;
+	for (unsigned int k = 1; k < n; k++)
+	{
+		// even and odd half spectra from bin k and the mirror of bin n - k
+		const float zr = re_[k], zi = im_[k];
+		const float mr = re_[n - k], mi = -im_[n - k];
+		const float er = (zr + mr) * 0.5f, ei = (zi + mi) * 0.5f;
+		const float or_ = (zi - mi) * 0.5f, oi = (mr - zr) * 0.5f;
+		re[k] = er + or_ * splitRe_[k] - oi * splitIm_[k];
+		im[k] = ei + or_ * splitIm_[k] + oi * splitRe_[k];
+	}
+}
+
+void RealFFT::Inverse(const float* re, const float* im, float* out)
+{
+	const unsigned int n = half_;
+	// rebuilt half size spectrum, conjugated so the forward transform inverts it
+	for (unsigned int k = 0; k < n; k++)
+	{
+		const float xr = re[k], xi = im[k];
+		const float mr = re[n - k], mi = -im[n - k];
+		const float er = xr + mr, ei = xi + mi;
+		const float dr = xr - mr, di = xi - mi;
+		// the odd part, (x - conj(mirror)) / w
+		const float or_ = dr * splitRe_[k] + di * splitIm_[k];
+		const float oi = di * splitRe_[k] - dr * splitIm_[k];
+		re_[reverse_[k]] = er - oi;
+		im_[reverse_[k]] = -(ei + or_);
+	}
+	Transform();
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		out[i * 2] = re_[i];
+		out[i * 2 + 1] = -im_[i];
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+
+// FFT of real signals, a complex FFT of half the size plus one split pass
+// spectra are split in real and imaginary arrays of size / 2 + 1 bins
+class RealFFT
+{
+public:
+	// size is a power of two, 4 at least
+	explicit RealFFT(unsigned int size);
+
+	unsigned int GetSize(void) const { return size_; }
+	unsigned int GetBins(void) const { return half_ + 1; }
+
+	void Forward(const float* in, float* re, float* im);
+	// unscaled, Inverse of Forward gives the signal times GetSize()
+	void Inverse(const float* re, const float* im, float* out);
+private:
+	// in place on re_ / im_, input in bit reversed order
+	void Transform(void);
+
+	unsigned int size_;
+	unsigned int half_;
+
+	std::vector<unsigned int> reverse_;
+	// twiddles of every stage after the first two, stage of length len at offset len / 2
+	std::vector<float> stageRe_;
+	std::vector<float> stageIm_;
+	// exp(-2 pi i k / size) for the split pass
+	std::vector<float> splitRe_;
+	std::vector<float> splitIm_;
+
+	std::vector<float> re_;
+	std::vector<float> im_;
+};
@@ -9,6 +9,17 @@ enum class AudioEffectType
 	Equalizer,
 	MasteringLimiter,
 	FXReverb,
+	// software mixer only, the impulse response comes from AudioManager::LoadConvolutionImpulse
+	Convolution,
 
 
 };
+
+// parameters of AudioEffectType::Convolution
+struct ConvolutionParameters
+{
+	// share of the convolved signal in percent, 0 to 100
+	float WetDryMix;
+	// linear gain of the convolved signal, 0 or more
+	float Gain;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "WAVDefines.h"
+
+// handed out by LoadSoundAsync / LoadBatchAsync, 0 is never issued
+using LoadTicket = unsigned int;
+
+struct LoadRequest
+{
+	std::string filename_;
+	std::string key_;
+	WAVLoadMode mode_ = WAVLoadMode::Copy;
+};
+
+struct LoadRecord
+{
+	std::string filename_;
+	// size of the data chunk, 0 when the file failed
+	unsigned int bytes_ = 0;
+	// time the worker spent on this file
+	double seconds_ = 0.0;
+	bool succeeded_ = false;
+};
+
+struct LoadReport
+{
+	// in completion order
+	std::vector<LoadRecord> records_;
+	unsigned int failed_ = 0;
+	uint64_t bytes_ = 0;
+	// from the request to the last file parsed
+	double seconds_ = 0.0;
+
+	double GetThroughput(void) const { return seconds_ > 0.0 ? static_cast<double>(bytes_) / seconds_ : 0.0; }
+};
+
+// called from Update once every file of the ticket is done
+using LoadCallback = std::function<void(LoadTicket, const LoadReport&)>;
+
+// one ticket in flight, kept by AudioManager
+struct LoadTicketState
+{
+	unsigned int remaining_ = 0;
+	std::chrono::steady_clock::time_point start_;
+	std::chrono::steady_clock::time_point last_;
+	LoadReport report_;
+	LoadCallback callback_;
+};
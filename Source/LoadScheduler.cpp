@@ -0,0 +1,80 @@
+#include "LoadScheduler.h"
+
+LoadResult::~LoadResult()
+{
+	WAVLoader::FreeWAVData(data_);
+}
+
+LoadScheduler::LoadScheduler(const WAVLoader& loader, unsigned int threadCount)
+	: loader_(loader)
+{
+	if (threadCount == 0) { threadCount = 1; }
+
+	thread_.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		thread_.emplace_back([this]() { Run(); });
+	}
+}
+
+LoadScheduler::~LoadScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_ = false;
+		job_.clear();
+	}
+	wake_.notify_all();
+
+	for (auto& t : thread_)
+	{
+		t.join();
+	}
+}
+
+void LoadScheduler::Push(std::vector<LoadJob>& jobs)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& j : jobs)
+		{
+			job_.emplace_back(std::move(j));
+		}
+	}
+	wake_.notify_all();
+}
+
+void LoadScheduler::TakeResults(std::vector<std::unique_ptr<LoadResult>>& results)
+{
+	std::lock_guard<std::mutex> lock(resultMutex_);
+	for (auto& r : result_)
+	{
+		results.emplace_back(std::move(r));
+	}
+	result_.clear();
+}
+
+void LoadScheduler::Run(void)
+{
+	for (;;)
+	{
+		std::unique_ptr<LoadResult> result(new LoadResult());
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [this]() { return !running_ || !job_.empty(); });
+			if (!running_) { return; }
+
+			result->job_ = std::move(job_.front());
+			job_.pop_front();
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		result->succeeded_ = loader_.ReadWAVFile(result->job_.filename_, result->job_.mode_,
+			result->data_, result->mapping_);
+		result->finished_ = std::chrono::steady_clock::now();
+		result->seconds_ = std::chrono::duration<double>(result->finished_ - begin).count();
+
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		result_.emplace_back(std::move(result));
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LoadDefines.h"
+#include "MappedFile.h"
+#include "WAVLoader.h"
+
+struct LoadJob
+{
+	LoadTicket ticket_;
+	std::string filename_;
+	std::string key_;
+	WAVLoadMode mode_;
+};
+
+struct LoadResult
+{
+	LoadResult() = default;
+	~LoadResult();
+	LoadResult(const LoadResult&) = delete;
+	LoadResult& operator=(const LoadResult&) = delete;
+
+	LoadJob job_;
+	bool succeeded_ = false;
+
+	// freed with the result unless WAVLoader::AddWAVFile took it
+	WAVData data_ = {};
+	std::unique_ptr<MappedFile> mapping_;
+
+	double seconds_ = 0.0;
+	std::chrono::steady_clock::time_point finished_;
+};
+
+// worker threads parsing wave files off the control thread
+// results wait until the control thread takes them, the loader table is never touched here
+class LoadScheduler
+{
+public:
+	LoadScheduler(const WAVLoader& loader, unsigned int threadCount);
+	// queued jobs are dropped, files being parsed are finished and freed
+	~LoadScheduler();
+	LoadScheduler(const LoadScheduler&) = delete;
+	LoadScheduler& operator=(const LoadScheduler&) = delete;
+
+	void Push(std::vector<LoadJob>& jobs);
+
+	// results finished since the last call, appended in completion order
+	void TakeResults(std::vector<std::unique_ptr<LoadResult>>& results);
+
+	unsigned int GetThreadCount(void) const { return static_cast<unsigned int>(thread_.size()); }
+private:
+	void Run(void);
+
+	const WAVLoader& loader_;
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::deque<LoadJob> job_;
+	bool running_ = true;
+
+	std::mutex resultMutex_;
+	std::vector<std::unique_ptr<LoadResult>> result_;
+
+	std::vector<std::thread> thread_;
+};
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() :file_(INVALID_HANDLE_VALUE), mapping_(nullptr), data_(nullptr), size_(0)
+{
+}
+#else
+MappedFile::MappedFile() :fd_(-1), data_(nullptr), size_(0)
+{
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+#ifdef _WIN32
+	file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE) { return false; }
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) { Close(); return false; }
+
+	mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_ == nullptr) { Close(); return false; }
+
+	data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == nullptr) { Close(); return false; }
+	size_ = static_cast<size_t>(size.QuadPart);
+#else
+	fd_ = open(filename.c_str(), O_RDONLY);
+	if (fd_ < 0) { return false; }
+
+	struct stat st;
+	if (fstat(fd_, &st) != 0 || st.st_size == 0) { Close(); return false; }
+
+	void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+	if (p == MAP_FAILED) { Close(); return false; }
+
+	data_ = static_cast<const unsigned char*>(p);
+	size_ = static_cast<size_t>(st.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::Close(void)
+{
+#ifdef _WIN32
+	if (data_ != nullptr)
+	{
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_ != nullptr)
+	{
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+	if (file_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data_ != nullptr)
+	{
+		munmap(const_cast<unsigned char*>(data_), size_);
+	}
+	if (fd_ >= 0)
+	{
+		close(fd_);
+		fd_ = -1;
+	}
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
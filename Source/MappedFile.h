@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// read-only view of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close(void);
+
+	const unsigned char* GetData(void) const { return data_; }
+	size_t GetSize(void) const { return size_; }
+private:
+#ifdef _WIN32
+	void* file_;
+	void* mapping_;
+#else
+	int fd_;
+#endif
+	const unsigned char* data_;
+	size_t size_;
+};
@@ -0,0 +1,127 @@
+#include "PCMConvert.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Backend/AudioPlatform.h"
+#include "Backend/MixerKernels.h"
+
+namespace
+{
+	// zero crossings on each side of the sinc, 32 taps per output sample
+	constexpr int SincHalfWidth = 16;
+	// the table is read with linear interpolation between phases
+	constexpr int SincPhases = 512;
+
+	// Blackman windowed sinc sampled at SincPhases steps per input frame
+	const std::vector<float>& GetSincTable(void)
+	{
+		static const std::vector<float> table = []()
+			{
+				const double pi = 3.14159265358979323846;
+				std::vector<float> t(SincHalfWidth * SincPhases + 1);
+				for (size_t i = 0; i < t.size(); i++)
+				{
+					const double x = static_cast<double>(i) / SincPhases;
+					const double sinc = i == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+					const double w = x / SincHalfWidth;
+					const double window = 0.42 + 0.5 * std::cos(pi * w) + 0.08 * std::cos(2.0 * pi * w);
+					t[i] = static_cast<float>(sinc * window);
+				}
+				return t;
+			}();
+		return table;
+	}
+}
+
+bool ConvertToFloat(const unsigned char* data, size_t samples, uint16_t formatType, uint16_t bitPerSample, float* out)
+{
+	const MixerKernels& kernels = GetMixerKernels();
+
+	if (formatType == WAVE_FORMAT_IEEE_FLOAT)
+	{
+		switch (bitPerSample)
+		{
+		case 32:
+			std::memcpy(out, data, samples * sizeof(float));
+			return true;
+		case 64:
+			for (size_t i = 0; i < samples; i++)
+			{
+				double v;
+				std::memcpy(&v, data + i * sizeof(double), sizeof(v));
+				out[i] = static_cast<float>(v);
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+	if (formatType != WAVE_FORMAT_PCM) { return false; }
+
+	switch (bitPerSample)
+	{
+	case 8:
+		for (size_t i = 0; i < samples; i++)
+		{
+			out[i] = (static_cast<int>(data[i]) - 128) * (1.0f / 128.0f);
+		}
+		return true;
+	case 16:
+		kernels.pcm16ToFloat_(reinterpret_cast<const int16_t*>(data), out, samples);
+		return true;
+	case 24:
+		kernels.pcm24ToFloat_(data, out, samples);
+		return true;
+	case 32:
+		for (size_t i = 0; i < samples; i++)
+		{
+			int32_t v;
+			std::memcpy(&v, data + i * sizeof(int32_t), sizeof(v));
+			out[i] = static_cast<float>(v * (1.0 / 2147483648.0));
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::vector<float> ResampleFloat(const float* in, size_t frames, unsigned int channel, unsigned int fromRate, unsigned int toRate)
+{
+	if (fromRate == toRate || fromRate == 0 || toRate == 0)
+	{
+		return std::vector<float>(in, in + frames * channel);
+	}
+
+	const size_t outFrames = static_cast<size_t>((static_cast<uint64_t>(frames) * toRate + fromRate - 1) / fromRate);
+	std::vector<float> out(outFrames * channel, 0.0f);
+
+	const std::vector<float>& table = GetSincTable();
+	const double step = static_cast<double>(fromRate) / toRate;
+	// downsampling stretches the sinc so the cutoff sits at the new Nyquist
+	const double scale = std::min(1.0, 1.0 / step);
+	const double reach = SincHalfWidth / scale;
+
+	for (size_t o = 0; o < outFrames; o++)
+	{
+		const double center = o * step;
+		const long long first = std::max<long long>(0, static_cast<long long>(std::ceil(center - reach)));
+		const long long last = std::min<long long>(static_cast<long long>(frames) - 1, static_cast<long long>(std::floor(center + reach)));
+
+		float* dst = &out[o * channel];
+		for (long long i = first; i <= last; i++)
+		{
+			const double phase = std::fabs(i - center) * scale * SincPhases;
+			const size_t index = static_cast<size_t>(phase);
+			if (index >= table.size() - 1) { continue; }
+
+			const float frac = static_cast<float>(phase - index);
+			const float weight = static_cast<float>((table[index] + (table[index + 1] - table[index]) * frac) * scale);
+			const float* src = &in[static_cast<size_t>(i) * channel];
+			for (unsigned int c = 0; c < channel; c++)
+			{
+				dst[c] += src[c] * weight;
+			}
+		}
+	}
+	return out;
+}
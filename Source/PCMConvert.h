@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// load time conversion of wave data to the float samples the mixers run on
+
+// interleaved PCM (8, 16, 24, 32 bit) or IEEE float (32, 64 bit) to float
+// false when the format is none of those
+bool ConvertToFloat(const unsigned char* data, size_t samples, uint16_t formatType, uint16_t bitPerSample, float* out);
+
+// windowed sinc, band limited to the lower of the two rates
+// frames is the input length, the output has frames * toRate / fromRate frames rounded up
+std::vector<float> ResampleFloat(const float* in, size_t frames, unsigned int channel, unsigned int fromRate, unsigned int toRate);
@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// fixed size owner array addressed by slot index
+// free slots are chained through the slots themselves, so Add / Remove are O(1)
+// each slot counts how many times it was released to detect stale handles
+// Reserve / Release may be called from any thread, everything else from the owner thread
+template<class T, size_t Size>
+class SlotArray
+{
+public:
+	SlotArray()
+	{
+		for (size_t i = 0; i < Size; i++)
+		{
+			slot_[i].next_.store(i + 1 < Size ? static_cast<int>(i + 1) : -1, std::memory_order_relaxed);
+		}
+		freeHead_.store(0, std::memory_order_relaxed);
+		live_.reserve(Size);
+	}
+
+	~SlotArray()
+	{
+		Clear();
+	}
+
+	// returns the slot index, -1 when full
+	int Add(T* value)
+	{
+		int index = Reserve();
+		if (index < 0) { return -1; }
+
+		Emplace(index, value);
+		return index;
+	}
+
+	void Remove(int index)
+	{
+		Slot& s = slot_[index];
+		if (!s.value_) { return; }
+
+		// unlink before destroying, the destructor may look at this array
+		std::unique_ptr<T> value = std::move(s.value_);
+
+		int last = live_.back();
+		live_[s.live_] = last;
+		slot_[last].live_ = s.live_;
+		live_.pop_back();
+
+		Release(index);
+
+		value.reset();
+	}
+
+	void Clear(void)
+	{
+		while (!live_.empty())
+		{
+			Remove(live_.back());
+		}
+	}
+
+	// takes a free slot without filling it, -1 when full
+	int Reserve(void)
+	{
+		uint64_t head = freeHead_.load(std::memory_order_acquire);
+		for (;;)
+		{
+			int index = static_cast<int32_t>(head & 0xffffffff);
+			if (index < 0) { return -1; }
+
+			// the tag in the upper half keeps a recycled head from passing the exchange
+			uint64_t next = static_cast<uint32_t>(slot_[index].next_.load(std::memory_order_relaxed));
+			if (freeHead_.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next,
+				std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return index;
+			}
+		}
+	}
+
+	// fills a reserved slot
+	void Emplace(int index, T* value)
+	{
+		Slot& s = slot_[index];
+		s.value_.reset(value);
+		s.live_ = static_cast<int>(live_.size());
+		live_.emplace_back(index);
+	}
+
+	// gives back a reserved slot that was never filled
+	void Release(int index)
+	{
+		Slot& s = slot_[index];
+		s.generation_.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t head = freeHead_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			s.next_.store(static_cast<int32_t>(head & 0xffffffff), std::memory_order_relaxed);
+			if (freeHead_.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | static_cast<uint32_t>(index),
+				std::memory_order_release, std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+	}
+
+	std::unique_ptr<T>& operator[](int index) { return slot_[index].value_; }
+	const std::unique_ptr<T>& operator[](int index) const { return slot_[index].value_; }
+
+	unsigned int GetGeneration(int index) const { return slot_[index].generation_.load(std::memory_order_relaxed); }
+
+	// occupied slots, unordered
+	const std::vector<int>& GetSlotList(void) const { return live_; }
+private:
+	struct Slot
+	{
+		std::unique_ptr<T> value_;
+		std::atomic<unsigned int> generation_ = 0;
+		// next free slot, valid while free
+		std::atomic<int> next_ = -1;
+		// position in live_, valid while used
+		int live_ = -1;
+	};
+
+	std::array<Slot, Size> slot_;
+	std::vector<int> live_;
+
+	// (tag << 32) | first free slot
+	std::atomic<uint64_t> freeHead_;
+};
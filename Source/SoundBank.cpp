@@ -0,0 +1,64 @@
+#include "SoundBank.h"
+#include <algorithm>
+#include <cstring>
+
+bool SoundBank::Open(const std::string& filename)
+{
+	header_ = nullptr;
+	if (!file_.Open(filename)) { return false; }
+
+	const unsigned char* base = file_.GetData();
+	const size_t size = file_.GetSize();
+	if (size < sizeof(SoundBankHeader)) { file_.Close(); return false; }
+
+	const SoundBankHeader* header = reinterpret_cast<const SoundBankHeader*>(base);
+	if (std::memcmp(header->magic_, SoundBankMagic, sizeof(SoundBankMagic)) != 0 ||
+		header->version_ != SoundBankVersion ||
+		header->fileSize_ > size ||
+		header->indexOffset_ % alignof(SoundBankEntry) != 0 ||
+		static_cast<uint64_t>(header->indexOffset_) + static_cast<uint64_t>(header->entryCount_) * sizeof(SoundBankEntry) > header->fileSize_ ||
+		static_cast<uint64_t>(header->stringOffset_) + header->stringSize_ > header->fileSize_)
+	{
+		file_.Close();
+		return false;
+	}
+
+	header_ = header;
+	entry_ = reinterpret_cast<const SoundBankEntry*>(base + header->indexOffset_);
+	string_ = reinterpret_cast<const char*>(base + header->stringOffset_);
+	return true;
+}
+
+const char* SoundBank::GetKey(const SoundBankEntry& entry) const
+{
+	// the terminator must be inside the table as well
+	if (static_cast<uint64_t>(entry.keyOffset_) + entry.keyLength_ >= header_->stringSize_) { return nullptr; }
+	return string_ + entry.keyOffset_;
+}
+
+const unsigned char* SoundBank::GetData(const SoundBankEntry& entry) const
+{
+	if (static_cast<uint64_t>(entry.dataOffset_) + entry.dataSize_ > header_->fileSize_) { return nullptr; }
+	return file_.GetData() + entry.dataOffset_;
+}
+
+const SoundBankEntry* SoundBank::Find(const std::string& key) const
+{
+	if (header_ == nullptr) { return nullptr; }
+
+	const uint64_t hash = HashSoundKey(key.data(), key.size());
+	const SoundBankEntry* end = entry_ + header_->entryCount_;
+	const SoundBankEntry* it = std::lower_bound(entry_, end, hash,
+		[](const SoundBankEntry& e, uint64_t h) { return e.hash_ < h; });
+
+	// different keys may share a hash, they sit next to each other
+	for (; it != end && it->hash_ == hash; ++it)
+	{
+		const char* k = GetKey(*it);
+		if (k != nullptr && it->keyLength_ == key.size() && std::memcmp(k, key.data(), key.size()) == 0)
+		{
+			return it;
+		}
+	}
+	return nullptr;
+}
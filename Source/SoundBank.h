@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+#include "SoundId.h"
+
+// layout of a packed sound bank, all little endian
+//   SoundBankHeader
+//   SoundBankEntry[entryCount_]  sorted by hash_
+//   key strings, NUL terminated
+//   PCM blobs, each aligned to SoundBankAlignment
+constexpr char SoundBankMagic[4] = { 'S', 'C', 'A', 'B' };
+constexpr uint32_t SoundBankVersion = 1;
+constexpr uint32_t SoundBankAlignment = 64;
+
+struct SoundBankHeader
+{
+	char magic_[4];
+	uint32_t version_;
+	uint32_t entryCount_;
+	uint32_t indexOffset_;
+	uint32_t stringOffset_;
+	uint32_t stringSize_;
+	uint32_t dataOffset_;
+	uint32_t fileSize_;
+};
+
+// fmt chunk of the sound is stored parsed, the runtime copies it as is
+struct SoundBankEntry
+{
+	// HashSoundKey of the key, the SoundId of the sound
+	uint64_t hash_;
+	// into the string table
+	uint32_t keyOffset_;
+	uint32_t keyLength_;
+	// from the top of the file
+	uint32_t dataOffset_;
+	uint32_t dataSize_;
+
+	uint16_t formatType_;
+	uint16_t channel_;
+	uint32_t samplesPerSec_;
+	uint32_t bytePerSec_;
+	uint16_t blockAlign_;
+	uint16_t bitPerSample_;
+};
+
+static_assert(sizeof(SoundBankHeader) == 32, "sound bank header layout changed");
+static_assert(sizeof(SoundBankEntry) == 40, "sound bank entry layout changed");
+
+// read-only view of a bank, the entries point straight into the mapping
+class SoundBank
+{
+public:
+	SoundBank() = default;
+	SoundBank(const SoundBank&) = delete;
+	SoundBank& operator=(const SoundBank&) = delete;
+
+	// checks the header and the table bounds, the sounds themselves are not touched
+	bool Open(const std::string& filename);
+
+	unsigned int GetEntryCount(void) const { return header_ != nullptr ? header_->entryCount_ : 0; }
+	const SoundBankEntry& GetEntry(unsigned int index) const { return entry_[index]; }
+
+	// nullptr when the entry points outside the file
+	const char* GetKey(const SoundBankEntry& entry) const;
+	const unsigned char* GetData(const SoundBankEntry& entry) const;
+
+	// binary search on the hash, nullptr when missing
+	const SoundBankEntry* Find(const std::string& key) const;
+private:
+	MappedFile file_;
+	const SoundBankHeader* header_ = nullptr;
+	const SoundBankEntry* entry_ = nullptr;
+	const char* string_ = nullptr;
+};
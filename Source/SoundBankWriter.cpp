@@ -0,0 +1,130 @@
+#include "SoundBankWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "MappedFile.h"
+#include "SoundBank.h"
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool WritePadding(FILE* fp, uint64_t from, uint64_t to)
+	{
+		static const unsigned char zero[SoundBankAlignment] = {};
+		return to == from || fwrite(zero, 1, static_cast<size_t>(to - from), fp) == to - from;
+	}
+}
+
+SoundBankWriter::~SoundBankWriter()
+{
+	for (auto& s : sound_)
+	{
+		WAVLoader::FreeWAVData(s.data_);
+	}
+}
+
+bool SoundBankWriter::Add(const std::string& key, const std::string& filename)
+{
+	for (auto& s : sound_)
+	{
+		if (s.key_ == key) { return false; }
+	}
+
+	Sound sound;
+	sound.key_ = key;
+	sound.data_ = {};
+	std::unique_ptr<MappedFile> mapping;
+	if (!loader_.ReadWAVFile(filename, WAVLoadMode::Copy, sound.data_, mapping))
+	{
+		return false;
+	}
+	sound_.emplace_back(std::move(sound));
+	return true;
+}
+
+bool SoundBankWriter::Write(const std::string& filename)
+{
+	// sorted once here so the runtime only binary searches
+	std::vector<SoundBankEntry> entry(sound_.size());
+	std::vector<const Sound*> order(sound_.size());
+	for (size_t i = 0; i < sound_.size(); i++)
+	{
+		order[i] = &sound_[i];
+	}
+	std::sort(order.begin(), order.end(), [](const Sound* a, const Sound* b)
+		{
+			uint64_t ha = HashSoundKey(a->key_.data(), a->key_.size());
+			uint64_t hb = HashSoundKey(b->key_.data(), b->key_.size());
+			return ha != hb ? ha < hb : a->key_ < b->key_;
+		});
+
+	SoundBankHeader header = {};
+	std::memcpy(header.magic_, SoundBankMagic, sizeof(SoundBankMagic));
+	header.version_ = SoundBankVersion;
+	header.entryCount_ = static_cast<uint32_t>(order.size());
+	header.indexOffset_ = sizeof(SoundBankHeader);
+
+	const uint64_t stringOffset = header.indexOffset_ + entry.size() * sizeof(SoundBankEntry);
+	uint64_t stringSize = 0;
+	for (auto& s : order)
+	{
+		stringSize += s->key_.size() + 1;
+	}
+
+	uint64_t cursor = AlignUp(stringOffset + stringSize, SoundBankAlignment);
+	const uint64_t dataOffset = cursor;
+	uint32_t keyOffset = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Sound& s = *order[i];
+		SoundBankEntry& e = entry[i];
+		e.hash_ = HashSoundKey(s.key_.data(), s.key_.size());
+		e.keyOffset_ = keyOffset;
+		e.keyLength_ = static_cast<uint32_t>(s.key_.size());
+		e.dataOffset_ = static_cast<uint32_t>(cursor);
+		e.dataSize_ = s.data_.dataSize_;
+		e.formatType_ = s.data_.fmt_.formatType_;
+		e.channel_ = s.data_.fmt_.channel_;
+		e.samplesPerSec_ = s.data_.fmt_.samplesPerSec_;
+		e.bytePerSec_ = s.data_.fmt_.bytePerSec_;
+		e.blockAlign_ = s.data_.fmt_.blockAlign_;
+		e.bitPerSample_ = s.data_.fmt_.bitPerSample_;
+
+		keyOffset += e.keyLength_ + 1;
+		cursor = AlignUp(cursor + e.dataSize_, SoundBankAlignment);
+	}
+
+	// offsets are 32 bit
+	if (cursor > UINT32_MAX) { return false; }
+
+	header.stringOffset_ = static_cast<uint32_t>(stringOffset);
+	header.stringSize_ = static_cast<uint32_t>(stringSize);
+	header.dataOffset_ = static_cast<uint32_t>(dataOffset);
+	header.fileSize_ = static_cast<uint32_t>(cursor);
+
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, filename.c_str(), "wb") != 0) { return false; }
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && (entry.empty() || fwrite(entry.data(), sizeof(SoundBankEntry), entry.size(), fp) == entry.size());
+	for (auto& s : order)
+	{
+		ok = ok && fwrite(s->key_.c_str(), 1, s->key_.size() + 1, fp) == s->key_.size() + 1;
+	}
+	ok = ok && WritePadding(fp, stringOffset + stringSize, dataOffset);
+
+	for (size_t i = 0; i < order.size() && ok; i++)
+	{
+		const SoundBankEntry& e = entry[i];
+		ok = e.dataSize_ == 0 || fwrite(order[i]->data_.data_, 1, e.dataSize_, fp) == e.dataSize_;
+		ok = ok && WritePadding(fp, static_cast<uint64_t>(e.dataOffset_) + e.dataSize_,
+			AlignUp(static_cast<uint64_t>(e.dataOffset_) + e.dataSize_, SoundBankAlignment));
+	}
+
+	ok = fclose(fp) == 0 && ok;
+	return ok;
+}
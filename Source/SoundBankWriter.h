@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "WAVLoader.h"
+
+// build side of SoundBank, used by tools to pack loose wave files into one bank
+class SoundBankWriter
+{
+public:
+	SoundBankWriter() = default;
+	~SoundBankWriter();
+	SoundBankWriter(const SoundBankWriter&) = delete;
+	SoundBankWriter& operator=(const SoundBankWriter&) = delete;
+
+	// parses the file right away, false when it fails or the key is taken
+	bool Add(const std::string& key, const std::string& filename);
+
+	bool Write(const std::string& filename);
+
+	size_t GetCount(void) const { return sound_.size(); }
+private:
+	struct Sound
+	{
+		std::string key_;
+		WAVData data_;
+	};
+
+	WAVLoader loader_;
+	std::vector<Sound> sound_;
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include <xaudio2.h>
+#include "Backend/AudioPlatform.h"
 
 class SoundEffectCreator
 {
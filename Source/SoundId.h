@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// FNV-1a over the key bytes, also the hash of the sound bank index
+constexpr uint64_t HashSoundKey(const char* key, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= static_cast<unsigned char>(key[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// integer name of a sound key, "explosion_01"_sid is folded at compile time
+struct SoundId
+{
+	uint64_t value_;
+
+	constexpr bool operator==(const SoundId& other) const { return value_ == other.value_; }
+	constexpr bool operator!=(const SoundId& other) const { return value_ != other.value_; }
+};
+
+constexpr SoundId MakeSoundId(const char* key, size_t length)
+{
+	return SoundId{ HashSoundKey(key, length) };
+}
+
+inline SoundId MakeSoundId(const std::string& key)
+{
+	return MakeSoundId(key.data(), key.size());
+}
+
+constexpr SoundId operator""_sid(const char* key, size_t length)
+{
+	return MakeSoundId(key, length);
+}
+
+template<>
+struct std::hash<SoundId>
+{
+	// already well mixed, only folded to size_t
+	size_t operator()(const SoundId& id) const noexcept
+	{
+		return static_cast<size_t>(id.value_ ^ (id.value_ >> 32));
+	}
+};
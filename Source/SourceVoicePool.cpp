@@ -0,0 +1,108 @@
+#include "SourceVoicePool.h"
+#include "AudioStream.h"
+
+SourceVoicePool::SourceVoicePool(AudioBackend& backend, float maxFrequencyRatio) :
+	backend_(backend), maxFrequencyRatio_(maxFrequencyRatio)
+{
+}
+
+SourceVoicePool::~SourceVoicePool()
+{
+	for (auto& bucket : idle_)
+	{
+		for (auto& v : bucket.second)
+		{
+			v->DestroyVoice();
+		}
+	}
+}
+
+AudioSourceVoice* SourceVoicePool::Acquire(const WAVEFORMATEX& format)
+{
+	auto it = idle_.find(MakeKey(format));
+	if (it != idle_.end() && !it->second.empty())
+	{
+		AudioSourceVoice* voice = it->second.back();
+		it->second.pop_back();
+		stats_.hits_++;
+		stats_.idle_--;
+		stats_.active_++;
+		return voice;
+	}
+
+	stats_.misses_++;
+	AudioSourceVoice* voice = backend_.CreateSourceVoice(format, maxFrequencyRatio_);
+	if (voice != nullptr) { stats_.active_++; }
+	return voice;
+}
+
+void SourceVoicePool::Release(const WAVEFORMATEX& format, AudioSourceVoice* voice)
+{
+	if (voice == nullptr) { return; }
+	stats_.active_--;
+
+	auto& bucket = idle_[MakeKey(format)];
+	if (bucket.size() >= maxIdle_)
+	{
+		voice->DestroyVoice();
+		stats_.discarded_++;
+		return;
+	}
+
+	voice->Stop();
+	voice->FlushSourceBuffers();
+	voice->SetVolume(1.0f);
+	voice->SetFrequencyRatio(1.0f);
+	voice->SetResampleQuality(ResampleQuality::Default);
+	voice->SetFilterParameters(XAUDIO2_FILTER_PARAMETERS{ LowPassFilter,
+		XAUDIO2_MAX_FILTER_FREQUENCY, XAUDIO2_DEFAULT_FILTER_ONEOVERQ });
+
+	// idle voices must not keep a submix alive
+	voice->SetOutputVoices({});
+
+	bucket.emplace_back(voice);
+	stats_.idle_++;
+}
+
+void SourceVoicePool::Warm(const WAVEFORMATEX& format, unsigned int count)
+{
+	auto& bucket = idle_[MakeKey(format)];
+	while (bucket.size() < count)
+	{
+		AudioSourceVoice* voice = backend_.CreateSourceVoice(format, maxFrequencyRatio_);
+		if (voice == nullptr) { return; }
+		bucket.emplace_back(voice);
+		stats_.idle_++;
+	}
+}
+
+std::shared_ptr<AudioStream> SourceVoicePool::AcquireStream(void)
+{
+	if (idleStream_.empty()) { return nullptr; }
+
+	std::shared_ptr<AudioStream> stream = std::move(idleStream_.back());
+	idleStream_.pop_back();
+	return stream;
+}
+
+void SourceVoicePool::ReleaseStream(std::shared_ptr<AudioStream> stream)
+{
+	if (!stream || idleStream_.size() >= maxIdle_) { return; }
+
+	idleStream_.emplace_back(std::move(stream));
+}
+
+void SourceVoicePool::ResetStats(void)
+{
+	stats_.hits_ = 0;
+	stats_.misses_ = 0;
+	stats_.discarded_ = 0;
+}
+
+uint64_t SourceVoicePool::MakeKey(const WAVEFORMATEX& format)
+{
+	return (static_cast<uint64_t>(format.wFormatTag) << 48) |
+		(static_cast<uint64_t>(format.nChannels) << 40) |
+		(static_cast<uint64_t>(format.wBitsPerSample) << 32) |
+		static_cast<uint64_t>(format.nSamplesPerSec);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Backend/AudioBackend.h"
+
+class AudioStream;
+
+struct VoicePoolStats
+{
+	// Acquire served from an idle voice
+	uint64_t hits_ = 0;
+	// Acquire that had to create a voice
+	uint64_t misses_ = 0;
+	// voices destroyed because their bucket was full
+	uint64_t discarded_ = 0;
+	unsigned int idle_ = 0;
+	// handed out by Acquire and not released yet
+	unsigned int active_ = 0;
+};
+
+// keeps stopped source voices bucketed by wave format for reuse
+class SourceVoicePool
+{
+public:
+	SourceVoicePool(AudioBackend& backend, float maxFrequencyRatio);
+	~SourceVoicePool();
+
+	AudioSourceVoice* Acquire(const WAVEFORMATEX& format);
+
+	// stops the voice and resets volume, pitch, filter and sends before keeping it
+	void Release(const WAVEFORMATEX& format, AudioSourceVoice* voice);
+
+	// creates voices until the bucket holds count idle voices
+	void Warm(const WAVEFORMATEX& format, unsigned int count);
+
+	// closed ADPCM decoders kept with the voices, a new play opens one again instead of allocating a ring
+	// nullptr when none is idle, a kept stream is still registered with the reader
+	std::shared_ptr<AudioStream> AcquireStream(void);
+	void ReleaseStream(std::shared_ptr<AudioStream> stream);
+
+	void SetMaxIdlePerFormat(unsigned int count) { maxIdle_ = count; }
+
+	const VoicePoolStats& GetStats(void) const { return stats_; }
+	void ResetStats(void);
+private:
+	static uint64_t MakeKey(const WAVEFORMATEX& format);
+
+	AudioBackend& backend_;
+	float maxFrequencyRatio_;
+	unsigned int maxIdle_ = 64;
+
+	std::unordered_map<uint64_t, std::vector<AudioSourceVoice*>> idle_;
+	std::vector<std::shared_ptr<AudioStream>> idleStream_;
+
+	VoicePoolStats stats_;
+};
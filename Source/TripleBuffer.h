@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// latest value of one writer, read from any number of threads without locks
+// the writer fills the slot after the latest one and never waits, a reader copies the latest slot and
+// takes the copy when the sequence of the slot did not move, which only fails after stalling over two writes
+template<class T>
+class TripleBuffer
+{
+	static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+	static constexpr size_t WordCount = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+public:
+	explicit TripleBuffer(const T& value = T())
+	{
+		Write(value);
+	}
+
+	// writer side
+	void Write(const T& value)
+	{
+		const unsigned int index = (latest_.load(std::memory_order_relaxed) + 1) % 3;
+		Slot& slot = slot_[index];
+
+		// odd while the words are being replaced
+		const uint32_t sequence = slot.sequence_.load(std::memory_order_relaxed);
+		slot.sequence_.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint32_t word[WordCount] = {};
+		std::memcpy(word, &value, sizeof(T));
+		for (size_t i = 0; i < WordCount; i++)
+		{
+			slot.word_[i].store(word[i], std::memory_order_relaxed);
+		}
+
+		slot.sequence_.store(sequence + 2, std::memory_order_release);
+		latest_.store(index, std::memory_order_release);
+	}
+
+	// any thread
+	void Read(T& value) const
+	{
+		uint32_t word[WordCount];
+		for (;;)
+		{
+			const Slot& slot = slot_[latest_.load(std::memory_order_acquire)];
+			const uint32_t sequence = slot.sequence_.load(std::memory_order_acquire);
+			if ((sequence & 1) != 0) { continue; }
+
+			for (size_t i = 0; i < WordCount; i++)
+			{
+				word[i] = slot.word_[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence_.load(std::memory_order_relaxed) == sequence) { break; }
+		}
+		std::memcpy(&value, word, sizeof(T));
+	}
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<uint32_t> sequence_ = 0;
+		std::array<std::atomic<uint32_t>, WordCount> word_ = {};
+	};
+
+	std::array<Slot, 3> slot_;
+	alignas(64) std::atomic<unsigned int> latest_ = 0;
+};
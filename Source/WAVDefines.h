@@ -0,0 +1,21 @@
+#pragma once
+
+
+enum class WAVLoadMode
+{
+	// reads the file and keeps a heap copy of the data chunk
+	Copy,
+	// maps the file and plays straight out of the mapping
+	Mapped,
+	// keeps only the header, Play reads the data chunk from disk block by block
+	Stream,
+	// like Copy, but 16 bit PCM is encoded to IMA ADPCM at load, about a quarter of the memory
+	// played by decoding block by block, ADPCM files are kept as they are in every mode
+	ADPCM,
+};
+
+enum class WAVSampleFormat
+{
+	PCM16,
+	Float32,
+};
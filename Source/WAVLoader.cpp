@@ -1,7 +1,109 @@
 #include "WAVLoader.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "MappedFile.h"
+#include "PCMConvert.h"
 #include "../Utility/utility.h"
 #include "../Window/DisplayException.h"
 
+namespace
+{
+	// "RIFF" + size + "WAVE"
+	constexpr unsigned int RiffHeaderSize = 12;
+	// chunk id + chunk size
+	constexpr unsigned int ChunkHeaderSize = 8;
+	constexpr unsigned int FmtMinSize = 16;
+	// enough for the cbSize extensions used, MS ADPCM is the longest at 50
+	constexpr unsigned int FmtReadSize = 64;
+	// cbSize, samplesPerBlock
+	constexpr unsigned int ADPCMFmtSize = 20;
+	// numCoef and 7 coefficient pairs follow
+	constexpr unsigned int MSADPCMFmtSize = ADPCMFmtSize + 2 + 7 * 4;
+	// cbSize, validBitsPerSample, channelMask, sub format GUID
+	constexpr unsigned int ExtensibleFmtSize = 40;
+	// the sub format GUID is {tag-0000-0010-8000-00AA00389B71}, only the tag differs between formats
+	constexpr unsigned char SubFormatTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+	// what a voice plays as is, 64 bit float only ever plays after ConvertWAVData
+	bool IsPlayableFormat(const FmtDesc& fmt)
+	{
+		if (fmt.formatType_ == WAVE_FORMAT_PCM)
+		{
+			return fmt.bitPerSample_ == 8 || fmt.bitPerSample_ == 16 || fmt.bitPerSample_ == 24 || fmt.bitPerSample_ == 32;
+		}
+		return fmt.formatType_ == WAVE_FORMAT_IEEE_FLOAT && fmt.bitPerSample_ == 32;
+	}
+
+	unsigned short ReadU16(const unsigned char* p)
+	{
+		return static_cast<unsigned short>(p[0] | (p[1] << 8));
+	}
+
+	unsigned int ReadU32(const unsigned char* p)
+	{
+		return static_cast<unsigned int>(p[0]) | (static_cast<unsigned int>(p[1]) << 8) |
+			(static_cast<unsigned int>(p[2]) << 16) | (static_cast<unsigned int>(p[3]) << 24);
+	}
+
+	bool IsFourCC(const unsigned char* p, const char fourcc[4])
+	{
+		return p[0] == fourcc[0] && p[1] == fourcc[1] && p[2] == fourcc[2] && p[3] == fourcc[3];
+	}
+
+	void AddChunk(const unsigned char* header, unsigned int offset, std::vector<RiffChunk>& chunks)
+	{
+		RiffChunk chunk;
+		std::copy(header, header + 4, chunk.id_);
+		chunk.offset_ = offset + ChunkHeaderSize;
+		chunk.size_ = ReadU32(header + 4);
+		chunks.emplace_back(chunk);
+	}
+
+	// hops chunk headers of a file image; size is the whole image
+	void WalkChunks(const unsigned char* file, size_t size, std::vector<RiffChunk>& chunks)
+	{
+		size_t cursor = RiffHeaderSize;
+		while (cursor + ChunkHeaderSize <= size)
+		{
+			AddChunk(&file[cursor], static_cast<unsigned int>(cursor), chunks);
+
+			// chunks are word aligned
+			const auto& chunk = chunks.back();
+			cursor = static_cast<size_t>(chunk.offset_) + chunk.size_ + (chunk.size_ & 1);
+		}
+	}
+
+	// same walk over an open file, only the chunk headers are read
+	void WalkChunks(FILE* fp, size_t size, std::vector<RiffChunk>& chunks)
+	{
+		size_t cursor = RiffHeaderSize;
+		unsigned char header[ChunkHeaderSize];
+		while (cursor + ChunkHeaderSize <= size)
+		{
+			if (fseek(fp, static_cast<long>(cursor), SEEK_SET) != 0) { return; }
+			if (fread_s(header, sizeof(header), sizeof(unsigned char), ChunkHeaderSize, fp) != ChunkHeaderSize) { return; }
+
+			AddChunk(header, static_cast<unsigned int>(cursor), chunks);
+
+			const auto& chunk = chunks.back();
+			cursor = static_cast<size_t>(chunk.offset_) + chunk.size_ + (chunk.size_ & 1);
+		}
+	}
+}
+
+const RiffChunk* WAVData::FindChunk(const char id[4]) const
+{
+	for (auto& c : chunks_)
+	{
+		if (IsFourCC(reinterpret_cast<const unsigned char*>(c.id_), id))
+		{
+			return &c;
+		}
+	}
+	return nullptr;
+}
+
 WAVLoader::WAVLoader()
 {
 }
@@ -10,42 +112,73 @@ WAVLoader::~WAVLoader()
 {
 	for (auto& w : wav_)
 	{
-		delete[] w.second.data_;
+		FreeWAVData(w.second);
 	}
 }
 
-bool SeekToFourCC(unsigned char* raw, const char fourcc[4], unsigned int& cursor, unsigned int filesize)
+bool WAVLoader::LoadWAVFile(const std::string& filename, WAVLoadMode mode)
 {
-	while (true)
+	if (IsLoaded(filename))
 	{
-		if (raw[cursor] == fourcc[0] && cursor <= (filesize - 4))
-		{
-			if (raw[cursor + 1] == fourcc[1] && raw[cursor + 2] == fourcc[2] && raw[cursor + 3] == fourcc[3])
-			{
-				cursor += 4;
-				return true;
-			}
-		}
-		cursor++;
+		return true;
+	}
 
-		if (cursor >= filesize - 3)
-		{
-			return false;
-		}
+	WAVData data = {};
+	std::unique_ptr<MappedFile> mapping;
+	if (!ReadWAVFile(filename, mode, data, mapping))
+	{
+		return false;
 	}
-	return false;
+	AddWAVFile(filename, data, std::move(mapping));
+	return true;
 }
 
-bool WAVLoader::LoadWAVFile(const std::string& filename)
+bool WAVLoader::AddWAVFile(const std::string& filename, WAVData& data, std::unique_ptr<MappedFile> mapping)
 {
-	if (wav_.find(filename) != wav_.end())
+	if (IsLoaded(filename))
 	{
-		return true;
+		FreeWAVData(data);
+		return false;
+	}
+
+	if (mapping)
+	{
+		mapping_.emplace(filename, std::move(mapping));
+	}
+	WAVData& added = wav_.emplace(filename, std::move(data)).first->second;
+	// the table owns the copy now
+	data.data_ = nullptr;
+
+	if (IsCached(added))
+	{
+		added.lru_ = lru_.insert(lru_.end(), &added);
+		stats_.residentBytes_ += added.dataSize_;
+		EnforceBudget(&added);
+	}
+	return true;
+}
+
+void WAVLoader::FreeWAVData(WAVData& data)
+{
+	if (!data.mapped_)
+	{
+		delete[] data.data_;
+	}
+	data.data_ = nullptr;
+}
+
+bool WAVLoader::ReadWAVFile(const std::string& filename, WAVLoadMode mode, WAVData& out,
+	std::unique_ptr<MappedFile>& mapping) const
+{
+	if (mode == WAVLoadMode::Mapped)
+	{
+		return ReadMappedWAVFile(filename, out, mapping);
 	}
+
 	FILE* fp;
 	errno_t result = 0;
 
-	WAVData data;
+	WAVData data = {};
 
 	result = fopen_s(&fp, filename.c_str(), "rb");
 	if (result != 0)
@@ -58,77 +191,103 @@ bool WAVLoader::LoadWAVFile(const std::string& filename)
 	try
 	{
 		// t@Cʎq`FbN
-		char fileidtf[4];
-		fread_s(fileidtf, sizeof(char) * 4, sizeof(char), 4, fp);
-		if (fileidtf[0] != 'R' || fileidtf[1] != 'I' || fileidtf[2] != 'F' || fileidtf[3] != 'F')
+		unsigned char header[RiffHeaderSize] = {};
+		fread_s(header, sizeof(header), sizeof(unsigned char), RiffHeaderSize, fp);
+		if (!CheckRiffHeader(header, filename))
 		{
-			std::wstring str = L"Oops!\n RIFF Identifier is not found in " + StringToWString(filename);
-			DisplayException::DisplayError(str.c_str());
+			fclose(fp);
 			return false;
 		}
 
-		unsigned int filesize;
-		fread_s(&filesize, sizeof(unsigned int), sizeof(unsigned int), 1, fp);
-		data.fileSize_ = filesize;
+		fseek(fp, 0, SEEK_END);
+		size_t filesize = std::min<size_t>(static_cast<size_t>(ftell(fp)),
+			static_cast<size_t>(ReadU32(&header[4])) + 8);
+		data.fileSize_ = static_cast<unsigned int>(filesize - 8);
 
-		unsigned char* raw;
-		unsigned int cursor = 0;
-		raw = new unsigned char[filesize];
-		fread_s(raw, sizeof(unsigned char) * filesize, sizeof(unsigned char), filesize, fp);
-		fclose(fp);
+		// only chunk headers are touched here, the payload is read once below
+		WalkChunks(fp, filesize, data.chunks_);
 
-		// RIFFʎq`FbN
-		char riffidtf[4];
-		std::copy(&raw[cursor], &raw[cursor + 4], riffidtf);
-		if (riffidtf[0] != 'W' || riffidtf[1] != 'A' || riffidtf[2] != 'V' || riffidtf[3] != 'E')
+		const RiffChunk* fmt = data.FindChunk(fmttag);
+		unsigned char fmtraw[FmtReadSize] = {};
+		unsigned int fmtsize = 0;
+		if (fmt != nullptr && fmt->size_ >= FmtMinSize)
 		{
-			std::wstring str = L"Oops!\n WAVE Identifier is not found in " + StringToWString(filename);
-			DisplayException::DisplayError(str.c_str());
-			return false;
+			fseek(fp, fmt->offset_, SEEK_SET);
+			fmtsize = static_cast<unsigned int>(fread_s(fmtraw, sizeof(fmtraw), sizeof(unsigned char),
+				std::min(fmt->size_, FmtReadSize), fp));
 		}
-		cursor += 4;
 
-		if (!SeekToFourCC(raw, fmttag, cursor, filesize))
+		if (!ParseChunks(fmtsize >= FmtMinSize ? fmtraw : nullptr, fmtsize, filesize, data, filename))
 		{
-			std::wstring str = L"Oops!\n fmt Identifier is not found in " + StringToWString(filename);
-			DisplayException::DisplayError(str.c_str());
+			fclose(fp);
 			return false;
 		}
 
-		std::copy(reinterpret_cast<FmtDesc*>(&raw[cursor]),
-			reinterpret_cast<FmtDesc*>(&raw[cursor + sizeof(FmtDesc)]), &data.fmt_);
-		cursor += sizeof(data.fmt_);
-
-		if (!SeekToFourCC(raw, datatag, cursor, filesize))
+		const RiffChunk* fact = data.FindChunk(facttag);
+		if (IsADPCM(data.fmt_.formatType_) && fact != nullptr && fact->size_ >= 4)
 		{
-			std::wstring str = L"Oops!\n data Identifier is not found in " + StringToWString(filename);
-			DisplayException::DisplayError(str.c_str());
-			return false;
+			unsigned char factraw[4] = {};
+			fseek(fp, fact->offset_, SEEK_SET);
+			if (fread_s(factraw, sizeof(factraw), sizeof(unsigned char), 4, fp) == 4)
+			{
+				data.frameCount_ = std::min(data.frameCount_, ReadU32(factraw));
+			}
 		}
 
-		std::copy(reinterpret_cast<unsigned int*>(&raw[cursor]),
-			reinterpret_cast<unsigned int*>(&raw[cursor + 4]), &data.dataSize_);
-		cursor += sizeof(data.dataSize_);
+		// the stream reader only copies bytes, compressed data is small enough to keep
+		if (mode == WAVLoadMode::Stream && IsADPCM(data.fmt_.formatType_))
+		{
+			mode = WAVLoadMode::Copy;
+		}
 
-		if (cursor + data.dataSize_ > filesize)
+		const bool playable = IsADPCM(data.fmt_.formatType_) || IsPlayableFormat(data.fmt_);
+		if (mode == WAVLoadMode::Stream && !playable)
 		{
-			std::wstring str = L"Oops!\n data size is not length enough in " + StringToWString(filename);
+			std::wstring str = L"Oops!\n 64 bit float cannot be streamed, load it as a copy " + StringToWString(filename);
 			DisplayException::DisplayError(str.c_str());
+			fclose(fp);
 			return false;
 		}
-		data.data_ = new unsigned char[data.dataSize_];
-		std::copy_n(&raw[cursor], data.dataSize_, data.data_);
 
-		wav_.emplace(filename, data);
-		delete[] raw;
+		if (mode == WAVLoadMode::Stream)
+		{
+			data.data_ = nullptr;
+			data.streamed_ = true;
+		}
+		else
+		{
+			data.data_ = new unsigned char[data.dataSize_];
+			fseek(fp, data.FindChunk(datatag)->offset_, SEEK_SET);
+			fread_s(data.data_, data.dataSize_, sizeof(unsigned char), data.dataSize_, fp);
+
+			const unsigned int rate = conversionRate_.load(std::memory_order_relaxed);
+			if ((mode == WAVLoadMode::Copy && rate != 0) || !playable)
+			{
+				ConvertWAVData(data, mode == WAVLoadMode::Copy ? rate : 0);
+			}
+			else if (mode == WAVLoadMode::ADPCM)
+			{
+				CompressWAVData(data);
+			}
+		}
+		fclose(fp);
+		fp = nullptr;
+		data.mapped_ = false;
+		data.mode_ = mode;
+
+		out = std::move(data);
 	}
 	catch(std::bad_alloc)
 	{
+		if (fp != nullptr) { fclose(fp); }
+		FreeWAVData(data);
 		DisplayException::DisplayError(L"Oops!\n Not enough memory :(");
 		return false;
 	}
 	catch (...)
 	{
+		if (fp != nullptr) { fclose(fp); }
+		FreeWAVData(data);
 		std::wstring str = L"Oops!\n Some happens in " + StringToWString(filename);
 		DisplayException::DisplayError(str.c_str());
 		return false;
@@ -136,20 +295,358 @@ bool WAVLoader::LoadWAVFile(const std::string& filename)
 	return true;
 }
 
+bool WAVLoader::ReadMappedWAVFile(const std::string& filename, WAVData& out, std::unique_ptr<MappedFile>& mapping) const
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(filename))
+	{
+		std::wstring str = L"Oops!\n Audio resource " + StringToWString(filename) + L"\n is not found :(";
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	const unsigned char* base = file->GetData();
+	if (file->GetSize() < RiffHeaderSize || !CheckRiffHeader(base, filename))
+	{
+		return false;
+	}
+
+	size_t filesize = std::min<size_t>(file->GetSize(), static_cast<size_t>(ReadU32(&base[4])) + 8);
+
+	WAVData data = {};
+	data.fileSize_ = static_cast<unsigned int>(filesize - 8);
+
+	WalkChunks(base, filesize, data.chunks_);
+
+	const RiffChunk* fmt = data.FindChunk(fmttag);
+	const unsigned char* fmtraw = nullptr;
+	unsigned int fmtsize = 0;
+	if (fmt != nullptr && fmt->size_ >= FmtMinSize && fmt->offset_ + FmtMinSize <= filesize)
+	{
+		fmtraw = &base[fmt->offset_];
+		fmtsize = static_cast<unsigned int>(std::min<size_t>(fmt->size_, filesize - fmt->offset_));
+	}
+
+	if (!ParseChunks(fmtraw, fmtsize, filesize, data, filename))
+	{
+		return false;
+	}
+
+	if (!IsADPCM(data.fmt_.formatType_) && !IsPlayableFormat(data.fmt_))
+	{
+		std::wstring str = L"Oops!\n 64 bit float cannot be mapped, load it as a copy " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	const RiffChunk* fact = data.FindChunk(facttag);
+	if (IsADPCM(data.fmt_.formatType_) && fact != nullptr && fact->size_ >= 4 && fact->offset_ + 4 <= filesize)
+	{
+		data.frameCount_ = std::min(data.frameCount_, ReadU32(&base[fact->offset_]));
+	}
+
+	// the view is read-only, data_ is never written through
+	data.data_ = const_cast<unsigned char*>(&base[data.FindChunk(datatag)->offset_]);
+	data.mapped_ = true;
+	data.mode_ = WAVLoadMode::Mapped;
+
+	mapping = std::move(file);
+	out = std::move(data);
+	return true;
+}
+
+bool WAVLoader::CheckRiffHeader(const unsigned char* header, const std::string& filename) const
+{
+	if (!IsFourCC(header, "RIFF"))
+	{
+		std::wstring str = L"Oops!\n RIFF Identifier is not found in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	// RIFFʎq`FbN
+	if (!IsFourCC(&header[8], "WAVE"))
+	{
+		std::wstring str = L"Oops!\n WAVE Identifier is not found in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool WAVLoader::ParseChunks(const unsigned char* fmtraw, unsigned int fmtsize, size_t filesize, WAVData& data, const std::string& filename) const
+{
+	if (fmtraw == nullptr)
+	{
+		std::wstring str = L"Oops!\n fmt Identifier is not found in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	data.fmt_.chunkSize_ = data.FindChunk(fmttag)->size_;
+	data.fmt_.formatType_ = ReadU16(&fmtraw[0]);
+	data.fmt_.channel_ = ReadU16(&fmtraw[2]);
+	data.fmt_.samplesPerSec_ = ReadU32(&fmtraw[4]);
+	data.fmt_.bytePerSec_ = ReadU32(&fmtraw[8]);
+	data.fmt_.blockAlign_ = ReadU16(&fmtraw[12]);
+	data.fmt_.bitPerSample_ = ReadU16(&fmtraw[14]);
+	data.fmt_.cbSize_ = fmtsize >= 18 ? ReadU16(&fmtraw[16]) : 0;
+	data.fmt_.extensible_ = false;
+	data.fmt_.validBitsPerSample_ = data.fmt_.bitPerSample_;
+	data.fmt_.channelMask_ = 0;
+
+	if (data.fmt_.formatType_ == WAVE_FORMAT_EXTENSIBLE)
+	{
+		if (fmtsize < ExtensibleFmtSize || std::memcmp(&fmtraw[26], SubFormatTail, sizeof(SubFormatTail)) != 0)
+		{
+			std::wstring str = L"Oops!\n Unknown sub format in " + StringToWString(filename);
+			DisplayException::DisplayError(str.c_str());
+			return false;
+		}
+		data.fmt_.extensible_ = true;
+		data.fmt_.validBitsPerSample_ = ReadU16(&fmtraw[18]);
+		data.fmt_.channelMask_ = ReadU32(&fmtraw[20]);
+		data.fmt_.formatType_ = ReadU16(&fmtraw[24]);
+	}
+
+	const bool adpcm = IsADPCM(data.fmt_.formatType_) && !data.fmt_.extensible_;
+	const bool pcm = (data.fmt_.formatType_ == WAVE_FORMAT_PCM &&
+		(data.fmt_.bitPerSample_ == 8 || data.fmt_.bitPerSample_ == 16 || data.fmt_.bitPerSample_ == 24 || data.fmt_.bitPerSample_ == 32)) ||
+		(data.fmt_.formatType_ == WAVE_FORMAT_IEEE_FLOAT && (data.fmt_.bitPerSample_ == 32 || data.fmt_.bitPerSample_ == 64));
+	if (data.fmt_.channel_ == 0 || data.fmt_.samplesPerSec_ == 0 || !(adpcm ||
+		(pcm && data.fmt_.blockAlign_ == data.fmt_.channel_ * data.fmt_.bitPerSample_ / 8)))
+	{
+		std::wstring str = L"Oops!\n Unsupported format in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	const RiffChunk* chunk = data.FindChunk(datatag);
+	if (chunk == nullptr)
+	{
+		std::wstring str = L"Oops!\n data Identifier is not found in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+
+	if (static_cast<size_t>(chunk->offset_) + chunk->size_ > filesize)
+	{
+		std::wstring str = L"Oops!\n data size is not length enough in " + StringToWString(filename);
+		DisplayException::DisplayError(str.c_str());
+		return false;
+	}
+	data.dataSize_ = chunk->size_;
+
+	if (IsADPCM(data.fmt_.formatType_))
+	{
+		// samplesPerBlock may be below what the block holds, never above
+		const unsigned int capacity = GetADPCMSamplesPerBlock(data.fmt_.formatType_, data.fmt_.blockAlign_, data.fmt_.channel_);
+		const unsigned int perBlock = fmtsize >= ADPCMFmtSize ? ReadU16(&fmtraw[18]) : capacity;
+		bool supported = capacity != 0 && perBlock != 0 && perBlock <= capacity;
+		if (data.fmt_.formatType_ == ADPCMFormatMS)
+		{
+			supported = supported && fmtsize >= MSADPCMFmtSize && IsStandardMSADPCMCoef(&fmtraw[22], ReadU16(&fmtraw[20]));
+		}
+		if (!supported)
+		{
+			std::wstring str = L"Oops!\n ADPCM format is not supported in " + StringToWString(filename);
+			DisplayException::DisplayError(str.c_str());
+			return false;
+		}
+
+		data.fmt_.samplesPerBlock_ = static_cast<unsigned short>(perBlock);
+		data.frameCount_ = GetADPCMFrameCount(data.fmt_.GetADPCMDesc(), data.dataSize_);
+	}
+	else
+	{
+		data.fmt_.samplesPerBlock_ = 0;
+		data.frameCount_ = data.fmt_.blockAlign_ != 0 ? data.dataSize_ / data.fmt_.blockAlign_ : 0;
+	}
+	return true;
+}
+
+void WAVLoader::CompressWAVData(WAVData& data) const
+{
+	if (data.fmt_.formatType_ != WAVE_FORMAT_PCM || data.fmt_.bitPerSample_ != 16 ||
+		data.fmt_.channel_ == 0 || data.fmt_.channel_ > 2)
+	{
+		return;
+	}
+
+	ADPCMDesc desc = {};
+	std::vector<unsigned char> encoded = EncodeIMAADPCM(reinterpret_cast<const int16_t*>(data.data_),
+		data.frameCount_, data.fmt_.channel_, desc);
+	if (encoded.empty()) { return; }
+
+	unsigned char* compressed = new unsigned char[encoded.size()];
+	std::copy(encoded.begin(), encoded.end(), compressed);
+	delete[] data.data_;
+	data.data_ = compressed;
+	data.dataSize_ = static_cast<unsigned int>(encoded.size());
+
+	// frameCount_ stays the PCM length, the padding of the last block is never played
+	data.fmt_.chunkSize_ = ADPCMFmtSize;
+	data.fmt_.formatType_ = desc.formatType_;
+	data.fmt_.blockAlign_ = desc.blockAlign_;
+	data.fmt_.bitPerSample_ = 4;
+	data.fmt_.samplesPerBlock_ = desc.samplesPerBlock_;
+	data.fmt_.bytePerSec_ = data.fmt_.samplesPerSec_ * desc.blockAlign_ / desc.samplesPerBlock_;
+}
+
+bool WAVLoader::ConvertWAVData(WAVData& data, unsigned int sampleRate) const
+{
+	const unsigned int channel = data.fmt_.channel_;
+	std::vector<float> samples(static_cast<size_t>(data.frameCount_) * channel);
+	if (!ConvertToFloat(data.data_, samples.size(), data.fmt_.formatType_, data.fmt_.bitPerSample_, samples.data()))
+	{
+		return false;
+	}
+
+	if (sampleRate != 0 && sampleRate != data.fmt_.samplesPerSec_)
+	{
+		samples = ResampleFloat(samples.data(), data.frameCount_, channel, data.fmt_.samplesPerSec_, sampleRate);
+		data.fmt_.samplesPerSec_ = sampleRate;
+	}
+
+	const size_t bytes = samples.size() * sizeof(float);
+	unsigned char* converted = new unsigned char[bytes];
+	std::memcpy(converted, samples.data(), bytes);
+	delete[] data.data_;
+	data.data_ = converted;
+	data.dataSize_ = static_cast<unsigned int>(bytes);
+	data.frameCount_ = static_cast<unsigned int>(samples.size() / channel);
+
+	// the channel mask stays, it still describes the channels
+	data.fmt_.chunkSize_ = FmtMinSize;
+	data.fmt_.formatType_ = WAVE_FORMAT_IEEE_FLOAT;
+	data.fmt_.cbSize_ = 0;
+	data.fmt_.extensible_ = false;
+	data.fmt_.bitPerSample_ = 32;
+	data.fmt_.validBitsPerSample_ = 32;
+	data.fmt_.blockAlign_ = static_cast<unsigned short>(channel * sizeof(float));
+	data.fmt_.bytePerSec_ = data.fmt_.samplesPerSec_ * data.fmt_.blockAlign_;
+	return true;
+}
+
 const WAVData& WAVLoader::GetWAVFile(const std::string& filename)
 {
 	if (wav_.find(filename) == wav_.end())
 	{
+		static const WAVData empty = {};
 		OutputDebugString(L"wav file not load");
-		return WAVData();
+		return empty;
 	}
 	return wav_.at(filename);
 }
 
+WAVData* WAVLoader::FindWAVFile(const std::string& filename)
+{
+	auto it = wav_.find(filename);
+	return it != wav_.end() ? &it->second : nullptr;
+}
+
 void WAVLoader::DestroyWAVFile(const std::string& filename)
 {
-	if (wav_.find(filename) == wav_.end()) { return; }
-	delete[] wav_.at(filename).data_;
+	auto it = wav_.find(filename);
+	if (it == wav_.end()) { return; }
+
+	if (IsCached(it->second) && it->second.resident_)
+	{
+		lru_.erase(it->second.lru_);
+		stats_.residentBytes_ -= it->second.dataSize_;
+	}
+
+	if (it->second.mapped_)
+	{
+		mapping_.erase(filename);
+	}
+	else
+	{
+		FreeWAVData(it->second);
+	}
+	wav_.erase(it);
+}
+
+void WAVLoader::SetBudget(size_t bytes)
+{
+	stats_.budget_ = bytes;
+	EnforceBudget(nullptr);
+}
 
-	wav_.erase(filename);
+bool WAVLoader::Acquire(WAVData& data, const std::string& filename)
+{
+	if (data.resident_)
+	{
+		stats_.hits_++;
+		if (IsCached(data))
+		{
+			// most recently played at the back
+			lru_.splice(lru_.end(), lru_, data.lru_);
+		}
+	}
+	else
+	{
+		stats_.misses_++;
+		if (!Reload(data, filename)) { return false; }
+	}
+
+	data.users_++;
+	return true;
+}
+
+bool WAVLoader::Pin(WAVData& data, const std::string& filename)
+{
+	if (!data.resident_ && !Reload(data, filename)) { return false; }
+
+	data.pins_++;
+	return true;
+}
+
+void WAVLoader::Unpin(WAVData& data)
+{
+	if (data.pins_ == 0) { return; }
+
+	data.pins_--;
+	EnforceBudget(nullptr);
+}
+
+bool WAVLoader::Reload(WAVData& data, const std::string& filename)
+{
+	WAVData fresh = {};
+	std::unique_ptr<MappedFile> mapping;
+	if (!ReadWAVFile(filename, data.mode_, fresh, mapping)) { return false; }
+
+	// the conversion may have changed since the first load
+	data.fmt_ = fresh.fmt_;
+	data.data_ = fresh.data_;
+	data.dataSize_ = fresh.dataSize_;
+	data.frameCount_ = fresh.frameCount_;
+	data.resident_ = true;
+	data.lru_ = lru_.insert(lru_.end(), &data);
+	stats_.residentBytes_ += data.dataSize_;
+
+	EnforceBudget(&data);
+	return true;
+}
+
+void WAVLoader::EnforceBudget(const WAVData* keep)
+{
+	if (stats_.budget_ == 0) { return; }
+
+	// not called from Release, a voice that was just flushed may still be read by the engine
+	for (auto it = lru_.begin(); it != lru_.end() && stats_.residentBytes_ > stats_.budget_;)
+	{
+		WAVData& d = **it;
+		if (&d == keep || d.pins_ > 0 || d.users_ > 0)
+		{
+			++it;
+			continue;
+		}
+
+		FreeWAVData(d);
+		d.resident_ = false;
+		stats_.residentBytes_ -= d.dataSize_;
+		stats_.evictions_++;
+		it = lru_.erase(it);
+	}
 }
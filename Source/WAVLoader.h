@@ -1,7 +1,14 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
 #include <unordered_map>
-#include <xaudio2.h>
+#include "Backend/AudioPlatform.h"
 #include <string>
+#include <vector>
+#include "ADPCM.h"
+#include "WAVDefines.h"
 
 struct FmtDesc
 {
@@ -12,6 +19,26 @@ struct FmtDesc
 	unsigned int bytePerSec_;
 	unsigned short blockAlign_;
 	unsigned short bitPerSample_;
+	// ADPCM only, frames in one block
+	unsigned short samplesPerBlock_;
+	// size of the extension after the 16 byte chunk, 0 when there is none
+	unsigned short cbSize_;
+	// WAVE_FORMAT_EXTENSIBLE, formatType_ then holds the tag of the sub format
+	bool extensible_;
+	// bits that carry signal inside bitPerSample_, same as bitPerSample_ outside extensible files
+	unsigned short validBitsPerSample_;
+	// speaker positions (SPEAKER_FRONT_LEFT...) of the channels, 0 when the file does not say
+	unsigned int channelMask_;
+
+	ADPCMDesc GetADPCMDesc(void) const { return ADPCMDesc{ formatType_, channel_, blockAlign_, samplesPerBlock_ }; }
+};
+
+struct RiffChunk
+{
+	char id_[4];
+	// payload position from the top of the file
+	unsigned int offset_;
+	unsigned int size_;
 };
 
 struct WAVData
@@ -20,20 +47,115 @@ struct WAVData
 	FmtDesc fmt_;
 	unsigned int dataSize_;
 	unsigned char* data_;
+	// decoded length, the fact chunk of an ADPCM file trims the padding of the last block
+	unsigned int frameCount_;
+
+	// data_ points into a file mapping owned by WAVLoader
+	bool mapped_ = false;
+	// data_ is nullptr, the data chunk stays on disk
+	bool streamed_ = false;
+
+	// every chunk of the file (fmt, data, smpl, cue, LIST, fact...) in file order
+	std::vector<RiffChunk> chunks_;
+
+	// cache bookkeeping of WAVLoader, only WAVLoadMode::Copy and ADPCM data is ever evicted
+	WAVLoadMode mode_ = WAVLoadMode::Copy;
+	// false after an eviction, data_ is nullptr until Acquire reads the file again
+	bool resident_ = true;
+	unsigned int pins_ = 0;
+	// live voices playing out of data_
+	unsigned int users_ = 0;
+	std::list<WAVData*>::iterator lru_;
+
+	const RiffChunk* FindChunk(const char id[4]) const;
+};
+
+struct WAVCacheStats
+{
+	// heap bytes of WAVLoadMode::Copy and ADPCM data chunks, mappings are paged by the OS
+	size_t residentBytes_ = 0;
+	// 0 means no limit
+	size_t budget_ = 0;
+	// Acquire served from memory
+	uint64_t hits_ = 0;
+	// Acquire that had to read an evicted file again
+	uint64_t misses_ = 0;
+	uint64_t evictions_ = 0;
+
+	double GetHitRate(void) const { return hits_ + misses_ > 0 ? static_cast<double>(hits_) / (hits_ + misses_) : 1.0; }
 };
 
+class MappedFile;
 class WAVLoader
 {
 public:
 	WAVLoader();
 	~WAVLoader();
-	bool LoadWAVFile(const std::string& filename);
+	bool LoadWAVFile(const std::string& filename, WAVLoadMode mode = WAVLoadMode::Copy);
 	const WAVData& GetWAVFile(const std::string& filename);
+	// nullptr when not loaded, the pointer stays valid until DestroyWAVFile
+	WAVData* FindWAVFile(const std::string& filename);
 	void DestroyWAVFile(const std::string& filename);
+	bool IsLoaded(const std::string& filename) const { return wav_.find(filename) != wav_.end(); }
+
+	// parses without touching the table, may run on any thread
+	// mapping receives the file mapping in WAVLoadMode::Mapped
+	bool ReadWAVFile(const std::string& filename, WAVLoadMode mode, WAVData& data,
+		std::unique_ptr<MappedFile>& mapping) const;
+	// takes over what ReadWAVFile produced, frees it instead when the file is already loaded
+	bool AddWAVFile(const std::string& filename, WAVData& data, std::unique_ptr<MappedFile> mapping);
+
+	// frees a data copy that was never added
+	static void FreeWAVData(WAVData& data);
+
+	// WAVLoadMode::Copy loads from now on are converted to 32 bit float at sampleRate, 0 keeps files as they are
+	// voices then neither convert nor resample, at up to twice the memory of 16 bit files
+	void SetConversion(unsigned int sampleRate) { conversionRate_.store(sampleRate, std::memory_order_relaxed); }
+
+	// evicts least recently acquired data, unpinned and unused, while over budget
+	// pinned or playing data may keep the loader over budget
+	void SetBudget(size_t bytes);
+
+	// a voice starts playing data, reads it again when it was evicted
+	// filename is only looked at on a miss
+	bool Acquire(WAVData& data, const std::string& filename);
+	// the voice is gone, the data stays resident until the budget needs it
+	static void Release(WAVData& data) { data.users_--; }
+
+	// pinned data is reloaded now and never evicted
+	bool Pin(WAVData& data, const std::string& filename);
+	void Unpin(WAVData& data);
+
+	const WAVCacheStats& GetCacheStats(void) const { return stats_; }
 private:
+	bool Reload(WAVData& data, const std::string& filename);
+	// keep is never evicted, it is the data being loaded
+	void EnforceBudget(const WAVData* keep);
+	bool IsCached(const WAVData& data) const
+	{
+		return (data.mode_ == WAVLoadMode::Copy || data.mode_ == WAVLoadMode::ADPCM) && !data.mapped_;
+	}
+	// WAVLoadMode::ADPCM, replaces a 16 bit PCM data_ with its IMA ADPCM encoding
+	void CompressWAVData(WAVData& data) const;
+	// replaces data_ with 32 bit float, resampled when sampleRate is not 0
+	bool ConvertWAVData(WAVData& data, unsigned int sampleRate) const;
+
+	bool ReadMappedWAVFile(const std::string& filename, WAVData& data, std::unique_ptr<MappedFile>& mapping) const;
+	bool CheckRiffHeader(const unsigned char* header, const std::string& filename) const;
+	bool ParseChunks(const unsigned char* fmtraw, unsigned int fmtsize, size_t filesize, WAVData& data, const std::string& filename) const;
+
 	std::unordered_map<std::string, WAVData> wav_;
+	std::unordered_map<std::string, std::unique_ptr<MappedFile>> mapping_;
+
+	// resident copies, least recently acquired first
+	std::list<WAVData*> lru_;
+	WAVCacheStats stats_;
+
+	// read by loads on the worker threads
+	std::atomic<unsigned int> conversionRate_ = 0;
 
 	static constexpr char fmttag[4] = { 'f', 'm', 't', ' ' };
 	static constexpr char datatag[4] = { 'd', 'a', 't', 'a' };
+	static constexpr char facttag[4] = { 'f', 'a', 'c', 't' };
 };
 
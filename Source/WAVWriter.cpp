@@ -0,0 +1,143 @@
+#include "WAVWriter.h"
+#include "Backend/AudioPlatform.h"
+#include "Backend/MixerKernels.h"
+
+namespace
+{
+	// RIFF + fmt + fact + data headers, fact only for float
+	constexpr uint32_t PCMHeaderSize = 12 + 8 + 16 + 8;
+	constexpr uint32_t FloatHeaderSize = 12 + 8 + 18 + 12 + 8;
+
+	void PutU16(unsigned char*& p, uint16_t v)
+	{
+		p[0] = static_cast<unsigned char>(v);
+		p[1] = static_cast<unsigned char>(v >> 8);
+		p += 2;
+	}
+
+	void PutU32(unsigned char*& p, uint32_t v)
+	{
+		PutU16(p, static_cast<uint16_t>(v));
+		PutU16(p, static_cast<uint16_t>(v >> 16));
+	}
+
+	void PutTag(unsigned char*& p, const char* tag)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			*p++ = static_cast<unsigned char>(tag[i]);
+		}
+	}
+}
+
+WAVWriter::~WAVWriter()
+{
+	Close();
+}
+
+bool WAVWriter::Open(const std::string& filename, unsigned int channels, unsigned int sampleRate, WAVSampleFormat format)
+{
+	Close();
+	if (channels == 0 || sampleRate == 0) { return false; }
+
+	if (fopen_s(&file_, filename.c_str(), "wb") != 0)
+	{
+		file_ = nullptr;
+		return false;
+	}
+
+	channels_ = channels;
+	sampleRate_ = sampleRate;
+	format_ = format;
+	writtenFrames_ = 0;
+	dataSize_ = 0;
+
+	// sizes are patched by Close
+	WriteHeader();
+	return true;
+}
+
+void WAVWriter::Write(const float* buffer, unsigned int frames)
+{
+	if (file_ == nullptr || frames == 0) { return; }
+
+	const size_t samples = static_cast<size_t>(frames) * channels_;
+	const size_t bytes = samples * (format_ == WAVSampleFormat::PCM16 ? sizeof(int16_t) : sizeof(float));
+
+	// RIFF sizes are 32 bit
+	if (static_cast<uint64_t>(dataSize_) + bytes + FloatHeaderSize > 0xffffffffull) { return; }
+
+	if (format_ == WAVSampleFormat::PCM16)
+	{
+		pcm_.resize(samples);
+		GetMixerKernels().floatToPcm16_(buffer, pcm_.data(), samples);
+		fwrite(pcm_.data(), sizeof(int16_t), samples, file_);
+	}
+	else
+	{
+		fwrite(buffer, sizeof(float), samples, file_);
+	}
+
+	dataSize_ += static_cast<uint32_t>(bytes);
+	writtenFrames_ += frames;
+}
+
+bool WAVWriter::Close(void)
+{
+	if (file_ == nullptr) { return false; }
+
+	// the data chunk gets a pad byte when its size is odd
+	if (dataSize_ & 1)
+	{
+		fputc(0, file_);
+	}
+
+	bool result = fseek(file_, 0, SEEK_SET) == 0;
+	if (result)
+	{
+		WriteHeader();
+	}
+	result = (ferror(file_) == 0) && result;
+
+	fclose(file_);
+	file_ = nullptr;
+	return result;
+}
+
+void WAVWriter::WriteHeader(void)
+{
+	const bool isFloat = format_ == WAVSampleFormat::Float32;
+	const uint16_t bits = isFloat ? 32 : 16;
+	const uint16_t blockAlign = static_cast<uint16_t>(channels_ * bits / 8);
+	const uint32_t headerSize = isFloat ? FloatHeaderSize : PCMHeaderSize;
+
+	unsigned char header[FloatHeaderSize];
+	unsigned char* p = header;
+
+	PutTag(p, "RIFF");
+	PutU32(p, headerSize - 8 + dataSize_ + (dataSize_ & 1));
+	PutTag(p, "WAVE");
+
+	PutTag(p, "fmt ");
+	PutU32(p, isFloat ? 18 : 16);
+	PutU16(p, isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+	PutU16(p, static_cast<uint16_t>(channels_));
+	PutU32(p, sampleRate_);
+	PutU32(p, sampleRate_ * blockAlign);
+	PutU16(p, blockAlign);
+	PutU16(p, bits);
+
+	if (isFloat)
+	{
+		// cbSize, and the frame count non-PCM files carry
+		PutU16(p, 0);
+		PutTag(p, "fact");
+		PutU32(p, 4);
+		PutU32(p, static_cast<uint32_t>(writtenFrames_));
+	}
+
+	PutTag(p, "data");
+	PutU32(p, dataSize_);
+
+	fwrite(header, 1, headerSize, file_);
+}
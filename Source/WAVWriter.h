@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "WAVDefines.h"
+
+// streams interleaved float frames into a RIFF WAVE file
+class WAVWriter
+{
+public:
+	WAVWriter() = default;
+	~WAVWriter();
+
+	bool Open(const std::string& filename, unsigned int channels, unsigned int sampleRate, WAVSampleFormat format);
+	void Write(const float* buffer, unsigned int frames);
+
+	// patches the chunk sizes, false when the file could not be finished
+	bool Close(void);
+
+	bool IsOpen(void) const { return file_ != nullptr; }
+	uint64_t GetWrittenFrames(void) const { return writtenFrames_; }
+private:
+	void WriteHeader(void);
+
+	FILE* file_ = nullptr;
+	unsigned int channels_ = 0;
+	unsigned int sampleRate_ = 0;
+	WAVSampleFormat format_ = WAVSampleFormat::PCM16;
+
+	uint64_t writtenFrames_ = 0;
+	uint32_t dataSize_ = 0;
+
+	std::vector<int16_t> pcm_;
+};
@@ -0,0 +1,70 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/ADPCM.h"
+
+// memory, decode cost and round trip error of IMA ADPCM on a 20 s stereo clip
+// the clip is synthetic, a chord with vibrato over quiet noise, so the run needs no files
+
+namespace
+{
+	double SnrDb(const std::vector<int16_t>& ref, const std::vector<int16_t>& test)
+	{
+		double signal = 0.0;
+		double error = 0.0;
+		for (size_t i = 0; i < ref.size(); i++)
+		{
+			const double d = static_cast<double>(ref[i]) - test[i];
+			signal += static_cast<double>(ref[i]) * ref[i];
+			error += d * d;
+		}
+		return 10.0 * std::log10(signal / std::max(error, 1.0));
+	}
+}
+
+int main(void)
+{
+	constexpr unsigned int Channels = 2;
+	constexpr unsigned int Frames = BenchSampleRate * 20;
+	constexpr double Pi = 3.14159265358979;
+
+	const std::vector<float> noise = MakeNoise(static_cast<size_t>(Frames) * Channels, 0.005f, 1);
+	std::vector<int16_t> pcm(static_cast<size_t>(Frames) * Channels);
+	for (unsigned int i = 0; i < Frames; i++)
+	{
+		const double t = static_cast<double>(i) / BenchSampleRate;
+		const double vibrato = 1.0 + 0.003 * std::sin(2.0 * Pi * 5.0 * t);
+		const double chord = 0.25 * std::sin(2.0 * Pi * 220.0 * vibrato * t) + 0.15 * std::sin(2.0 * Pi * 277.2 * t) +
+			0.1 * std::sin(2.0 * Pi * 329.6 * t) + 0.05 * std::sin(2.0 * Pi * 1760.0 * t);
+		for (unsigned int c = 0; c < Channels; c++)
+		{
+			const double s = chord * (c == 0 ? 1.0 : 0.8) + noise[static_cast<size_t>(i) * Channels + c];
+			pcm[static_cast<size_t>(i) * Channels + c] = static_cast<int16_t>(std::lround(s * 32767.0));
+		}
+	}
+
+	ADPCMDesc desc;
+	const std::vector<unsigned char> encoded = EncodeIMAADPCM(pcm.data(), Frames, Channels, desc);
+	const size_t pcmBytes = pcm.size() * sizeof(int16_t);
+	printf("memory   %zu -> %zu bytes (%.2fx)\n", pcmBytes, encoded.size(), static_cast<double>(pcmBytes) / encoded.size());
+
+	// block by block, as the stream ring decodes while a voice plays
+	std::vector<int16_t> decoded(static_cast<size_t>(Frames) * Channels + desc.samplesPerBlock_ * Channels);
+	const size_t blocks = encoded.size() / desc.blockAlign_;
+	const double seconds = BestOf(5, [&]()
+		{
+			size_t frame = 0;
+			for (size_t b = 0; b < blocks; b++)
+			{
+				frame += DecodeADPCMBlock(desc, &encoded[b * desc.blockAlign_], desc.blockAlign_,
+					&decoded[frame * Channels]);
+			}
+		});
+	const double ns = seconds * 1e9 / Frames;
+	printf("decode   %.1f ns per frame, %.3f%% of one core per playing voice\n", ns, ns * BenchSampleRate * 1e-7);
+
+	decoded.resize(pcm.size());
+	printf("snr      %.1f dB\n", SnrDb(pcm, decoded));
+	return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+// helpers of the benchmarks under bench/, none of this is part of the library
+// every benchmark is one file with its own main, built with all the library sources, e.g. from the repository root
+//   g++ -std=c++17 -O2 -pthread bench/EffectBench.cpp $(find Source -name '*.cpp') -o effect_bench
+// the library includes ../Utility and ../Window, so they must sit next to the repository as for any other build
+
+// output rate every benchmark runs at
+constexpr unsigned int BenchSampleRate = 48000;
+// frames of one mixer quantum at BenchSampleRate
+constexpr unsigned int BenchQuantumFrames = 480;
+
+// seconds of the fastest of runs calls of body, the least disturbed by the rest of the machine
+template<class F>
+double BestOf(unsigned int runs, F&& body)
+{
+	double best = 1e30;
+	for (unsigned int r = 0; r < runs; r++)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		body();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	}
+	return best;
+}
+
+#ifdef _WIN32
+inline double FileTimeSeconds(const FILETIME& kernel, const FILETIME& user)
+{
+	const uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+	const uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+	return (k + u) * 1e-7;
+}
+#endif
+
+// cpu seconds the calling thread has used
+inline double ThreadCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME create, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &create, &exit, &kernel, &user);
+	return FileTimeSeconds(kernel, user);
+#else
+	timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+// cpu seconds every thread of the process has used
+inline double ProcessCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME create, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+	return FileTimeSeconds(kernel, user);
+#else
+	timespec t;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+// uniform noise in [-amplitude, amplitude), the same for the same seed
+inline std::vector<float> MakeNoise(size_t count, float amplitude, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-amplitude, amplitude);
+	std::vector<float> out(count);
+	for (auto& v : out)
+	{
+		v = dist(rng);
+	}
+	return out;
+}
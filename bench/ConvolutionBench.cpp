@@ -0,0 +1,44 @@
+#include <cstdio>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/Effect/ConvolutionEngine.h"
+
+// cpu cost of the convolution engine against impulse response length and channel count
+// ns per frame per channel over 10 s of 480 frame quanta, the ir has as many channels as the output
+// the engine runs with background on, total counts its tail thread as well and render only the thread calling Process
+
+int main(void)
+{
+	constexpr unsigned int Frames = BenchSampleRate * 10;
+
+	printf("%-6s %5s   %-15s %-15s %-15s\n", "ir", "part", "1 ch", "2 ch", "6 ch");
+	printf("%-6s %5s   %-15s %-15s %-15s\n", "", "", "total / render", "total / render", "total / render");
+	for (float seconds : { 0.5f, 1.0f, 2.0f, 4.0f, 6.0f })
+	{
+		const size_t irFrames = static_cast<size_t>(seconds * BenchSampleRate);
+		unsigned int partition = 0;
+		char line[3][32];
+		unsigned int column = 0;
+		for (unsigned int ch : { 1u, 2u, 6u })
+		{
+			const std::vector<float> ir = MakeNoise(irFrames * ch, 0.1f, 1);
+			const std::vector<float> in = MakeNoise(static_cast<size_t>(Frames) * ch, 0.5f, 2);
+			std::vector<float> out(in.size());
+
+			ConvolutionEngine engine(ir.data(), irFrames, ch, ch, true);
+			partition = engine.GetPartitionFrames();
+
+			const double process = ProcessCpuSeconds();
+			const double thread = ThreadCpuSeconds();
+			for (unsigned int i = 0; i < Frames; i += BenchQuantumFrames)
+			{
+				engine.Process(&in[static_cast<size_t>(i) * ch], &out[static_cast<size_t>(i) * ch], BenchQuantumFrames);
+			}
+			const double scale = 1e9 / Frames / ch;
+			snprintf(line[column++], sizeof(line[0]), "%4.0f / %4.0f", (ProcessCpuSeconds() - process) * scale,
+				(ThreadCpuSeconds() - thread) * scale);
+		}
+		printf("%4.1f s %5u   %-15s %-15s %-15s\n", seconds, partition, line[0], line[1], line[2]);
+	}
+	return 0;
+}
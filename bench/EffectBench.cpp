@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/Effect/MixerEffect.h"
+
+// cost of every native mixer effect in ns per frame per channel, 480 frame quanta of noise
+// the equalizer has all four bands away from unity, a band at unity is skipped
+
+int main(void)
+{
+	struct
+	{
+		const char* name_;
+		AudioEffectType type_;
+	} list[] =
+	{
+		{ "VolumeMeter", AudioEffectType::VolumeMeter },
+		{ "Echo", AudioEffectType::Echo },
+		{ "Equalizer", AudioEffectType::Equalizer },
+		{ "MasteringLimiter", AudioEffectType::MasteringLimiter },
+		{ "Reverb", AudioEffectType::Reverb },
+		{ "FXReverb", AudioEffectType::FXReverb },
+	};
+
+	constexpr unsigned int Frames = BenchSampleRate * 20;
+	printf("%-17s %8s %8s   ns per frame per channel\n", "", "2 ch", "6 ch");
+	for (auto& l : list)
+	{
+		printf("%-17s", l.name_);
+		for (unsigned int ch : { 2u, 6u })
+		{
+			MixerEffect* effect = CreateMixerEffect(l.type_, ch, BenchSampleRate);
+			if (l.type_ == AudioEffectType::Equalizer)
+			{
+				FXEQ_PARAMETERS p;
+				effect->GetParameters(&p);
+				p.Gain0 = 2.0f;
+				p.Gain1 = 0.5f;
+				p.Gain2 = 1.5f;
+				p.Gain3 = 0.7f;
+				effect->SetParameters(&p);
+			}
+
+			// the same quantum again and again, copied so the effect never sees its own output
+			const std::vector<float> quantum = MakeNoise(BenchQuantumFrames * ch, 0.5f, 2);
+			std::vector<float> work(quantum.size());
+			const double seconds = BestOf(5, [&]()
+				{
+					for (unsigned int i = 0; i < Frames; i += BenchQuantumFrames)
+					{
+						std::copy(quantum.begin(), quantum.end(), work.begin());
+						effect->Process(work.data(), BenchQuantumFrames);
+					}
+				});
+			printf(" %8.2f", seconds * 1e9 / Frames / ch);
+			effect->Release();
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/Backend/MixerDevice.h"
+#include "../Source/Backend/MixerKernels.h"
+#include "../Source/Backend/SoftwareMixer.h"
+
+// cost of every mixing kernel on each instruction set this cpu runs, then a whole mix of many voices
+// the numbers quoted for the SIMD kernels come from this
+
+namespace
+{
+	const char* LevelName(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel::Scalar: return "scalar";
+		case SimdLevel::SSE2: return "sse2";
+		case SimdLevel::AVX2: return "avx2";
+		case SimdLevel::NEON: return "neon";
+		}
+		return "?";
+	}
+
+	// ns per output sample of one stereo quantum, best of 5 runs of repeat calls
+	template<class F>
+	double NsPerSample(unsigned int samples, F&& body)
+	{
+		constexpr unsigned int Repeat = 20000;
+		const double seconds = BestOf(5, [&]()
+			{
+				for (unsigned int i = 0; i < Repeat; i++)
+				{
+					body();
+				}
+			});
+		return seconds * 1e9 / (static_cast<double>(Repeat) * samples);
+	}
+
+	void KernelTable(void)
+	{
+		constexpr unsigned int Frames = BenchQuantumFrames;
+		constexpr unsigned int Channels = 2;
+		constexpr unsigned int Samples = Frames * Channels;
+
+		std::vector<int16_t> pcm16(Samples);
+		std::vector<uint8_t> pcm24(Samples * 3);
+		const std::vector<float> noise = MakeNoise(Samples * 3, 0.5f, 1);
+		for (unsigned int i = 0; i < Samples; i++)
+		{
+			pcm16[i] = static_cast<int16_t>(noise[i] * 32767.0f);
+		}
+		for (size_t i = 0; i < pcm24.size(); i++)
+		{
+			pcm24[i] = static_cast<uint8_t>(i * 151);
+		}
+		std::vector<float> dst(Frames * 8);
+		std::vector<int16_t> out16(Samples);
+		// stereo to 2, 6 and 8 outputs share the rows they have in common
+		const float matrix[8 * 2] =
+		{
+			0.7f, 0.0f, 0.0f, 0.7f, 0.5f, 0.5f, 0.3f, 0.3f, 0.6f, 0.1f, 0.1f, 0.6f, 0.4f, 0.0f, 0.0f, 0.4f,
+		};
+
+		printf("%-8s %12s %12s %12s %12s %12s %12s %12s   ns per output sample and speedup, %u stereo frames\n",
+			"", "pcm16", "pcm24", "ramp", "mix 2>2", "mix 2>6", "mix 2>8", "to pcm16", Frames);
+		constexpr unsigned int Columns = 7;
+		double scalar[Columns] = {};
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::NEON })
+		{
+			const MixerKernels* k = GetMixerKernels(level);
+			if (k == nullptr) { continue; }
+
+			const double ns[Columns] =
+			{
+				NsPerSample(Samples, [&]() { k->pcm16ToFloat_(pcm16.data(), dst.data(), Samples); }),
+				NsPerSample(Samples, [&]() { k->pcm24ToFloat_(pcm24.data(), dst.data(), Samples); }),
+				NsPerSample(Samples, [&]() { k->accumulateRamp_(noise.data(), dst.data(), Frames, Channels, 0.2f, 0.8f); }),
+				NsPerSample(Samples, [&]() { k->mixMatrix_(noise.data(), 2, dst.data(), 2, Frames, matrix, 0.2f, 0.8f); }),
+				NsPerSample(Frames * 6, [&]() { k->mixMatrix_(noise.data(), 2, dst.data(), 6, Frames, matrix, 0.2f, 0.8f); }),
+				NsPerSample(Frames * 8, [&]() { k->mixMatrix_(noise.data(), 2, dst.data(), 8, Frames, matrix, 0.2f, 0.8f); }),
+				NsPerSample(Samples, [&]() { k->floatToPcm16_(noise.data(), out16.data(), Samples); }),
+			};
+			if (level == SimdLevel::Scalar)
+			{
+				std::copy(ns, ns + Columns, scalar);
+			}
+
+			printf("%-8s", LevelName(level));
+			for (unsigned int i = 0; i < Columns; i++)
+			{
+				printf(" %5.3f %4.1fx", ns[i], scalar[i] / ns[i]);
+			}
+			printf("\n");
+		}
+		printf("dispatched: %s\n\n", LevelName(GetMixerKernels().level_));
+	}
+
+	// looping 16 bit voices at 44.1kHz, half mono and half stereo, mixed to 48kHz stereo on the offline device
+	void MixerRun(unsigned int voices)
+	{
+		constexpr unsigned int SourceRate = 44100;
+		std::vector<int16_t> tone(SourceRate * 2);
+		for (unsigned int i = 0; i < SourceRate; i++)
+		{
+			const int16_t s = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / SourceRate));
+			tone[i * 2] = s;
+			tone[i * 2 + 1] = s;
+		}
+
+		AudioBackendDesc desc;
+		desc.type_ = AudioBackendType::SoftwareMixer;
+		desc.device_ = MixerDeviceType::Offline;
+		SoftwareMixer mixer;
+		mixer.Initialize(desc);
+
+		std::vector<AudioSourceVoice*> source;
+		for (unsigned int v = 0; v < voices; v++)
+		{
+			const WORD channels = v % 2 == 0 ? 1 : 2;
+			WAVEFORMATEX format = {};
+			format.wFormatTag = WAVE_FORMAT_PCM;
+			format.nChannels = channels;
+			format.nSamplesPerSec = SourceRate;
+			format.wBitsPerSample = 16;
+			format.nBlockAlign = channels * sizeof(int16_t);
+			format.nAvgBytesPerSec = SourceRate * format.nBlockAlign;
+
+			XAUDIO2_BUFFER buffer = {};
+			buffer.AudioBytes = SourceRate * format.nBlockAlign;
+			buffer.pAudioData = reinterpret_cast<const BYTE*>(tone.data());
+			buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+
+			AudioSourceVoice* voice = mixer.CreateSourceVoice(format, 2.0f);
+			voice->SubmitSourceBuffer(buffer);
+			voice->SetVolume(1.0f / voices);
+			voice->Start();
+			source.push_back(voice);
+		}
+
+		auto& device = static_cast<OfflineMixerDevice&>(mixer.GetDevice());
+		constexpr unsigned int Seconds = 10;
+		const double seconds = BestOf(3, [&]() { device.Advance(BenchSampleRate * Seconds); });
+		printf("%u voices: %.1f ms per second of output, %.1fx real time\n", voices, seconds * 1000.0 / Seconds, Seconds / seconds);
+
+		for (auto& v : source)
+		{
+			v->DestroyVoice();
+		}
+	}
+}
+
+int main(void)
+{
+	KernelTable();
+	MixerRun(200);
+	return 0;
+}
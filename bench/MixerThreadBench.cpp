@@ -0,0 +1,141 @@
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/Backend/MixerDevice.h"
+#include "../Source/Backend/SoftwareMixer.h"
+
+// quanta per second of the software mixer against AudioBackendDesc::mixerThreads_
+// 512 looping voices over leaf submixes that feed one bus per four leaves, with filters and resampling
+// speedup needs as many free cores as threads, on fewer the extra threads only add their overhead
+
+namespace
+{
+	constexpr unsigned int Voices = 512;
+	constexpr unsigned int LeafStage = 126;
+	constexpr unsigned int BusStage = 127;
+
+	struct Graph
+	{
+		SoftwareMixer mixer_;
+		std::vector<AudioVoice*> voice_;
+
+		~Graph()
+		{
+			// sources first, they send into the submixes
+			for (auto it = voice_.rbegin(); it != voice_.rend(); ++it)
+			{
+				(*it)->DestroyVoice();
+			}
+		}
+	};
+
+	void Build(Graph& graph, unsigned int threads, unsigned int leaves, const std::vector<int16_t>& tone)
+	{
+		AudioBackendDesc desc;
+		desc.type_ = AudioBackendType::SoftwareMixer;
+		desc.device_ = MixerDeviceType::Offline;
+		desc.mixerThreads_ = threads;
+		graph.mixer_.Initialize(desc);
+
+		std::vector<AudioVoice*> bus;
+		for (unsigned int b = 0; b < (leaves + 3) / 4; b++)
+		{
+			bus.push_back(graph.mixer_.CreateSubmixVoice(2, 0, BusStage));
+		}
+		std::vector<AudioVoice*> leaf;
+		for (unsigned int l = 0; l < leaves; l++)
+		{
+			AudioVoice* v = graph.mixer_.CreateSubmixVoice(2, 0, LeafStage);
+			v->SetOutputVoices({ bus[l / 4] });
+			v->SetVolume(0.5f + 0.01f * l);
+			if (l % 3 == 0)
+			{
+				v->SetFilterParameters({ LowPassFilter, 0.3f, 1.0f });
+			}
+			leaf.push_back(v);
+		}
+		graph.voice_.insert(graph.voice_.end(), bus.begin(), bus.end());
+		graph.voice_.insert(graph.voice_.end(), leaf.begin(), leaf.end());
+
+		WAVEFORMATEX format = {};
+		format.wFormatTag = WAVE_FORMAT_PCM;
+		format.nChannels = 1;
+		format.nSamplesPerSec = 44100;
+		format.wBitsPerSample = 16;
+		format.nBlockAlign = sizeof(int16_t);
+		format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+		XAUDIO2_BUFFER buffer = {};
+		buffer.AudioBytes = static_cast<UINT32>(tone.size() * sizeof(int16_t));
+		buffer.pAudioData = reinterpret_cast<const BYTE*>(tone.data());
+		buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+
+		for (unsigned int v = 0; v < Voices; v++)
+		{
+			AudioSourceVoice* src = graph.mixer_.CreateSourceVoice(format, 2.0f);
+			src->SubmitSourceBuffer(buffer);
+			src->SetVolume(0.01f * (v % 50 + 1));
+			if (v % 7 == 0)
+			{
+				src->SetOutputVoices({ leaf[v % leaves], leaf[(v + 1) % leaves] });
+			}
+			else
+			{
+				src->SetOutputVoices({ leaf[v % leaves] });
+			}
+			if (v % 5 == 0)
+			{
+				src->SetFrequencyRatio(0.8f + 0.01f * (v % 40));
+			}
+			if (v % 11 == 0)
+			{
+				src->SetFilterParameters({ HighPassFilter, 0.2f, 1.0f });
+			}
+			src->Start();
+			graph.voice_.push_back(src);
+		}
+	}
+}
+
+int main(void)
+{
+	std::vector<int16_t> tone(44100);
+	for (size_t i = 0; i < tone.size(); i++)
+	{
+		tone[i] = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / 44100.0));
+	}
+
+	printf("%u hardware threads, %u voices\n", std::thread::hardware_concurrency(), Voices);
+	for (unsigned int leaves : { 8u, 32u, 64u })
+	{
+		std::vector<float> reference;
+		double base = 0.0;
+		for (unsigned int threads : { 1u, 2u, 4u, 8u })
+		{
+			Graph graph;
+			Build(graph, threads, leaves, tone);
+			auto& device = static_cast<OfflineMixerDevice&>(graph.mixer_.GetDevice());
+
+			// the mix is summed in the same order whatever the thread count
+			device.Render(BenchQuantumFrames * 50);
+			if (threads == 1)
+			{
+				reference = device.GetOutput();
+			}
+			const bool same = device.GetOutput() == reference;
+
+			constexpr unsigned int Quanta = 300;
+			const double seconds = BestOf(5, [&]() { device.Advance(BenchQuantumFrames * Quanta); });
+			const double qps = Quanta / seconds;
+			if (threads == 1)
+			{
+				base = qps;
+			}
+			printf("leaves %2u threads %u: %6.0f quanta/s, %.2fx of 1 thread, output %s\n", leaves, threads, qps, qps / base,
+				same ? "identical" : "DIFFERS");
+		}
+	}
+	return 0;
+}
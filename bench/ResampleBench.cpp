@@ -0,0 +1,118 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "BenchCommon.h"
+#include "../Source/Backend/MixerKernels.h"
+
+// quality and cost of the three resampling tiers, 44.1kHz sources played at 48kHz
+// the source is a sine rounded to 16 bit as a loaded sound would be, the reference is the exact sine
+
+namespace
+{
+	constexpr unsigned int SourceRate = 44100;
+	constexpr double Pi = 3.14159265358979;
+
+	using ResampleKernel = void (*)(const float*, unsigned int, uint64_t, uint64_t, float*, unsigned int);
+
+	const char* const TierName[3] = { "linear", "cubic", "sinc" };
+
+	ResampleKernel Tier(const MixerKernels& k, unsigned int tier)
+	{
+		return tier == 0 ? k.resampleLinear_ : tier == 1 ? k.resampleCubic_ : k.resampleSinc_;
+	}
+
+	// step of a voice at ratio, 32.32 fixed point in source frames per output frame
+	uint64_t Step(double ratio)
+	{
+		return static_cast<uint64_t>(ratio * SourceRate / BenchSampleRate * 4294967296.0);
+	}
+
+	double SnrDb(ResampleKernel kernel, double frequency, double semitones)
+	{
+		constexpr double Amplitude = 16000.0 / 32768.0;
+		constexpr unsigned int Frames = BenchSampleRate;
+
+		const uint64_t step = Step(std::exp2(semitones / 12.0));
+		const size_t sourceFrames = static_cast<size_t>((static_cast<double>(step) * Frames) / 4294967296.0) +
+			ResampleHistoryFrames + ResampleLookaheadFrames + 2;
+		std::vector<float> source(sourceFrames);
+		for (size_t i = 0; i < sourceFrames; i++)
+		{
+			const double t = (static_cast<double>(i) - ResampleHistoryFrames) / SourceRate;
+			source[i] = static_cast<float>(std::lround(Amplitude * 32768.0 * std::sin(2.0 * Pi * frequency * t)) / 32768.0);
+		}
+
+		std::vector<float> out(Frames);
+		kernel(source.data() + ResampleHistoryFrames, 1, 0, step, out.data(), Frames);
+
+		double signal = 0.0;
+		double error = 0.0;
+		for (unsigned int n = 0; n < Frames; n++)
+		{
+			const double position = static_cast<double>(step) * n / 4294967296.0;
+			const double ref = Amplitude * std::sin(2.0 * Pi * frequency * position / SourceRate);
+			signal += ref * ref;
+			error += (out[n] - ref) * (out[n] - ref);
+		}
+		return 10.0 * std::log10(signal / error);
+	}
+
+	// us of one stereo quantum, best of 5 runs
+	double QuantumUs(ResampleKernel kernel, const std::vector<float>& source)
+	{
+		constexpr unsigned int Repeat = 20000;
+		std::vector<float> out(BenchQuantumFrames * 2);
+		const uint64_t step = Step(1.0);
+		const double seconds = BestOf(5, [&]()
+			{
+				for (unsigned int i = 0; i < Repeat; i++)
+				{
+					kernel(source.data() + ResampleHistoryFrames * 2, 2, static_cast<uint64_t>(i & 255) << 24, step,
+						out.data(), BenchQuantumFrames);
+				}
+			});
+		return seconds * 1e6 / Repeat;
+	}
+}
+
+int main(void)
+{
+	const MixerKernels& best = GetMixerKernels();
+	printf("snr in dB, 16 bit sine at -6 dBFS, 44.1kHz -> 48kHz\n");
+	printf("%-8s %8s %8s %8s %8s\n", "", "10k", "1k", "1k +7st", "1k -12st");
+	for (unsigned int tier = 0; tier < 3; tier++)
+	{
+		const ResampleKernel kernel = Tier(best, tier);
+		printf("%-8s %8.1f %8.1f %8.1f %8.1f\n", TierName[tier], SnrDb(kernel, 10000.0, 0.0), SnrDb(kernel, 1000.0, 0.0),
+			SnrDb(kernel, 1000.0, 7.0), SnrDb(kernel, 1000.0, -12.0));
+	}
+
+	// the largest difference of the dispatched kernels from the scalar ones
+	const MixerKernels& scalar = *GetMixerKernels(SimdLevel::Scalar);
+	const std::vector<float> source = MakeNoise((BenchQuantumFrames + 64) * 2, 1.0f, 1);
+	float maxDiff = 0.0f;
+	for (unsigned int tier = 0; tier < 3; tier++)
+	{
+		std::vector<float> a(BenchQuantumFrames * 2);
+		std::vector<float> b(BenchQuantumFrames * 2);
+		Tier(scalar, tier)(source.data() + ResampleHistoryFrames * 2, 2, 12345, Step(1.0), a.data(), BenchQuantumFrames);
+		Tier(best, tier)(source.data() + ResampleHistoryFrames * 2, 2, 12345, Step(1.0), b.data(), BenchQuantumFrames);
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			maxDiff = std::max(maxDiff, std::fabs(a[i] - b[i]));
+		}
+	}
+	printf("\nlargest difference from the scalar kernels %g\n", maxDiff);
+
+	printf("\nus per %u frame stereo quantum\n", BenchQuantumFrames);
+	for (const MixerKernels* k : { &scalar, &best })
+	{
+		printf("%-8s", k == &scalar ? "scalar" : "best");
+		for (unsigned int tier = 0; tier < 3; tier++)
+		{
+			printf(" %s %.2f", TierName[tier], QuantumUs(Tier(*k, tier), source));
+		}
+		printf("\n");
+	}
+	return 0;
+}